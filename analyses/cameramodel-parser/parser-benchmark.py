@@ -0,0 +1,70 @@
+#!/usr/bin/python3
+
+r'''Compares the C cameramodel parser against ast.literal_eval()
+
+mrcal.cameramodel() reads the .cameramodel files with the C parser in
+mrcal._mrcal._read_cameramodel_string(), falling back to ast.literal_eval() if
+that fails. This script times both on the given models, and makes sure they
+produce the same data. Models containing the optimization_inputs are the
+interesting ones: they are large, and literal_eval() is slow with them.
+
+Usage:
+
+  parser-benchmark.py [--count N] model.cameramodel [model.cameramodel ...]
+
+'''
+
+import sys
+import argparse
+import ast
+import time
+import numpy as np
+
+import mrcal
+
+parser = argparse.ArgumentParser(description = __doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument('--count',
+                    type    = int,
+                    default = 20,
+                    help    = '''How many times to parse each model. Default is 20''')
+parser.add_argument('models',
+                    nargs   = '+',
+                    help    = '''The .cameramodel files to read''')
+args = parser.parse_args()
+
+
+def timeit(f):
+    t0 = time.perf_counter()
+    for i in range(args.count):
+        result = f()
+    return result, (time.perf_counter() - t0) / args.count
+
+
+for filename in args.models:
+    with open(filename, 'rb') as f:
+        s = f.read()
+
+    model_c,  dt_c  = timeit(lambda: mrcal._mrcal._read_cameramodel_string(s))
+    model_py, dt_py = timeit(lambda: ast.literal_eval(s.decode()))
+
+    # The C parser normalizes the legacy key names
+    for k0,k1 in (('distortion_model',                    'lensmodel'),
+                  ('lens_model',                          'lensmodel'),
+                  ('icam_intrinsics_optimization_inputs', 'icam_intrinsics')):
+        if k0 in model_py and not k1 in model_py:
+            model_py[k1] = model_py[k0]
+            del model_py[k0]
+
+    for k in model_c:
+        if k == 'lensmodel':
+            # The C parser always reports the canonical name
+            continue
+        if isinstance(model_c[k], np.ndarray):
+            same = np.array_equal(model_c[k], np.array(model_py[k], dtype=model_c[k].dtype).reshape(model_c[k].shape))
+        else:
+            same = model_c[k] == model_py[k]
+        if not same:
+            print(f"{filename}: key '{k}' MISMATCHED")
+
+    print(f"{filename}: {len(s)} bytes. C parser: {dt_c*1e3:.2f}ms, ast.literal_eval(): {dt_py*1e3:.2f}ms. Speedup: {dt_py/dt_c:.1f}x")
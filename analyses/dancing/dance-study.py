@@ -37,6 +37,17 @@ as an output vnl).
 If we don't want to scan any parameter, and just want a single
 uncertainty-vs-range plot, don't pass --scan.
 
+Each scanned value may be evaluated with several random seeds (--Nseeds). The
+(scanned-value, seed) jobs are independent, and are evaluated in parallel by
+--jobs worker processes. Each job is deterministic: its random numbers depend
+only on its seed, so the results don't depend on the order in which the jobs are
+evaluated. The output vnl rows are written as the jobs complete, so they may
+appear out of order. If --cache-dir is given, the results of each solve are
+stored there, keyed by everything that went into that solve. Subsequent runs
+that share some solves (to look at a different --icam-uncertainty or
+--uncertainty-at-range-sampled-..., or to extend a scan) reuse them instead of
+solving again.
+
 '''
 
 import sys
@@ -232,6 +243,25 @@ def parse_args():
                         something (--scan ... given) then by default the scan
                         evaluates 8 different values. Otherwise this is set to 1''')
 
+    parser.add_argument('--Nseeds',
+                        type=positive_int,
+                        default=1,
+                        help='''How many random seeds to evaluate for each scanned value. Each seed produces
+                        a different set of chessboard poses and observation
+                        noise. The output vnl contains the results for each
+                        seed; the plot shows the mean across the seeds. Defaults
+                        to 1''')
+    parser.add_argument('--jobs', '-j',
+                        type=positive_int,
+                        default=1,
+                        help='''How many worker processes to use to evaluate the (scanned-value, seed) jobs
+                        in parallel. Defaults to 1: everything is evaluated
+                        serially, in this process''')
+    parser.add_argument('--cache-dir',
+                        help='''If given, a directory to store the results of each solve. Solves whose
+                        configuration matches one already in the cache are read
+                        from the cache instead of being recomputed''')
+
     parser.add_argument('--hardcopy',
                         help=f'''Filename to plot into. If omitted, we make an interactive plot. This is
                         passed directly to gnuplotlib''')
@@ -261,12 +291,23 @@ elif not ( args.object_width_n  is not None and \
 # arg-parsing is done before the imports so that --help works without building
 # stuff, so that I can generate the manpages and README
 
+if args.jobs > 1:
+    # Each worker process gets one core. mrcal's own threading is controlled
+    # with the Nthreads arguments below, but the solves call into CHOLMOD and
+    # BLAS, which size their thread pools when they're loaded. So I set the
+    # limits here, before anything imports them
+    for v in ('OMP_NUM_THREADS', 'OPENBLAS_NUM_THREADS', 'MKL_NUM_THREADS'):
+        os.environ[v] = '1'
 
 import numpy as np
 import numpysane as nps
 import gnuplotlib as gp
 import copy
 import os.path
+import hashlib
+import pickle
+import multiprocessing
+import concurrent.futures
 
 # I import the LOCAL mrcal
 scriptdir = os.path.dirname(os.path.realpath(__file__))
@@ -364,9 +405,6 @@ uncertainty_at_range_samples = \
                  np.log10(uncertainty_at_range_sampled_max),
                  Nuncertainty_at_range_samples)
 
-# I want the RNG to be deterministic
-np.random.seed(0)
-
 model_intrinsics = mrcal.cameramodel(args.model)
 
 calobject_warp_true_ref = np.array((0.002, -0.005))
@@ -382,6 +420,7 @@ def solve(Ncameras,
 
           q_true_near, Rt_cam0_board_true_near,
           q_true_far,  Rt_cam0_board_true_far,
+          rng,
           fixed_frames = args.fixed_frames):
 
     q_true_near             = q_true_near            [:Nframes_near]
@@ -431,7 +470,7 @@ def solve(Ncameras,
                   axis = -5 )
 
     # apply noise
-    q += np.random.randn(*q.shape) * args.observed_pixel_uncertainty
+    q += rng.normal(size = q.shape) * args.observed_pixel_uncertainty
 
     # The observations are dense (in the data every camera sees all the
     # chessboards), but some of the observations WILL be out of bounds. I
@@ -558,6 +597,64 @@ def solve(Ncameras,
     return optimization_inputs
 
 
+def make_models_true(Ncameras):
+    r'''The cameras we're simulating: identical, arranged horizontally'''
+    return \
+        [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
+                            imagersize          = model_intrinsics.imagersize(),
+                            extrinsics_rt_toref = np.array((0,0,0,
+                                                            i*args.camera_spacing,
+                                                            0,0), dtype=float) ) \
+          for i in range(Ncameras) ]
+
+
+def solve_cached(cache_config, *solve_args):
+    r'''solve(), with the result stored in --cache-dir, if given
+
+    cache_config describes everything the solve depends on. It is hashed to
+    produce the cache key
+    '''
+
+    if args.cache_dir is None:
+        return solve(*solve_args)
+
+    # Everything the solve depends on that isn't in cache_config
+    cache_config = \
+        cache_config + \
+        ( model_intrinsics.intrinsics()[0],
+          model_intrinsics.intrinsics()[1].tolist(),
+          model_intrinsics.imagersize().tolist(),
+          calobject_warp_true_ref.tolist(),
+          args.lensmodel,
+          args.camera_spacing,
+          args.observed_pixel_uncertainty,
+          args.full_observations_only,
+          args.fixed_frames )
+    # numpy scalars are converted to plain python values, so that the key
+    # doesn't depend on how each value was computed
+    cache_config = tuple( x.item() if isinstance(x, np.generic) else x \
+                          for x in cache_config )
+    key = hashlib.sha1(repr(cache_config).encode()).hexdigest()
+    filename = f"{args.cache_dir}/{key}.pickle"
+
+    try:
+        with open(filename, "rb") as f:
+            return pickle.load(f)
+    except FileNotFoundError:
+        pass
+
+    optimization_inputs = solve(*solve_args)
+
+    # Write to a temporary file, and rename. Concurrent jobs then never see a
+    # partially-written cache entry
+    os.makedirs(args.cache_dir, exist_ok = True)
+    filename_tmp = f"{filename}.{os.getpid()}.tmp"
+    with open(filename_tmp, "wb") as f:
+        pickle.dump(optimization_inputs, f)
+    os.replace(filename_tmp, filename)
+    return optimization_inputs
+
+
 def observation_centroid(optimization_inputs, icam):
     r'''mean pixel coordinate of all non-outlier points seen by a given camera'''
 
@@ -573,15 +670,21 @@ def observation_centroid(optimization_inputs, icam):
     return np.mean(q, axis=-2)
 
 
-def eval_one_rangenear_tilt(models_true,
-                            range_near, range_far, tilt_radius,
+def eval_one_rangenear_tilt(range_near, range_far, tilt_radius,
                             object_width_n, object_height_n, object_spacing,
                             uncertainty_at_range_samples,
                             Ncameras,
-                            Nframes_near_samples, Nframes_far_samples):
+                            Nframes_near_samples, Nframes_far_samples,
+                            seed,
+                            Nthreads = 0):
 
-    # I want the RNG to be deterministic
-    np.random.seed(0)
+    # I want the RNG to be deterministic. Everything random here comes from the
+    # seed, so each (scan-value, seed) job produces the same result regardless
+    # of what else is being evaluated, or in what order. The chessboard poses
+    # are sampled with a counter-based RNG, so asking for fewer frames produces
+    # the first frames of the full set
+
+    models_true = make_models_true(Ncameras)
 
     uncertainties = np.zeros((len(Nframes_far_samples),
                               len(uncertainty_at_range_samples)),
@@ -609,7 +712,9 @@ def eval_one_rangenear_tilt(models_true,
                                                       range_near*2.,
                                                       range_near/10.)),
                                             np.max(Nframes_near_samples),
-                                            which = which)
+                                            which    = which,
+                                            seed     = 2*seed,
+                                            Nthreads = Nthreads)
     if range_far is not None:
         q_true_far, Rt_cam0_board_true_far  = \
             mrcal.synthesize_board_observations(models_true,
@@ -623,7 +728,9 @@ def eval_one_rangenear_tilt(models_true,
                                                           range_far*2.,
                                                           range_far/10.)),
                                                 np.max(Nframes_far_samples),
-                                                which = which)
+                                                which    = which,
+                                                seed     = 2*seed + 1,
+                                                Nthreads = Nthreads)
     else:
         q_true_far             = None
         Rt_cam0_board_true_far = None
@@ -633,12 +740,21 @@ def eval_one_rangenear_tilt(models_true,
         Nframes_far  = Nframes_far_samples [i_Nframes_far]
         Nframes_near = Nframes_near_samples[i_Nframes_far]
 
-        optimization_inputs = solve(Ncameras,
-                                    Nframes_near, Nframes_far,
-                                    object_spacing,
-                                    models_true,
-                                    q_true_near, Rt_cam0_board_true_near,
-                                    q_true_far,  Rt_cam0_board_true_far)
+        # The observation noise for this solve depends only on its seed and
+        # its frame counts, so a cached solve doesn't affect the others
+        optimization_inputs = \
+            solve_cached( (Ncameras,
+                           Nframes_near, Nframes_far,
+                           range_near, range_far, tilt_radius,
+                           object_width_n, object_height_n, object_spacing,
+                           seed),
+                          Ncameras,
+                          Nframes_near, Nframes_far,
+                          object_spacing,
+                          models_true,
+                          q_true_near, Rt_cam0_board_true_near,
+                          q_true_far,  Rt_cam0_board_true_far,
+                          np.random.default_rng((seed, Nframes_near, Nframes_far)))
 
         models_out = \
             [ mrcal.cameramodel( optimization_inputs = optimization_inputs,
@@ -676,14 +792,15 @@ def eval_one_rangenear_tilt(models_true,
         uncertainties[i_Nframes_far] = \
             mrcal.projection_uncertainty(pcam_samples,
                                          model,
-                                         what='worstdirection-stdev')
+                                         what     = 'worstdirection-stdev',
+                                         Nthreads = Nthreads)
 
     return uncertainties
 
 
 
-output_table_legend = 'range_uncertainty_sample Nframes_near Nframes_far Ncameras range_near range_far tilt_radius object_width_n object_spacing uncertainty'
-output_table_fmt    = '%f %d %d %d %f %f %f %d %f %f'
+output_table_legend = 'range_uncertainty_sample Nframes_near Nframes_far Ncameras range_near range_far tilt_radius object_width_n object_spacing uncertainty seed'
+output_table_fmt    = '%f %d %d %d %f %f %f %d %f %f %d'
 output_table_icol__range_uncertainty_sample = 0
 output_table_icol__Nframes_near             = 1
 output_table_icol__Nframes_far              = 2
@@ -694,11 +811,26 @@ output_table_icol__tilt_radius              = 6
 output_table_icol__object_width_n           = 7
 output_table_icol__object_spacing           = 8
 output_table_icol__uncertainty              = 9
-output_table_Ncols                          = 10
+output_table_icol__seed                     = 10
+output_table_Ncols                          = 11
+
+output_table = np.zeros( (args.Nseeds, args.Nscan_samples, Nuncertainty_at_range_samples, output_table_Ncols), dtype=float)
 
-output_table = np.zeros( (args.Nscan_samples, Nuncertainty_at_range_samples, output_table_Ncols), dtype=float)
+output_table[..., output_table_icol__range_uncertainty_sample] += uncertainty_at_range_samples
+output_table[..., output_table_icol__seed]                     += np.arange(args.Nseeds).reshape(args.Nseeds,1,1)
 
-output_table[:,:, output_table_icol__range_uncertainty_sample] += uncertainty_at_range_samples
+# Each scan branch below describes its work as a list of jobs. Each job is
+# evaluated with each seed. The jobs are evaluated after the scan has been set
+# up
+jobs = []
+def add_job(isample, *eval_args):
+    r'''Adds an evaluation job
+
+    isample indexes the scan sample whose output rows this job fills in: each
+    job produces one curve. eval_args are the arguments to
+    eval_one_rangenear_tilt(), except the seed
+    '''
+    jobs.append( (isample, eval_args) )
 
 if re.match("num_far_constant_Nframes_", args.scan):
 
@@ -715,34 +847,29 @@ if re.match("num_far_constant_Nframes_", args.scan):
                                            Nfar_samples, dtype=int)
         Nframes_near_samples = args.Nframes_all - Nframes_far_samples
 
-    models_true = \
-        [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
-                            imagersize          = model_intrinsics.imagersize(),
-                            extrinsics_rt_toref = np.array((0,0,0,
-                                                            i*args.camera_spacing,
-                                                            0,0), dtype=float) ) \
-          for i in range(controllable_args['Ncameras']['value']) ]
-
-    # shape (args.Nscan_samples, Nuncertainty_at_range_samples)
-    output_table[:,:, output_table_icol__uncertainty] = \
-        eval_one_rangenear_tilt(models_true,
-                                *controllable_args['range']['value'],
-                                controllable_args['tilt_radius']['value'],
-                                controllable_args['object_width_n']['value'],
-                                args.object_height_n,
-                                controllable_args['object_spacing']['value'],
-                                uncertainty_at_range_samples,
-                                controllable_args['Ncameras']['value'],
-                                Nframes_near_samples, Nframes_far_samples)
-
-    output_table[:,:, output_table_icol__Nframes_near]    += nps.transpose(Nframes_near_samples)
-    output_table[:,:, output_table_icol__Nframes_far]     += nps.transpose(Nframes_far_samples)
-    output_table[:,:, output_table_icol__Ncameras]        = controllable_args['Ncameras']['value']
-    output_table[:,:, output_table_icol__range_near]      = controllable_args['range']['value'][0]
-    output_table[:,:, output_table_icol__range_far]       = controllable_args['range']['value'][1]
-    output_table[:,:, output_table_icol__tilt_radius ]    = controllable_args['tilt_radius']['value']
-    output_table[:,:, output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
-    output_table[:,:, output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
+    # One job per sample. The chessboard poses come from a counter-based RNG,
+    # so each job synthesizes the same leading frames that one job producing
+    # the whole scan would
+    for i_Nframes_far in range(Nfar_samples):
+        add_job(i_Nframes_far,
+                *controllable_args['range']['value'],
+                controllable_args['tilt_radius']['value'],
+                controllable_args['object_width_n']['value'],
+                args.object_height_n,
+                controllable_args['object_spacing']['value'],
+                uncertainty_at_range_samples,
+                controllable_args['Ncameras']['value'],
+                Nframes_near_samples[i_Nframes_far:i_Nframes_far+1],
+                Nframes_far_samples [i_Nframes_far:i_Nframes_far+1])
+
+    output_table[..., output_table_icol__Nframes_near]    += nps.transpose(Nframes_near_samples)
+    output_table[..., output_table_icol__Nframes_far]     += nps.transpose(Nframes_far_samples)
+    output_table[..., output_table_icol__Ncameras]        = controllable_args['Ncameras']['value']
+    output_table[..., output_table_icol__range_near]      = controllable_args['range']['value'][0]
+    output_table[..., output_table_icol__range_far]       = controllable_args['range']['value'][1]
+    output_table[..., output_table_icol__tilt_radius ]    = controllable_args['tilt_radius']['value']
+    output_table[..., output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
+    output_table[..., output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
 
     samples = Nframes_far_samples
 
@@ -750,37 +877,28 @@ elif args.scan == "range":
     Nframes_near_samples = np.array( (controllable_args['Nframes']['value'],), dtype=int)
     Nframes_far_samples  = np.array( (0,),            dtype=int)
 
-    models_true = \
-        [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
-                            imagersize          = model_intrinsics.imagersize(),
-                            extrinsics_rt_toref = np.array((0,0,0,
-                                                            i*args.camera_spacing,
-                                                            0,0), dtype=float) ) \
-          for i in range(controllable_args['Ncameras']['value']) ]
-
     Nrange_samples = args.Nscan_samples
     range_samples = np.linspace(*controllable_args['range']['value'],
                                 Nrange_samples, dtype=float)
     for i_range in range(Nrange_samples):
-        output_table[i_range,:, output_table_icol__uncertainty] = \
-            eval_one_rangenear_tilt(models_true,
-                                    range_samples[i_range], None,
-                                    controllable_args['tilt_radius']['value'],
-                                    controllable_args['object_width_n']['value'],
-                                    args.object_height_n,
-                                    controllable_args['object_spacing']['value'],
-                                    uncertainty_at_range_samples,
-                                    controllable_args['Ncameras']['value'],
-                                    Nframes_near_samples, Nframes_far_samples)[0]
-
-    output_table[:,:, output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
-    output_table[:,:, output_table_icol__Nframes_far]  = 0
-    output_table[:,:, output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
-    output_table[:,:, output_table_icol__range_near]  += nps.transpose(range_samples)
-    output_table[:,:, output_table_icol__range_far]    = -1
-    output_table[:,:, output_table_icol__tilt_radius ] = controllable_args['tilt_radius']['value']
-    output_table[:,:, output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
-    output_table[:,:, output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
+        add_job(i_range,
+                range_samples[i_range], None,
+                controllable_args['tilt_radius']['value'],
+                controllable_args['object_width_n']['value'],
+                args.object_height_n,
+                controllable_args['object_spacing']['value'],
+                uncertainty_at_range_samples,
+                controllable_args['Ncameras']['value'],
+                Nframes_near_samples, Nframes_far_samples)
+
+    output_table[..., output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
+    output_table[..., output_table_icol__Nframes_far]  = 0
+    output_table[..., output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
+    output_table[..., output_table_icol__range_near]  += nps.transpose(range_samples)
+    output_table[..., output_table_icol__range_far]    = -1
+    output_table[..., output_table_icol__tilt_radius ] = controllable_args['tilt_radius']['value']
+    output_table[..., output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
+    output_table[..., output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
 
     samples = range_samples
 
@@ -788,37 +906,28 @@ elif args.scan == "tilt_radius":
     Nframes_near_samples = np.array( (controllable_args['Nframes']['value'],), dtype=int)
     Nframes_far_samples  = np.array( (0,),            dtype=int)
 
-    models_true = \
-        [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
-                            imagersize          = model_intrinsics.imagersize(),
-                            extrinsics_rt_toref = np.array((0,0,0,
-                                                            i*args.camera_spacing,
-                                                            0,0), dtype=float) ) \
-          for i in range(controllable_args['Ncameras']['value']) ]
-
     Ntilt_rad_samples = args.Nscan_samples
     tilt_rad_samples = np.linspace(*controllable_args['tilt_radius']['value'],
                                    Ntilt_rad_samples, dtype=float)
     for i_tilt in range(Ntilt_rad_samples):
-        output_table[i_tilt,:, output_table_icol__uncertainty] = \
-            eval_one_rangenear_tilt(models_true,
-                                    controllable_args['range']['value'], None,
-                                    tilt_rad_samples[i_tilt],
-                                    controllable_args['object_width_n']['value'],
-                                    args.object_height_n,
-                                    controllable_args['object_spacing']['value'],
-                                    uncertainty_at_range_samples,
-                                    controllable_args['Ncameras']['value'],
-                                    Nframes_near_samples, Nframes_far_samples)[0]
-
-    output_table[:,:, output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
-    output_table[:,:, output_table_icol__Nframes_far]  = 0
-    output_table[:,:, output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
-    output_table[:,:, output_table_icol__range_near]   = controllable_args['range']['value']
-    output_table[:,:, output_table_icol__range_far]    = -1
-    output_table[:,:, output_table_icol__tilt_radius] += nps.transpose(tilt_rad_samples)
-    output_table[:,:, output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
-    output_table[:,:, output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
+        add_job(i_tilt,
+                controllable_args['range']['value'], None,
+                tilt_rad_samples[i_tilt],
+                controllable_args['object_width_n']['value'],
+                args.object_height_n,
+                controllable_args['object_spacing']['value'],
+                uncertainty_at_range_samples,
+                controllable_args['Ncameras']['value'],
+                Nframes_near_samples, Nframes_far_samples)
+
+    output_table[..., output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
+    output_table[..., output_table_icol__Nframes_far]  = 0
+    output_table[..., output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
+    output_table[..., output_table_icol__range_near]   = controllable_args['range']['value']
+    output_table[..., output_table_icol__range_far]    = -1
+    output_table[..., output_table_icol__tilt_radius] += nps.transpose(tilt_rad_samples)
+    output_table[..., output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
+    output_table[..., output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
 
     samples = tilt_rad_samples
 
@@ -833,33 +942,24 @@ elif args.scan == "Ncameras":
     for i_Ncameras in range(N_Ncameras_samples):
 
         Ncameras = Ncameras_samples[i_Ncameras]
-        models_true = \
-            [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
-                                imagersize          = model_intrinsics.imagersize(),
-                                extrinsics_rt_toref = np.array((0,0,0,
-                                                                i*args.camera_spacing,
-                                                                0,0), dtype=float) ) \
-              for i in range(Ncameras) ]
-
-        output_table[i_Ncameras,:, output_table_icol__uncertainty] = \
-            eval_one_rangenear_tilt(models_true,
-                                    controllable_args['range']['value'], None,
-                                    controllable_args['tilt_radius']['value'],
-                                    controllable_args['object_width_n']['value'],
-                                    args.object_height_n,
-                                    controllable_args['object_spacing']['value'],
-                                    uncertainty_at_range_samples,
-                                    Ncameras,
-                                    Nframes_near_samples, Nframes_far_samples)[0]
-
-    output_table[:,:, output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
-    output_table[:,:, output_table_icol__Nframes_far]  = 0
-    output_table[:,:, output_table_icol__Ncameras]    += nps.transpose(Ncameras_samples)
-    output_table[:,:, output_table_icol__range_near]   = controllable_args['range']['value']
-    output_table[:,:, output_table_icol__range_far]    = -1
-    output_table[:,:, output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
-    output_table[:,:, output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
-    output_table[:,:, output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
+        add_job(i_Ncameras,
+                controllable_args['range']['value'], None,
+                controllable_args['tilt_radius']['value'],
+                controllable_args['object_width_n']['value'],
+                args.object_height_n,
+                controllable_args['object_spacing']['value'],
+                uncertainty_at_range_samples,
+                Ncameras,
+                Nframes_near_samples, Nframes_far_samples)
+
+    output_table[..., output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
+    output_table[..., output_table_icol__Nframes_far]  = 0
+    output_table[..., output_table_icol__Ncameras]    += nps.transpose(Ncameras_samples)
+    output_table[..., output_table_icol__range_near]   = controllable_args['range']['value']
+    output_table[..., output_table_icol__range_far]    = -1
+    output_table[..., output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
+    output_table[..., output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
+    output_table[..., output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
 
     samples = Ncameras_samples
 
@@ -867,14 +967,6 @@ elif args.scan == "Nframes":
 
     Nframes_far_samples  = np.array( (0,),            dtype=int)
 
-    models_true = \
-        [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
-                            imagersize          = model_intrinsics.imagersize(),
-                            extrinsics_rt_toref = np.array((0,0,0,
-                                                            i*args.camera_spacing,
-                                                            0,0), dtype=float) ) \
-          for i in range(controllable_args['Ncameras']['value']) ]
-
     N_Nframes_samples = args.Nscan_samples
     Nframes_samples = np.linspace(*controllable_args['Nframes']['value'],
                                   N_Nframes_samples, dtype=int)
@@ -883,25 +975,24 @@ elif args.scan == "Nframes":
         Nframes = Nframes_samples[i_Nframes]
         Nframes_near_samples = np.array( (Nframes,), dtype=int)
 
-        output_table[i_Nframes,:, output_table_icol__uncertainty] = \
-            eval_one_rangenear_tilt(models_true,
-                                    controllable_args['range']['value'], None,
-                                    controllable_args['tilt_radius']['value'],
-                                    controllable_args['object_width_n']['value'],
-                                    args.object_height_n,
-                                    controllable_args['object_spacing']['value'],
-                                    uncertainty_at_range_samples,
-                                    controllable_args['Ncameras']['value'],
-                                    Nframes_near_samples, Nframes_far_samples)[0]
-
-    output_table[:,:, output_table_icol__Nframes_near]+= nps.transpose(Nframes_samples)
-    output_table[:,:, output_table_icol__Nframes_far]  = 0
-    output_table[:,:, output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
-    output_table[:,:, output_table_icol__range_near]   = controllable_args['range']['value']
-    output_table[:,:, output_table_icol__range_far]    = -1
-    output_table[:,:, output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
-    output_table[:,:, output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
-    output_table[:,:, output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
+        add_job(i_Nframes,
+                controllable_args['range']['value'], None,
+                controllable_args['tilt_radius']['value'],
+                controllable_args['object_width_n']['value'],
+                args.object_height_n,
+                controllable_args['object_spacing']['value'],
+                uncertainty_at_range_samples,
+                controllable_args['Ncameras']['value'],
+                Nframes_near_samples, Nframes_far_samples)
+
+    output_table[..., output_table_icol__Nframes_near]+= nps.transpose(Nframes_samples)
+    output_table[..., output_table_icol__Nframes_far]  = 0
+    output_table[..., output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
+    output_table[..., output_table_icol__range_near]   = controllable_args['range']['value']
+    output_table[..., output_table_icol__range_far]    = -1
+    output_table[..., output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
+    output_table[..., output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
+    output_table[..., output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
 
     samples = Nframes_samples
 
@@ -910,14 +1001,6 @@ elif args.scan == "object_width_n":
     Nframes_near_samples = np.array( (controllable_args['Nframes']['value'],), dtype=int)
     Nframes_far_samples  = np.array( (0,),            dtype=int)
 
-    models_true = \
-        [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
-                            imagersize          = model_intrinsics.imagersize(),
-                            extrinsics_rt_toref = np.array((0,0,0,
-                                                            i*args.camera_spacing,
-                                                            0,0), dtype=float) ) \
-          for i in range(controllable_args['Ncameras']['value']) ]
-
     Nsamples = args.Nscan_samples
     samples  = np.linspace(*controllable_args['object_width_n']['value'],
                            Nsamples, dtype=int)
@@ -932,39 +1015,30 @@ elif args.scan == "object_width_n":
 
     for i_sample in range(Nsamples):
 
-        output_table[i_sample,:, output_table_icol__uncertainty] = \
-            eval_one_rangenear_tilt(models_true,
-                                    controllable_args['range']['value'], None,
-                                    controllable_args['tilt_radius']['value'],
-                                    samples[i_sample],
-                                    samples[i_sample],
-                                    object_spacing[i_sample],
-                                    uncertainty_at_range_samples,
-                                    controllable_args['Ncameras']['value'],
-                                    Nframes_near_samples, Nframes_far_samples)[0]
-
-    output_table[:,:, output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
-    output_table[:,:, output_table_icol__Nframes_far]  = 0
-    output_table[:,:, output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
-    output_table[:,:, output_table_icol__range_near]   = controllable_args['range']['value']
-    output_table[:,:, output_table_icol__range_far]    = -1
-    output_table[:,:, output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
-    output_table[:,:, output_table_icol__object_width_n ]+= nps.transpose(samples)
-    output_table[:,:, output_table_icol__object_spacing ]+= nps.transpose(object_spacing)
+        add_job(i_sample,
+                controllable_args['range']['value'], None,
+                controllable_args['tilt_radius']['value'],
+                samples[i_sample],
+                samples[i_sample],
+                object_spacing[i_sample],
+                uncertainty_at_range_samples,
+                controllable_args['Ncameras']['value'],
+                Nframes_near_samples, Nframes_far_samples)
+
+    output_table[..., output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
+    output_table[..., output_table_icol__Nframes_far]  = 0
+    output_table[..., output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
+    output_table[..., output_table_icol__range_near]   = controllable_args['range']['value']
+    output_table[..., output_table_icol__range_far]    = -1
+    output_table[..., output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
+    output_table[..., output_table_icol__object_width_n ]+= nps.transpose(samples)
+    output_table[..., output_table_icol__object_spacing ]+= nps.transpose(object_spacing)
 
 elif args.scan == "object_spacing":
 
     Nframes_near_samples = np.array( (controllable_args['Nframes']['value'],), dtype=int)
     Nframes_far_samples  = np.array( (0,),            dtype=int)
 
-    models_true = \
-        [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
-                            imagersize          = model_intrinsics.imagersize(),
-                            extrinsics_rt_toref = np.array((0,0,0,
-                                                            i*args.camera_spacing,
-                                                            0,0), dtype=float) ) \
-          for i in range(controllable_args['Ncameras']['value']) ]
-
     Nsamples = args.Nscan_samples
     samples  = np.linspace(*controllable_args['object_spacing']['value'],
                            Nsamples, dtype=float)
@@ -978,29 +1052,28 @@ elif args.scan == "object_spacing":
         if args.scan_object_spacing_compensate_range:
             r *= samples[i_sample]/samples[0]
 
-        output_table[i_sample,:, output_table_icol__uncertainty] = \
-            eval_one_rangenear_tilt(models_true,
-                                    r, None,
-                                    controllable_args['tilt_radius']['value'],
-                                    controllable_args['object_width_n']['value'],
-                                    args.object_height_n,
-                                    samples[i_sample],
-                                    uncertainty_at_range_samples,
-                                    controllable_args['Ncameras']['value'],
-                                    Nframes_near_samples, Nframes_far_samples)[0]
-
-    output_table[:,:, output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
-    output_table[:,:, output_table_icol__Nframes_far]  = 0
-    output_table[:,:, output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
-    output_table[:,:, output_table_icol__range_far]    = -1
-    output_table[:,:, output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
-    output_table[:,:, output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
-    output_table[:,:, output_table_icol__object_spacing ]+= nps.transpose(samples)
+        add_job(i_sample,
+                r, None,
+                controllable_args['tilt_radius']['value'],
+                controllable_args['object_width_n']['value'],
+                args.object_height_n,
+                samples[i_sample],
+                uncertainty_at_range_samples,
+                controllable_args['Ncameras']['value'],
+                Nframes_near_samples, Nframes_far_samples)
+
+    output_table[..., output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
+    output_table[..., output_table_icol__Nframes_far]  = 0
+    output_table[..., output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
+    output_table[..., output_table_icol__range_far]    = -1
+    output_table[..., output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
+    output_table[..., output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
+    output_table[..., output_table_icol__object_spacing ]+= nps.transpose(samples)
 
     if args.scan_object_spacing_compensate_range:
-        output_table[:,:, output_table_icol__range_near] += controllable_args['range']['value'] * nps.transpose(samples/samples[0])
+        output_table[..., output_table_icol__range_near] += controllable_args['range']['value'] * nps.transpose(samples/samples[0])
     else:
-        output_table[:,:, output_table_icol__range_near] = controllable_args['range']['value']
+        output_table[..., output_table_icol__range_near] = controllable_args['range']['value']
 
 else:
     # no --scan. We just want one sample
@@ -1008,38 +1081,70 @@ else:
     Nframes_near_samples = np.array( (controllable_args['Nframes']['value'],), dtype=int)
     Nframes_far_samples  = np.array( (0,),            dtype=int)
 
-    models_true = \
-        [ mrcal.cameramodel(intrinsics          = model_intrinsics.intrinsics(),
-                            imagersize          = model_intrinsics.imagersize(),
-                            extrinsics_rt_toref = np.array((0,0,0,
-                                                            i*args.camera_spacing,
-                                                            0,0), dtype=float) ) \
-          for i in range(controllable_args['Ncameras']['value']) ]
-
-    output_table[0,:, output_table_icol__uncertainty] = \
-        eval_one_rangenear_tilt(models_true,
-                                controllable_args['range']['value'], None,
-                                controllable_args['tilt_radius']['value'],
-                                controllable_args['object_width_n']['value'],
-                                args.object_height_n,
-                                controllable_args['object_spacing']['value'],
-                                uncertainty_at_range_samples,
-                                controllable_args['Ncameras']['value'],
-                                Nframes_near_samples, Nframes_far_samples)[0]
-
-    output_table[:,:, output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
-    output_table[:,:, output_table_icol__Nframes_far]  = 0
-    output_table[:,:, output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
-    output_table[:,:, output_table_icol__range_near]   = controllable_args['range']['value']
-    output_table[:,:, output_table_icol__range_far]    = -1
-    output_table[:,:, output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
-    output_table[:,:, output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
-    output_table[:,:, output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
+    add_job(0,
+            controllable_args['range']['value'], None,
+            controllable_args['tilt_radius']['value'],
+            controllable_args['object_width_n']['value'],
+            args.object_height_n,
+            controllable_args['object_spacing']['value'],
+            uncertainty_at_range_samples,
+            controllable_args['Ncameras']['value'],
+            Nframes_near_samples, Nframes_far_samples)
+
+    output_table[..., output_table_icol__Nframes_near] = controllable_args['Nframes']['value']
+    output_table[..., output_table_icol__Nframes_far]  = 0
+    output_table[..., output_table_icol__Ncameras]     = controllable_args['Ncameras']['value']
+    output_table[..., output_table_icol__range_near]   = controllable_args['range']['value']
+    output_table[..., output_table_icol__range_far]    = -1
+    output_table[..., output_table_icol__tilt_radius]  = controllable_args['tilt_radius']['value']
+    output_table[..., output_table_icol__object_width_n ] = controllable_args['object_width_n']['value']
+    output_table[..., output_table_icol__object_spacing ] = controllable_args['object_spacing']['value']
 
     samples = None
 
 
 
+def eval_job(ijob, iseed, Nthreads):
+    eval_args = jobs[ijob][1]
+    return ijob, iseed, eval_one_rangenear_tilt(*eval_args,
+                                                seed     = iseed,
+                                                Nthreads = Nthreads)
+
+def write_job_output(ijob, iseed, uncertainties):
+    r'''Fill in the output table with the result of a job, and report it'''
+    isample = jobs[ijob][0]
+    output_table[iseed,isample, :, output_table_icol__uncertainty] = uncertainties[0]
+
+    np.savetxt(sys.stdout,
+               output_table[iseed,isample].reshape(-1,output_table_Ncols),
+               fmt = output_table_fmt)
+    sys.stdout.flush()
+
+print(f"# {output_table_legend}")
+sys.stdout.flush()
+
+if args.jobs == 1 or \
+   args.show_geometry_first_solve    or \
+   args.show_uncertainty_first_solve or \
+   args.write_models_first_solve:
+    # Serial evaluation in this process. The debugging options want to
+    # interact with the first solve, so they're evaluated this way too
+    for iseed in range(args.Nseeds):
+        for ijob in range(len(jobs)):
+            write_job_output(*eval_job(ijob, iseed, 0))
+else:
+    # The workers are forked, so they see all the state set up above. Each
+    # worker gets one core
+    with concurrent.futures.ProcessPoolExecutor(max_workers = args.jobs,
+                                                mp_context  = multiprocessing.get_context('fork')) \
+                                                as executor:
+        futures = [ executor.submit(eval_job, ijob, iseed, 1) \
+                    for iseed in range(args.Nseeds) \
+                    for ijob  in range(len(jobs)) ]
+        for future in concurrent.futures.as_completed(futures):
+            write_job_output(*future.result())
+
+
 if isinstance(controllable_args['range']['value'], float):
     guides = [ f"arrow nohead dashtype 3 from {controllable_args['range']['value']},graph 0 to {controllable_args['range']['value']},graph 1" ]
 else:
@@ -1086,11 +1191,6 @@ elif samples.dtype.kind == 'i':
 else:
     legend = np.array([ f"{legend_what} = {x:.2f}" for x in samples])
 
-np.savetxt(sys.stdout,
-           nps.clump(output_table, n=2),
-           fmt   = output_table_fmt,
-           header= output_table_legend)
-
 kwargs = dict( yrange   = (0, args.ymax),
                _with    = 'lines',
                _set     = guides,
@@ -1102,8 +1202,9 @@ kwargs = dict( yrange   = (0, args.ymax),
                terminal = args.terminal,
                wait     = not args.explore and args.hardcopy is None)
 if legend is not None: kwargs['legend'] = legend
+# I plot the mean across all the seeds
 gp.plot(uncertainty_at_range_samples,
-        output_table[:,:, output_table_icol__uncertainty],
+        np.mean(output_table[..., output_table_icol__uncertainty], axis=0),
         **kwargs)
 
 if args.explore:
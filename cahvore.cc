@@ -0,0 +1,252 @@
+#include "autodiff.hh"
+
+extern "C" {
+#include "basic_geometry.h"
+}
+
+#include <stdio.h>
+
+// The CAHVORE projection, templated on the number of gradient terms. The only
+// gradients I compute are those in respect to the point being projected, so
+// NGRAD is 0 (no gradients) or 3 (dq/dp)
+template<int NGRAD>
+static bool
+project_cahvore_core( // out
+                     val_withgrad_t<NGRAD>* q,
+
+                     // in
+                     const vec_withgrad_t<NGRAD,3>& p,
+                     const double* o,
+                     // core, distortions concatenated
+                     const double* intrinsics,
+                     // if true, failures aren't reported on stderr
+                     bool quiet)
+{
+    const double fx        = intrinsics[0];
+    const double fy        = intrinsics[1];
+    const double cx        = intrinsics[2];
+    const double cy        = intrinsics[3];
+    const double r0        = intrinsics[4 + 2];
+    const double r1        = intrinsics[4 + 3];
+    const double r2        = intrinsics[4 + 4];
+    const double e0        = intrinsics[4 + 5];
+    const double e1        = intrinsics[4 + 6];
+    const double e2        = intrinsics[4 + 7];
+    const double linearity = intrinsics[4 + 8];
+
+    ///////////////// THIS IS MADE UP, AND PROBABLY WRONG
+
+    // I'm using jplv as the reference implementation for this, but that
+    // implementation can't work. In jplv project(p) and project(k*p) don't
+    // project to the same point, which they must for a valid projection
+    // function. Look at the definition of upsilon below. omega and l are
+    // proportional to the distance to the camera while the other terms are
+    // not. So if I'm looking at a point along the same observation ray, but
+    // 1000 times further out, omega and l will jump by a factor of 1000, while
+    // the other terms will not. I thus won't get the same projection result.
+    //
+    // I'm hypothesizing that they meant to normalize p, but never did it. So
+    // I'm doing that here. mrcal supports cahvore only for compatibility, so
+    // nobody's using this code. IF YOU ARE GOING TO USE THIS CODE, PLEASE
+    // CONFIRM THAT THIS CAHVORE PROJECTION IS CORRECT
+    const vec_withgrad_t<NGRAD,3> v = p / p.mag();
+
+    // cos( angle between p and o ) = inner(p,o) / (norm(o) * norm(p)) =
+    // omega/norm(p)
+    const val_withgrad_t<NGRAD> omega =
+        v.v[0]*o[0] + v.v[1]*o[1] + v.v[2]*o[2];
+
+    // Basic Computations
+
+    // Calculate initial terms
+    vec_withgrad_t<NGRAD,3> ll;
+    for(int i=0; i<3; i++) ll.v[i] = v.v[i] - omega*o[i];
+    const val_withgrad_t<NGRAD> l = ll.mag();
+
+    // Calculate theta using Newton's Method. This is an iterative process, so
+    // I do it with plain values, and compute the gradients of the result
+    // afterwards
+    double theta = atan2(l.x, omega.x);
+    double sth,cth,upsilon;
+
+    int inewton;
+    for( inewton = 100; inewton; inewton--)
+    {
+        // Compute terms from the current value of theta
+        sincos(theta, &sth, &cth);
+
+        double theta2  = theta * theta;
+        double theta3  = theta * theta2;
+        double theta4  = theta * theta3;
+        upsilon =
+            omega.x*cth + l.x*sth
+            - (1.0   - cth) * (e0 +      e1*theta2 +     e2*theta4)
+            - (theta - sth) * (      2.0*e1*theta  + 4.0*e2*theta3);
+
+        // Update theta
+        double dtheta =
+            (
+             omega.x*sth - l.x*cth
+             - (theta - sth) * (e0 + e1*theta2 + e2*theta4)
+             ) / upsilon;
+
+        theta -= dtheta;
+
+        // Check exit criterion from last update
+        if(fabs(dtheta) < 1e-8)
+            break;
+    }
+    if(inewton == 0)
+    {
+        if(!quiet)
+            fprintf(stderr, "%s(): too many iterations\n", __func__);
+        return false;
+    }
+
+    // got a theta
+
+    // Check the value of theta
+    if(theta * fabs(linearity) > M_PI/2.)
+    {
+        if(!quiet)
+            fprintf(stderr, "%s(): theta out of bounds\n", __func__);
+        return false;
+    }
+
+    // If we aren't close enough to use the small-angle approximation ...
+    if (theta > 1e-8)
+    {
+        // The Newton iterations solved f(theta; omega,l) = 0 with
+        //
+        //   f = omega sin(theta) - l cos(theta) - (theta - sin(theta)) (e0 + e1 theta^2 + e2 theta^4)
+        //
+        // So by the implicit function theorem, dtheta = -(df/domega domega +
+        // df/dl dl) / (df/dtheta), and df/dtheta = upsilon. I evaluate it at
+        // the final theta
+        sincos(theta, &sth, &cth);
+        {
+            double theta2  = theta * theta;
+            double theta3  = theta * theta2;
+            double theta4  = theta * theta3;
+            upsilon =
+                omega.x*cth + l.x*sth
+                - (1.0   - cth) * (e0 +      e1*theta2 +     e2*theta4)
+                - (theta - sth) * (      2.0*e1*theta  + 4.0*e2*theta3);
+        }
+        val_withgrad_t<NGRAD> thetag(theta);
+        for(int i=0; i<NGRAD; i++)
+            thetag.j[i] = (cth*l.j[i] - sth*omega.j[i]) / upsilon;
+
+        // ... do more math!
+        val_withgrad_t<NGRAD> linth = thetag * linearity;
+        val_withgrad_t<NGRAD> chi;
+        if (linearity < -1e-15)
+            chi = linth.sin() / linearity;
+        else if (linearity > 1e-15)
+            chi = linth.sin() / linth.cos() / linearity;
+        else
+            chi = thetag;
+
+        const val_withgrad_t<NGRAD> chi2 = chi * chi;
+        const val_withgrad_t<NGRAD> chi4 = chi2 * chi2;
+
+        const val_withgrad_t<NGRAD> zetap = l / chi;
+
+        const val_withgrad_t<NGRAD> mu = chi2*r1 + chi4*r2 + r0;
+
+        vec_withgrad_t<NGRAD,3> u;
+        for(int i=0; i<3; i++)
+            u.v[i] = zetap*o[i] + ll.v[i]*(mu + 1.);
+
+        // now I apply a normal projection to the warped 3d point p
+        q[0] = u.v[0] / u.v[2] * fx + cx;
+        q[1] = u.v[1] / u.v[2] * fy + cy;
+    }
+    else
+    {
+        // now I apply a normal projection to the warped 3d point p
+        q[0] = v.v[0] / v.v[2] * fx + cx;
+        q[1] = v.v[1] / v.v[2] * fy + cy;
+    }
+    return true;
+}
+
+// NOT A PART OF THE EXTERNAL API. This is exported for the mrcal python wrapper
+// only
+extern "C"
+bool _mrcal_project_internal_cahvore( // out
+                                     mrcal_point2_t* q,
+
+                                     // Stored as a row-first array of shape
+                                     // (N,2,3). Each row lives in a
+                                     // mrcal_point3_t. May be NULL
+                                     mrcal_point3_t* dq_dp,
+
+                                     // in
+                                     const mrcal_point3_t* p,
+                                     int N,
+
+                                     // core, distortions concatenated
+                                     const double* intrinsics,
+
+                                     // If true, points that can't be
+                                     // projected aren't reported on stderr.
+                                     // We still return false
+                                     bool quiet)
+{
+    // Apply a CAHVORE warp to an un-distorted point
+
+    //  Given intrinsic parameters of a CAHVORE model and a set of
+    //  camera-coordinate points, return the projected point(s)
+
+    // This comes from cmod_cahvore_3d_to_2d_general() in
+    // m-jplv/libcmod/cmod_cahvore.c
+    //
+    // The lack of documentation here comes directly from the lack of
+    // documentation in that function.
+
+    // I parametrize the optical axis such that
+    // - o(alpha=0, beta=0) = (0,0,1) i.e. the optical axis is at the center
+    //   if both parameters are 0
+    // - The gradients are cartesian. I.e. do/dalpha and do/dbeta are both
+    //   NOT 0 at (alpha=0,beta=0). This would happen at the poles (gimbal
+    //   lock), and that would make my solver unhappy
+    // So o = { s_al*c_be, s_be,  c_al*c_be }
+    const double alpha = intrinsics[4 + 0];
+    const double beta  = intrinsics[4 + 1];
+
+    double sa,ca;
+    sincos(alpha, &sa, &ca);
+    double sb,cb;
+    sincos(beta, &sb, &cb);
+
+    const double o[] ={ cb * sa, sb, cb * ca };
+
+    for(int i_pt=0; i_pt<N; i_pt++)
+    {
+        if(dq_dp == NULL)
+        {
+            vec_withgrad_t<0,3> pg(p[i_pt].xyz);
+            val_withgrad_t<0>   qg[2];
+            if(!project_cahvore_core<0>(qg, pg, o, intrinsics, quiet))
+                return false;
+            q[i_pt].x = qg[0].x;
+            q[i_pt].y = qg[1].x;
+        }
+        else
+        {
+            vec_withgrad_t<3,3> pg(p[i_pt].xyz, 0);
+            val_withgrad_t<3>   qg[2];
+            if(!project_cahvore_core<3>(qg, pg, o, intrinsics, quiet))
+                return false;
+            q[i_pt].x = qg[0].x;
+            q[i_pt].y = qg[1].x;
+            for(int i=0; i<3; i++)
+            {
+                dq_dp[2*i_pt + 0].xyz[i] = qg[0].j[i];
+                dq_dp[2*i_pt + 1].xyz[i] = qg[1].j[i];
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,741 @@
+// A parser for the .cameramodel files
+//
+// The models are stored as python dict literals. This is a hand-written
+// recursive-descent parser for the subset of the python syntax that the
+// cameramodels use:
+//
+// - The top level is a dict {...} of string keys
+// - Values are strings ('...' or "..."), byte strings (b'...'), numbers, lists
+//   [...] or tuples (...) of values, or True/False/None
+// - # comments, arbitrary whitespace and trailing commas are allowed
+//
+// The keys that mrcal knows about are read into a mrcal_cameramodel_t.
+// Everything else is syntax-checked, and ignored
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "mrcal.h"
+
+#define MSG(fmt, ...) fprintf(stderr, "%s(%d): " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
+
+typedef enum
+{
+    TOKEN_EOF = 0,
+    TOKEN_PUNCTUATION, // one of {}[]():,
+    TOKEN_STRING,
+    TOKEN_BYTES,
+    TOKEN_NUMBER,
+    TOKEN_IDENTIFIER   // True, False, None
+} token_type_t;
+
+typedef struct
+{
+    token_type_t type;
+
+    // The token text. For strings this is the contents between the quotes,
+    // with the escapes NOT yet processed
+    const char*  start;
+    int          len;
+
+    char         punctuation;
+
+    double       number;
+    bool         number_is_integer;
+} token_t;
+
+typedef struct
+{
+    const char* string;
+    int         len;
+    int         i;
+    int         line;
+
+    // The current token. The parser looks at this, and calls next_token() to
+    // advance
+    token_t     token;
+} parser_t;
+
+// A growable array of doubles
+typedef struct
+{
+    double* x;
+    int     N;
+    int     Nallocated;
+} doubles_t;
+
+static bool doubles_push(doubles_t* d, double x)
+{
+    if(d->N == d->Nallocated)
+    {
+        int     Nallocated = d->Nallocated > 0 ? 2*d->Nallocated : 16;
+        double* x_new      = realloc(d->x, Nallocated*sizeof(double));
+        if(x_new == NULL)
+        {
+            MSG("Couldn't allocate memory");
+            return false;
+        }
+        d->x          = x_new;
+        d->Nallocated = Nallocated;
+    }
+    d->x[d->N++] = x;
+    return true;
+}
+
+static void parse_error(const parser_t* p, const char* what)
+{
+    MSG("Error parsing cameramodel on line %d: %s", p->line, what);
+}
+
+static bool skip_whitespace_and_comments(parser_t* p)
+{
+    while(p->i < p->len)
+    {
+        const char c = p->string[p->i];
+        if(c == '\n')
+        {
+            p->line++;
+            p->i++;
+        }
+        else if(c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v')
+            p->i++;
+        else if(c == '#')
+        {
+            while(p->i < p->len && p->string[p->i] != '\n')
+                p->i++;
+        }
+        else
+            return true;
+    }
+    return true;
+}
+
+// Reads the next token into p->token. Returns false on a lexer error
+static bool next_token(parser_t* p)
+{
+    skip_whitespace_and_comments(p);
+
+    token_t* t = &p->token;
+    *t = (token_t){};
+
+    if(p->i >= p->len)
+    {
+        t->type = TOKEN_EOF;
+        return true;
+    }
+
+    const char c = p->string[p->i];
+
+    if(strchr("{}[]():,", c) != NULL)
+    {
+        t->type        = TOKEN_PUNCTUATION;
+        t->punctuation = c;
+        t->start       = &p->string[p->i];
+        t->len         = 1;
+        p->i++;
+        return true;
+    }
+
+    if(c == '\'' || c == '"' ||
+       ((c == 'b' || c == 'B') &&
+        p->i+1 < p->len &&
+        (p->string[p->i+1] == '\'' || p->string[p->i+1] == '"')))
+    {
+        if(c == 'b' || c == 'B')
+        {
+            t->type = TOKEN_BYTES;
+            p->i++;
+        }
+        else
+            t->type = TOKEN_STRING;
+
+        const char quote = p->string[p->i++];
+        t->start = &p->string[p->i];
+        while(true)
+        {
+            if(p->i >= p->len || p->string[p->i] == '\n')
+            {
+                parse_error(p, "Unterminated string");
+                return false;
+            }
+            if(p->string[p->i] == '\\')
+            {
+                // Skip the escaped character. Escaped newlines continue the
+                // string on the next line
+                if(p->i+1 < p->len && p->string[p->i+1] == '\n')
+                    p->line++;
+                p->i += 2;
+                continue;
+            }
+            if(p->string[p->i] == quote)
+                break;
+            p->i++;
+        }
+        t->len = (int)(&p->string[p->i] - t->start);
+        p->i++; // the closing quote
+        return true;
+    }
+
+    if(c == '-' || c == '+' || c == '.' || (c >= '0' && c <= '9'))
+    {
+        t->type              = TOKEN_NUMBER;
+        t->start             = &p->string[p->i];
+        t->number_is_integer = true;
+        while(p->i < p->len)
+        {
+            const char d = p->string[p->i];
+            if(d == '.' || d == 'e' || d == 'E')
+                t->number_is_integer = false;
+            else if(!((d >= '0' && d <= '9') || d == '-' || d == '+'))
+                break;
+            p->i++;
+        }
+        t->len = (int)(&p->string[p->i] - t->start);
+
+        // strtod() needs a \0-terminated string
+        char buf[64];
+        if(t->len >= (int)sizeof(buf))
+        {
+            parse_error(p, "Number too long");
+            return false;
+        }
+        memcpy(buf, t->start, t->len);
+        buf[t->len] = '\0';
+        char* end;
+        t->number = strtod(buf, &end);
+        if(end != &buf[t->len])
+        {
+            parse_error(p, "Couldn't parse number");
+            return false;
+        }
+        return true;
+    }
+
+    if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+    {
+        t->type  = TOKEN_IDENTIFIER;
+        t->start = &p->string[p->i];
+        while(p->i < p->len &&
+              ((p->string[p->i] >= 'a' && p->string[p->i] <= 'z') ||
+               (p->string[p->i] >= 'A' && p->string[p->i] <= 'Z') ||
+               (p->string[p->i] >= '0' && p->string[p->i] <= '9') ||
+               p->string[p->i] == '_'))
+            p->i++;
+        t->len = (int)(&p->string[p->i] - t->start);
+        if(!((t->len == 4 && 0 == strncmp(t->start, "True",  4)) ||
+             (t->len == 5 && 0 == strncmp(t->start, "False", 5)) ||
+             (t->len == 4 && 0 == strncmp(t->start, "None",  4))))
+        {
+            parse_error(p, "Unexpected identifier. Only True, False, None are allowed");
+            return false;
+        }
+        return true;
+    }
+
+    parse_error(p, "Unexpected character");
+    return false;
+}
+
+static bool is_punctuation(const parser_t* p, char c)
+{
+    return p->token.type == TOKEN_PUNCTUATION && p->token.punctuation == c;
+}
+
+static bool expect_punctuation(parser_t* p, char c)
+{
+    if(!is_punctuation(p, c))
+    {
+        char what[64];
+        snprintf(what, sizeof(what), "Expected '%c'", c);
+        parse_error(p, what);
+        return false;
+    }
+    return next_token(p);
+}
+
+// Decode the escapes in a string token. The output is written to "out", which
+// must have room for token.len+1 bytes. Returns the decoded length. The python
+// escapes are supported, except for the unicode ones
+static int decode_string(char* out, const token_t* t)
+{
+    int n = 0;
+    for(int i=0; i<t->len; i++)
+    {
+        if(t->start[i] != '\\' || i+1 >= t->len)
+        {
+            out[n++] = t->start[i];
+            continue;
+        }
+
+        i++;
+        const char c = t->start[i];
+        switch(c)
+        {
+        case '\n': break;
+        case '\\': out[n++] = '\\'; break;
+        case '\'': out[n++] = '\''; break;
+        case '"':  out[n++] = '"';  break;
+        case 'a':  out[n++] = '\a'; break;
+        case 'b':  out[n++] = '\b'; break;
+        case 'f':  out[n++] = '\f'; break;
+        case 'n':  out[n++] = '\n'; break;
+        case 'r':  out[n++] = '\r'; break;
+        case 't':  out[n++] = '\t'; break;
+        case 'v':  out[n++] = '\v'; break;
+        case 'x':
+            if(i+2 < t->len)
+            {
+                char hex[3] = { t->start[i+1], t->start[i+2], '\0' };
+                char* end;
+                long  x = strtol(hex, &end, 16);
+                if(end == &hex[2])
+                {
+                    out[n++] = (char)x;
+                    i += 2;
+                    break;
+                }
+            }
+            // fallthrough
+        default:
+            // Unknown escapes are left alone, like python does
+            out[n++] = '\\';
+            out[n++] = c;
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+// Skips over any value
+static bool skip_value(parser_t* p)
+{
+    if(p->token.type == TOKEN_STRING ||
+       p->token.type == TOKEN_BYTES  ||
+       p->token.type == TOKEN_NUMBER ||
+       p->token.type == TOKEN_IDENTIFIER)
+        return next_token(p);
+
+    if(is_punctuation(p, '[') || is_punctuation(p, '('))
+    {
+        const char close = is_punctuation(p, '[') ? ']' : ')';
+        if(!next_token(p)) return false;
+        while(!is_punctuation(p, close))
+        {
+            if(!skip_value(p)) return false;
+            if(is_punctuation(p, ','))
+            {
+                if(!next_token(p)) return false;
+            }
+            else if(!is_punctuation(p, close))
+            {
+                parse_error(p, "Expected ',' or the end of the list");
+                return false;
+            }
+        }
+        return next_token(p);
+    }
+
+    if(is_punctuation(p, '{'))
+    {
+        if(!next_token(p)) return false;
+        while(!is_punctuation(p, '}'))
+        {
+            if(!skip_value(p))                return false;
+            if(!expect_punctuation(p, ':'))   return false;
+            if(!skip_value(p))                return false;
+            if(is_punctuation(p, ','))
+            {
+                if(!next_token(p)) return false;
+            }
+            else if(!is_punctuation(p, '}'))
+            {
+                parse_error(p, "Expected ',' or the end of the dict");
+                return false;
+            }
+        }
+        return next_token(p);
+    }
+
+    parse_error(p, "Expected a value");
+    return false;
+}
+
+// Reads a flat list of numbers: [1,2,3] or (1,2,3). If all_integers is
+// non-NULL, it's set to true iff all the numbers were integers
+static bool parse_numbers(// out
+                          doubles_t* d,
+                          bool*      all_integers,
+                          // in
+                          parser_t*  p)
+{
+    if(!is_punctuation(p, '[') && !is_punctuation(p, '('))
+    {
+        parse_error(p, "Expected a list of numbers");
+        return false;
+    }
+    const char close = is_punctuation(p, '[') ? ']' : ')';
+    if(!next_token(p)) return false;
+
+    d->N = 0;
+    if(all_integers != NULL) *all_integers = true;
+    while(!is_punctuation(p, close))
+    {
+        if(p->token.type != TOKEN_NUMBER)
+        {
+            parse_error(p, "Expected a number");
+            return false;
+        }
+        if(!doubles_push(d, p->token.number)) return false;
+        if(all_integers != NULL && !p->token.number_is_integer)
+            *all_integers = false;
+        if(!next_token(p)) return false;
+
+        if(is_punctuation(p, ','))
+        {
+            if(!next_token(p)) return false;
+        }
+        else if(!is_punctuation(p, close))
+        {
+            parse_error(p, "Expected ',' or the end of the list");
+            return false;
+        }
+    }
+    return next_token(p);
+}
+
+// Reads a list of (x,y) pairs: [[x,y], [x,y], ...]. Stored flattened in d
+static bool parse_points2(// out
+                          doubles_t* d,
+                          // in
+                          parser_t*  p)
+{
+    if(!is_punctuation(p, '[') && !is_punctuation(p, '('))
+    {
+        parse_error(p, "Expected a list of points");
+        return false;
+    }
+    const char close = is_punctuation(p, '[') ? ']' : ')';
+    if(!next_token(p)) return false;
+
+    d->N = 0;
+    doubles_t point = {};
+    bool result = false;
+    while(!is_punctuation(p, close))
+    {
+        if(!parse_numbers(&point, NULL, p)) goto done;
+        if(point.N != 2)
+        {
+            parse_error(p, "Each point must contain exactly 2 values");
+            goto done;
+        }
+        if(!doubles_push(d, point.x[0]) ||
+           !doubles_push(d, point.x[1])) goto done;
+
+        if(is_punctuation(p, ','))
+        {
+            if(!next_token(p)) goto done;
+        }
+        else if(!is_punctuation(p, close))
+        {
+            parse_error(p, "Expected ',' or the end of the list");
+            goto done;
+        }
+    }
+    result = next_token(p);
+
+ done:
+    free(point.x);
+    return result;
+}
+
+static bool key_is(const token_t* t, const char* key)
+{
+    return (int)strlen(key) == t->len && 0 == strncmp(t->start, key, t->len);
+}
+
+mrcal_cameramodel_t* mrcal_read_cameramodel_string(const char* string, int len)
+{
+    mrcal_cameramodel_t* result = NULL;
+
+    if(len <= 0)
+        len = (int)strlen(string);
+
+    parser_t p = { .string = string,
+                   .len    = len,
+                   .line   = 1 };
+
+    // The keys I care about. Each token_t refers to the value in the string.
+    // The legacy key names are accepted only if the current ones aren't given
+    token_t lensmodel                    = {};
+    token_t lensmodel_legacy             = {};
+    token_t optimization_inputs          = {};
+    token_t projection_uncertainty_cache = {};
+    doubles_t intrinsics                 = {};
+    doubles_t extrinsics                 = {};
+    doubles_t imagersize                 = {};
+    doubles_t valid_intrinsics_region    = {};
+    bool have_intrinsics                 = false;
+    bool have_extrinsics                 = false;
+    bool have_imagersize                 = false;
+    bool have_valid_intrinsics_region    = false;
+    bool imagersize_all_integers         = false;
+    int  icam_intrinsics                 = -1;
+    int  icam_intrinsics_legacy          = -1;
+
+    if(!next_token(&p))               goto done;
+    if(!expect_punctuation(&p, '{'))  goto done;
+
+    while(!is_punctuation(&p, '}'))
+    {
+        if(p.token.type != TOKEN_STRING)
+        {
+            parse_error(&p, "Expected a string key");
+            goto done;
+        }
+        const token_t key = p.token;
+        if(!next_token(&p))              goto done;
+        if(!expect_punctuation(&p, ':')) goto done;
+
+        if(key_is(&key, "lensmodel") ||
+           key_is(&key, "lens_model") ||
+           key_is(&key, "distortion_model"))
+        {
+            if(p.token.type != TOKEN_STRING)
+            {
+                parse_error(&p, "The lensmodel must be a string");
+                goto done;
+            }
+            if(key_is(&key, "lensmodel")) lensmodel        = p.token;
+            else                          lensmodel_legacy = p.token;
+            if(!next_token(&p)) goto done;
+        }
+        else if(key_is(&key, "intrinsics"))
+        {
+            if(!parse_numbers(&intrinsics, NULL, &p)) goto done;
+            have_intrinsics = true;
+        }
+        else if(key_is(&key, "extrinsics"))
+        {
+            if(!parse_numbers(&extrinsics, NULL, &p)) goto done;
+            have_extrinsics = true;
+        }
+        else if(key_is(&key, "imagersize"))
+        {
+            if(!parse_numbers(&imagersize, &imagersize_all_integers, &p)) goto done;
+            have_imagersize = true;
+        }
+        else if(key_is(&key, "valid_intrinsics_region"))
+        {
+            if(!parse_points2(&valid_intrinsics_region, &p)) goto done;
+            have_valid_intrinsics_region = true;
+        }
+        else if(key_is(&key, "icam_intrinsics") ||
+                key_is(&key, "icam_intrinsics_optimization_inputs"))
+        {
+            if(p.token.type != TOKEN_NUMBER || !p.token.number_is_integer ||
+               p.token.number < 0 || p.token.number > INT_MAX)
+            {
+                parse_error(&p, "icam_intrinsics must be an integer >= 0");
+                goto done;
+            }
+            if(key_is(&key, "icam_intrinsics")) icam_intrinsics        = (int)p.token.number;
+            else                                icam_intrinsics_legacy = (int)p.token.number;
+            if(!next_token(&p)) goto done;
+        }
+        else if(key_is(&key, "optimization_inputs") ||
+                key_is(&key, "projection_uncertainty_cache"))
+        {
+            if(p.token.type != TOKEN_BYTES)
+            {
+                parse_error(&p, "optimization_inputs and projection_uncertainty_cache must be byte strings");
+                goto done;
+            }
+            if(key_is(&key, "optimization_inputs")) optimization_inputs          = p.token;
+            else                                    projection_uncertainty_cache = p.token;
+            if(!next_token(&p)) goto done;
+        }
+        else if(!skip_value(&p))
+            goto done;
+
+        if(is_punctuation(&p, ','))
+        {
+            if(!next_token(&p)) goto done;
+        }
+        else if(!is_punctuation(&p, '}'))
+        {
+            parse_error(&p, "Expected ',' or the end of the dict");
+            goto done;
+        }
+    }
+    if(!next_token(&p)) goto done;
+    if(p.token.type != TOKEN_EOF)
+    {
+        parse_error(&p, "Unexpected data after the end of the model");
+        goto done;
+    }
+
+    if(lensmodel.start == NULL)
+        lensmodel = lensmodel_legacy;
+    if(icam_intrinsics < 0)
+        icam_intrinsics = icam_intrinsics_legacy;
+
+    if(lensmodel.start == NULL || !have_intrinsics || !have_extrinsics || !have_imagersize)
+    {
+        MSG("A cameramodel must have at least these keys: 'lensmodel','intrinsics','extrinsics','imagersize'");
+        goto done;
+    }
+
+    // The lens model. The legacy models are named DISTORTION_... instead of
+    // LENSMODEL_...
+    char lensmodel_name[256];
+    if(lensmodel.len + 16 > (int)sizeof(lensmodel_name))
+    {
+        MSG("The lens model name is too long");
+        goto done;
+    }
+    decode_string(lensmodel_name, &lensmodel);
+    if(0 == strncmp(lensmodel_name, "DISTORTION_", strlen("DISTORTION_")))
+    {
+        // "LENSMODEL_" is shorter than "DISTORTION_", so I can do this in-place
+        memmove(&lensmodel_name[strlen("LENSMODEL_")],
+                &lensmodel_name[strlen("DISTORTION_")],
+                strlen(lensmodel_name) - strlen("DISTORTION_") + 1);
+        memcpy(lensmodel_name, "LENSMODEL_", strlen("LENSMODEL_"));
+    }
+    mrcal_lensmodel_t lensmodel_parsed = mrcal_lensmodel_from_name(lensmodel_name);
+    if(!mrcal_lensmodel_type_is_valid(lensmodel_parsed.type))
+    {
+        MSG("Couldn't parse the lens model '%s'", lensmodel_name);
+        goto done;
+    }
+    const int Nintrinsics = mrcal_lensmodel_num_params(lensmodel_parsed);
+    if(intrinsics.N != Nintrinsics)
+    {
+        MSG("The lens model '%s' has %d parameters, but the intrinsics contain %d values",
+            lensmodel_name, Nintrinsics, intrinsics.N);
+        goto done;
+    }
+    if(extrinsics.N != 6)
+    {
+        MSG("The extrinsics must contain 6 values. Got %d", extrinsics.N);
+        goto done;
+    }
+    if(imagersize.N != 2 || !imagersize_all_integers ||
+       imagersize.x[0] <= 0 || imagersize.x[1] <= 0 ||
+       imagersize.x[0] > UINT_MAX || imagersize.x[1] > UINT_MAX)
+    {
+        MSG("The imagersize must contain two positive integers");
+        goto done;
+    }
+
+    // Everything is stored in one block: the structure, the intrinsics, the
+    // valid-intrinsics region, and the byte strings
+    const int Nvalid_intrinsics_region = valid_intrinsics_region.N / 2;
+    size_t size =
+        sizeof(mrcal_cameramodel_t) +
+        Nintrinsics              * sizeof(double) +
+        Nvalid_intrinsics_region * sizeof(mrcal_point2_t);
+    if(optimization_inputs.start != NULL)
+        size += optimization_inputs.len + 1;
+    if(projection_uncertainty_cache.start != NULL)
+        size += projection_uncertainty_cache.len + 1;
+
+    result = malloc(size);
+    if(result == NULL)
+    {
+        MSG("Couldn't allocate the cameramodel");
+        goto done;
+    }
+    *result = (mrcal_cameramodel_t){ .imagersize      = { (unsigned int)imagersize.x[0],
+                                                          (unsigned int)imagersize.x[1] },
+                                     .lensmodel       = lensmodel_parsed,
+                                     .icam_intrinsics = icam_intrinsics };
+    memcpy(result->rt_cam_ref, extrinsics.x, 6*sizeof(double));
+    memcpy(result->intrinsics, intrinsics.x, Nintrinsics*sizeof(double));
+
+    char* next = (char*)&result->intrinsics[Nintrinsics];
+    if(have_valid_intrinsics_region)
+    {
+        result->Nvalid_intrinsics_region = Nvalid_intrinsics_region;
+        result->valid_intrinsics_region  = (mrcal_point2_t*)next;
+        if(Nvalid_intrinsics_region > 0)
+            memcpy(result->valid_intrinsics_region, valid_intrinsics_region.x,
+                   Nvalid_intrinsics_region*sizeof(mrcal_point2_t));
+        next += Nvalid_intrinsics_region*sizeof(mrcal_point2_t);
+    }
+    if(optimization_inputs.start != NULL)
+    {
+        result->optimization_inputs     = next;
+        result->optimization_inputs_len = decode_string(next, &optimization_inputs);
+        next += optimization_inputs.len + 1;
+    }
+    if(projection_uncertainty_cache.start != NULL)
+    {
+        result->projection_uncertainty_cache     = next;
+        result->projection_uncertainty_cache_len = decode_string(next, &projection_uncertainty_cache);
+        next += projection_uncertainty_cache.len + 1;
+    }
+
+ done:
+    free(intrinsics.x);
+    free(extrinsics.x);
+    free(imagersize.x);
+    free(valid_intrinsics_region.x);
+    return result;
+}
+
+mrcal_cameramodel_t* mrcal_read_cameramodel_file(const char* filename)
+{
+    mrcal_cameramodel_t* result = NULL;
+    char*                string = MAP_FAILED;
+    size_t               len    = 0;
+
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        MSG("Couldn't open '%s': %s", filename, strerror(errno));
+        goto done;
+    }
+    struct stat st;
+    if(0 != fstat(fd, &st))
+    {
+        MSG("Couldn't stat '%s': %s", filename, strerror(errno));
+        goto done;
+    }
+    len = (size_t)st.st_size;
+    if(len == 0 || len > INT_MAX)
+    {
+        MSG("'%s' has an unsupported size: %zu bytes", filename, len);
+        goto done;
+    }
+    string = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(string == MAP_FAILED)
+    {
+        MSG("Couldn't mmap '%s': %s", filename, strerror(errno));
+        goto done;
+    }
+
+    result = mrcal_read_cameramodel_string(string, (int)len);
+
+ done:
+    if(string != MAP_FAILED)
+        munmap(string, len);
+    if(fd >= 0)
+        close(fd);
+    return result;
+}
+
+void mrcal_free_cameramodel(mrcal_cameramodel_t** cameramodel)
+{
+    free(*cameramodel);
+    *cameramodel = NULL;
+}
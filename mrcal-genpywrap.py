@@ -36,7 +36,7 @@ bool validate_lensmodel(// out; valid if we returned true
 
                         // in
                         const char* lensmodel_str,
-                        int Nintrinsics_in_arg, bool is_project)
+                        int Nintrinsics_in_arg)
 {
     if(lensmodel_str == NULL)
     {
@@ -53,13 +53,6 @@ bool validate_lensmodel(// out; valid if we returned true
         return false;
     }
 
-    if( !is_project && lensmodel->type == MRCAL_LENSMODEL_CAHVORE )
-    {
-        PyErr_Format(PyExc_RuntimeError,
-                     "The internal _unproject() routine does not support CAHVORE. Use the Python mrcal.unproject() for that");
-        return false;
-    }
-
     int NlensParams = mrcal_lensmodel_num_params(*lensmodel);
     if( NlensParams != Nintrinsics_in_arg )
     {
@@ -162,7 +155,7 @@ _project_withgrad() in mrcal-genpywrap.py. Please keep them in sync
 
             Ccode_validate = r'''
               if( !( validate_lensmodel(&cookie->lensmodel,
-                                        lensmodel, dims_slice__intrinsics[0], true) &&
+                                        lensmodel, dims_slice__intrinsics[0]) &&
                      CHECK_CONTIGUOUS_AND_SETERROR_ALL()))
                   return false;
 
@@ -179,9 +172,11 @@ _project_withgrad() in mrcal-genpywrap.py. Please keep them in sync
                  if(cookie->lensmodel.type == MRCAL_LENSMODEL_CAHVORE)
                      return _mrcal_project_internal_cahvore(
                                 (mrcal_point2_t*)data_slice__output,
+                                NULL,
                                 (const mrcal_point3_t*)data_slice__points,
                                 N,
-                                (const double*)data_slice__intrinsics);
+                                (const double*)data_slice__intrinsics,
+                                false);
 
                  if(MRCAL_LENSMODEL_IS_OPENCV(cookie->lensmodel.type) ||
                     cookie->lensmodel.type == MRCAL_LENSMODEL_PINHOLE)
@@ -249,7 +244,7 @@ _project_withgrad() in mrcal-genpywrap.py. Please keep them in sync
 
             Ccode_validate = r'''
               if( !( validate_lensmodel(&cookie->lensmodel,
-                                        lensmodel, dims_slice__intrinsics[0], true) &&
+                                        lensmodel, dims_slice__intrinsics[0]) &&
                      CHECK_CONTIGUOUS_AND_SETERROR_ALL()))
                   return false;
 
@@ -299,8 +294,6 @@ function, and see the docs for that function. The differences:
   different. numpysane_pywrap broadcasts the leading arguments, so this function
   takes the lensmodel (the one argument that does not broadcast) last
 
-- This function does NOT support CAHVORE
-
 - To speed things up, this function doesn't call the C mrcal_unproject(), but
   uses the _mrcal_unproject_internal...() functions instead. That allows as much
   as possible of the outer init stuff to be moved outside of the slice
@@ -323,16 +316,10 @@ mrcal-genpywrap.py. Please keep them in sync """,
 
             Ccode_validate = r'''
               if( !( validate_lensmodel(&cookie->lensmodel,
-                                        lensmodel, dims_slice__intrinsics[0], false) &&
+                                        lensmodel, dims_slice__intrinsics[0]) &&
                      CHECK_CONTIGUOUS_AND_SETERROR_ALL()))
                   return false;
 
-              if(cookie->lensmodel.type == MRCAL_LENSMODEL_CAHVORE)
-              {
-                  PyErr_Format(PyExc_RuntimeError,
-                               "_unproject(MRCAL_LENSMODEL_CAHVORE) is not yet implemented: we need gradients. The python mrcal.unproject() should work; slowly.");
-                  return false;
-              }
               _mrcal_precompute_lensmodel_data(&cookie->precomputed, cookie->lensmodel);
               return true;
 ''',
@@ -365,14 +352,15 @@ m.function( "_A_Jt_J_At",
 
 This is used in the internals of projection_uncertainty().
 
-A has shape (2,Nstate)
+A has shape (N,2,Nstate): we compute the result for N different A matrices at
+once
 
 J has shape (Nmeasurements,Nstate). J is large and sparse
 
 We use the Nleading_rows_J leading rows of J. This integer is passed-in as an
 argument.
 
-matmult(A, Jt, J, At) has shape (2,2)
+matmult(A, Jt, J, At) has shape (N,2,2)
 
 The input matrices are large, but the result is very small. I can't see a way to
 do this efficiently in pure Python, so I'm writing this.
@@ -382,13 +370,21 @@ and is also how CHOLMOD stores Jt (CHOLMOD stores by column, so the same data
 looks like Jt to CHOLMOD). The sparse J is given here as the p,i,x arrays from
 CHOLMOD, equivalent to the indptr,indices,data members of
 scipy.sparse.csr_matrix respectively.
+
+All N of the A matrices are evaluated in one pass over J: each row of J is
+applied to all of them. The rows of J are split among Nthreads threads. If
+Nthreads <= 0 (the default), we use all the available cores. The result doesn't
+depend on the number of threads. If evaluating many A matrices, pass them all
+in one call, with the N dimension, instead of broadcasting over them: the
+broadcasting loop would read J once per slice.
  """,
 
             args_input       = ('A', 'Jp', 'Ji', 'Jx'),
-            prototype_input  = ((2,'Nstate'), ('Np',), ('Nix',), ('Nix',)),
-            prototype_output = (2,2),
+            prototype_input  = (('N',2,'Nstate'), ('Np',), ('Nix',), ('Nix',)),
+            prototype_output = ('N',2,2),
 
-            extra_args = (("int", "Nleading_rows_J", "-1", "i"),),
+            extra_args = (("int", "Nleading_rows_J", "-1", "i"),
+                          ("int", "Nthreads",        "0",  "i"),),
 
             Ccode_validate = r'''
             if(*Nleading_rows_J <= 0)
@@ -410,40 +406,25 @@ scipy.sparse.csr_matrix respectively.
                  //   For each row jt of J:
                  //     jta = matmult(jt,At); // jta has shape (2,)
                  //     accumulate( outer(jta,jta) )
-
-
-                 int32_t Nstate = dims_slice__A[1];
-
-                 const double*   A = (const double* )data_slice__A;
-                 const int32_t* Jp = (const int32_t*)data_slice__Jp;
-                 const int32_t* Ji = (const int32_t*)data_slice__Ji;
-                 const double*  Jx = (const double* )data_slice__Jx;
-                 double* out       = (      double* )data_slice__output;
-
-                 out[0] = 0.0;
-                 out[1] = 0.0;
-                 out[2] = 0.0;
-                 out[3] = 0.0;
-
-                 for(int irow=0; irow<*Nleading_rows_J; irow++)
+                 //
+                 // The C implementation does this for all the A at once
+                 if(*Nleading_rows_J >= dims_slice__Jp[0])
                  {
-                     double jta[2] = {};
-
-                     for(int32_t i = Jp[irow]; i < Jp[irow+1]; i++)
-                     {
-                         int32_t icol = Ji[i];
-                         double x     = Jx[i];
-
-                         jta[0] += A[icol + 0*Nstate] * x;
-                         jta[1] += A[icol + 1*Nstate] * x;
-
-                     }
-                     out[0] += jta[0]*jta[0];
-                     out[1] += jta[1]*jta[0];
-                     out[2] += jta[1]*jta[0];
-                     out[3] += jta[1]*jta[1];
+                     PyErr_Format(PyExc_RuntimeError,
+                                  "Nleading_rows_J must be < len(Jp) = %d. Got %d",
+                                  (int)dims_slice__Jp[0], *Nleading_rows_J);
+                     return false;
                  }
-                 return true;
+
+                 return
+                     _mrcal_A_Jt_J_At((double*)data_slice__output,
+                                      (const double* )data_slice__A,
+                                      dims_slice__A[0], dims_slice__A[2],
+                                      (const int32_t*)data_slice__Jp,
+                                      (const int32_t*)data_slice__Ji,
+                                      (const double* )data_slice__Jx,
+                                      *Nleading_rows_J,
+                                      *Nthreads);
 '''},
 )
 
@@ -5,6 +5,9 @@
 #include <structmember.h>
 #include <numpy/arrayobject.h>
 #include <signal.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
 #include <dogleg.h>
 
 #if (CHOLMOD_VERSION > (CHOLMOD_VER_CODE(2,2)))
@@ -197,6 +200,26 @@ typedef struct {
     cholmod_common  common;
     cholmod_factor* factorization;
 
+    // Blocks of inv(JtJ) computed by selected_inverse(). A dict mapping
+    // (bytes(istate), Nmeasurements_observations) to the (N,N) numpy array.
+    // Created on first use, and cleared when the factorization changes
+    PyObject*       selected_inverse_cache;
+
+    // The factorization settings, from the constructor arguments.
+    // CHOLMOD_SIMPLICIAL, CHOLMOD_AUTO or CHOLMOD_SUPERNODAL. And the ordering
+    // method: CHOLMOD_NATURAL, ... or <0 to let CHOLMOD pick
+    int             supernodal;
+    int             ordering;
+    int             Nthreads;
+
+    // Cumulative timing counters, in seconds, reported by stats()
+    double          time_analyze;
+    double          time_factorize;
+    double          time_solve;
+    double          time_selected_inverse;
+    long            Nsolves;
+    long            Nrhs_solved;
+
     // optimizer_callback should return it
     // and I should have two solve methods:
 } CHOLMOD_factorization;
@@ -213,9 +236,36 @@ static int cholmod_error_callback(const char* s, ...)
   return ret;
 }
 
+static double timestamp_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static const struct
+{
+    const char* name;
+    int         ordering;
+} cholmod_orderings[] =
+    { {"natural", CHOLMOD_NATURAL},
+      {"amd",     CHOLMOD_AMD},
+      {"metis",   CHOLMOD_METIS},
+      {"nesdis",  CHOLMOD_NESDIS},
+      {"colamd",  CHOLMOD_COLAMD} };
+
+static const char* cholmod_ordering_name(int ordering)
+{
+    for(int i=0; i<(int)(sizeof(cholmod_orderings)/sizeof(cholmod_orderings[0])); i++)
+        if(cholmod_orderings[i].ordering == ordering)
+            return cholmod_orderings[i].name;
+    return "other";
+}
+
 // for my internal C usage
 static void _CHOLMOD_factorization_release_internal(CHOLMOD_factorization* self)
 {
+    Py_CLEAR(self->selected_inverse_cache);
     if( self->factorization )
     {
         cholmod_free_factor(&self->factorization, &self->common);
@@ -239,11 +289,23 @@ _CHOLMOD_factorization_init_from_cholmod_sparse(CHOLMOD_factorization* self, cho
         }
         self->inited_common = true;
 
-        // stolen from libdogleg
+        // By default I use the simplicial routines only. Like libdogleg, this
+        // keeps me on the LGPL parts of CHOLMOD. The GPL supernodal routines
+        // are opt-in: supernodal=True to always use them, or
+        // supernodal='auto' to let CHOLMOD pick based on the flop count per
+        // nonzero of the factor
+        self->common.supernodal = self->supernodal;
 
-        // I want to use LGPL parts of CHOLMOD only, so I turn off the supernodal routines. This gave me a
-        // 25% performance hit in the solver for a particular set of optical calibration data.
-        self->common.supernodal = 0;
+        if(self->ordering >= 0)
+        {
+            self->common.nmethods           = 1;
+            self->common.method[0].ordering = self->ordering;
+        }
+
+        // The threading in CHOLMOD itself. The threading of the BLAS used by
+        // the supernodal routines is controlled by the BLAS library
+        if(self->Nthreads > 0)
+            self->common.nthreads_max = self->Nthreads;
 
         // I want all output to go to STDERR, not STDOUT
 #if (CHOLMOD_VERSION <= (CHOLMOD_VER_CODE(2,2)))
@@ -254,14 +316,19 @@ _CHOLMOD_factorization_init_from_cholmod_sparse(CHOLMOD_factorization* self, cho
 #endif
     }
 
+    double t0 = timestamp_sec();
     self->factorization = cholmod_analyze(Jt, &self->common);
+    double t1 = timestamp_sec();
+    self->time_analyze += t1 - t0;
 
     if(self->factorization == NULL)
     {
         BARF("cholmod_analyze() failed");
         return false;
     }
-    if( !cholmod_factorize(Jt, self->factorization, &self->common) )
+    bool factorized = cholmod_factorize(Jt, self->factorization, &self->common);
+    self->time_factorize += timestamp_sec() - t1;
+    if( !factorized )
     {
         BARF("cholmod_factorize() failed");
         return false;
@@ -287,8 +354,10 @@ CHOLMOD_factorization_init(CHOLMOD_factorization* self, PyObject* args, PyObject
     // error by default
     int result = -1;
 
-    char* keywords[] = {"J", NULL};
+    char* keywords[] = {"J", "supernodal", "ordering", "Nthreads", NULL};
     PyObject* Py_J                  = NULL;
+    PyObject* Py_supernodal         = NULL;
+    const char* ordering            = NULL;
     PyObject* module                = NULL;
     PyObject* csr_matrix_type       = NULL;
 
@@ -302,10 +371,59 @@ CHOLMOD_factorization_init(CHOLMOD_factorization* self, PyObject* args, PyObject
     PyObject* Py_h = NULL;
     PyObject* Py_w = NULL;
 
+    self->Nthreads = 0;
     if( !PyArg_ParseTupleAndKeywords(args, kwargs,
-                                     "|O", keywords, &Py_J))
+                                     "|OOzi", keywords,
+                                     &Py_J, &Py_supernodal, &ordering,
+                                     &self->Nthreads))
         goto done;
 
+    if(IS_NULL(Py_supernodal))
+        self->supernodal = CHOLMOD_SIMPLICIAL;
+    else if(PyUnicode_Check(Py_supernodal))
+    {
+        const char* s = PyUnicode_AsUTF8(Py_supernodal);
+        if(s == NULL)
+            goto done;
+        if(0 != strcmp(s, "auto"))
+        {
+            BARF("supernodal must be None, a boolean or 'auto'. Got '%s'", s);
+            goto done;
+        }
+        self->supernodal = CHOLMOD_AUTO;
+    }
+    else
+    {
+        int is_true = PyObject_IsTrue(Py_supernodal);
+        if(is_true < 0)
+            goto done;
+        self->supernodal = is_true ? CHOLMOD_SUPERNODAL : CHOLMOD_SIMPLICIAL;
+    }
+
+    self->ordering = -1;
+    if(ordering != NULL)
+    {
+        for(int i=0; i<(int)(sizeof(cholmod_orderings)/sizeof(cholmod_orderings[0])); i++)
+            if(0 == strcmp(ordering, cholmod_orderings[i].name))
+            {
+                self->ordering = cholmod_orderings[i].ordering;
+                break;
+            }
+        if(self->ordering < 0)
+        {
+            BARF("Unknown ordering '%s'. Must be one of ('natural', 'amd', 'metis', 'nesdis', 'colamd') or None",
+                 ordering);
+            goto done;
+        }
+    }
+
+    self->time_analyze          = 0.;
+    self->time_factorize        = 0.;
+    self->time_solve            = 0.;
+    self->time_selected_inverse = 0.;
+    self->Nsolves               = 0;
+    self->Nrhs_solved           = 0;
+
     if( Py_J == NULL )
     {
         // Success. Nothing to do
@@ -482,6 +600,73 @@ static PyObject* CHOLMOD_factorization_str(CHOLMOD_factorization* self)
                                self->factorization->n);
 }
 
+// solve_xt_JtJ_bt() splits the RHS into chunks of this many vectors, and
+// solves the chunks in parallel
+#define SOLVE_CHUNK_NRHS 64
+
+typedef struct
+{
+    cholmod_factor* factorization;
+    int             Nstate;
+    int             Nrhs;
+    const double*   bt;
+    double*         xt;
+
+    // set by the workers if anything failed
+    bool            failed;
+} solve_xt_JtJ_bt_context_t;
+
+static void solve_xt_JtJ_bt_work(int ichunk, void* cookie)
+{
+    solve_xt_JtJ_bt_context_t* ctx = (solve_xt_JtJ_bt_context_t*)cookie;
+
+    int irhs0 = ichunk*SOLVE_CHUNK_NRHS;
+    int Nrhs  = ctx->Nrhs - irhs0;
+    if(Nrhs > SOLVE_CHUNK_NRHS)
+        Nrhs = SOLVE_CHUNK_NRHS;
+
+    // Each thread needs its own cholmod_common. The factorization itself is
+    // only read by the solve
+    cholmod_common common;
+    if(!cholmod_start(&common))
+    {
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+        return;
+    }
+
+    cholmod_dense b = {
+        .nrow  = ctx->Nstate,
+        .ncol  = Nrhs,
+        .nzmax = Nrhs * ctx->Nstate,
+        .d     = ctx->Nstate,
+        .x     = (double*)&ctx->bt[irhs0*ctx->Nstate],
+        .xtype = CHOLMOD_REAL,
+        .dtype = CHOLMOD_DOUBLE };
+    cholmod_dense out = {
+        .nrow  = ctx->Nstate,
+        .ncol  = Nrhs,
+        .nzmax = Nrhs * ctx->Nstate,
+        .d     = ctx->Nstate,
+        .x     = &ctx->xt[irhs0*ctx->Nstate],
+        .xtype = CHOLMOD_REAL,
+        .dtype = CHOLMOD_DOUBLE };
+
+    cholmod_dense* M = &out;
+    cholmod_dense* Y = NULL;
+    cholmod_dense* E = NULL;
+
+    if(!cholmod_solve2( CHOLMOD_A, ctx->factorization,
+                        &b, NULL,
+                        &M, NULL, &Y, &E,
+                        &common) ||
+       M != &out)
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+
+    cholmod_free_dense (&E, &common);
+    cholmod_free_dense (&Y, &common);
+    cholmod_finish(&common);
+}
+
 static PyObject*
 CHOLMOD_factorization_solve_xt_JtJ_bt(CHOLMOD_factorization* self, PyObject* args, PyObject* kwargs)
 {
@@ -489,8 +674,9 @@ CHOLMOD_factorization_solve_xt_JtJ_bt(CHOLMOD_factorization* self, PyObject* arg
     PyObject* result = NULL;
     PyObject* Py_out = NULL;
 
-    char* keywords[] = {"bt", NULL};
+    char* keywords[] = {"bt", "Nthreads", NULL};
     PyObject* Py_bt   = NULL;
+    int       Nthreads = self->Nthreads;
 
     if(!(self->inited_common && self->factorization))
     {
@@ -499,7 +685,7 @@ CHOLMOD_factorization_solve_xt_JtJ_bt(CHOLMOD_factorization* self, PyObject* arg
     }
 
     if( !PyArg_ParseTupleAndKeywords(args, kwargs,
-                                     "O", keywords, &Py_bt))
+                                     "O|i", keywords, &Py_bt, &Nthreads))
         goto done;
 
     if( Py_bt == NULL || !PyArray_Check((PyArrayObject*)Py_bt) )
@@ -546,15 +732,6 @@ CHOLMOD_factorization_solve_xt_JtJ_bt(CHOLMOD_factorization* self, PyObject* arg
         goto done;
     }
 
-    cholmod_dense b = {
-        .nrow  = Nstate,
-        .ncol  = Nrhs,
-        .nzmax = Nrhs * Nstate,
-        .d     = Nstate,
-        .x     = PyArray_DATA((PyArrayObject*)Py_bt),
-        .xtype = CHOLMOD_REAL,
-        .dtype = CHOLMOD_DOUBLE };
-
     Py_out = PyArray_SimpleNew(ndim,
                                PyArray_DIMS((PyArrayObject*)Py_bt),
                                NPY_DOUBLE);
@@ -564,55 +741,262 @@ CHOLMOD_factorization_solve_xt_JtJ_bt(CHOLMOD_factorization* self, PyObject* arg
         goto done;
     }
 
-    cholmod_dense out = {
-        .nrow  = Nstate,
-        .ncol  = Nrhs,
-        .nzmax = Nrhs * Nstate,
-        .d     = Nstate,
-        .x     = PyArray_DATA((PyArrayObject*)Py_out),
-        .xtype = CHOLMOD_REAL,
-        .dtype = CHOLMOD_DOUBLE };
+    solve_xt_JtJ_bt_context_t ctx =
+        { .factorization = self->factorization,
+          .Nstate        = Nstate,
+          .Nrhs          = Nrhs,
+          .bt            = (const double*)PyArray_DATA((PyArrayObject*)Py_bt),
+          .xt            = (double*)PyArray_DATA((PyArrayObject*)Py_out),
+          .failed        = false };
+
+    double t0 = timestamp_sec();
+    Py_BEGIN_ALLOW_THREADS;
+    _mrcal_parallel_for((Nrhs + SOLVE_CHUNK_NRHS-1) / SOLVE_CHUNK_NRHS,
+                        Nthreads,
+                        &solve_xt_JtJ_bt_work, &ctx);
+    Py_END_ALLOW_THREADS;
+    self->time_solve  += timestamp_sec() - t0;
+    self->Nsolves     += 1;
+    self->Nrhs_solved += Nrhs;
+
+    if(ctx.failed)
+    {
+        BARF("cholmod_solve2() failed");
+        goto done;
+    }
 
-    cholmod_dense* M = &out;
-    cholmod_dense* Y = NULL;
-    cholmod_dense* E = NULL;
+    Py_INCREF(Py_out);
+    result = Py_out;
 
-    if(!cholmod_solve2( CHOLMOD_A, self->factorization,
-                        &b, NULL,
-                        &M, NULL, &Y, &E,
-                        &self->common))
+ done:
+    Py_XDECREF(Py_out);
+
+    return result;
+}
+
+// for my internal C usage. Returns a new reference to the (N,N) array of
+// inv(JtJ)[istate,istate], computing it if it isn't cached already. Returns
+// NULL with a Python exception set on error
+static PyArrayObject*
+_CHOLMOD_factorization_selected_inverse_cached(CHOLMOD_factorization* self,
+                                               const int* istate, int N,
+                                               const cholmod_sparse* Jt,
+                                               int Nmeasurements_observations,
+                                               int Nthreads)
+{
+    PyArrayObject* result = NULL;
+    PyObject*      key    = NULL;
+
+    if(!(self->inited_common && self->factorization))
     {
-        BARF("cholmod_solve2() failed");
+        BARF("No factorization has been computed");
         goto done;
     }
-    if( M != &out )
+
+    if(self->selected_inverse_cache == NULL &&
+       NULL == (self->selected_inverse_cache = PyDict_New()))
+        goto done;
+
+    PyObject* istate_bytes = PyBytes_FromStringAndSize((const char*)istate,
+                                                       N*sizeof(int));
+    if(istate_bytes == NULL)
+        goto done;
+    // "N" steals the reference to istate_bytes
+    key = Py_BuildValue("(Ni)", istate_bytes, Nmeasurements_observations);
+    if(key == NULL)
+        goto done;
+
+    result = (PyArrayObject*)PyDict_GetItem(self->selected_inverse_cache, key);
+    if(result != NULL)
     {
-        BARF("cholmod_solve2() reallocated out! We leaked memory");
+        Py_INCREF(result);
         goto done;
     }
 
-    cholmod_free_dense (&E, &self->common);
-    cholmod_free_dense (&Y, &self->common);
+    result = (PyArrayObject*)PyArray_SimpleNew(2, ((npy_intp[]){N,N}), NPY_DOUBLE);
+    if(result == NULL)
+        goto done;
 
-    Py_INCREF(Py_out);
-    result = Py_out;
+    bool success;
+    double t0 = timestamp_sec();
+    Py_BEGIN_ALLOW_THREADS;
+    success = mrcal_selected_inverse((double*)PyArray_DATA(result),
+                                     istate, N,
+                                     self->factorization,
+                                     Jt, Nmeasurements_observations,
+                                     Nthreads);
+    Py_END_ALLOW_THREADS;
+    self->time_selected_inverse += timestamp_sec() - t0;
+    if(!success)
+    {
+        BARF("mrcal_selected_inverse() failed");
+        Py_CLEAR(result);
+        goto done;
+    }
+
+    // This array is shared by everybody that asks for it
+    PyArray_CLEARFLAGS(result, NPY_ARRAY_WRITEABLE);
+    if(0 != PyDict_SetItem(self->selected_inverse_cache, key, (PyObject*)result))
+        Py_CLEAR(result);
 
  done:
-    Py_XDECREF(Py_out);
+    Py_XDECREF(key);
+    return result;
+}
+
+// Jt, described by the csr arrays of J. Any of Jp,Ji,Jx may be NULL or None,
+// in which case we don't have J, and *Jt is left alone. Returns true if we have
+// a valid Jt
+static bool Jt_from_csr_arrays(// out
+                               cholmod_sparse* Jt,
+                               bool* have_Jt,
+                               // in
+                               int Nstate,
+                               PyObject* Jp, PyObject* Ji, PyObject* Jx)
+{
+    *have_Jt = false;
+    if(Jp == NULL || Jp == Py_None ||
+       Ji == NULL || Ji == Py_None ||
+       Jx == NULL || Jx == Py_None)
+        return true;
+
+    PyObject* arrays[] = {Jp, Ji, Jx};
+    int       types[]  = {NPY_INT32, NPY_INT32, NPY_FLOAT64};
+    for(int i=0; i<3; i++)
+    {
+        if( !PyArray_Check((PyArrayObject*)arrays[i]) ||
+            1 != PyArray_NDIM((PyArrayObject*)arrays[i]) ||
+            PyArray_TYPE((PyArrayObject*)arrays[i]) != types[i] ||
+            !PyArray_IS_C_CONTIGUOUS((PyArrayObject*)arrays[i]) )
+        {
+            BARF("Jp,Ji,Jx must be contiguous, 1-dimensional numpy arrays with dtype np.int32,np.int32,float respectively");
+            return false;
+        }
+    }
+    if( PyArray_DIMS((PyArrayObject*)Ji)[0] != PyArray_DIMS((PyArrayObject*)Jx)[0] )
+    {
+        BARF("Ji and Jx must have the same number of elements");
+        return false;
+    }
+
+    // J is stored row-first (csr). This is exactly Jt stored column-first (csc)
+    *Jt = (cholmod_sparse){
+        .nrow   = Nstate,
+        .ncol   = PyArray_DIMS((PyArrayObject*)Jp)[0] - 1,
+        .nzmax  = PyArray_DIMS((PyArrayObject*)Jx)[0],
+        .p      = PyArray_DATA((PyArrayObject*)Jp),
+        .i      = PyArray_DATA((PyArrayObject*)Ji),
+        .x      = PyArray_DATA((PyArrayObject*)Jx),
+        .stype  = 0,
+        .itype  = CHOLMOD_INT,
+        .xtype  = CHOLMOD_REAL,
+        .dtype  = CHOLMOD_DOUBLE,
+        .sorted = 1,
+        .packed = 1 };
+    *have_Jt = true;
+    return true;
+}
 
+static PyObject*
+CHOLMOD_factorization_selected_inverse(CHOLMOD_factorization* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* result = NULL;
+
+    char* keywords[] = {"istate",
+                        "Nmeasurements_observations",
+                        "Jp", "Ji", "Jx",
+                        "Nthreads",
+                        NULL};
+    PyObject* Py_istate                  = NULL;
+    PyArrayObject* istate                = NULL;
+    int       Nmeasurements_observations = -1;
+    PyObject* Jp                         = NULL;
+    PyObject* Ji                         = NULL;
+    PyObject* Jx                         = NULL;
+    int       Nthreads                   = 0;
+
+    if(!(self->inited_common && self->factorization))
+    {
+        BARF("No factorization has been computed");
+        goto done;
+    }
+
+    if( !PyArg_ParseTupleAndKeywords(args, kwargs,
+                                     "O|iOOOi", keywords,
+                                     &Py_istate,
+                                     &Nmeasurements_observations,
+                                     &Jp, &Ji, &Jx,
+                                     &Nthreads))
+        goto done;
+
+    istate = (PyArrayObject*)PyArray_FROMANY(Py_istate, NPY_INT, 1, 1,
+                                             NPY_ARRAY_C_CONTIGUOUS | NPY_ARRAY_ALIGNED);
+    if(istate == NULL)
+        goto done;
+
+    cholmod_sparse Jt;
+    bool           have_Jt;
+    if(!Jt_from_csr_arrays(&Jt, &have_Jt, (int)self->factorization->n, Jp, Ji, Jx))
+        goto done;
+    if(Nmeasurements_observations >= 0 && !have_Jt)
+    {
+        BARF("Nmeasurements_observations >= 0, so the regularization correction is requested. This requires Jp,Ji,Jx");
+        goto done;
+    }
+
+    result = (PyObject*)
+        _CHOLMOD_factorization_selected_inverse_cached(self,
+                                                       (const int*)PyArray_DATA(istate),
+                                                       (int)PyArray_DIMS(istate)[0],
+                                                       have_Jt ? &Jt : NULL,
+                                                       Nmeasurements_observations,
+                                                       Nthreads);
+
+ done:
+    Py_XDECREF(istate);
     return result;
 }
 
+static PyObject*
+CHOLMOD_factorization_stats(CHOLMOD_factorization* self, PyObject* NPY_UNUSED(args))
+{
+    if(!(self->inited_common && self->factorization))
+    {
+        BARF("No factorization has been computed");
+        return NULL;
+    }
+
+    return Py_BuildValue("{sOsssdsdsdsdsdsdslsl}",
+                         "supernodal",            self->factorization->is_super ? Py_True : Py_False,
+                         "ordering",              cholmod_ordering_name(self->factorization->ordering),
+                         "nnz_L",                 self->common.lnz,
+                         "flops_factorize",       self->common.fl,
+                         "time_analyze",          self->time_analyze,
+                         "time_factorize",        self->time_factorize,
+                         "time_solve",            self->time_solve,
+                         "time_selected_inverse", self->time_selected_inverse,
+                         "Nsolves",               self->Nsolves,
+                         "Nrhs_solved",           self->Nrhs_solved);
+}
+
 static const char CHOLMOD_factorization_docstring[] =
 #include "CHOLMOD_factorization.docstring.h"
     ;
 static const char CHOLMOD_factorization_solve_xt_JtJ_bt_docstring[] =
 #include "CHOLMOD_factorization_solve_xt_JtJ_bt.docstring.h"
     ;
+static const char CHOLMOD_factorization_selected_inverse_docstring[] =
+#include "CHOLMOD_factorization_selected_inverse.docstring.h"
+    ;
+static const char CHOLMOD_factorization_stats_docstring[] =
+#include "CHOLMOD_factorization_stats.docstring.h"
+    ;
 
 static PyMethodDef CHOLMOD_factorization_methods[] =
     {
         PYMETHODDEF_ENTRY(CHOLMOD_factorization_, solve_xt_JtJ_bt, METH_VARARGS | METH_KEYWORDS),
+        PYMETHODDEF_ENTRY(CHOLMOD_factorization_, selected_inverse, METH_VARARGS | METH_KEYWORDS),
+        PYMETHODDEF_ENTRY(CHOLMOD_factorization_, stats,            METH_NOARGS),
         {}
     };
 
@@ -1051,7 +1435,9 @@ static PyObject* unproject_stereographic(PyObject* self,
     _(point_max_range,                    double,         -1.0,    "d",  ,                                  NULL,           -1,         {})  \
     _(verbose,                            int,            0,       "p",  ,                                  NULL,           -1,         {})  \
     _(do_apply_regularization,            int,            1,       "p",  ,                                  NULL,           -1,         {})  \
-    _(do_apply_outlier_rejection,         int,            1,       "p",  ,                                  NULL,           -1,         {})
+    _(do_apply_outlier_rejection,         int,            1,       "p",  ,                                  NULL,           -1,         {})  \
+    _(do_solve_with_pcg,                  int,            0,       "p",  ,                                  NULL,           -1,         {})  \
+    _(do_store_jacobian_float32,          int,            0,       "p",  ,                                  NULL,           -1,         {})
 
 #define OPTIMIZER_CALLBACK_ARGUMENTS_OPTIONAL_EXTRA(_) \
     _(no_jacobian,                        int,               0,    "p",  ,                                  NULL,           -1,         {}) \
@@ -1453,7 +1839,9 @@ PyObject* _optimize(bool is_optimize, // or optimizer_callback
               .do_optimize_frames                = do_optimize_frames,
               .do_optimize_calobject_warp        = do_optimize_calobject_warp,
               .do_apply_regularization           = do_apply_regularization,
-              .do_apply_outlier_rejection        = do_apply_outlier_rejection
+              .do_apply_outlier_rejection        = do_apply_outlier_rejection,
+              .do_solve_with_pcg                 = do_solve_with_pcg,
+              .do_store_jacobian_float32         = do_store_jacobian_float32
             };
 
         mrcal_problem_constants_t problem_constants =
@@ -1726,99 +2114,1618 @@ static PyObject* optimize(PyObject* NPY_UNUSED(self),
     return _optimize(true, args, kwargs);
 }
 
+// Per-problem storage for optimize_batch(). The arrays referenced by the
+// mrcal_optimize_problem_t must stay alive until the batch is solved
+typedef struct
+{
+    mrcal_problem_constants_t  problem_constants;
+    mrcal_observation_board_t* observations_board;
+    mrcal_observation_point_t* observations_point;
+
+    PyArrayObject* p_packed_final;
+    PyArrayObject* x_final;
+} optimize_batch_storage_t;
+
+// Parses one set of optimize() arguments, and fills in the corresponding
+// mrcal_optimize_problem_t. The arrays we reference are appended to the
+// "keepalive" list
+static bool optimize_batch_setup_problem(// out
+                                         mrcal_optimize_problem_t* problem,
+                                         optimize_batch_storage_t* storage,
+                                         PyObject*                 keepalive,
 
-
-// The state_index_... python functions don't need the full data but many of
-// them do need to know the dimensionality of the data. Thus these can take the
-// same arguments as optimizer_callback(). OR in lieu of that, the dimensions can
-// be passed-in explicitly with arguments
-//
-// If both are given, the explicit arguments take precedence. If neither are
-// given, I assume 0.
-//
-// This means that the arguments that are required in optimizer_callback() are
-// only optional here
-typedef int (callback_state_index_t)(int i,
-                                     int Ncameras_intrinsics,
-                                     int Ncameras_extrinsics,
-                                     int Nframes,
-                                     int Npoints,
-                                     int Npoints_fixed,
-                                     int Nobservations_board,
-                                     int Nobservations_point,
-                                     int calibration_object_width_n,
-                                     int calibration_object_height_n,
-                                     mrcal_lensmodel_t lensmodel,
-                                     mrcal_problem_selections_t problem_selections);
-
-static PyObject* state_index_generic(PyObject* self, PyObject* args, PyObject* kwargs,
-                                     const char* argname,
-                                     callback_state_index_t cb)
+                                         // in
+                                         PyObject* kwargs)
 {
-    // This is VERY similar to _pack_unpack_state(). Please consolidate
-    // Also somewhat similar to _optimize()
+    bool result = false;
 
-    PyObject* result = NULL;
+    PyObject* args = NULL;
 
     OPTIMIZE_ARGUMENTS_REQUIRED(ARG_DEFINE);
     OPTIMIZE_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+    OPTIMIZER_CALLBACK_ARGUMENTS_OPTIONAL_EXTRA(ARG_DEFINE);
 
-    int i = -1;
-
-    int Ncameras_intrinsics = -1;
-    int Ncameras_extrinsics = -1;
-    int Nframes             = -1;
-    int Npoints             = -1;
-    int Nobservations_board = -1;
-    int Nobservations_point = -1;
+    if(!PyDict_Check(kwargs))
+    {
+        BARF("Each problem MUST be given as a dict of optimize() arguments");
+        goto done;
+    }
 
-    char* keywords[] = { (char*)argname,
-                         OPTIMIZE_ARGUMENTS_REQUIRED(NAMELIST)
+    args = PyTuple_New(0);
+    if(args == NULL)
+        goto done;
 
-                         "Ncameras_intrinsics",
-                         "Ncameras_extrinsics",
-                         "Nframes",
-                         "Npoints",
-                         "Nobservations_board",
-                         "Nobservations_point",
+    char* keywords[] = { OPTIMIZE_ARGUMENTS_REQUIRED(NAMELIST)
                          OPTIMIZE_ARGUMENTS_OPTIONAL(NAMELIST)
                          NULL};
-    char** keywords_noargname = &keywords[1];
-
-    if(argname != NULL)
-    {
-        if(!PyArg_ParseTupleAndKeywords( args, kwargs,
-                                         "i"
-                                         "|" // everything is optional. I apply
-                                             // logic down the line to get what
-                                             // I need
-                                         OPTIMIZE_ARGUMENTS_REQUIRED(PARSECODE)
-                                         "iiiiii"
-                                         OPTIMIZE_ARGUMENTS_OPTIONAL(PARSECODE),
-
-                                         keywords,
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     OPTIMIZE_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     OPTIMIZE_ARGUMENTS_OPTIONAL(PARSECODE),
 
-                                         &i,
-                                         OPTIMIZE_ARGUMENTS_REQUIRED(PARSEARG)
-                                         &Ncameras_intrinsics,
-                                         &Ncameras_extrinsics,
-                                         &Nframes,
-                                         &Npoints,
-                                         &Nobservations_board,
-                                         &Nobservations_point,
-                                         OPTIMIZE_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
-            goto done;
-    }
-    else
-    {
-        if(!PyArg_ParseTupleAndKeywords( args, kwargs,
-                                         OPTIMIZE_ARGUMENTS_REQUIRED(PARSECODE) "|"
-                                         "iiiiii"
-                                         OPTIMIZE_ARGUMENTS_OPTIONAL(PARSECODE),
+                                     keywords,
 
-                                         keywords_noargname,
+                                     OPTIMIZE_ARGUMENTS_REQUIRED(PARSEARG)
+                                     OPTIMIZE_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
 
-                                         OPTIMIZE_ARGUMENTS_REQUIRED(PARSEARG)
+    // Same logic as in _optimize()
+    SET_SIZE0_IF_NONE(extrinsics_rt_fromref,      NPY_DOUBLE, 0,6);
+    SET_SIZE0_IF_NONE(frames_rt_toref,            NPY_DOUBLE, 0,6);
+    SET_SIZE0_IF_NONE(observations_board,         NPY_DOUBLE, 0,179,171,3);
+    SET_SIZE0_IF_NONE(indices_frame_camintrinsics_camextrinsics, NPY_INT32,    0,3);
+    SET_SIZE0_IF_NONE(points,                     NPY_DOUBLE, 0,3);
+    SET_SIZE0_IF_NONE(observations_point,         NPY_DOUBLE, 0,3);
+    SET_SIZE0_IF_NONE(indices_point_camintrinsics_camextrinsics,NPY_INT32, 0,3);
+    SET_SIZE0_IF_NONE(imagersizes,                NPY_INT32,    0,2);
+
+    mrcal_lensmodel_t mrcal_lensmodel_type;
+    if( !optimize_validate_args(&mrcal_lensmodel_type,
+                                true,
+                                OPTIMIZE_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                OPTIMIZE_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                OPTIMIZER_CALLBACK_ARGUMENTS_OPTIONAL_EXTRA(ARG_LIST_CALL)
+                                NULL))
+        goto done;
+
+    {
+        int Ncameras_intrinsics = PyArray_DIMS(intrinsics)[0];
+        int Ncameras_extrinsics = PyArray_DIMS(extrinsics_rt_fromref)[0];
+        int Nframes             = PyArray_DIMS(frames_rt_toref)[0];
+        int Npoints             = PyArray_DIMS(points)[0];
+        int Nobservations_board = PyArray_DIMS(observations_board)[0];
+        int Nobservations_point = PyArray_DIMS(observations_point)[0];
+
+        int calibration_object_height_n = -1;
+        int calibration_object_width_n  = -1;
+        if( Nobservations_board > 0 )
+        {
+            calibration_object_height_n = PyArray_DIMS(observations_board)[1];
+            calibration_object_width_n  = PyArray_DIMS(observations_board)[2];
+        }
+
+        storage->observations_board = malloc((Nobservations_board > 0 ? Nobservations_board : 1) *
+                                             sizeof(storage->observations_board[0]));
+        storage->observations_point = malloc((Nobservations_point > 0 ? Nobservations_point : 1) *
+                                             sizeof(storage->observations_point[0]));
+        if(storage->observations_board == NULL ||
+           storage->observations_point == NULL)
+        {
+            BARF("Couldn't allocate the observation arrays");
+            goto done;
+        }
+        fill_c_observations_board(storage->observations_board,
+                                  Nobservations_board,
+                                  indices_frame_camintrinsics_camextrinsics);
+        fill_c_observations_point(storage->observations_point,
+                                  Nobservations_point,
+                                  indices_point_camintrinsics_camextrinsics,
+                                  (mrcal_point3_t*)PyArray_DATA(observations_point));
+
+        storage->problem_constants =
+            (mrcal_problem_constants_t){.point_min_range = point_min_range,
+                                        .point_max_range = point_max_range};
+
+        mrcal_problem_selections_t problem_selections =
+            { .do_optimize_intrinsics_core       = do_optimize_intrinsics_core,
+              .do_optimize_intrinsics_distortions= do_optimize_intrinsics_distortions,
+              .do_optimize_extrinsics            = do_optimize_extrinsics,
+              .do_optimize_frames                = do_optimize_frames,
+              .do_optimize_calobject_warp        = do_optimize_calobject_warp,
+              .do_apply_regularization           = do_apply_regularization,
+              .do_apply_outlier_rejection        = do_apply_outlier_rejection,
+              .do_solve_with_pcg                 = do_solve_with_pcg,
+              .do_store_jacobian_float32         = do_store_jacobian_float32
+            };
+
+        int Nmeasurements = mrcal_num_measurements(Nobservations_board,
+                                                   Nobservations_point,
+                                                   calibration_object_width_n,
+                                                   calibration_object_height_n,
+                                                   Ncameras_intrinsics, Ncameras_extrinsics,
+                                                   Nframes,
+                                                   Npoints, Npoints_fixed,
+                                                   problem_selections,
+                                                   mrcal_lensmodel_type);
+        int Nstate = mrcal_num_states(Ncameras_intrinsics, Ncameras_extrinsics,
+                                      Nframes, Npoints, Npoints_fixed, Nobservations_board,
+                                      problem_selections, mrcal_lensmodel_type);
+
+        storage->p_packed_final = (PyArrayObject*)PyArray_SimpleNew(1, ((npy_intp[]){Nstate}), NPY_DOUBLE);
+        storage->x_final        = (PyArrayObject*)PyArray_SimpleNew(1, ((npy_intp[]){Nmeasurements}), NPY_DOUBLE);
+        if(storage->p_packed_final == NULL ||
+           storage->x_final        == NULL)
+            goto done;
+
+        *problem = (mrcal_optimize_problem_t)
+            { .stats                       = {.rms_reproj_error__pixels = -1.0},
+              .p_packed                    = PyArray_DATA(storage->p_packed_final),
+              .buffer_size_p_packed        = Nstate*sizeof(double),
+              .x                           = PyArray_DATA(storage->x_final),
+              .buffer_size_x               = Nmeasurements*sizeof(double),
+              .intrinsics                  = (double*)        PyArray_DATA(intrinsics),
+              .extrinsics_fromref          = (mrcal_pose_t*)  PyArray_DATA(extrinsics_rt_fromref),
+              .frames_toref                = (mrcal_pose_t*)  PyArray_DATA(frames_rt_toref),
+              .points                      = (mrcal_point3_t*)PyArray_DATA(points),
+              .calobject_warp              =
+                IS_NULL(calobject_warp) ?
+                NULL : (mrcal_point2_t*)PyArray_DATA(calobject_warp),
+              .Ncameras_intrinsics         = Ncameras_intrinsics,
+              .Ncameras_extrinsics         = Ncameras_extrinsics,
+              .Nframes                     = Nframes,
+              .Npoints                     = Npoints,
+              .Npoints_fixed               = Npoints_fixed,
+              .observations_board          = storage->observations_board,
+              .observations_point          = storage->observations_point,
+              .Nobservations_board         = Nobservations_board,
+              .Nobservations_point         = Nobservations_point,
+              .observations_board_pool     = (mrcal_point3_t*)PyArray_DATA(observations_board),
+              .lensmodel                   = mrcal_lensmodel_type,
+              .observed_pixel_uncertainty  = observed_pixel_uncertainty,
+              .imagersizes                 = PyArray_DATA(imagersizes),
+              .problem_selections          = problem_selections,
+              .problem_constants           = &storage->problem_constants,
+              .calibration_object_spacing  = calibration_object_spacing,
+              .calibration_object_width_n  = calibration_object_width_n,
+              .calibration_object_height_n = calibration_object_height_n,
+              .verbose                     = verbose };
+    }
+
+    // The problem references the data in these arrays, so I hold on to them
+    // until the batch is done
+#define KEEPALIVE(name, pytype, initialvalue, parsecode, parseprearg, name_pyarrayobj, npy_type, dims_ref) \
+    if(!IS_NULL(name_pyarrayobj) &&                                     \
+       0 != PyList_Append(keepalive, (PyObject*)name_pyarrayobj))      \
+        goto done;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    OPTIMIZE_ARGUMENTS_REQUIRED(KEEPALIVE);
+    OPTIMIZE_ARGUMENTS_OPTIONAL(KEEPALIVE);
+#pragma GCC diagnostic pop
+#undef KEEPALIVE
+
+    result = true;
+
+ done:
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    OPTIMIZE_ARGUMENTS_REQUIRED(FREE_PYARRAY);
+    OPTIMIZE_ARGUMENTS_OPTIONAL(FREE_PYARRAY);
+    OPTIMIZER_CALLBACK_ARGUMENTS_OPTIONAL_EXTRA(FREE_PYARRAY);
+#pragma GCC diagnostic pop
+    Py_XDECREF(args);
+    return result;
+}
+
+// The problems are solved concurrently, so no two of them may write to the same
+// memory
+typedef struct
+{
+    const char* name;
+    const char* begin;
+    const char* end;
+} optimize_batch_span_t;
+#define OPTIMIZE_BATCH_NSPANS 6
+static void optimize_batch_output_spans(// out
+                                        optimize_batch_span_t* spans,
+
+                                        // in
+                                        const mrcal_optimize_problem_t* p)
+{
+#define SPAN(name, N)                                                   \
+    (optimize_batch_span_t){ #name,                                     \
+                             (const char*)p->name,                      \
+                             (const char*)(p->name == NULL ? NULL : p->name + (N)) }
+
+    spans[0] = SPAN(intrinsics,         p->Ncameras_intrinsics*mrcal_lensmodel_num_params(p->lensmodel));
+    spans[1] = SPAN(extrinsics_fromref, p->Ncameras_extrinsics);
+    spans[2] = SPAN(frames_toref,       p->Nframes);
+    spans[3] = SPAN(points,             p->Npoints);
+    spans[4] = SPAN(calobject_warp,     1);
+
+    // The board observations are only written-to if we're rejecting outliers
+    if(p->problem_selections.do_apply_outlier_rejection)
+        spans[5] = SPAN(observations_board_pool,
+                        p->Nobservations_board*p->calibration_object_width_n*p->calibration_object_height_n);
+    else
+        spans[5] = (optimize_batch_span_t){};
+#undef SPAN
+}
+static bool optimize_batch_check_no_overlap(const mrcal_optimize_problem_t* problems,
+                                            int Nproblems)
+{
+    optimize_batch_span_t spans0[OPTIMIZE_BATCH_NSPANS];
+    optimize_batch_span_t spans1[OPTIMIZE_BATCH_NSPANS];
+
+    for(int i0=0; i0<Nproblems; i0++)
+    {
+        optimize_batch_output_spans(spans0, &problems[i0]);
+        for(int i1=0; i1<i0; i1++)
+        {
+            optimize_batch_output_spans(spans1, &problems[i1]);
+
+            for(int j0=0; j0<OPTIMIZE_BATCH_NSPANS; j0++)
+                for(int j1=0; j1<OPTIMIZE_BATCH_NSPANS; j1++)
+                    if(spans0[j0].begin != NULL &&
+                       spans1[j1].begin != NULL &&
+                       spans0[j0].begin < spans1[j1].end &&
+                       spans1[j1].begin < spans0[j0].end)
+                    {
+                        BARF("Problems %d and %d share the memory in '%s' and '%s'. Each problem in the batch is written-to independently, and MUST have its own copy",
+                             i1, i0, spans1[j1].name, spans0[j0].name);
+                        return false;
+                    }
+        }
+    }
+    return true;
+}
+
+static PyObject* optimize_batch(PyObject* NPY_UNUSED(self),
+                                PyObject* args,
+                                PyObject* kwargs)
+{
+    PyObject* result    = NULL;
+    PyObject* problems  = NULL;
+    PyObject* problems_seq = NULL;
+    PyObject* keepalive = NULL;
+    PyObject* pystats   = NULL;
+    int       Nthreads  = 0;
+
+    mrcal_optimize_problem_t* c_problems = NULL;
+    optimize_batch_storage_t* storage    = NULL;
+    int                       Nproblems  = 0;
+
+    SET_SIGINT();
+
+    char* keywords[] = { "problems", "Nthreads", NULL };
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     "O|i", keywords,
+                                     &problems, &Nthreads))
+        goto done;
+
+    problems_seq = PySequence_Fast(problems, "'problems' must be an iterable of dicts");
+    if(problems_seq == NULL)
+        goto done;
+    Nproblems = (int)PySequence_Fast_GET_SIZE(problems_seq);
+
+    keepalive = PyList_New(0);
+    if(keepalive == NULL)
+        goto done;
+
+    c_problems = calloc(Nproblems > 0 ? Nproblems : 1, sizeof(c_problems[0]));
+    storage    = calloc(Nproblems > 0 ? Nproblems : 1, sizeof(storage[0]));
+    if(c_problems == NULL || storage == NULL)
+    {
+        BARF("Couldn't allocate the problem arrays");
+        goto done;
+    }
+
+    for(int i=0; i<Nproblems; i++)
+        if(!optimize_batch_setup_problem(&c_problems[i],
+                                         &storage[i],
+                                         keepalive,
+                                         PySequence_Fast_GET_ITEM(problems_seq, i)))
+        {
+            // Add the problem index to the existing error message
+            PyObject *type, *value, *traceback;
+            PyErr_Fetch(&type, &value, &traceback);
+            BARF("Problem %d: %S", i, value == NULL ? Py_None : value);
+            Py_XDECREF(type);
+            Py_XDECREF(value);
+            Py_XDECREF(traceback);
+            goto done;
+        }
+
+    if(!optimize_batch_check_no_overlap(c_problems, Nproblems))
+        goto done;
+
+    // The solvers don't touch any python objects, so the other python threads
+    // can run while we're busy
+    Py_BEGIN_ALLOW_THREADS;
+    mrcal_optimize_batch(c_problems, Nproblems, Nthreads);
+    Py_END_ALLOW_THREADS;
+
+    result = PyList_New(Nproblems);
+    if(result == NULL)
+        goto done;
+
+    for(int i=0; i<Nproblems; i++)
+    {
+        const mrcal_stats_t stats = c_problems[i].stats;
+
+        if(stats.rms_reproj_error__pixels < 0.0)
+        {
+            // This problem failed. The rest of the batch is still valid, so I
+            // report this failure with a None instead of throwing
+            Py_INCREF(Py_None);
+            PyList_SET_ITEM(result, i, Py_None);
+            continue;
+        }
+
+        pystats = PyDict_New();
+        if(pystats == NULL)
+        {
+            BARF("PyDict_New() failed!");
+            goto done;
+        }
+        MRCAL_STATS_ITEM(MRCAL_STATS_ITEM_POPULATE_DICT);
+
+        if( 0 != PyDict_SetItemString(pystats, "p_packed",
+                                      (PyObject*)storage[i].p_packed_final) )
+        {
+            BARF("Couldn't add to stats dict 'p_packed'");
+            goto done;
+        }
+        if( 0 != PyDict_SetItemString(pystats, "x",
+                                      (PyObject*)storage[i].x_final) )
+        {
+            BARF("Couldn't add to stats dict 'x'");
+            goto done;
+        }
+
+        // PyList_SET_ITEM() steals the reference
+        PyList_SET_ITEM(result, i, pystats);
+        pystats = NULL;
+    }
+
+ done:
+    if(PyErr_Occurred())
+        Py_CLEAR(result);
+
+    if(storage != NULL)
+        for(int i=0; i<Nproblems; i++)
+        {
+            free(storage[i].observations_board);
+            free(storage[i].observations_point);
+            Py_XDECREF(storage[i].p_packed_final);
+            Py_XDECREF(storage[i].x_final);
+        }
+    free(storage);
+    free(c_problems);
+    Py_XDECREF(pystats);
+    Py_XDECREF(keepalive);
+    Py_XDECREF(problems_seq);
+    RESET_SIGINT();
+    return result;
+}
+
+
+#define PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(_)                                  \
+    _(p_cam,                      PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, p_cam,                 NPY_DOUBLE, {} ) \
+    _(lensmodel,                  PyObject*,      NULL, STRING_OBJECT, ,                         NULL,                  -1,         {} ) \
+    _(intrinsics,                 PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, intrinsics,            NPY_DOUBLE, {-1} ) \
+    _(extrinsics_rt_fromref,      PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, extrinsics_rt_fromref, NPY_DOUBLE, {6} ) \
+    _(frames_rt_toref,            PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, frames_rt_toref,       NPY_DOUBLE, {-1 COMMA 6} ) \
+    _(factorization,              PyObject*,      NULL, "O",  ,                                  NULL,                  -1,         {} ) \
+    _(Jp,                         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, Jp,                    NPY_INT32,  {-1} ) \
+    _(Ji,                         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, Ji,                    NPY_INT32,  {-1} ) \
+    _(Jx,                         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, Jx,                    NPY_DOUBLE, {-1} ) \
+    _(Nmeasurements_observations, int,            -1,   "i",  ,                                  NULL,                  -1,         {} ) \
+    _(state_scale,                PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, state_scale,           NPY_DOUBLE, {-1} ) \
+    _(istate_intrinsics,          int,            -1,   "i",  ,                                  NULL,                  -1,         {} ) \
+    _(i_intrinsics0,              int,            0,    "i",  ,                                  NULL,                  -1,         {} ) \
+    _(Nintrinsics_optimized,      int,            0,    "i",  ,                                  NULL,                  -1,         {} ) \
+    _(istate_extrinsics,          int,            -1,   "i",  ,                                  NULL,                  -1,         {} ) \
+    _(istate_frames,              int,            -1,   "i",  ,                                  NULL,                  -1,         {} ) \
+    _(observed_pixel_uncertainty, double,         -1.0, "d",  ,                                  NULL,                  -1,         {} ) \
+    _(atinfinity,                 int,            0,    "p",  ,                                  NULL,                  -1,         {} ) \
+    _(what,                       const char*,    NULL, "s",  ,                                  NULL,                  -1,         {} )
+#define PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(_)                                  \
+    _(Nthreads,                   int,            0,    "i",  ,                                  NULL,                  -1,         {} ) \
+    _(use_selected_inverse,       int,            -1,   "i",  ,                                  NULL,                  -1,         {} ) \
+    _(Var_ief,                    PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, Var_ief,               NPY_DOUBLE, {-1 COMMA -1} )
+
+static bool _projection_uncertainty_validate_args(PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(ARG_LIST_DEFINE)
+                                                  PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(ARG_LIST_DEFINE)
+                                                  void* dummy __attribute__((unused)))
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(CHECK_LAYOUT);
+    PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(CHECK_LAYOUT);
+#pragma GCC diagnostic pop
+
+    if( IS_NULL(p_cam) || IS_NULL(intrinsics) )
+    {
+        BARF("p_cam and intrinsics must both be given");
+        return false;
+    }
+    if( IS_NULL(state_scale) && IS_NULL(Var_ief) )
+    {
+        BARF("state_scale may be None only if Var_ief is given");
+        return false;
+    }
+    if( PyArray_NDIM(p_cam) < 1 ||
+        PyArray_DIMS(p_cam)[PyArray_NDIM(p_cam)-1] != 3 )
+    {
+        BARF("p_cam.shape[-1] MUST be 3");
+        return false;
+    }
+    if( IS_NULL(Var_ief) )
+    {
+        if( IS_NULL(factorization) ||
+            !PyObject_TypeCheck(factorization, &CHOLMOD_factorization_type) )
+        {
+            BARF("Var_ief is not given, so factorization must be a mrcal.CHOLMOD_factorization");
+            return false;
+        }
+        if( Nmeasurements_observations >= 0 &&
+            (IS_NULL(Jp) || IS_NULL(Ji) || IS_NULL(Jx)) )
+        {
+            BARF("Nmeasurements_observations >= 0, so the regularized uncertainty is requested. This requires Jp,Ji,Jx");
+            return false;
+        }
+    }
+    return true;
+}
+
+static PyObject* _projection_uncertainty(PyObject* NPY_UNUSED(self),
+                                         PyObject* args,
+                                         PyObject* kwargs)
+{
+    PyObject*      result           = NULL;
+    PyArrayObject* out              = NULL;
+    PyArrayObject* Var_ief_selected = NULL;
+
+    SET_SIGINT();
+
+    PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    char* keywords[] = { PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(NAMELIST)
+                         PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                     keywords,
+
+                                     PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(PARSEARG)
+                                     PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
+
+    if(!_projection_uncertainty_validate_args(PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                              PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                              NULL))
+        goto done;
+
+    mrcal_lensmodel_t lensmodel_type;
+    if(!parse_lensmodel_from_arg(&lensmodel_type, lensmodel))
+        goto done;
+    int Nintrinsics = mrcal_lensmodel_num_params(lensmodel_type);
+    if( PyArray_DIMS(intrinsics)[0] != Nintrinsics )
+    {
+        BARF("intrinsics.shape[-1] MUST be %d. Instead got %ld",
+             Nintrinsics, PyArray_DIMS(intrinsics)[0]);
+        goto done;
+    }
+
+    mrcal_uncertainty_what_t what_type;
+    if(     0 == strcmp(what, "covariance"))
+        what_type = MRCAL_UNCERTAINTY_COVARIANCE;
+    else if(0 == strcmp(what, "worstdirection-stdev"))
+        what_type = MRCAL_UNCERTAINTY_WORSTDIRECTION_STDEV;
+    else if(0 == strcmp(what, "rms-stdev"))
+        what_type = MRCAL_UNCERTAINTY_RMS_STDEV;
+    else
+    {
+        BARF("'what' must be one of ('covariance','worstdirection-stdev','rms-stdev'). Got '%s'",
+             what);
+        goto done;
+    }
+
+    int Nframes = IS_NULL(frames_rt_toref) ? 0 : (int)PyArray_DIMS(frames_rt_toref)[0];
+    if( IS_NULL(extrinsics_rt_fromref) ) istate_extrinsics = -1;
+    if( IS_NULL(frames_rt_toref) )       istate_frames     = -1;
+    int Nief =
+        mrcal_projection_uncertainty_state_indices(NULL, atinfinity, Nframes,
+                                                   istate_intrinsics, Nintrinsics_optimized,
+                                                   istate_extrinsics, istate_frames);
+
+    const npy_intp* leading_dims  = PyArray_DIMS(p_cam);
+    int             Nleading_dims = PyArray_NDIM(p_cam)-1;
+    int Npoints = (int)(PyArray_SIZE(p_cam) / 3);
+
+    CHOLMOD_factorization* f = NULL;
+    cholmod_sparse Jt;
+    bool           have_Jt = false;
+    int            Nstate;
+
+    if(!IS_NULL(Var_ief))
+    {
+        // We were given the covariance blocks; I don't need the factorization
+        if( PyArray_DIMS(Var_ief)[0] != Nief ||
+            PyArray_DIMS(Var_ief)[1] != Nief )
+        {
+            BARF("Var_ief must have shape (Nief,Nief) = (%d,%d). Instead got (%ld,%ld)",
+                 Nief, Nief,
+                 PyArray_DIMS(Var_ief)[0], PyArray_DIMS(Var_ief)[1]);
+            goto done;
+        }
+        if(!IS_NULL(state_scale))
+        {
+            Nstate = (int)PyArray_DIMS(state_scale)[0];
+            int istate_ief[Nief];
+            mrcal_projection_uncertainty_state_indices(istate_ief, atinfinity, Nframes,
+                                                       istate_intrinsics, Nintrinsics_optimized,
+                                                       istate_extrinsics, istate_frames);
+            for(int i=0; i<Nief; i++)
+                if(istate_ief[i] >= Nstate)
+                {
+                    BARF("State index %d out of bounds of state_scale: Nstate = %d",
+                         istate_ief[i], Nstate);
+                    goto done;
+                }
+        }
+    }
+    else
+    {
+        f = (CHOLMOD_factorization*)factorization;
+        if(!(f->inited_common && f->factorization))
+        {
+            BARF("No factorization has been computed");
+            goto done;
+        }
+        Nstate = (int)f->factorization->n;
+        if( PyArray_DIMS(state_scale)[0] != Nstate )
+        {
+            BARF("state_scale must have Nstate=%d elements. Instead got %ld",
+                 Nstate, PyArray_DIMS(state_scale)[0]);
+            goto done;
+        }
+
+        if(!Jt_from_csr_arrays(&Jt, &have_Jt, Nstate,
+                               (PyObject*)Jp, (PyObject*)Ji, (PyObject*)Jx))
+            goto done;
+        if( have_Jt && (int)Jt.ncol < Nmeasurements_observations )
+        {
+            BARF("J has %d measurements, but Nmeasurements_observations = %d",
+                 (int)Jt.ncol, Nmeasurements_observations);
+            goto done;
+        }
+
+        // Do I use the selected inverse? It costs one solve per ief variable,
+        // but it's cached in the factorization, and makes each subsequent
+        // query cheap. Each direct query costs 2 solves per point. By default I
+        // use the selected inverse if it'd be cheaper
+        if(use_selected_inverse < 0)
+            use_selected_inverse = 2*Npoints >= Nief;
+        if(use_selected_inverse)
+        {
+            int istate_ief[Nief];
+            mrcal_projection_uncertainty_state_indices(istate_ief, atinfinity, Nframes,
+                                                       istate_intrinsics, Nintrinsics_optimized,
+                                                       istate_extrinsics, istate_frames);
+            Var_ief_selected = _CHOLMOD_factorization_selected_inverse_cached(f, istate_ief, Nief,
+                                                                              have_Jt ? &Jt : NULL,
+                                                                              Nmeasurements_observations,
+                                                                              Nthreads);
+            if(Var_ief_selected == NULL)
+                goto done;
+        }
+    }
+
+    {
+        npy_intp dims[Nleading_dims+2];
+        memcpy(dims, leading_dims, Nleading_dims*sizeof(dims[0]));
+        int ndims = Nleading_dims;
+        if(what_type == MRCAL_UNCERTAINTY_COVARIANCE)
+        {
+            dims[ndims++] = 2;
+            dims[ndims++] = 2;
+        }
+        out = (PyArrayObject*)PyArray_SimpleNew(ndims, dims, NPY_DOUBLE);
+        if(out == NULL)
+        {
+            BARF("Couldn't allocate the output");
+            goto done;
+        }
+    }
+
+    bool success;
+    Py_BEGIN_ALLOW_THREADS;
+    success =
+        mrcal_projection_uncertainty( (double*)PyArray_DATA(out),
+                                      what_type,
+                                      (const mrcal_point3_t*)PyArray_DATA(p_cam),
+                                      Npoints,
+                                      atinfinity,
+                                      lensmodel_type,
+                                      (const double*)PyArray_DATA(intrinsics),
+                                      IS_NULL(extrinsics_rt_fromref) ? NULL :
+                                      (const mrcal_pose_t*)PyArray_DATA(extrinsics_rt_fromref),
+                                      IS_NULL(frames_rt_toref) ? NULL :
+                                      (const mrcal_pose_t*)PyArray_DATA(frames_rt_toref),
+                                      Nframes,
+                                      istate_intrinsics,
+                                      i_intrinsics0,
+                                      Nintrinsics_optimized,
+                                      istate_extrinsics,
+                                      istate_frames,
+                                      IS_NULL(state_scale) ? NULL :
+                                      (const double*)PyArray_DATA(state_scale),
+                                      !IS_NULL(Var_ief)        ? (const double*)PyArray_DATA(Var_ief) :
+                                      Var_ief_selected != NULL ? (const double*)PyArray_DATA(Var_ief_selected) :
+                                      NULL,
+                                      f != NULL ? f->factorization : NULL,
+                                      have_Jt ? &Jt : NULL,
+                                      Nmeasurements_observations,
+                                      observed_pixel_uncertainty,
+                                      Nthreads );
+    Py_END_ALLOW_THREADS;
+
+    if(!success)
+    {
+        BARF("mrcal_projection_uncertainty() failed");
+        goto done;
+    }
+
+    result = (PyObject*)out;
+    out    = NULL;
+
+ done:
+    Py_XDECREF(out);
+    Py_XDECREF(Var_ief_selected);
+    PROJECTION_UNCERTAINTY_ARGUMENTS_REQUIRED(FREE_PYARRAY) ;
+    PROJECTION_UNCERTAINTY_ARGUMENTS_OPTIONAL(FREE_PYARRAY) ;
+    RESET_SIGINT();
+    return result;
+}
+
+#define ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(_)                                   \
+    _(v,                          PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, v,       NPY_DOUBLE, {-1 COMMA -1 COMMA -1 COMMA 3} ) \
+    _(weights,                    PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, weights, NPY_DOUBLE, {-1 COMMA -1 COMMA -1} ) \
+    _(calibration_object_spacing, double,         -1.0, "d",  ,                                  NULL,    -1,         {} )
+#define ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(_)                                   \
+    _(Nthreads,                   int,            0,    "i",  ,                                  NULL,    -1,         {} )
+
+static bool _estimate_board_poses_validate_args(ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(ARG_LIST_DEFINE)
+                                                ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(ARG_LIST_DEFINE)
+                                                void* dummy __attribute__((unused)))
+{
+    if( IS_NULL(v) || IS_NULL(weights) )
+    {
+        BARF("v and weights must both be given");
+        return false;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(CHECK_LAYOUT);
+    ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(CHECK_LAYOUT);
+#pragma GCC diagnostic pop
+
+    for(int i=0; i<3; i++)
+        if( PyArray_DIMS(v)[i] != PyArray_DIMS(weights)[i] )
+        {
+            BARF("v.shape[:3] must match weights.shape. Mismatch in dim %d: %ld != %ld",
+                 i, PyArray_DIMS(v)[i], PyArray_DIMS(weights)[i]);
+            return false;
+        }
+    if( !(calibration_object_spacing > 0.0) )
+    {
+        BARF("calibration_object_spacing must be > 0. Got %f", calibration_object_spacing);
+        return false;
+    }
+    return true;
+}
+
+static PyObject* _estimate_board_poses(PyObject* NPY_UNUSED(self),
+                                       PyObject* args,
+                                       PyObject* kwargs)
+{
+    PyObject*      result = NULL;
+    PyArrayObject* rt     = NULL;
+
+    SET_SIGINT();
+
+    ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    char* keywords[] = { ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(NAMELIST)
+                         ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                     keywords,
+
+                                     ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(PARSEARG)
+                                     ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
+
+    if(!_estimate_board_poses_validate_args(ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                            ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                            NULL))
+        goto done;
+
+    int Nobservations = (int)PyArray_DIMS(v)[0];
+    rt = (PyArrayObject*)PyArray_SimpleNew(2, ((npy_intp[]){Nobservations,6}), NPY_DOUBLE);
+    if(rt == NULL)
+        goto done;
+
+    // The failed observations are reported with NaN poses. The caller decides
+    // what to do with those
+    Py_BEGIN_ALLOW_THREADS;
+    mrcal_estimate_board_poses( (mrcal_pose_t*)PyArray_DATA(rt),
+                                (const mrcal_point3_t*)PyArray_DATA(v),
+                                (const double*)PyArray_DATA(weights),
+                                Nobservations,
+                                (int)PyArray_DIMS(v)[2],
+                                (int)PyArray_DIMS(v)[1],
+                                calibration_object_spacing,
+                                Nthreads );
+    Py_END_ALLOW_THREADS;
+
+    result = (PyObject*)rt;
+    rt     = NULL;
+
+ done:
+    Py_XDECREF(rt);
+    ESTIMATE_BOARD_POSES_ARGUMENTS_REQUIRED(FREE_PYARRAY) ;
+    ESTIMATE_BOARD_POSES_ARGUMENTS_OPTIONAL(FREE_PYARRAY) ;
+    RESET_SIGINT();
+    return result;
+}
+
+#define ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(_)                                  \
+    _(calobject_poses_local_Rt_cf, PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, calobject_poses_local_Rt_cf, NPY_DOUBLE, {-1 COMMA 4 COMMA 3} ) \
+    _(indices_frame_camera,        PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, indices_frame_camera,        NPY_INT32,  {-1 COMMA 2} ) \
+    _(Ncameras,                    int,            -1,   "i",  ,                                  NULL,                        -1,         {} ) \
+    _(calibration_object_width_n,  int,            -1,   "i",  ,                                  NULL,                        -1,         {} ) \
+    _(calibration_object_height_n, int,            -1,   "i",  ,                                  NULL,                        -1,         {} ) \
+    _(calibration_object_spacing,  double,         -1.0, "d",  ,                                  NULL,                        -1,         {} )
+#define ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(_)                                  \
+    _(Nthreads,                    int,            0,    "i",  ,                                  NULL,                        -1,         {} )
+
+static bool _estimate_camera_poses_validate_args(ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(ARG_LIST_DEFINE)
+                                                 ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(ARG_LIST_DEFINE)
+                                                 void* dummy __attribute__((unused)))
+{
+    if( IS_NULL(calobject_poses_local_Rt_cf) || IS_NULL(indices_frame_camera) )
+    {
+        BARF("calobject_poses_local_Rt_cf and indices_frame_camera must both be given");
+        return false;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(CHECK_LAYOUT);
+    ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(CHECK_LAYOUT);
+#pragma GCC diagnostic pop
+
+    if( PyArray_DIMS(calobject_poses_local_Rt_cf)[0] != PyArray_DIMS(indices_frame_camera)[0] )
+    {
+        BARF("calobject_poses_local_Rt_cf and indices_frame_camera must have the same number of observations. Got %ld and %ld",
+             PyArray_DIMS(calobject_poses_local_Rt_cf)[0], PyArray_DIMS(indices_frame_camera)[0]);
+        return false;
+    }
+    if( Ncameras <= 0 ||
+        calibration_object_width_n <= 0 || calibration_object_height_n <= 0 ||
+        !(calibration_object_spacing > 0.0) )
+    {
+        BARF("Ncameras, calibration_object_width_n, calibration_object_height_n, calibration_object_spacing must all be > 0");
+        return false;
+    }
+    return true;
+}
+
+static PyObject* _estimate_camera_poses(PyObject* NPY_UNUSED(self),
+                                        PyObject* args,
+                                        PyObject* kwargs)
+{
+    PyObject*      result = NULL;
+    PyArrayObject* Rt_0c  = NULL;
+
+    SET_SIGINT();
+
+    ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    char* keywords[] = { ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(NAMELIST)
+                         ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                     keywords,
+
+                                     ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(PARSEARG)
+                                     ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
+
+    if(!_estimate_camera_poses_validate_args(ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                             ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                             NULL))
+        goto done;
+
+    Rt_0c = (PyArrayObject*)PyArray_SimpleNew(3, ((npy_intp[]){Ncameras-1,4,3}), NPY_DOUBLE);
+    if(Rt_0c == NULL)
+        goto done;
+
+    bool success;
+    Py_BEGIN_ALLOW_THREADS;
+    success =
+        mrcal_estimate_camera_poses( (double*)PyArray_DATA(Rt_0c),
+                                     (const double*)PyArray_DATA(calobject_poses_local_Rt_cf),
+                                     (const int*)PyArray_DATA(indices_frame_camera),
+                                     (int)PyArray_DIMS(indices_frame_camera)[0],
+                                     Ncameras,
+                                     calibration_object_width_n,
+                                     calibration_object_height_n,
+                                     calibration_object_spacing,
+                                     Nthreads );
+    Py_END_ALLOW_THREADS;
+
+    if(!success)
+    {
+        BARF("mrcal_estimate_camera_poses() failed. Don't have complete camera observations overlap? The messages above have the details");
+        goto done;
+    }
+
+    result = (PyObject*)Rt_0c;
+    Rt_0c  = NULL;
+
+ done:
+    Py_XDECREF(Rt_0c);
+    ESTIMATE_CAMERA_POSES_ARGUMENTS_REQUIRED(FREE_PYARRAY) ;
+    ESTIMATE_CAMERA_POSES_ARGUMENTS_OPTIONAL(FREE_PYARRAY) ;
+    RESET_SIGINT();
+    return result;
+}
+
+#define RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(_)                                     \
+    _(lensmodel0,                 PyObject*,      NULL, STRING_OBJECT, ,                         NULL,          -1,         {} ) \
+    _(intrinsics0,                PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, intrinsics0,   NPY_DOUBLE, {-1} ) \
+    _(lensmodel1,                 PyObject*,      NULL, STRING_OBJECT, ,                         NULL,          -1,         {} ) \
+    _(intrinsics1,                PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, intrinsics1,   NPY_DOUBLE, {-1} ) \
+    _(R_cam0_stereo,              PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, R_cam0_stereo, NPY_DOUBLE, {3 COMMA 3} ) \
+    _(R_cam1_cam0,                PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, R_cam1_cam0,   NPY_DOUBLE, {3 COMMA 3} ) \
+    _(az,                         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, az,            NPY_DOUBLE, {-1} ) \
+    _(el,                         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, el,            NPY_DOUBLE, {-1} )
+#define RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(_)                                     \
+    _(fixed_point,                int,            0,    "p",  ,                                  NULL,          -1,         {} ) \
+    _(Nthreads,                   int,            0,    "i",  ,                                  NULL,          -1,         {} )
+
+static bool _rectification_maps_validate_args(RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(ARG_LIST_DEFINE)
+                                              RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(ARG_LIST_DEFINE)
+                                              void* dummy __attribute__((unused)))
+{
+    if( IS_NULL(intrinsics0)   || IS_NULL(intrinsics1) ||
+        IS_NULL(R_cam0_stereo) || IS_NULL(R_cam1_cam0) ||
+        IS_NULL(az)            || IS_NULL(el) )
+    {
+        BARF("intrinsics0, intrinsics1, R_cam0_stereo, R_cam1_cam0, az, el must all be given");
+        return false;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(CHECK_LAYOUT);
+    RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(CHECK_LAYOUT);
+#pragma GCC diagnostic pop
+
+    return true;
+}
+
+static PyObject* _rectification_maps(PyObject* NPY_UNUSED(self),
+                                     PyObject* args,
+                                     PyObject* kwargs)
+{
+    PyObject*      result = NULL;
+    PyArrayObject* maps   = NULL;
+    PyArrayObject* maps_interpolation = NULL;
+
+    SET_SIGINT();
+
+    RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    char* keywords[] = { RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(NAMELIST)
+                         RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                     keywords,
+
+                                     RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(PARSEARG)
+                                     RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
+
+    if(!_rectification_maps_validate_args(RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                          RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                          NULL))
+        goto done;
+
+    mrcal_lensmodel_t lensmodels[2];
+    if(!parse_lensmodel_from_arg(&lensmodels[0], lensmodel0) ||
+       !parse_lensmodel_from_arg(&lensmodels[1], lensmodel1))
+        goto done;
+    PyArrayObject* intrinsics[2] = {intrinsics0, intrinsics1};
+    for(int icam=0; icam<2; icam++)
+    {
+        int Nintrinsics = mrcal_lensmodel_num_params(lensmodels[icam]);
+        if( PyArray_DIMS(intrinsics[icam])[0] != Nintrinsics )
+        {
+            BARF("intrinsics%d.shape[-1] MUST be %d. Instead got %ld",
+                 icam, Nintrinsics, PyArray_DIMS(intrinsics[icam])[0]);
+            goto done;
+        }
+    }
+
+    int Naz = (int)PyArray_DIMS(az)[0];
+    int Nel = (int)PyArray_DIMS(el)[0];
+
+    maps = (PyArrayObject*)PyArray_SimpleNew(4, ((npy_intp[]){2,Nel,Naz,2}),
+                                             fixed_point ? NPY_INT16 : NPY_FLOAT32);
+    if(maps == NULL)
+        goto done;
+    if(fixed_point)
+    {
+        maps_interpolation = (PyArrayObject*)PyArray_SimpleNew(3, ((npy_intp[]){2,Nel,Naz}),
+                                                               NPY_UINT16);
+        if(maps_interpolation == NULL)
+            goto done;
+    }
+
+    bool success;
+    Py_BEGIN_ALLOW_THREADS;
+    success =
+        mrcal_rectification_maps( fixed_point ? NULL : (float*)PyArray_DATA(maps),
+                                  fixed_point ? (int16_t*) PyArray_DATA(maps)               : NULL,
+                                  fixed_point ? (uint16_t*)PyArray_DATA(maps_interpolation) : NULL,
+                                  lensmodels,
+                                  (const double*)PyArray_DATA(intrinsics0),
+                                  (const double*)PyArray_DATA(intrinsics1),
+                                  (const double*)PyArray_DATA(R_cam0_stereo),
+                                  (const double*)PyArray_DATA(R_cam1_cam0),
+                                  (const double*)PyArray_DATA(az), Naz,
+                                  (const double*)PyArray_DATA(el), Nel,
+                                  Nthreads );
+    Py_END_ALLOW_THREADS;
+    if(!success)
+    {
+        BARF("mrcal_rectification_maps() failed");
+        goto done;
+    }
+
+    if(fixed_point)
+        result = Py_BuildValue("(OO)", maps, maps_interpolation);
+    else
+    {
+        result = (PyObject*)maps;
+        maps   = NULL;
+    }
+
+ done:
+    Py_XDECREF(maps);
+    Py_XDECREF(maps_interpolation);
+    RECTIFICATION_MAPS_ARGUMENTS_REQUIRED(FREE_PYARRAY) ;
+    RECTIFICATION_MAPS_ARGUMENTS_OPTIONAL(FREE_PYARRAY) ;
+    RESET_SIGINT();
+    return result;
+}
+
+#define UNPROJECT_BATCH_ARGUMENTS_REQUIRED(_)                                        \
+    _(q,                          PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, q,          NPY_DOUBLE, {} ) \
+    _(lensmodel,                  PyObject*,      NULL, STRING_OBJECT, ,                         NULL,       -1,         {} ) \
+    _(intrinsics,                 PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, intrinsics, NPY_DOUBLE, {-1} )
+#define UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(_)                                        \
+    _(Nthreads,                   int,            0,    "i",  ,                                  NULL,       -1,         {} )
+
+static bool _unproject_batch_validate_args(UNPROJECT_BATCH_ARGUMENTS_REQUIRED(ARG_LIST_DEFINE)
+                                           UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(ARG_LIST_DEFINE)
+                                           void* dummy __attribute__((unused)))
+{
+    if( IS_NULL(q) || IS_NULL(intrinsics) )
+    {
+        BARF("q and intrinsics must both be given");
+        return false;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    UNPROJECT_BATCH_ARGUMENTS_REQUIRED(CHECK_LAYOUT);
+    UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(CHECK_LAYOUT);
+#pragma GCC diagnostic pop
+
+    if( PyArray_NDIM(q) < 1 ||
+        PyArray_DIMS(q)[PyArray_NDIM(q)-1] != 2 )
+    {
+        BARF("q.shape[-1] MUST be 2");
+        return false;
+    }
+    return true;
+}
+
+static PyObject* _unproject_batch(PyObject* NPY_UNUSED(self),
+                                  PyObject* args,
+                                  PyObject* kwargs)
+{
+    PyObject*      result = NULL;
+    PyArrayObject* v      = NULL;
+
+    SET_SIGINT();
+
+    UNPROJECT_BATCH_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    char* keywords[] = { UNPROJECT_BATCH_ARGUMENTS_REQUIRED(NAMELIST)
+                         UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     UNPROJECT_BATCH_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                     keywords,
+
+                                     UNPROJECT_BATCH_ARGUMENTS_REQUIRED(PARSEARG)
+                                     UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
+
+    if(!_unproject_batch_validate_args(UNPROJECT_BATCH_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                       UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                       NULL))
+        goto done;
+
+    mrcal_lensmodel_t lensmodel_type;
+    if(!parse_lensmodel_from_arg(&lensmodel_type, lensmodel))
+        goto done;
+    int Nintrinsics = mrcal_lensmodel_num_params(lensmodel_type);
+    if( PyArray_DIMS(intrinsics)[0] != Nintrinsics )
+    {
+        BARF("intrinsics.shape[-1] MUST be %d. Instead got %ld",
+             Nintrinsics, PyArray_DIMS(intrinsics)[0]);
+        goto done;
+    }
+
+    {
+        int      Ndims = PyArray_NDIM(q);
+        npy_intp dims[Ndims];
+        for(int i=0; i<Ndims-1; i++)
+            dims[i] = PyArray_DIMS(q)[i];
+        dims[Ndims-1] = 3;
+        v = (PyArrayObject*)PyArray_SimpleNew(Ndims, dims, NPY_DOUBLE);
+        if(v == NULL)
+            goto done;
+    }
+
+    bool success;
+    Py_BEGIN_ALLOW_THREADS;
+    success =
+        mrcal_unproject_batch( (mrcal_point3_t*)PyArray_DATA(v),
+                               (const mrcal_point2_t*)PyArray_DATA(q),
+                               (int)(PyArray_SIZE(q) / 2),
+                               lensmodel_type,
+                               (const double*)PyArray_DATA(intrinsics),
+                               Nthreads );
+    Py_END_ALLOW_THREADS;
+    if(!success)
+    {
+        BARF("mrcal_unproject_batch() failed");
+        goto done;
+    }
+
+    result = (PyObject*)v;
+    v      = NULL;
+
+ done:
+    Py_XDECREF(v);
+    UNPROJECT_BATCH_ARGUMENTS_REQUIRED(FREE_PYARRAY) ;
+    UNPROJECT_BATCH_ARGUMENTS_OPTIONAL(FREE_PYARRAY) ;
+    RESET_SIGINT();
+    return result;
+}
+
+#define IMPLIED_RT10_ARGUMENTS_REQUIRED(_)                                           \
+    _(q0,                         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, q0,           NPY_DOUBLE, {-1 COMMA 2} ) \
+    _(p0,                         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, p0,           NPY_DOUBLE, {-1 COMMA -1 COMMA 3} ) \
+    _(v1,                         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, v1,           NPY_DOUBLE, {-1 COMMA -1 COMMA 3} )
+#define IMPLIED_RT10_ARGUMENTS_OPTIONAL(_)                                           \
+    _(weights,                    PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, weights,      NPY_DOUBLE, {-1 COMMA -1 COMMA -1} ) \
+    _(atinfinity,                 int,            1,    "p",  ,                                  NULL,         -1,         {} ) \
+    _(focus_center,               PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, focus_center, NPY_DOUBLE, {2} ) \
+    _(focus_radius,               double,         1e8,  "d",  ,                                  NULL,         -1,         {} ) \
+    _(Nthreads,                   int,            0,    "i",  ,                                  NULL,         -1,         {} )
+
+static bool _implied_Rt10_validate_args(IMPLIED_RT10_ARGUMENTS_REQUIRED(ARG_LIST_DEFINE)
+                                        IMPLIED_RT10_ARGUMENTS_OPTIONAL(ARG_LIST_DEFINE)
+                                        void* dummy __attribute__((unused)))
+{
+    if( IS_NULL(q0) || IS_NULL(p0) || IS_NULL(v1) )
+    {
+        BARF("q0, p0, v1 must all be given");
+        return false;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    IMPLIED_RT10_ARGUMENTS_REQUIRED(CHECK_LAYOUT);
+    IMPLIED_RT10_ARGUMENTS_OPTIONAL(CHECK_LAYOUT);
+#pragma GCC diagnostic pop
+
+    const npy_intp N = PyArray_DIMS(q0)[0];
+    if( PyArray_DIMS(p0)[1] != N || PyArray_DIMS(v1)[1] != N )
+    {
+        BARF("q0, p0, v1 must have the same number of points. Got q0.shape=(%ld,2), p0.shape=(%ld,%ld,3), v1.shape=(%ld,%ld,3)",
+             N, PyArray_DIMS(p0)[0], PyArray_DIMS(p0)[1],
+             PyArray_DIMS(v1)[0], PyArray_DIMS(v1)[1]);
+        return false;
+    }
+    if( !IS_NULL(weights) &&
+        ( PyArray_DIMS(weights)[0] != PyArray_DIMS(v1)[0] ||
+          PyArray_DIMS(weights)[1] != PyArray_DIMS(p0)[0] ||
+          PyArray_DIMS(weights)[2] != N ) )
+    {
+        BARF("weights.shape must be (Nfits,Nsets,N). Got weights.shape=(%ld,%ld,%ld), p0.shape=(%ld,%ld,3), v1.shape=(%ld,%ld,3)",
+             PyArray_DIMS(weights)[0], PyArray_DIMS(weights)[1], PyArray_DIMS(weights)[2],
+             PyArray_DIMS(p0)[0], PyArray_DIMS(p0)[1],
+             PyArray_DIMS(v1)[0], PyArray_DIMS(v1)[1]);
+        return false;
+    }
+    return true;
+}
+
+static PyObject* _implied_Rt10(PyObject* NPY_UNUSED(self),
+                               PyObject* args,
+                               PyObject* kwargs)
+{
+    PyObject*      result = NULL;
+    PyArrayObject* Rt10   = NULL;
+
+    SET_SIGINT();
+
+    IMPLIED_RT10_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    IMPLIED_RT10_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    char* keywords[] = { IMPLIED_RT10_ARGUMENTS_REQUIRED(NAMELIST)
+                         IMPLIED_RT10_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     IMPLIED_RT10_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     IMPLIED_RT10_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                     keywords,
+
+                                     IMPLIED_RT10_ARGUMENTS_REQUIRED(PARSEARG)
+                                     IMPLIED_RT10_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
+
+    if(!_implied_Rt10_validate_args(IMPLIED_RT10_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                    IMPLIED_RT10_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                    NULL))
+        goto done;
+
+    const int Nfits = (int)PyArray_DIMS(v1)[0];
+    Rt10 = (PyArrayObject*)PyArray_SimpleNew(3, ((npy_intp[]){Nfits,4,3}), NPY_DOUBLE);
+    if(Rt10 == NULL)
+        goto done;
+
+    bool success;
+    Py_BEGIN_ALLOW_THREADS;
+    success =
+        mrcal_implied_Rt10_batch( (double*)PyArray_DATA(Rt10),
+                                  (const mrcal_point2_t*)PyArray_DATA(q0),
+                                  (const mrcal_point3_t*)PyArray_DATA(p0),
+                                  (const mrcal_point3_t*)PyArray_DATA(v1),
+                                  IS_NULL(weights) ? NULL : (const double*)PyArray_DATA(weights),
+                                  (int)PyArray_DIMS(q0)[0],
+                                  (int)PyArray_DIMS(p0)[0],
+                                  Nfits,
+                                  atinfinity,
+                                  IS_NULL(focus_center) ? NULL : (const double*)PyArray_DATA(focus_center),
+                                  focus_radius,
+                                  Nthreads );
+    Py_END_ALLOW_THREADS;
+    if(!success)
+    {
+        BARF("Focus region contained too few points");
+        goto done;
+    }
+
+    result = (PyObject*)Rt10;
+    Rt10   = NULL;
+
+ done:
+    Py_XDECREF(Rt10);
+    IMPLIED_RT10_ARGUMENTS_REQUIRED(FREE_PYARRAY) ;
+    IMPLIED_RT10_ARGUMENTS_OPTIONAL(FREE_PYARRAY) ;
+    RESET_SIGINT();
+    return result;
+}
+
+#define FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(_)                               \
+    _(q,                          PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, q,          NPY_DOUBLE, {-1 COMMA 2} ) \
+    _(p,                          PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, p,          NPY_DOUBLE, {-1 COMMA 3} ) \
+    _(lensmodel,                  PyObject*,      NULL, STRING_OBJECT, ,                         NULL,       -1,         {} ) \
+    _(intrinsics,                 PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, intrinsics, NPY_DOUBLE, {-1} )
+#define FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(_)                               \
+    _(rt_cam_ref,                 PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, rt_cam_ref, NPY_DOUBLE, {6} ) \
+    _(do_optimize_intrinsics_core, int,           1,    "p",  ,                                  NULL,       -1,         {} )
+
+static bool fit_intrinsics_to_points_validate_args(FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(ARG_LIST_DEFINE)
+                                                   FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(ARG_LIST_DEFINE)
+                                                   void* dummy __attribute__((unused)))
+{
+    if( IS_NULL(q) || IS_NULL(p) || IS_NULL(intrinsics) )
+    {
+        BARF("q, p, intrinsics must all be given");
+        return false;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(CHECK_LAYOUT);
+    FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(CHECK_LAYOUT);
+#pragma GCC diagnostic pop
+
+    if( PyArray_DIMS(q)[0] != PyArray_DIMS(p)[0] )
+    {
+        BARF("q and p must have the same number of points. Got q.shape=(%ld,2), p.shape=(%ld,3)",
+             PyArray_DIMS(q)[0], PyArray_DIMS(p)[0]);
+        return false;
+    }
+    return true;
+}
+
+static PyObject* fit_intrinsics_to_points(PyObject* NPY_UNUSED(self),
+                                          PyObject* args,
+                                          PyObject* kwargs)
+{
+    PyObject* result = NULL;
+
+    SET_SIGINT();
+
+    FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    char* keywords[] = { FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(NAMELIST)
+                         FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                     keywords,
+
+                                     FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(PARSEARG)
+                                     FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
+
+    if(!fit_intrinsics_to_points_validate_args(FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                               FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                               NULL))
+        goto done;
+
+    mrcal_lensmodel_t lensmodel_type;
+    if(!parse_lensmodel_from_arg(&lensmodel_type, lensmodel))
+        goto done;
+    int Nintrinsics = mrcal_lensmodel_num_params(lensmodel_type);
+    if( PyArray_DIMS(intrinsics)[0] != Nintrinsics )
+    {
+        BARF("intrinsics.shape[-1] MUST be %d. Instead got %ld",
+             Nintrinsics, PyArray_DIMS(intrinsics)[0]);
+        goto done;
+    }
+
+    double rms_error;
+    bool   success;
+    Py_BEGIN_ALLOW_THREADS;
+    success =
+        mrcal_fit_intrinsics_to_points( (double*)PyArray_DATA(intrinsics),
+                                        IS_NULL(rt_cam_ref) ? NULL : (double*)PyArray_DATA(rt_cam_ref),
+                                        &rms_error,
+                                        (const mrcal_point2_t*)PyArray_DATA(q),
+                                        (const mrcal_point3_t*)PyArray_DATA(p),
+                                        (int)PyArray_DIMS(q)[0],
+                                        lensmodel_type,
+                                        do_optimize_intrinsics_core );
+    Py_END_ALLOW_THREADS;
+    if(!success)
+    {
+        BARF("mrcal_fit_intrinsics_to_points() failed");
+        goto done;
+    }
+
+    result = PyFloat_FromDouble(rms_error);
+
+ done:
+    FIT_INTRINSICS_TO_POINTS_ARGUMENTS_REQUIRED(FREE_PYARRAY) ;
+    FIT_INTRINSICS_TO_POINTS_ARGUMENTS_OPTIONAL(FREE_PYARRAY) ;
+    RESET_SIGINT();
+    return result;
+}
+
+#define SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(_)                          \
+    _(lensmodels,                 PyObject*,      NULL, "O",  ,                                  NULL,             -1,         {} ) \
+    _(intrinsics,                 PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, intrinsics,       NPY_DOUBLE, {-1} ) \
+    _(rt_cam_ref,                 PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, rt_cam_ref,       NPY_DOUBLE, {-1 COMMA 6} ) \
+    _(imagersizes,                PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, imagersizes,      NPY_INT32,  {-1 COMMA 2} ) \
+    _(object_width_n,             int,            -1,   "i",  ,                                  NULL,             -1,         {} ) \
+    _(object_height_n,            int,            -1,   "i",  ,                                  NULL,             -1,         {} ) \
+    _(object_spacing,             double,         -1.0, "d",  ,                                  NULL,             -1,         {} ) \
+    _(rt_ref_boardcenter,         PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, rt_ref_boardcenter, NPY_DOUBLE, {6} ) \
+    _(rt_ref_boardcenter__noiseradius, PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, rt_ref_boardcenter__noiseradius, NPY_DOUBLE, {6} ) \
+    _(Nframes,                    int,            -1,   "i",  ,                                  NULL,             -1,         {} )
+#define SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(_)                          \
+    _(calobject_warp,             PyArrayObject*, NULL, "O&", PyArray_Converter_leaveNone COMMA, calobject_warp,   NPY_DOUBLE, {2} ) \
+    _(which,                      const char*,    "all_cameras_must_see_full_board", "s", ,      NULL,             -1,         {} ) \
+    _(seed,                       unsigned long long, 0, "K", ,                                  NULL,             -1,         {} ) \
+    _(Nthreads,                   int,            0,    "i",  ,                                  NULL,             -1,         {} )
+
+static bool _synthesize_board_observations_validate_args(SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(ARG_LIST_DEFINE)
+                                                         SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(ARG_LIST_DEFINE)
+                                                         void* dummy __attribute__((unused)))
+{
+    if( IS_NULL(intrinsics) || IS_NULL(rt_cam_ref) || IS_NULL(imagersizes) ||
+        IS_NULL(rt_ref_boardcenter) || IS_NULL(rt_ref_boardcenter__noiseradius) )
+    {
+        BARF("intrinsics, rt_cam_ref, imagersizes, rt_ref_boardcenter, rt_ref_boardcenter__noiseradius must all be given");
+        return false;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+    SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(CHECK_LAYOUT);
+    SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(CHECK_LAYOUT);
+#pragma GCC diagnostic pop
+
+    if( PyArray_DIMS(rt_cam_ref)[0] != PyArray_DIMS(imagersizes)[0] )
+    {
+        BARF("rt_cam_ref and imagersizes must describe the same number of cameras. Got rt_cam_ref.shape=(%ld,6), imagersizes.shape=(%ld,2)",
+             PyArray_DIMS(rt_cam_ref)[0], PyArray_DIMS(imagersizes)[0]);
+        return false;
+    }
+    if( object_width_n < 2 || object_height_n < 2 || Nframes < 0 )
+    {
+        BARF("Need object_width_n >= 2, object_height_n >= 2, Nframes >= 0. Got %d,%d,%d",
+             object_width_n, object_height_n, Nframes);
+        return false;
+    }
+    return true;
+}
+
+static PyObject* _synthesize_board_observations(PyObject* NPY_UNUSED(self),
+                                                PyObject* args,
+                                                PyObject* kwargs)
+{
+    PyObject*          result         = NULL;
+    PyObject*          lensmodels_seq = NULL;
+    PyArrayObject*     q              = NULL;
+    PyArrayObject*     Rt_ref_board   = NULL;
+    mrcal_lensmodel_t* lensmodels_c   = NULL;
+
+    SET_SIGINT();
+
+    SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    char* keywords[] = { SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(NAMELIST)
+                         SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                     SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                     SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                     keywords,
+
+                                     SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(PARSEARG)
+                                     SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+        goto done;
+
+    if(!_synthesize_board_observations_validate_args(SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(ARG_LIST_CALL)
+                                                     SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(ARG_LIST_CALL)
+                                                     NULL))
+        goto done;
+
+    mrcal_board_visibility_t which_c;
+    if     (0 == strcmp(which, "all_cameras_must_see_full_board"))  which_c = MRCAL_ALL_CAMERAS_MUST_SEE_FULL_BOARD;
+    else if(0 == strcmp(which, "some_cameras_must_see_full_board")) which_c = MRCAL_SOME_CAMERAS_MUST_SEE_FULL_BOARD;
+    else if(0 == strcmp(which, "all_cameras_must_see_half_board"))  which_c = MRCAL_ALL_CAMERAS_MUST_SEE_HALF_BOARD;
+    else if(0 == strcmp(which, "some_cameras_must_see_half_board")) which_c = MRCAL_SOME_CAMERAS_MUST_SEE_HALF_BOARD;
+    else
+    {
+        BARF("'which' must be one of ('all_cameras_must_see_full_board', 'some_cameras_must_see_full_board', 'all_cameras_must_see_half_board', 'some_cameras_must_see_half_board'). Got '%s'",
+             which);
+        goto done;
+    }
+
+    lensmodels_seq = PySequence_Fast(lensmodels, "'lensmodels' must be an iterable of strings");
+    if(lensmodels_seq == NULL)
+        goto done;
+    const int Ncameras = (int)PyArray_DIMS(rt_cam_ref)[0];
+    if( PySequence_Fast_GET_SIZE(lensmodels_seq) != Ncameras )
+    {
+        BARF("Must have one lens model for each camera. Got %d cameras, but %ld lens models",
+             Ncameras, PySequence_Fast_GET_SIZE(lensmodels_seq));
+        goto done;
+    }
+    lensmodels_c = malloc((Ncameras > 0 ? Ncameras : 1) * sizeof(lensmodels_c[0]));
+    if(lensmodels_c == NULL)
+    {
+        BARF("Couldn't allocate the lens models");
+        goto done;
+    }
+    int Nintrinsics_all = 0;
+    for(int i=0; i<Ncameras; i++)
+    {
+        if(!parse_lensmodel_from_arg(&lensmodels_c[i],
+                                     PySequence_Fast_GET_ITEM(lensmodels_seq, i)))
+            goto done;
+        Nintrinsics_all += mrcal_lensmodel_num_params(lensmodels_c[i]);
+    }
+    if( PyArray_DIMS(intrinsics)[0] != Nintrinsics_all )
+    {
+        BARF("intrinsics must contain the intrinsics of all the cameras, concatenated: %d values. Got %ld instead",
+             Nintrinsics_all, PyArray_DIMS(intrinsics)[0]);
+        goto done;
+    }
+
+    q = (PyArrayObject*)PyArray_SimpleNew(5, ((npy_intp[]){Nframes, Ncameras,
+                                                           object_height_n, object_width_n,
+                                                           2}),
+                                          NPY_DOUBLE);
+    if(q == NULL)
+        goto done;
+    Rt_ref_board = (PyArrayObject*)PyArray_SimpleNew(3, ((npy_intp[]){Nframes,4,3}), NPY_DOUBLE);
+    if(Rt_ref_board == NULL)
+        goto done;
+
+    bool success;
+    Py_BEGIN_ALLOW_THREADS;
+    success =
+        mrcal_synthesize_board_observations( (mrcal_point2_t*)PyArray_DATA(q),
+                                             (double*)PyArray_DATA(Rt_ref_board),
+                                             lensmodels_c,
+                                             (const double*)PyArray_DATA(intrinsics),
+                                             (const double*)PyArray_DATA(rt_cam_ref),
+                                             (const int*)PyArray_DATA(imagersizes),
+                                             Ncameras,
+                                             object_width_n, object_height_n,
+                                             object_spacing,
+                                             IS_NULL(calobject_warp) ? NULL : (const mrcal_point2_t*)PyArray_DATA(calobject_warp),
+                                             (const double*)PyArray_DATA(rt_ref_boardcenter),
+                                             (const double*)PyArray_DATA(rt_ref_boardcenter__noiseradius),
+                                             Nframes,
+                                             which_c,
+                                             (uint64_t)seed,
+                                             Nthreads );
+    Py_END_ALLOW_THREADS;
+    if(!success)
+    {
+        BARF("mrcal_synthesize_board_observations() failed");
+        goto done;
+    }
+
+    result = Py_BuildValue("(OO)", q, Rt_ref_board);
+
+ done:
+    Py_XDECREF(q);
+    Py_XDECREF(Rt_ref_board);
+    Py_XDECREF(lensmodels_seq);
+    free(lensmodels_c);
+    SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_REQUIRED(FREE_PYARRAY) ;
+    SYNTHESIZE_BOARD_OBSERVATIONS_ARGUMENTS_OPTIONAL(FREE_PYARRAY) ;
+    RESET_SIGINT();
+    return result;
+}
+
+
+// The state_index_... python functions don't need the full data but many of
+// them do need to know the dimensionality of the data. Thus these can take the
+// same arguments as optimizer_callback(). OR in lieu of that, the dimensions can
+// be passed-in explicitly with arguments
+//
+// If both are given, the explicit arguments take precedence. If neither are
+// given, I assume 0.
+//
+// This means that the arguments that are required in optimizer_callback() are
+// only optional here
+typedef int (callback_state_index_t)(int i,
+                                     int Ncameras_intrinsics,
+                                     int Ncameras_extrinsics,
+                                     int Nframes,
+                                     int Npoints,
+                                     int Npoints_fixed,
+                                     int Nobservations_board,
+                                     int Nobservations_point,
+                                     int calibration_object_width_n,
+                                     int calibration_object_height_n,
+                                     mrcal_lensmodel_t lensmodel,
+                                     mrcal_problem_selections_t problem_selections);
+
+static PyObject* state_index_generic(PyObject* self, PyObject* args, PyObject* kwargs,
+                                     const char* argname,
+                                     callback_state_index_t cb)
+{
+    // This is VERY similar to _pack_unpack_state(). Please consolidate
+    // Also somewhat similar to _optimize()
+
+    PyObject* result = NULL;
+
+    OPTIMIZE_ARGUMENTS_REQUIRED(ARG_DEFINE);
+    OPTIMIZE_ARGUMENTS_OPTIONAL(ARG_DEFINE);
+
+    int i = -1;
+
+    int Ncameras_intrinsics = -1;
+    int Ncameras_extrinsics = -1;
+    int Nframes             = -1;
+    int Npoints             = -1;
+    int Nobservations_board = -1;
+    int Nobservations_point = -1;
+
+    char* keywords[] = { (char*)argname,
+                         OPTIMIZE_ARGUMENTS_REQUIRED(NAMELIST)
+
+                         "Ncameras_intrinsics",
+                         "Ncameras_extrinsics",
+                         "Nframes",
+                         "Npoints",
+                         "Nobservations_board",
+                         "Nobservations_point",
+                         OPTIMIZE_ARGUMENTS_OPTIONAL(NAMELIST)
+                         NULL};
+    char** keywords_noargname = &keywords[1];
+
+    if(argname != NULL)
+    {
+        if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                         "i"
+                                         "|" // everything is optional. I apply
+                                             // logic down the line to get what
+                                             // I need
+                                         OPTIMIZE_ARGUMENTS_REQUIRED(PARSECODE)
+                                         "iiiiii"
+                                         OPTIMIZE_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                         keywords,
+
+                                         &i,
+                                         OPTIMIZE_ARGUMENTS_REQUIRED(PARSEARG)
+                                         &Ncameras_intrinsics,
+                                         &Ncameras_extrinsics,
+                                         &Nframes,
+                                         &Npoints,
+                                         &Nobservations_board,
+                                         &Nobservations_point,
+                                         OPTIMIZE_ARGUMENTS_OPTIONAL(PARSEARG) NULL))
+            goto done;
+    }
+    else
+    {
+        if(!PyArg_ParseTupleAndKeywords( args, kwargs,
+                                         OPTIMIZE_ARGUMENTS_REQUIRED(PARSECODE) "|"
+                                         "iiiiii"
+                                         OPTIMIZE_ARGUMENTS_OPTIONAL(PARSECODE),
+
+                                         keywords_noargname,
+
+                                         OPTIMIZE_ARGUMENTS_REQUIRED(PARSEARG)
                                          &Ncameras_intrinsics,
                                          &Ncameras_extrinsics,
                                          &Nframes,
@@ -2709,6 +4616,395 @@ static PyObject* corresponding_icam_extrinsics(PyObject* self, PyObject* args, P
     return result;
 }
 
+// Parses chessboard-corner detections in the vnlog format written by mrgingham.
+// Used by mrcal.compute_chessboard_corners() to ingest the corners cache or the
+// output of the detector. See _corners_vnl_parse.docstring for the details
+typedef struct
+{
+    // The filename of this run of points is at text[filename_offset...]
+    int filename_offset, filename_len;
+    // The first point of this run
+    int ipoint0;
+} corners_vnl_run_t;
+
+typedef struct
+{
+    corners_vnl_run_t* runs;
+    int                Nruns, Nruns_allocated;
+    // Each point is (x,y,extra)
+    double*            points;
+    int                Npoints, Npoints_allocated;
+
+    // If the parsing failed, this is the offending line
+    const char*        badline;
+    int                badline_len;
+} corners_vnl_parsed_t;
+
+static bool corners_vnl_run_push(corners_vnl_parsed_t* ctx,
+                                 int filename_offset, int filename_len)
+{
+    if(ctx->Nruns == ctx->Nruns_allocated)
+    {
+        int N = ctx->Nruns_allocated ? 2*ctx->Nruns_allocated : 128;
+        corners_vnl_run_t* runs = realloc(ctx->runs, N*sizeof(ctx->runs[0]));
+        if(runs == NULL) return false;
+        ctx->runs            = runs;
+        ctx->Nruns_allocated = N;
+    }
+    ctx->runs[ctx->Nruns++] = (corners_vnl_run_t){ .filename_offset = filename_offset,
+                                                   .filename_len    = filename_len,
+                                                   .ipoint0         = ctx->Npoints };
+    return true;
+}
+
+static bool corners_vnl_point_push(corners_vnl_parsed_t* ctx,
+                                   double x, double y, double extra)
+{
+    if(ctx->Npoints == ctx->Npoints_allocated)
+    {
+        int N = ctx->Npoints_allocated ? 2*ctx->Npoints_allocated : 4096;
+        double* points = realloc(ctx->points, N*3*sizeof(ctx->points[0]));
+        if(points == NULL) return false;
+        ctx->points            = points;
+        ctx->Npoints_allocated = N;
+    }
+    double* p = &ctx->points[3*ctx->Npoints++];
+    p[0] = x;
+    p[1] = y;
+    p[2] = extra;
+    return true;
+}
+
+// Parses a whole whitespace-delimited token as a double
+static bool corners_vnl_parse_double(double* x,
+                                     const char* token, int len)
+{
+    char buf[64];
+    if(len <= 0 || len >= (int)sizeof(buf))
+        return false;
+    memcpy(buf, token, len);
+    buf[len] = '\0';
+
+    char* endptr;
+    *x = strtod(buf, &endptr);
+    return endptr == &buf[len];
+}
+
+// Returns false on error. If ctx->badline != NULL, the error was due to
+// unparseable data; otherwise we ran out of memory
+static bool corners_vnl_parse(corners_vnl_parsed_t* ctx,
+                              const char* text, int Ntext)
+{
+    const char* end = &text[Ntext];
+
+    // Is a run of points open? Points for the same filename are appended to it
+    bool run_open = false;
+
+    for(const char* line = text; line < end; )
+    {
+        const char* eol = memchr(line, '\n', end-line);
+        if(eol == NULL) eol = end;
+        const char* next = eol < end ? eol+1 : end;
+
+        if(*line == '#')
+        {
+            line = next;
+            continue;
+        }
+
+        // The filename: all the non-whitespace at the start of the line. It must
+        // be followed by some whitespace
+        const char* p = line;
+        while(p < eol && !Py_ISSPACE(*p)) p++;
+        const char* filename     = line;
+        int         filename_len = (int)(p - line);
+        if(filename_len == 0 || p == end)
+        {
+            ctx->badline     = line;
+            ctx->badline_len = (int)(eol - line);
+            return false;
+        }
+        while(p < eol && Py_ISSPACE(*p)) p++;
+
+        if(p+1 < eol && p[0] == '-' && p[1] == ' ')
+        {
+            // No observations for this image. Done with this image; move on
+            if(!corners_vnl_run_push(ctx, (int)(filename - text), filename_len))
+                return false;
+            run_open = false;
+            line = next;
+            continue;
+        }
+
+        if( !run_open ||
+            ctx->runs[ctx->Nruns-1].filename_len != filename_len ||
+            0 != memcmp(&text[ctx->runs[ctx->Nruns-1].filename_offset], filename, filename_len) )
+        {
+            // Got data for the next image
+            if(!corners_vnl_run_push(ctx, (int)(filename - text), filename_len))
+                return false;
+            run_open = true;
+        }
+
+        // The row may have 2 or 3 values: if 3, the last one is a decimation
+        // level or a weight of the corner observation. A value of '-' means
+        // "ignore this point"
+        const char* fields[3];
+        int         fields_len[3];
+        int         Nfields = 0;
+        while(p < eol)
+        {
+            const char* f = p;
+            while(p < eol && !Py_ISSPACE(*p)) p++;
+            if(Nfields < 3)
+            {
+                fields    [Nfields] = f;
+                fields_len[Nfields] = (int)(p - f);
+            }
+            Nfields++;
+            while(p < eol && Py_ISSPACE(*p)) p++;
+        }
+
+        double x, y, extra = NAN;
+        if( Nfields < 2 ||
+            !corners_vnl_parse_double(&x, fields[0], fields_len[0]) ||
+            !corners_vnl_parse_double(&y, fields[1], fields_len[1]) ||
+            ( Nfields == 3 &&
+              !(fields_len[2] == 1 && fields[2][0] == '-') &&
+              !corners_vnl_parse_double(&extra, fields[2], fields_len[2])) )
+        {
+            ctx->badline     = line;
+            ctx->badline_len = (int)(eol - line);
+            return false;
+        }
+        if(Nfields == 3 && fields_len[2] == 1 && fields[2][0] == '-')
+            extra = -1.0;
+
+        if(!corners_vnl_point_push(ctx, x, y, extra))
+            return false;
+
+        line = next;
+    }
+    return true;
+}
+
+static PyObject* _corners_vnl_parse(PyObject* NPY_UNUSED(self),
+                                    PyObject* args)
+{
+    PyObject*      result              = NULL;
+    PyObject*      filenames           = NULL;
+    PyArrayObject* image_point_offsets = NULL;
+    PyArrayObject* points              = NULL;
+
+    corners_vnl_parsed_t ctx = {};
+
+    PyObject* text_object;
+    if(!PyArg_ParseTuple( args, "O", &text_object ))
+        goto done;
+    if(!PyBytes_Check(text_object))
+    {
+        BARF("The argument must be a bytes object");
+        goto done;
+    }
+
+    char*      text;
+    Py_ssize_t Ntext;
+    if(0 != PyBytes_AsStringAndSize(text_object, &text, &Ntext))
+        goto done;
+    if(Ntext > INT_MAX)
+    {
+        BARF("The text is too large to parse at once: %ld bytes", (long)Ntext);
+        goto done;
+    }
+
+    // The text object stays alive (args holds a reference), so I can parse it
+    // without the GIL. The caller may be ingesting the data in a thread
+    bool success;
+    Py_BEGIN_ALLOW_THREADS;
+    success = corners_vnl_parse(&ctx, text, (int)Ntext);
+    Py_END_ALLOW_THREADS;
+
+    if(!success)
+    {
+        if(ctx.badline == NULL)
+        {
+            BARF("Couldn't allocate memory to parse the corners");
+            goto done;
+        }
+
+        // Report the offending line, truncated if necessary
+        char line[256];
+        int  len = ctx.badline_len < (int)sizeof(line)-1 ? ctx.badline_len : (int)sizeof(line)-1;
+        memcpy(line, ctx.badline, len);
+        line[len] = '\0';
+        BARF("Unexpected line in the corners data. Data rows must contain a filename and 2 or 3 values. Instead got line '%s'",
+             line);
+        goto done;
+    }
+
+    filenames = PyList_New(ctx.Nruns);
+    if(filenames == NULL) goto done;
+    for(int i=0; i<ctx.Nruns; i++)
+    {
+        PyObject* f = PyUnicode_DecodeUTF8(&text[ctx.runs[i].filename_offset],
+                                           ctx.runs[i].filename_len,
+                                           NULL);
+        if(f == NULL) goto done;
+        PyList_SET_ITEM(filenames, i, f);
+    }
+
+    image_point_offsets =
+        (PyArrayObject*)PyArray_SimpleNew(1, ((npy_intp[]){ctx.Nruns+1}), NPY_INT64);
+    if(image_point_offsets == NULL) goto done;
+    int64_t* offsets = (int64_t*)PyArray_DATA(image_point_offsets);
+    for(int i=0; i<ctx.Nruns; i++)
+        offsets[i] = ctx.runs[i].ipoint0;
+    offsets[ctx.Nruns] = ctx.Npoints;
+
+    points =
+        (PyArrayObject*)PyArray_SimpleNew(2, ((npy_intp[]){ctx.Npoints,3}), NPY_DOUBLE);
+    if(points == NULL) goto done;
+    if(ctx.Npoints > 0)
+        memcpy(PyArray_DATA(points), ctx.points, ctx.Npoints*3*sizeof(double));
+
+    result = Py_BuildValue("(OOO)", filenames, image_point_offsets, points);
+
+ done:
+    free(ctx.runs);
+    free(ctx.points);
+    Py_XDECREF(filenames);
+    Py_XDECREF(image_point_offsets);
+    Py_XDECREF(points);
+    return result;
+}
+
+// Parses a .cameramodel string. See _read_cameramodel_string.docstring for the
+// details
+static PyObject* _read_cameramodel_string(PyObject* NPY_UNUSED(self),
+                                          PyObject* args)
+{
+    PyObject*            result                  = NULL;
+    PyObject*            value                   = NULL;
+    PyArrayObject*       intrinsics              = NULL;
+    PyArrayObject*       extrinsics              = NULL;
+    PyArrayObject*       imagersize              = NULL;
+    PyArrayObject*       valid_intrinsics_region = NULL;
+    mrcal_cameramodel_t* cameramodel             = NULL;
+
+    PyObject* string_object;
+    if(!PyArg_ParseTuple( args, "O", &string_object ))
+        goto done;
+    if(!PyBytes_Check(string_object))
+    {
+        BARF("The argument must be a bytes object");
+        goto done;
+    }
+
+    char*      string;
+    Py_ssize_t Nstring;
+    if(0 != PyBytes_AsStringAndSize(string_object, &string, &Nstring))
+        goto done;
+    if(Nstring <= 0 || Nstring > INT_MAX)
+    {
+        BARF("The cameramodel string has an unsupported size: %ld bytes", (long)Nstring);
+        goto done;
+    }
+
+    Py_BEGIN_ALLOW_THREADS;
+    cameramodel = mrcal_read_cameramodel_string(string, (int)Nstring);
+    Py_END_ALLOW_THREADS;
+    if(cameramodel == NULL)
+    {
+        BARF("Couldn't parse the cameramodel. The messages above have the details");
+        goto done;
+    }
+
+    char lensmodel_name[1024];
+    if(!mrcal_lensmodel_name(lensmodel_name, sizeof(lensmodel_name), cameramodel->lensmodel))
+    {
+        BARF("Couldn't construct the lensmodel name");
+        goto done;
+    }
+
+    const int Nintrinsics = mrcal_lensmodel_num_params(cameramodel->lensmodel);
+
+    intrinsics = (PyArrayObject*)PyArray_SimpleNew(1, ((npy_intp[]){Nintrinsics}), NPY_DOUBLE);
+    if(intrinsics == NULL) goto done;
+    memcpy(PyArray_DATA(intrinsics), cameramodel->intrinsics, Nintrinsics*sizeof(double));
+
+    extrinsics = (PyArrayObject*)PyArray_SimpleNew(1, ((npy_intp[]){6}), NPY_DOUBLE);
+    if(extrinsics == NULL) goto done;
+    memcpy(PyArray_DATA(extrinsics), cameramodel->rt_cam_ref, 6*sizeof(double));
+
+    imagersize = (PyArrayObject*)PyArray_SimpleNew(1, ((npy_intp[]){2}), NPY_INT32);
+    if(imagersize == NULL) goto done;
+    ((int32_t*)PyArray_DATA(imagersize))[0] = (int32_t)cameramodel->imagersize[0];
+    ((int32_t*)PyArray_DATA(imagersize))[1] = (int32_t)cameramodel->imagersize[1];
+
+    result = Py_BuildValue("{sssOsOsO}",
+                           "lensmodel",  lensmodel_name,
+                           "intrinsics", intrinsics,
+                           "extrinsics", extrinsics,
+                           "imagersize", imagersize);
+    if(result == NULL) goto done;
+
+    if(cameramodel->valid_intrinsics_region != NULL)
+    {
+        valid_intrinsics_region =
+            (PyArrayObject*)PyArray_SimpleNew(2,
+                                              ((npy_intp[]){cameramodel->Nvalid_intrinsics_region,2}),
+                                              NPY_DOUBLE);
+        if(valid_intrinsics_region == NULL ||
+           0 != PyDict_SetItemString(result, "valid_intrinsics_region", (PyObject*)valid_intrinsics_region))
+            goto fail;
+        if(cameramodel->Nvalid_intrinsics_region > 0)
+            memcpy(PyArray_DATA(valid_intrinsics_region), cameramodel->valid_intrinsics_region,
+                   cameramodel->Nvalid_intrinsics_region*sizeof(mrcal_point2_t));
+    }
+    if(cameramodel->icam_intrinsics >= 0)
+    {
+        value = PyLong_FromLong(cameramodel->icam_intrinsics);
+        if(value == NULL ||
+           0 != PyDict_SetItemString(result, "icam_intrinsics", value))
+            goto fail;
+        Py_DECREF(value);
+        value = NULL;
+    }
+    if(cameramodel->optimization_inputs != NULL)
+    {
+        value = PyBytes_FromStringAndSize(cameramodel->optimization_inputs,
+                                          cameramodel->optimization_inputs_len);
+        if(value == NULL ||
+           0 != PyDict_SetItemString(result, "optimization_inputs", value))
+            goto fail;
+        Py_DECREF(value);
+        value = NULL;
+    }
+    if(cameramodel->projection_uncertainty_cache != NULL)
+    {
+        value = PyBytes_FromStringAndSize(cameramodel->projection_uncertainty_cache,
+                                          cameramodel->projection_uncertainty_cache_len);
+        if(value == NULL ||
+           0 != PyDict_SetItemString(result, "projection_uncertainty_cache", value))
+            goto fail;
+        Py_DECREF(value);
+        value = NULL;
+    }
+    goto done;
+
+ fail:
+    Py_CLEAR(result);
+
+ done:
+    mrcal_free_cameramodel(&cameramodel);
+    Py_XDECREF(value);
+    Py_XDECREF(intrinsics);
+    Py_XDECREF(extrinsics);
+    Py_XDECREF(imagersize);
+    Py_XDECREF(valid_intrinsics_region);
+    return result;
+}
+
 static const char state_index_intrinsics_docstring[] =
 #include "state_index_intrinsics.docstring.h"
     ;
@@ -2781,6 +5077,39 @@ static const char optimize_docstring[] =
 static const char optimizer_callback_docstring[] =
 #include "optimizer_callback.docstring.h"
     ;
+static const char optimize_batch_docstring[] =
+#include "optimize_batch.docstring.h"
+    ;
+static const char _projection_uncertainty_docstring[] =
+#include "_projection_uncertainty.docstring.h"
+    ;
+static const char _corners_vnl_parse_docstring[] =
+#include "_corners_vnl_parse.docstring.h"
+    ;
+static const char _estimate_board_poses_docstring[] =
+#include "_estimate_board_poses.docstring.h"
+    ;
+static const char _estimate_camera_poses_docstring[] =
+#include "_estimate_camera_poses.docstring.h"
+    ;
+static const char _rectification_maps_docstring[] =
+#include "_rectification_maps.docstring.h"
+    ;
+static const char _unproject_batch_docstring[] =
+#include "_unproject_batch.docstring.h"
+    ;
+static const char _implied_Rt10_docstring[] =
+#include "_implied_Rt10.docstring.h"
+    ;
+static const char fit_intrinsics_to_points_docstring[] =
+#include "fit_intrinsics_to_points.docstring.h"
+    ;
+static const char _synthesize_board_observations_docstring[] =
+#include "_synthesize_board_observations.docstring.h"
+    ;
+static const char _read_cameramodel_string_docstring[] =
+#include "_read_cameramodel_string.docstring.h"
+    ;
 static const char lensmodel_metadata_docstring[] =
 #include "lensmodel_metadata.docstring.h"
     ;
@@ -2802,6 +5131,17 @@ static const char unproject_stereographic_docstring[] =
 static PyMethodDef methods[] =
     { PYMETHODDEF_ENTRY(,optimize,                         METH_VARARGS | METH_KEYWORDS),
       PYMETHODDEF_ENTRY(,optimizer_callback,               METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,optimize_batch,                   METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,_projection_uncertainty,          METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,_corners_vnl_parse,               METH_VARARGS),
+      PYMETHODDEF_ENTRY(,_estimate_board_poses,            METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,_estimate_camera_poses,           METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,_rectification_maps,              METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,_unproject_batch,                 METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,_implied_Rt10,                    METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,fit_intrinsics_to_points,         METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,_synthesize_board_observations,   METH_VARARGS | METH_KEYWORDS),
+      PYMETHODDEF_ENTRY(,_read_cameramodel_string,         METH_VARARGS),
 
       PYMETHODDEF_ENTRY(, state_index_intrinsics,          METH_VARARGS | METH_KEYWORDS),
       PYMETHODDEF_ENTRY(, state_index_extrinsics,          METH_VARARGS | METH_KEYWORDS),
@@ -8,6 +8,9 @@
 #include <stdbool.h>
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <limits.h>
 
 #include "mrcal.h"
 #include "minimath/minimath.h"
@@ -2083,186 +2086,6 @@ void project( // out
     }
 }
 
-// NOT A PART OF THE EXTERNAL API. This is exported for the mrcal python wrapper
-// only
-bool _mrcal_project_internal_cahvore( // out
-                                     mrcal_point2_t* out,
-
-                                     // in
-                                     const mrcal_point3_t* p,
-                                     int N,
-
-                                     // core, distortions concatenated
-                                     const double* intrinsics)
-{
-    // Apply a CAHVORE warp to an un-distorted point
-
-    //  Given intrinsic parameters of a CAHVORE model and a set of
-    //  camera-coordinate points, return the projected point(s)
-
-    // This comes from cmod_cahvore_3d_to_2d_general() in
-    // m-jplv/libcmod/cmod_cahvore.c
-    //
-    // The lack of documentation here comes directly from the lack of
-    // documentation in that function.
-
-    // I parametrize the optical axis such that
-    // - o(alpha=0, beta=0) = (0,0,1) i.e. the optical axis is at the center
-    //   if both parameters are 0
-    // - The gradients are cartesian. I.e. do/dalpha and do/dbeta are both
-    //   NOT 0 at (alpha=0,beta=0). This would happen at the poles (gimbal
-    //   lock), and that would make my solver unhappy
-    // So o = { s_al*c_be, s_be,  c_al*c_be }
-    const mrcal_intrinsics_core_t* core = (const mrcal_intrinsics_core_t*)intrinsics;
-    const double alpha     = intrinsics[4 + 0];
-    const double beta      = intrinsics[4 + 1];
-    const double r0        = intrinsics[4 + 2];
-    const double r1        = intrinsics[4 + 3];
-    const double r2        = intrinsics[4 + 4];
-    const double e0        = intrinsics[4 + 5];
-    const double e1        = intrinsics[4 + 6];
-    const double e2        = intrinsics[4 + 7];
-    const double linearity = intrinsics[4 + 8];
-
-    double sa,ca;
-    sincos(alpha, &sa, &ca);
-    double sb,cb;
-    sincos(beta, &sb, &cb);
-
-    const double o[] ={ cb * sa, sb, cb * ca };
-
-    for(int i_pt=0; i_pt<N; i_pt++)
-    {
-        ///////////////// THIS IS MADE UP, AND PROBABLY WRONG
-
-        // I'm using jplv as the reference implementation for this, but that
-        // implementation can't work. In jplv project(p) and project(k*p) don't
-        // project to the same point, which they must for a valid projection
-        // function. Look at the definition of upsilon below. omega and l are
-        // proportional to the distance to the camera while the other terms are
-        // not. So if I'm looking at a point along the same observation ray, but
-        // 1000 times further out, omega and l will jump by a factor of 1000,
-        // while the other terms will not. I thus won't get the same projection
-        // result.
-        //
-        // I'm hypothesizing that they meant to normalize p, but never did it.
-        // So I'm doing that here. mrcal supports cahvore only for
-        // compatibility, so nobody's using this code. IF YOU ARE GOING TO USE
-        // THIS CODE, PLEASE CONFIRM THAT THIS CAHVORE PROJECTION IS CORRECT
-        double pnorm = sqrt(p[i_pt].x*p[i_pt].x +
-                            p[i_pt].y*p[i_pt].y +
-                            p[i_pt].z*p[i_pt].z );
-        double v[] =
-            {
-                p[i_pt].x / pnorm,
-                p[i_pt].y / pnorm,
-                p[i_pt].z / pnorm
-            };
-
-        // cos( angle between p and o ) = inner(p,o) / (norm(o) * norm(p)) =
-        // omega/norm(p)
-        double omega = v[0]*o[0] + v[1]*o[1] + v[2]*o[2];
-
-
-        // Basic Computations
-
-        // Calculate initial terms
-        double u[3];
-        for(int i=0; i<3; i++) u[i] = omega*o[i];
-
-        double ll[3];
-        for(int i=0; i<3; i++) ll[i] = v[i]-u[i];
-        double l = sqrt(ll[0]*ll[0] + ll[1]*ll[1] + ll[2]*ll[2]);
-
-        // Calculate theta using Newton's Method
-        double theta = atan2(l, omega);
-
-        int inewton;
-        for( inewton = 100; inewton; inewton--)
-        {
-            // Compute terms from the current value of theta
-            double sth,cth;
-            sincos(theta, &sth, &cth);
-
-            double theta2  = theta * theta;
-            double theta3  = theta * theta2;
-            double theta4  = theta * theta3;
-            double upsilon =
-                omega*cth + l*sth
-                - (1.0   - cth) * (e0 +      e1*theta2 +     e2*theta4)
-                - (theta - sth) * (      2.0*e1*theta  + 4.0*e2*theta3);
-
-            // Update theta
-            double dtheta =
-                (
-                 omega*sth - l*cth
-                 - (theta - sth) * (e0 + e1*theta2 + e2*theta4)
-                 ) / upsilon;
-
-            theta -= dtheta;
-
-            // Check exit criterion from last update
-            if(fabs(dtheta) < 1e-8)
-                break;
-        }
-        if(inewton == 0)
-        {
-            fprintf(stderr, "%s(): too many iterations\n", __func__);
-            return false;
-        }
-
-        // got a theta
-
-        // Check the value of theta
-        if(theta * fabs(linearity) > M_PI/2.)
-        {
-            fprintf(stderr, "%s(): theta out of bounds\n", __func__);
-            return false;
-        }
-
-        // If we aren't close enough to use the small-angle approximation ...
-        if (theta > 1e-8)
-        {
-            // ... do more math!
-            double linth = linearity * theta;
-            double chi;
-            if (linearity < -1e-15)
-                chi = sin(linth) / linearity;
-            else if (linearity > 1e-15)
-                chi = tan(linth) / linearity;
-            else
-                chi = theta;
-
-            double chi2 = chi * chi;
-            double chi3 = chi * chi2;
-            double chi4 = chi * chi3;
-
-            double zetap = l / chi;
-
-            double mu = r0 + r1*chi2 + r2*chi4;
-
-            double uu[3];
-            for(int i=0; i<3; i++) uu[i] = zetap*o[i];
-            double vv[3];
-            for(int i=0; i<3; i++) vv[i] = (1. + mu)*ll[i];
-
-            for(int i=0; i<3; i++)
-                u[i] = uu[i] + vv[i];
-            // now I apply a normal projection to the warped 3d point p
-            out[i_pt].x = core->focal_xy[0] * u[0]/u[2] + core->center_xy[0];
-            out[i_pt].y = core->focal_xy[1] * u[1]/u[2] + core->center_xy[1];
-        }
-        else
-        {
-            // now I apply a normal projection to the warped 3d point p
-            out[i_pt].x = core->focal_xy[0] * v[0]/v[2] + core->center_xy[0];
-            out[i_pt].y = core->focal_xy[1] * v[1]/v[2] + core->center_xy[1];
-        }
-    }
-    return true;
-}
-
-
 // NOT A PART OF THE EXTERNAL API. This is exported for the mrcal python wrapper
 // only
 bool _mrcal_project_internal( // out
@@ -2401,7 +2224,8 @@ bool _mrcal_project_internal( // out
 // supports chessboards). dq_dintrinsics and/or dq_dp are allowed to be NULL if
 // we're not interested in gradients.
 //
-// This function supports CAHVORE distortions if we don't ask for gradients
+// This function supports CAHVORE distortions if we don't ask for gradients in
+// respect to the intrinsics
 //
 // Projecting out-of-bounds points (beyond the field of view) returns undefined
 // values. Generally things remain continuous even as we move off the imager
@@ -2438,12 +2262,12 @@ bool mrcal_project( // out
     // project() doesn't handle cahvore, so I special-case it here
     if( lensmodel.type == MRCAL_LENSMODEL_CAHVORE )
     {
-        if(dq_dintrinsics != NULL || dq_dp != NULL)
+        if(dq_dintrinsics != NULL)
         {
-            fprintf(stderr, "mrcal_project(MRCAL_LENSMODEL_CAHVORE) is not yet implemented if we're asking for gradients\n");
+            fprintf(stderr, "mrcal_project(MRCAL_LENSMODEL_CAHVORE) is not yet implemented if we're asking for gradients in respect to the intrinsics\n");
             return false;
         }
-        return _mrcal_project_internal_cahvore(q, p, N, intrinsics);
+        return _mrcal_project_internal_cahvore(q, dq_dp, p, N, intrinsics, false);
     }
 
     int Nintrinsics = mrcal_lensmodel_num_params(lensmodel);
@@ -2475,6 +2299,208 @@ bool mrcal_project( // out
                                 Nintrinsics, &precomputed);
 }
 
+typedef struct
+{
+    float*    maps_float;
+    int16_t*  maps_fixed_xy;
+    uint16_t* maps_fixed_interpolation;
+
+    const mrcal_lensmodel_t*              lensmodels;
+    const double* const*                  intrinsics;
+    const mrcal_projection_precomputed_t* precomputed;
+    const int*                            Nintrinsics;
+    // R_cam_stereo for each camera
+    const double (*R)[3][3];
+
+    const double* az;
+    const double* el;
+    int Naz, Nel;
+
+    // set by the workers if anything failed
+    bool failed;
+} rectification_maps_context_t;
+
+// OpenCV's fixed-point remap() format, as produced by cv2.convertMaps() with
+// dstmap1type=CV_16SC2: the pixel coordinates are quantized to
+// 1/MRCAL_RECTIFICATION_INTERPOLATION_TABLE_SIZE of a pixel. The integer part
+// goes into maps_fixed_xy, and the fractional part into
+// maps_fixed_interpolation
+static void rectification_map_fixed(// out
+                                    int16_t*  xy,
+                                    uint16_t* interpolation,
+                                    // in
+                                    const mrcal_point2_t* q)
+{
+    const int N = MRCAL_RECTIFICATION_INTERPOLATION_TABLE_SIZE;
+
+    // I clamp to the range representable in the output. Anything that doesn't
+    // fit (or is a NaN) is off the imager, and remap() will treat it as such
+    const double lo = (double)INT16_MIN * N;
+    const double hi = (double)INT16_MAX * N + (N-1);
+
+    int ixy[2];
+    const double qxy[2] = {q->x, q->y};
+    for(int i=0; i<2; i++)
+    {
+        double x = qxy[i] * N;
+        if(     !(x >= lo)) x = lo;
+        else if(!(x <= hi)) x = hi;
+        ixy[i] = (int)lrint(x);
+    }
+
+    // ixy may be negative, so I can't just shift: >> of a negative number is
+    // implementation-defined
+    for(int i=0; i<2; i++)
+    {
+        int whole = ixy[i] >= 0 ? ixy[i] / N : -((-ixy[i] + N-1) / N);
+        xy[i]  = (int16_t)whole;
+        ixy[i] = ixy[i] - whole*N;
+    }
+    *interpolation = (uint16_t)(ixy[1]*N + ixy[0]);
+}
+
+static void rectification_maps_row(int iel, void* cookie)
+{
+    rectification_maps_context_t* ctx = (rectification_maps_context_t*)cookie;
+
+    const int Naz = ctx->Naz;
+
+    mrcal_point3_t* v = malloc(Naz*(sizeof(mrcal_point3_t) + sizeof(mrcal_point2_t)));
+    if(v == NULL)
+    {
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+        return;
+    }
+    mrcal_point2_t* q = (mrcal_point2_t*)&v[Naz];
+
+    const double sel = sin(ctx->el[iel]);
+    const double cel = cos(ctx->el[iel]);
+
+    for(int icam=0; icam<2; icam++)
+    {
+        const double (*R)[3] = ctx->R[icam];
+
+        // Same as stereo_unproject() in stereo.py: v = (saz, caz sel, caz cel)
+        // in the rectified coordinate system. Then I rotate into the camera
+        // coord system
+        for(int iaz=0; iaz<Naz; iaz++)
+        {
+            const double saz = sin(ctx->az[iaz]);
+            const double caz = cos(ctx->az[iaz]);
+            const double vstereo[3] = { saz, caz*sel, caz*cel };
+            for(int i=0; i<3; i++)
+                v[iaz].xyz[i] =
+                    R[i][0]*vstereo[0] +
+                    R[i][1]*vstereo[1] +
+                    R[i][2]*vstereo[2];
+        }
+
+        // Same logic as in mrcal_project(), but the lens model data was
+        // precomputed once for all the rows
+        const mrcal_lensmodel_t* lensmodel = &ctx->lensmodels[icam];
+        if( lensmodel->type == MRCAL_LENSMODEL_CAHVORE )
+        {
+            if(!_mrcal_project_internal_cahvore(q, NULL, v, Naz, ctx->intrinsics[icam], false))
+                __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+        }
+        else if(MRCAL_LENSMODEL_IS_OPENCV(lensmodel->type) ||
+                lensmodel->type == MRCAL_LENSMODEL_PINHOLE)
+            _mrcal_project_internal_opencv( q, NULL,NULL,
+                                            v, Naz, ctx->intrinsics[icam],
+                                            ctx->Nintrinsics[icam]);
+        else if(!_mrcal_project_internal(q, NULL, NULL,
+                                         v, Naz, *lensmodel, ctx->intrinsics[icam],
+                                         ctx->Nintrinsics[icam], &ctx->precomputed[icam]))
+            __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+
+        const int ioffset = (icam*ctx->Nel + iel)*Naz;
+        if(ctx->maps_float != NULL)
+        {
+            float* out = &ctx->maps_float[2*ioffset];
+            for(int iaz=0; iaz<Naz; iaz++)
+            {
+                out[2*iaz + 0] = (float)q[iaz].x;
+                out[2*iaz + 1] = (float)q[iaz].y;
+            }
+        }
+        else
+            for(int iaz=0; iaz<Naz; iaz++)
+                rectification_map_fixed(&ctx->maps_fixed_xy[2*(ioffset+iaz)],
+                                        &ctx->maps_fixed_interpolation[ioffset+iaz],
+                                        &q[iaz]);
+    }
+
+    free(v);
+}
+
+bool mrcal_rectification_maps( // output
+                               float*    rectification_maps,
+                               int16_t*  rectification_maps_fixed_xy,
+                               uint16_t* rectification_maps_fixed_interpolation,
+
+                               // input
+                               const mrcal_lensmodel_t* lensmodels,
+                               const double* intrinsics0,
+                               const double* intrinsics1,
+                               const double* R_cam0_stereo,
+                               const double* R_cam1_cam0,
+                               const double* az, int Naz,
+                               const double* el, int Nel,
+                               int Nthreads)
+{
+    if( (rectification_maps == NULL) ==
+        (rectification_maps_fixed_xy == NULL || rectification_maps_fixed_interpolation == NULL) )
+    {
+        MSG("Exactly one of the float or the fixed-point maps must be requested");
+        return false;
+    }
+
+    double R[2][3][3];
+    for(int i=0; i<3; i++)
+        for(int j=0; j<3; j++)
+        {
+            R[0][i][j] = R_cam0_stereo[3*i + j];
+            R[1][i][j] = 0.0;
+        }
+    for(int i=0; i<3; i++)
+        for(int j=0; j<3; j++)
+            for(int k=0; k<3; k++)
+                R[1][i][j] += R_cam1_cam0[3*i + k] * R[0][k][j];
+
+    const double* intrinsics[2] = {intrinsics0, intrinsics1};
+    int Nintrinsics[2];
+    mrcal_projection_precomputed_t precomputed[2];
+    for(int icam=0; icam<2; icam++)
+    {
+        Nintrinsics[icam] = mrcal_lensmodel_num_params(lensmodels[icam]);
+        _mrcal_precompute_lensmodel_data(&precomputed[icam], lensmodels[icam]);
+    }
+
+    rectification_maps_context_t ctx =
+        { .maps_float               = rectification_maps,
+          .maps_fixed_xy            = rectification_maps_fixed_xy,
+          .maps_fixed_interpolation = rectification_maps_fixed_interpolation,
+          .lensmodels               = lensmodels,
+          .intrinsics               = intrinsics,
+          .precomputed              = precomputed,
+          .Nintrinsics              = Nintrinsics,
+          .R                        = (const double (*)[3][3])R,
+          .az                       = az,
+          .el                       = el,
+          .Naz                      = Naz,
+          .Nel                      = Nel,
+          .failed                   = false };
+    _mrcal_parallel_for(Nel, Nthreads,
+                        &rectification_maps_row, &ctx);
+
+    if(ctx.failed)
+    {
+        MSG("Couldn't compute the rectification maps");
+        return false;
+    }
+    return true;
+}
+
 
 // Maps a set of distorted 2D imager points q to a 3D vector in camera
 // coordinates that produced these pixel observations. The 3D vector is defined
@@ -2487,7 +2513,6 @@ bool mrcal_project( // out
 // cvUndistortPoints() (and cv2.undistortPoints()), but these are inaccurate:
 // https://github.com/opencv/opencv/issues/8811
 //
-// This function does NOT support CAHVORE
 bool mrcal_unproject( // out
                      mrcal_point3_t* out,
 
@@ -2498,12 +2523,6 @@ bool mrcal_unproject( // out
                      // core, distortions concatenated
                      const double* intrinsics)
 {
-    if( lensmodel.type == MRCAL_LENSMODEL_CAHVORE )
-    {
-        fprintf(stderr, "mrcal_unproject(MRCAL_LENSMODEL_CAHVORE) not yet implemented. No gradients available\n");
-        return false;
-    }
-
     // easy special-cases
     if( lensmodel.type == MRCAL_LENSMODEL_PINHOLE )
     {
@@ -2581,19 +2600,38 @@ bool _mrcal_unproject_internal( // out
 
             mrcal_point3_t dq_dtframe[2];
             mrcal_point2_t q_hypothesis;
-            project( &q_hypothesis,
-                     NULL,NULL,NULL,NULL,NULL,
-                     NULL, NULL, NULL, dq_dtframe,
-                     NULL,
+            if(lensmodel.type == MRCAL_LENSMODEL_CAHVORE)
+            {
+                // project() doesn't handle cahvore. The frame is at the
+                // origin, with an identity rotation, so dq/dtframe = dq/dp.
+                // The solver routinely tries hypotheses that can't be
+                // projected, so I don't report those failures
+                if(!_mrcal_project_internal_cahvore(&q_hypothesis, dq_dtframe,
+                                                    &frame.t, 1, intrinsics,
+                                                    true))
+                {
+                    // This hypothesis can't be projected. I report a huge
+                    // error, so that the solver rejects this step
+                    x[0] = 1e6;
+                    x[1] = 1e6;
+                    memset(J, 0, 2*2*sizeof(J[0]));
+                    return;
+                }
+            }
+            else
+                project( &q_hypothesis,
+                         NULL,NULL,NULL,NULL,NULL,
+                         NULL, NULL, NULL, dq_dtframe,
+                         NULL,
 
-                     // in
-                     intrinsics,
-                     NULL,
-                     &frame,
-                     NULL,
-                     true,
-                     lensmodel, precomputed,
-                     0.0, 0,0);
+                         // in
+                         intrinsics,
+                         NULL,
+                         &frame,
+                         NULL,
+                         true,
+                         lensmodel, precomputed,
+                         0.0, 0,0);
             x[0] = q_hypothesis.x - q[i].x;
             x[1] = q_hypothesis.y - q[i].y;
             J[0*2 + 0] =
@@ -2644,21 +2682,15 @@ bool _mrcal_unproject_internal( // out
             dogleg_optimize_dense2(out->xyz, 2, 2, cb, NULL,
                                    &dogleg_parameters,
                                    NULL);
-        //This needs to be precise; if it isn't, I barf. Shouldn't happen
-        //very often
+        //This needs to be precise; if it isn't, I return nan for this point.
+        //Shouldn't happen very often
 
-        static bool already_complained = false;
         if(norm2x/2.0 > 1e-4)
         {
-            if(!already_complained)
-            {
-                // MSG("WARNING: I wasn't able to precisely compute some points. norm2x=%f. Returning nan for those. Will complain just once",
-                //     norm2x);
-                already_complained = true;
-            }
             double nan = strtod("NAN", NULL);
             out->xyz[0] = nan;
             out->xyz[1] = nan;
+            out->xyz[2] = nan;
         }
         else
         {
@@ -2684,6 +2716,59 @@ bool _mrcal_unproject_internal( // out
     return true;
 }
 
+// Each thread in mrcal_unproject_batch() unprojects chunks of this many points
+#define UNPROJECT_BATCH_CHUNK_SIZE 256
+
+typedef struct
+{
+    mrcal_point3_t*       v;
+    const mrcal_point2_t* q;
+    int                   N;
+    mrcal_lensmodel_t     lensmodel;
+    const double*         intrinsics;
+
+    // set by the workers if anything failed
+    bool failed;
+} unproject_batch_context_t;
+
+static void unproject_batch_work(int ichunk, void* cookie)
+{
+    unproject_batch_context_t* ctx = (unproject_batch_context_t*)cookie;
+
+    int i0 = ichunk*UNPROJECT_BATCH_CHUNK_SIZE;
+    int N  = ctx->N - i0;
+    if(N > UNPROJECT_BATCH_CHUNK_SIZE)
+        N = UNPROJECT_BATCH_CHUNK_SIZE;
+
+    if(!mrcal_unproject(&ctx->v[i0], &ctx->q[i0], N,
+                        ctx->lensmodel, ctx->intrinsics))
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+}
+
+bool mrcal_unproject_batch( // out
+                            mrcal_point3_t* v,
+
+                            // in
+                            const mrcal_point2_t* q,
+                            int N,
+                            mrcal_lensmodel_t lensmodel,
+                            // core, distortions concatenated
+                            const double* intrinsics,
+                            int Nthreads)
+{
+    unproject_batch_context_t ctx =
+        { .v          = v,
+          .q          = q,
+          .N          = N,
+          .lensmodel  = lensmodel,
+          .intrinsics = intrinsics,
+          .failed     = false };
+    _mrcal_parallel_for((N + UNPROJECT_BATCH_CHUNK_SIZE-1) / UNPROJECT_BATCH_CHUNK_SIZE,
+                        Nthreads,
+                        &unproject_batch_work, &ctx);
+    return !ctx.failed;
+}
+
 // The following functions define/use the layout of the state vector. In general
 // I do:
 //
@@ -3512,17 +3597,22 @@ typedef struct
     const char* reportFitMsg;
 } callback_context_t;
 
-static
-void optimizer_callback(// input state
-                       const double*   packed_state,
+// The body of optimizer_callback(). The PCG solver can store the Jacobian
+// values in single precision; Jt_float32 says how they're stored. This is
+// always inlined into optimizer_callback() with a constant Jt_float32, so each
+// dtype gets its own copy of the loops, without a per-element test
+static inline __attribute__((always_inline))
+void optimizer_callback_dtype(// input state
+                              const double*   packed_state,
 
-                       // output measurements
-                       double*         x,
+                              // output measurements
+                              double*         x,
 
-                       // Jacobian
-                       cholmod_sparse* Jt,
+                              // Jacobian
+                              cholmod_sparse* Jt,
 
-                       const callback_context_t* ctx)
+                              const callback_context_t* ctx,
+                              const bool      Jt_float32)
 {
     double norm2_error = 0.0;
 
@@ -3531,13 +3621,19 @@ void optimizer_callback(// input state
 
     int*    Jrowptr = Jt ? (int*)   Jt->p : NULL;
     int*    Jcolidx = Jt ? (int*)   Jt->i : NULL;
-    double* Jval    = Jt ? (double*)Jt->x : NULL;
+    void*   Jval    = Jt ?          Jt->x : NULL;
+#define STORE_JACOBIAN_VALUE(i, g)                      \
+    do                                                  \
+    {                                                   \
+        if(Jt_float32) ((float* )Jval)[i] = (float)(g); \
+        else           ((double*)Jval)[i] = g;          \
+    } while(0)
 #define STORE_JACOBIAN(col, g)                  \
     do                                          \
     {                                           \
         if(Jt) {                                \
             Jcolidx[ iJacobian ] = col;         \
-            Jval   [ iJacobian ] = g;           \
+            STORE_JACOBIAN_VALUE(iJacobian, g); \
         }                                       \
         iJacobian++;                            \
     } while(0)
@@ -3546,9 +3642,9 @@ void optimizer_callback(// input state
     {                                           \
         if(Jt) {                                \
             Jcolidx[ iJacobian+0 ] = col0+0;    \
-            Jval   [ iJacobian+0 ] = g0;        \
+            STORE_JACOBIAN_VALUE(iJacobian+0, g0); \
             Jcolidx[ iJacobian+1 ] = col0+1;    \
-            Jval   [ iJacobian+1 ] = g1;        \
+            STORE_JACOBIAN_VALUE(iJacobian+1, g1); \
         }                                       \
         iJacobian += 2;                         \
     } while(0)
@@ -3557,11 +3653,11 @@ void optimizer_callback(// input state
     {                                               \
         if(Jt) {                                    \
             Jcolidx[ iJacobian+0 ] = col0+0;        \
-            Jval   [ iJacobian+0 ] = g0;            \
+            STORE_JACOBIAN_VALUE(iJacobian+0, g0);  \
             Jcolidx[ iJacobian+1 ] = col0+1;        \
-            Jval   [ iJacobian+1 ] = g1;            \
+            STORE_JACOBIAN_VALUE(iJacobian+1, g1);  \
             Jcolidx[ iJacobian+2 ] = col0+2;        \
-            Jval   [ iJacobian+2 ] = g2;            \
+            STORE_JACOBIAN_VALUE(iJacobian+2, g2);  \
         }                                           \
         iJacobian += 3;                             \
     } while(0)
@@ -4553,6 +4649,24 @@ void optimizer_callback(// input state
     }
 }
 
+static
+void optimizer_callback(// input state
+                       const double*   packed_state,
+
+                       // output measurements
+                       double*         x,
+
+                       // Jacobian
+                       cholmod_sparse* Jt,
+
+                       const callback_context_t* ctx)
+{
+    if(Jt != NULL && Jt->dtype == CHOLMOD_SINGLE)
+        optimizer_callback_dtype(packed_state, x, Jt, ctx, true);
+    else
+        optimizer_callback_dtype(packed_state, x, Jt, ctx, false);
+}
+
 bool mrcal_optimizer_callback(// out
 
                              // These output pointers may NOT be NULL, unlike
@@ -4731,92 +4845,685 @@ done:
     return result;
 }
 
-mrcal_stats_t
-mrcal_optimize( // out
-                // Each one of these output pointers may be NULL
-
-                // Shape (Nstate,)
-                double* p_packed_final,
-                // used only to confirm that the user passed-in the buffer they
-                // should have passed-in. The size must match exactly
-                int buffer_size_p_packed_final,
-
-                // Shape (Nmeasurements,)
-                double* x_final,
-                // used only to confirm that the user passed-in the buffer they
-                // should have passed-in. The size must match exactly
-                int buffer_size_x_final,
-
-                // out, in
+// The matrix-free solver used by mrcal_optimize() if
+// problem_selections.do_solve_with_pcg. libdogleg factors J^T J with CHOLMOD,
+// and for very large problems the fill-in of that factor doesn't fit in
+// memory. Here each trust-region step is instead solved inexactly with the
+// Steihaug-Toint conjugate-gradient method. This only needs products with J and
+// J^T, so the memory use is dominated by J itself.
+//
+// The iterations are preconditioned with the inverse of the block diagonal of
+// J^T J. The blocks are the natural variable groups in the state vector: the
+// intrinsics of each camera, the pose of each camera and frame, each point and
+// the calibration-object warp. Large blocks (the intrinsics of splined models)
+// are split into chunks of at most PCG_BLOCK_MAX states. The trust region is
+// measured in the norm defined by this preconditioner
+#define PCG_BLOCK_MAX 32
 
-                // These are a seed on input, solution on output
+static bool banded_cholesky(double* A, int N, int bandwidth);
+static void banded_cholesky_solve(double* b, const double* L, int N, int bandwidth);
 
-                // intrinsics is a concatenation of the intrinsics core and the
-                // distortion params. The specific distortion parameters may
-                // vary, depending on lensmodel, so this is a variable-length
-                // structure
-                double*             intrinsics,         // Ncameras_intrinsics * NlensParams
-                mrcal_pose_t*       extrinsics_fromref, // Ncameras_extrinsics of these. Transform FROM the reference frame
-                mrcal_pose_t*       frames_toref,       // Nframes of these.    Transform TO the reference frame
-                mrcal_point3_t*     points,             // Npoints of these.    In the reference frame
-                mrcal_point2_t*     calobject_warp,     // 1 of these. May be NULL if !problem_selections.do_optimize_calobject_warp
+typedef struct
+{
+    int     Nblocks;
+
+    // Nblocks+1 of these. Block i covers the states [istate0[i],istate0[i+1])
+    int*    istate0;
+    // Nstate of these: the block containing each state
+    int*    iblock;
+    // Nblocks+1 of these. Block i is stored at L[ioffset[i]]
+    int*    ioffset;
+    // The Cholesky factor of each block. A block of size n is stored in the
+    // layout used by banded_cholesky() with bandwidth=n-1
+    double* L;
+} pcg_preconditioner_t;
+
+// Computes the block boundaries of the preconditioner. If istate0 is NULL,
+// this just counts the blocks. Returns the number of blocks
+static int pcg_block_boundaries(// out
+                                int* istate0,
+
+                                // in
+                                const callback_context_t* ctx)
+{
+    const mrcal_problem_selections_t problem_selections = ctx->problem_selections;
 
-                // in
-                int Ncameras_intrinsics, int Ncameras_extrinsics, int Nframes,
-                int Npoints, int Npoints_fixed, // at the end of points[]
+    const struct
+    {
+        int N, Nstates;
+    } groups[] =
+        { { ctx->Ncameras_intrinsics,
+            mrcal_num_intrinsics_optimization_params(problem_selections, ctx->lensmodel) },
+          { mrcal_num_states_extrinsics(ctx->Ncameras_extrinsics,
+                                        problem_selections) / 6, 6 },
+          { mrcal_num_states_frames(ctx->Nframes,
+                                    problem_selections) / 6,     6 },
+          { mrcal_num_states_points(ctx->Npoints, ctx->Npoints_fixed,
+                                    problem_selections) / 3,     3 },
+          { 1, mrcal_num_states_calobject_warp(problem_selections,
+                                               ctx->Nobservations_board) } };
+
+    int Nblocks = 0;
+    int istate  = 0;
+    for(int igroup=0; igroup<(int)(sizeof(groups)/sizeof(groups[0])); igroup++)
+        for(int i=0; i<groups[igroup].N; i++)
+        {
+            for(int j=0; j<groups[igroup].Nstates; j+=PCG_BLOCK_MAX)
+            {
+                if(istate0 != NULL)
+                    istate0[Nblocks] = istate + j;
+                Nblocks++;
+            }
+            istate += groups[igroup].Nstates;
+        }
+    if(istate0 != NULL)
+        istate0[Nblocks] = istate;
+    return Nblocks;
+}
 
-                const mrcal_observation_board_t* observations_board,
-                const mrcal_observation_point_t* observations_point,
-                int Nobservations_board,
-                int Nobservations_point,
+static void pcg_preconditioner_free(pcg_preconditioner_t* M)
+{
+    free(M->istate0);
+    free(M->iblock);
+    free(M->ioffset);
+    free(M->L);
+    *M = (pcg_preconditioner_t){};
+}
 
-                // All the board pixel observations, in order.
-                // .x, .y are the pixel observations
-                // .z is the weight of the observation. Most of the weights are
-                // expected to be 1.0, which implies that the noise on the
-                // observation has standard deviation of
-                // observed_pixel_uncertainty. observed_pixel_uncertainty scales
-                // inversely with the weight.
-                //
-                // z<0 indicates that this is an outlier. This is respected on
-                // input (even if !do_apply_outlier_rejection). New outliers are
-                // marked with z<0 on output, so this isn't const
-                mrcal_point3_t* observations_board_pool,
+static bool pcg_preconditioner_init(// out
+                                    pcg_preconditioner_t* M,
 
-                mrcal_lensmodel_t lensmodel,
-                double observed_pixel_uncertainty,
-                const int* imagersizes, // Ncameras_intrinsics*2 of these
-                mrcal_problem_selections_t       problem_selections,
-                const mrcal_problem_constants_t* problem_constants,
+                                    // in
+                                    const callback_context_t* ctx,
+                                    int Nstate)
+{
+    *M = (pcg_preconditioner_t){.Nblocks = pcg_block_boundaries(NULL, ctx)};
 
-                double calibration_object_spacing,
-                int calibration_object_width_n,
-                int calibration_object_height_n,
-                bool verbose,
+    M->istate0 = malloc((M->Nblocks+1)*sizeof(int));
+    M->iblock  = malloc(Nstate        *sizeof(int));
+    M->ioffset = malloc((M->Nblocks+1)*sizeof(int));
+    if(M->istate0 == NULL || M->iblock == NULL || M->ioffset == NULL)
+    {
+        MSG("Couldn't allocate the preconditioner");
+        pcg_preconditioner_free(M);
+        return false;
+    }
 
-                bool check_gradient)
-{
-    if( Nobservations_board > 0 )
+    pcg_block_boundaries(M->istate0, ctx);
+    if(M->istate0[M->Nblocks] != Nstate)
     {
-        if( problem_selections.do_optimize_calobject_warp && calobject_warp == NULL )
-        {
-            MSG("ERROR: We're optimizing the calibration object warp, so a buffer with a seed MUST be passed in.");
-            return (mrcal_stats_t){.rms_reproj_error__pixels = -1.0};
-        }
+        MSG("The preconditioner blocks cover %d states, but we have Nstate=%d. This is a bug",
+            M->istate0[M->Nblocks], Nstate);
+        pcg_preconditioner_free(M);
+        return false;
     }
-    else
-        problem_selections.do_optimize_calobject_warp = false;
 
-    if(!modelHasCore_fxfycxcy(lensmodel))
-        problem_selections.do_optimize_intrinsics_core = false;
+    M->ioffset[0] = 0;
+    for(int iblock=0; iblock<M->Nblocks; iblock++)
+    {
+        const int n = M->istate0[iblock+1] - M->istate0[iblock];
+        for(int i=M->istate0[iblock]; i<M->istate0[iblock+1]; i++)
+            M->iblock[i] = iblock;
+        M->ioffset[iblock+1] = M->ioffset[iblock] + n*n;
+    }
 
-    if(!problem_selections.do_optimize_intrinsics_core        &&
-       !problem_selections.do_optimize_intrinsics_distortions &&
-       !problem_selections.do_optimize_extrinsics             &&
-       !problem_selections.do_optimize_frames                 &&
-       !problem_selections.do_optimize_calobject_warp)
+    M->L = malloc(M->ioffset[M->Nblocks]*sizeof(double));
+    if(M->L == NULL)
     {
-        MSG("Warning: Not optimizing any of our variables");
+        MSG("Couldn't allocate the preconditioner");
+        pcg_preconditioner_free(M);
+        return false;
+    }
+    return true;
+}
+
+// If do_store_jacobian_float32, the values of Jt are stored in single
+// precision, but all the arithmetic is in double precision. The kernels below
+// test the dtype once, and then run a copy of their loops specific to it: the
+// loop is written as a macro taking the type-specific pointer to the values
+#define PCG_FOR_JT_DTYPE(Jt, Jx, loop)                       \
+    do                                                      \
+    {                                                       \
+        if((Jt)->dtype == CHOLMOD_SINGLE)                   \
+        {                                                   \
+            const float*  Jx = (const float* )(Jt)->x;      \
+            loop;                                           \
+        }                                                   \
+        else                                                \
+        {                                                   \
+            const double* Jx = (const double*)(Jt)->x;      \
+            loop;                                           \
+        }                                                   \
+    } while(0)
+
+// Computes and factors the blocks of J^T J at the current operating point
+static void pcg_preconditioner_compute(// out
+                                       pcg_preconditioner_t* M,
+
+                                       // in
+                                       const cholmod_sparse* Jt)
+{
+    const int*    Jp = (const int*   )Jt->p;
+    const int*    Ji = (const int*   )Jt->i;
+
+    memset(M->L, 0, M->ioffset[M->Nblocks]*sizeof(double));
+
+    // The lower triangle of each block of J^T J. Each column of Jt is one row
+    // of J
+#define ACCUMULATE_BLOCKS                                               \
+    for(int imeasurement=0; imeasurement<(int)Jt->ncol; imeasurement++) \
+        for(int k0=Jp[imeasurement]; k0<Jp[imeasurement+1]; k0++)       \
+        {                                                               \
+            const int i      = Ji[k0];                                  \
+            const int iblock = M->iblock[i];                            \
+            const int i0     = M->istate0[iblock];                      \
+            const int n      = M->istate0[iblock+1] - i0;               \
+            double*   A      = &M->L[M->ioffset[iblock]];               \
+                                                                        \
+            for(int k1=Jp[imeasurement]; k1<Jp[imeasurement+1]; k1++)   \
+            {                                                           \
+                const int j = Ji[k1];                                   \
+                if(j > i || M->iblock[j] != iblock)                     \
+                    continue;                                           \
+                A[(i-i0)*n + i-j] += (double)Jx[k0]*(double)Jx[k1];     \
+            }                                                           \
+        }
+    PCG_FOR_JT_DTYPE(Jt, Jx, ACCUMULATE_BLOCKS);
+#undef ACCUMULATE_BLOCKS
+
+    for(int iblock=0; iblock<M->Nblocks; iblock++)
+    {
+        const int n = M->istate0[iblock+1] - M->istate0[iblock];
+        double*   A = &M->L[M->ioffset[iblock]];
+
+        // States that no measurement touches have an empty row and column. I
+        // leave those unscaled
+        double diagmax = 0.0;
+        for(int i=0; i<n; i++)
+            if(A[i*n] > diagmax)
+                diagmax = A[i*n];
+        for(int i=0; i<n; i++)
+            if(!(A[i*n] > 0.0))
+                A[i*n] = diagmax > 0.0 ? diagmax : 1.0;
+
+        double A0[n*n];
+        memcpy(A0, A, n*n*sizeof(double));
+        if(banded_cholesky(A, n, n-1))
+            continue;
+
+        // The block is singular: a point observed by a single camera, for
+        // instance. I try again with a small ridge, and if that doesn't work
+        // either, I fall back to the diagonal
+        memcpy(A, A0, n*n*sizeof(double));
+        for(int i=0; i<n; i++)
+            A[i*n] += 1e-9*diagmax;
+        if(banded_cholesky(A, n, n-1))
+            continue;
+
+        for(int i=0; i<n; i++)
+        {
+            for(int j=1; j<n; j++)
+                A[i*n + j] = 0.0;
+            A[i*n] = sqrt(A0[i*n]);
+        }
+    }
+}
+
+static void pcg_preconditioner_apply(// out
+                                     double* z,
+
+                                     // in
+                                     const double* r,
+                                     const pcg_preconditioner_t* M)
+{
+    memcpy(z, r, M->istate0[M->Nblocks]*sizeof(double));
+    for(int iblock=0; iblock<M->Nblocks; iblock++)
+    {
+        const int n = M->istate0[iblock+1] - M->istate0[iblock];
+        banded_cholesky_solve(&z[M->istate0[iblock]],
+                              &M->L[M->ioffset[iblock]],
+                              n, n-1);
+    }
+}
+
+// out = J v
+static void pcg_J_v(double* out, const cholmod_sparse* Jt, const double* v)
+{
+    const int*    Jp = (const int*   )Jt->p;
+    const int*    Ji = (const int*   )Jt->i;
+
+#define J_V                                                             \
+    for(int imeasurement=0; imeasurement<(int)Jt->ncol; imeasurement++) \
+    {                                                                   \
+        double s = 0.0;                                                 \
+        for(int k=Jp[imeasurement]; k<Jp[imeasurement+1]; k++)          \
+            s += (double)Jx[k]*v[Ji[k]];                                \
+        out[imeasurement] = s;                                          \
+    }
+    PCG_FOR_JT_DTYPE(Jt, Jx, J_V);
+#undef J_V
+}
+
+// out = J^T w
+static void pcg_Jt_w(double* out, const cholmod_sparse* Jt, const double* w)
+{
+    const int*    Jp = (const int*   )Jt->p;
+    const int*    Ji = (const int*   )Jt->i;
+
+    memset(out, 0, Jt->nrow*sizeof(double));
+#define JT_W                                                            \
+    for(int imeasurement=0; imeasurement<(int)Jt->ncol; imeasurement++) \
+        for(int k=Jp[imeasurement]; k<Jp[imeasurement+1]; k++)          \
+            out[Ji[k]] += (double)Jx[k]*w[imeasurement];
+    PCG_FOR_JT_DTYPE(Jt, Jx, JT_W);
+#undef JT_W
+}
+
+static double pcg_dot(const double* a, const double* b, int N)
+{
+    double s = 0.0;
+    for(int i=0; i<N; i++)
+        s += a[i]*b[i];
+    return s;
+}
+
+typedef struct
+{
+    // Nstate of each of these
+    double *g, *s, *r, *z, *d, *Bd;
+    // Nmeasurements
+    double *Jd;
+} pcg_workspace_t;
+
+// Approximately solves the trust-region subproblem
+//
+//   min( g^T s + 1/2 s^T J^T J s ) subject to norm_M(s) <= trustregion
+//
+// with the Steihaug-Toint method, writing the step into w->s. The iterations
+// stop when the residual drops below eta*norm(g), or when the step reaches the
+// trust-region boundary. The M-norms are tracked with the usual PCG
+// recurrences, so M itself is never needed; only its inverse. If the trust
+// region is unbounded, and the first direction has no curvature, there's no
+// boundary to go to; I then take the steepest-descent step of M-norm
+// trustregion_unbounded. Returns the M-norm of the step, and sets
+// *hit_boundary and *Niterations
+static double pcg_solve_step(// out
+                             bool* hit_boundary,
+                             int*  Niterations,
+
+                             // in,out
+                             pcg_workspace_t* w,
+
+                             // in
+                             const cholmod_sparse* Jt,
+                             const pcg_preconditioner_t* M,
+                             double trustregion,
+                             double trustregion_unbounded,
+                             double eta)
+{
+    const int Nstate = (int)Jt->nrow;
+    double trustregion2 = trustregion*trustregion;
+
+    memset(w->s, 0, Nstate*sizeof(double));
+    memcpy(w->r, w->g, Nstate*sizeof(double));
+    pcg_preconditioner_apply(w->z, w->r, M);
+    for(int i=0; i<Nstate; i++)
+        w->d[i] = -w->z[i];
+
+    double rz  = pcg_dot(w->r, w->z, Nstate);
+    double sMs = 0.0;
+    double sMd = 0.0;
+    double dMd = rz;
+
+    const double r_threshold = eta * sqrt(pcg_dot(w->g, w->g, Nstate));
+
+    *hit_boundary = false;
+    int iteration;
+    for(iteration=0; iteration<Nstate; iteration++)
+    {
+        pcg_J_v (w->Jd, Jt, w->d);
+        pcg_Jt_w(w->Bd, Jt, w->Jd);
+        const double dBd = pcg_dot(w->Jd, w->Jd, (int)Jt->ncol);
+
+        const double alpha = rz / dBd;
+        if(!(dBd > 0.0) ||
+           sMs + 2.0*alpha*sMd + alpha*alpha*dMd >= trustregion2)
+        {
+            // The step leaves the trust region, or we have no curvature in
+            // this direction. I go to the boundary along d:
+            // norm2_M(s + tau d) = trustregion^2
+            if(!isfinite(trustregion2))
+            {
+                // No curvature, and no boundary. If I already have a step, I
+                // keep it. Otherwise s=0, and d is the steepest-descent
+                // direction: I use the fallback boundary
+                if(iteration > 0)
+                    break;
+                trustregion2 = trustregion_unbounded*trustregion_unbounded;
+            }
+            const double tau =
+                (-sMd + sqrt(sMd*sMd + dMd*(trustregion2 - sMs))) / dMd;
+            for(int i=0; i<Nstate; i++)
+                w->s[i] += tau*w->d[i];
+            sMs = trustregion2;
+            *hit_boundary = true;
+            iteration++;
+            break;
+        }
+
+        for(int i=0; i<Nstate; i++)
+        {
+            w->s[i] += alpha*w->d[i];
+            w->r[i] += alpha*w->Bd[i];
+        }
+        sMs += 2.0*alpha*sMd + alpha*alpha*dMd;
+
+        if(sqrt(pcg_dot(w->r, w->r, Nstate)) <= r_threshold)
+        {
+            iteration++;
+            break;
+        }
+
+        pcg_preconditioner_apply(w->z, w->r, M);
+        const double rz_new = pcg_dot(w->r, w->z, Nstate);
+        const double beta   = rz_new / rz;
+        rz = rz_new;
+        for(int i=0; i<Nstate; i++)
+            w->d[i] = -w->z[i] + beta*w->d[i];
+
+        sMd = beta*(sMd + alpha*dMd);
+        dMd = rz + beta*beta*dMd;
+    }
+    *Niterations = iteration;
+    return sqrt(sMs);
+}
+
+// Solves the optimization problem with the matrix-free trust-region solver
+// described above. The parameters are interpreted as in libdogleg, except that
+// the trust region is measured in the preconditioner norm. The trust region
+// starts out unbounded: the first step is the full (inexact) Gauss-Newton step.
+// trustregion0 is only used if that step can't be computed because the
+// steepest-descent direction has no curvature. p is updated in-place, and the
+// measurements at the solution are written to x. Returns norm2(x), or <0 on
+// error
+static double pcg_optimize(// in,out
+                           double* p,
+
+                           // out
+                           double* x,
+
+                           // in
+                           const dogleg_parameters2_t* parameters,
+                           const callback_context_t* ctx,
+                           int Nstate)
+{
+    const int  Nmeasurements = ctx->Nmeasurements;
+    const bool verbose       = ctx->verbose;
+
+    double norm2_x = -1.0;
+
+    pcg_preconditioner_t M         = {};
+    pcg_workspace_t      w         = {};
+    double*              buffer    = NULL;
+    int*                 Jp        = NULL;
+    int*                 Ji        = NULL;
+    void*                Jx        = NULL;
+    void*                Jx_candidate = NULL;
+
+    const bool float32 = ctx->problem_selections.do_store_jacobian_float32;
+
+    if(!pcg_preconditioner_init(&M, ctx, Nstate))
+        goto done;
+
+    buffer = malloc((7*Nstate + 2*Nmeasurements)*sizeof(double));
+    Jp     = malloc((Nmeasurements+1)*sizeof(int));
+    Ji     = malloc(ctx->N_j_nonzero*sizeof(int));
+    // The sparsity pattern of J doesn't depend on the state, but the values do.
+    // I keep the values at the current operating point and at the candidate
+    // separately, so that a rejected step doesn't need J to be recomputed
+    Jx           = malloc(ctx->N_j_nonzero*(float32 ? sizeof(float) : sizeof(double)));
+    Jx_candidate = malloc(ctx->N_j_nonzero*(float32 ? sizeof(float) : sizeof(double)));
+    if(buffer == NULL || Jp == NULL || Ji == NULL || Jx == NULL || Jx_candidate == NULL)
+    {
+        MSG("Couldn't allocate the PCG solver buffers");
+        goto done;
+    }
+
+    w = (pcg_workspace_t){ .g  = &buffer[0*Nstate],
+                           .s  = &buffer[1*Nstate],
+                           .r  = &buffer[2*Nstate],
+                           .z  = &buffer[3*Nstate],
+                           .d  = &buffer[4*Nstate],
+                           .Bd = &buffer[5*Nstate],
+                           .Jd = &buffer[7*Nstate] };
+    double* p_candidate = &buffer[6*Nstate];
+    double* x_candidate = &buffer[7*Nstate + Nmeasurements];
+
+    cholmod_sparse Jt = { .nrow   = Nstate,
+                          .ncol   = Nmeasurements,
+                          .nzmax  = ctx->N_j_nonzero,
+                          .p      = Jp,
+                          .i      = Ji,
+                          .x      = Jx,
+                          .stype  = 0,
+                          .itype  = CHOLMOD_INT,
+                          .xtype  = CHOLMOD_REAL,
+                          .dtype  = float32 ? CHOLMOD_SINGLE : CHOLMOD_DOUBLE,
+                          .sorted = 1,
+                          .packed = 1 };
+
+    optimizer_callback(p, x, &Jt, ctx);
+    norm2_x = pcg_dot(x, x, Nmeasurements);
+    pcg_preconditioner_compute(&M, &Jt);
+    pcg_Jt_w(w.g, &Jt, x);
+    const double norm_g0 = sqrt(pcg_dot(w.g, w.g, Nstate));
+
+    double trustregion = INFINITY;
+    int    iteration;
+    for(iteration=0; iteration<parameters->max_iterations; iteration++)
+    {
+        const double norm_g = sqrt(pcg_dot(w.g, w.g, Nstate));
+        if(norm_g == 0.0)
+            break;
+        bool converged_gradient = true;
+        for(int i=0; i<Nstate; i++)
+            if(fabs(w.g[i]) > parameters->Jt_x_threshold)
+            {
+                converged_gradient = false;
+                break;
+            }
+        if(converged_gradient)
+        {
+            MSG_IF_VERBOSE("PCG: gradient below threshold. Done");
+            break;
+        }
+
+        // The Eisenstat-Walker-style forcing term: the steps get more precise
+        // as we converge
+        double eta = sqrt(norm_g / norm_g0);
+        if(eta > 0.1) eta = 0.1;
+
+        bool hit_boundary;
+        int  Niterations_cg;
+        const double norm_step =
+            pcg_solve_step(&hit_boundary, &Niterations_cg,
+                           &w, &Jt, &M, trustregion,
+                           parameters->trustregion0, eta);
+        if(hit_boundary && !isfinite(trustregion))
+            // We had no curvature, and took a steepest-descent step to the
+            // fallback boundary. That's the trust region now
+            trustregion = norm_step;
+
+        double step_max = 0.0;
+        for(int i=0; i<Nstate; i++)
+        {
+            p_candidate[i] = p[i] + w.s[i];
+            if(fabs(w.s[i]) > step_max)
+                step_max = fabs(w.s[i]);
+        }
+
+        // The expected improvement from the linearized model:
+        // norm2(x) - norm2(x + J s)
+        pcg_J_v(w.Jd, &Jt, w.s);
+        double norm2_x_expected = 0.0;
+        for(int i=0; i<Nmeasurements; i++)
+            norm2_x_expected += (x[i] + w.Jd[i])*(x[i] + w.Jd[i]);
+        const double expected_improvement = norm2_x - norm2_x_expected;
+
+        // The candidate J goes into its own buffer
+        Jt.x = Jx_candidate;
+        optimizer_callback(p_candidate, x_candidate, &Jt, ctx);
+        Jt.x = Jx;
+        const double norm2_x_candidate = pcg_dot(x_candidate, x_candidate, Nmeasurements);
+        const double rho =
+            expected_improvement > 0.0 ?
+            (norm2_x - norm2_x_candidate) / expected_improvement :
+            -1.0;
+
+        MSG_IF_VERBOSE("PCG iteration %d: norm2(x)=%.10g, candidate norm2(x)=%.10g, rho=%g, trustregion=%g, step=%g, CG iterations: %d",
+                       iteration, norm2_x, norm2_x_candidate, rho,
+                       trustregion, norm_step, Niterations_cg);
+
+        if(rho < parameters->trustregion_decrease_threshold)
+            trustregion = parameters->trustregion_decrease_factor * norm_step;
+        else if(rho > parameters->trustregion_increase_threshold && hit_boundary)
+            trustregion *= parameters->trustregion_increase_factor;
+
+        if(norm2_x_candidate < norm2_x)
+        {
+            // Accept the step. The candidate J becomes the current one
+            void* Jx_swap = Jx;
+            Jx            = Jx_candidate;
+            Jx_candidate  = Jx_swap;
+            Jt.x          = Jx;
+
+            memcpy(p, p_candidate, Nstate*sizeof(double));
+            memcpy(x, x_candidate, Nmeasurements*sizeof(double));
+            norm2_x = norm2_x_candidate;
+            pcg_preconditioner_compute(&M, &Jt);
+            pcg_Jt_w(w.g, &Jt, x);
+        }
+        // Otherwise I reject the step. Jt still has the J at the current
+        // operating point
+
+        if(step_max < parameters->update_threshold)
+        {
+            MSG_IF_VERBOSE("PCG: step below threshold. Done");
+            break;
+        }
+        if(trustregion < parameters->trustregion_threshold)
+        {
+            MSG_IF_VERBOSE("PCG: trust region below threshold. Done");
+            break;
+        }
+    }
+    if(iteration == parameters->max_iterations)
+        MSG("PCG solver: hit the iteration limit (%d) before converging",
+            parameters->max_iterations);
+
+ done:
+    pcg_preconditioner_free(&M);
+    free(buffer);
+    free(Jp);
+    free(Ji);
+    free(Jx);
+    free(Jx_candidate);
+    return norm2_x;
+}
+
+mrcal_stats_t
+mrcal_optimize( // out
+                // Each one of these output pointers may be NULL
+
+                // Shape (Nstate,)
+                double* p_packed_final,
+                // used only to confirm that the user passed-in the buffer they
+                // should have passed-in. The size must match exactly
+                int buffer_size_p_packed_final,
+
+                // Shape (Nmeasurements,)
+                double* x_final,
+                // used only to confirm that the user passed-in the buffer they
+                // should have passed-in. The size must match exactly
+                int buffer_size_x_final,
+
+                // out, in
+
+                // These are a seed on input, solution on output
+
+                // intrinsics is a concatenation of the intrinsics core and the
+                // distortion params. The specific distortion parameters may
+                // vary, depending on lensmodel, so this is a variable-length
+                // structure
+                double*             intrinsics,         // Ncameras_intrinsics * NlensParams
+                mrcal_pose_t*       extrinsics_fromref, // Ncameras_extrinsics of these. Transform FROM the reference frame
+                mrcal_pose_t*       frames_toref,       // Nframes of these.    Transform TO the reference frame
+                mrcal_point3_t*     points,             // Npoints of these.    In the reference frame
+                mrcal_point2_t*     calobject_warp,     // 1 of these. May be NULL if !problem_selections.do_optimize_calobject_warp
+
+                // in
+                int Ncameras_intrinsics, int Ncameras_extrinsics, int Nframes,
+                int Npoints, int Npoints_fixed, // at the end of points[]
+
+                const mrcal_observation_board_t* observations_board,
+                const mrcal_observation_point_t* observations_point,
+                int Nobservations_board,
+                int Nobservations_point,
+
+                // All the board pixel observations, in order.
+                // .x, .y are the pixel observations
+                // .z is the weight of the observation. Most of the weights are
+                // expected to be 1.0, which implies that the noise on the
+                // observation has standard deviation of
+                // observed_pixel_uncertainty. observed_pixel_uncertainty scales
+                // inversely with the weight.
+                //
+                // z<0 indicates that this is an outlier. This is respected on
+                // input (even if !do_apply_outlier_rejection). New outliers are
+                // marked with z<0 on output, so this isn't const
+                mrcal_point3_t* observations_board_pool,
+
+                mrcal_lensmodel_t lensmodel,
+                double observed_pixel_uncertainty,
+                const int* imagersizes, // Ncameras_intrinsics*2 of these
+                mrcal_problem_selections_t       problem_selections,
+                const mrcal_problem_constants_t* problem_constants,
+
+                double calibration_object_spacing,
+                int calibration_object_width_n,
+                int calibration_object_height_n,
+                bool verbose,
+
+                bool check_gradient)
+{
+    if( Nobservations_board > 0 )
+    {
+        if( problem_selections.do_optimize_calobject_warp && calobject_warp == NULL )
+        {
+            MSG("ERROR: We're optimizing the calibration object warp, so a buffer with a seed MUST be passed in.");
+            return (mrcal_stats_t){.rms_reproj_error__pixels = -1.0};
+        }
+    }
+    else
+        problem_selections.do_optimize_calobject_warp = false;
+
+    if(!modelHasCore_fxfycxcy(lensmodel))
+        problem_selections.do_optimize_intrinsics_core = false;
+
+    if(problem_selections.do_store_jacobian_float32 &&
+       !problem_selections.do_solve_with_pcg && !check_gradient)
+    {
+        MSG("ERROR: do_store_jacobian_float32 requires do_solve_with_pcg: libdogleg works with double-precision Jacobians only");
+        return (mrcal_stats_t){.rms_reproj_error__pixels = -1.0};
+    }
+
+    if(!problem_selections.do_optimize_intrinsics_core        &&
+       !problem_selections.do_optimize_intrinsics_distortions &&
+       !problem_selections.do_optimize_extrinsics             &&
+       !problem_selections.do_optimize_frames                 &&
+       !problem_selections.do_optimize_calobject_warp)
+    {
+        MSG("Warning: Not optimizing any of our variables");
     }
 
     dogleg_parameters2_t dogleg_parameters;
@@ -4932,8 +5639,24 @@ mrcal_optimize( // out
     double norm2_error = -1.0;
     mrcal_stats_t stats = {.rms_reproj_error__pixels = -1.0 };
 
+    // The solution. libdogleg keeps it in its context; the PCG solver writes
+    // the measurements into x_pcg
+    const double* p_solved = NULL;
+    const double* x_solved = NULL;
+    double*       x_pcg    = NULL;
+
     if( !check_gradient )
     {
+        if(problem_selections.do_solve_with_pcg)
+        {
+            x_pcg = malloc(ctx.Nmeasurements*sizeof(double));
+            if(x_pcg == NULL)
+            {
+                MSG("Couldn't allocate the measurement vector");
+                goto done;
+            }
+        }
+
         stats.Noutliers = 0;
 
         int Nfeatures =
@@ -4955,15 +5678,30 @@ mrcal_optimize( // out
         double outliernessScale = -1.0;
         do
         {
-            norm2_error = dogleg_optimize2(packed_state,
-                                           Nstate, ctx.Nmeasurements, ctx.N_j_nonzero,
-                                           (dogleg_callback_t*)&optimizer_callback, &ctx,
+            if(problem_selections.do_solve_with_pcg)
+            {
+                norm2_error = pcg_optimize(packed_state, x_pcg,
                                            &dogleg_parameters,
-                                           &solver_context);
-
-            if(norm2_error < 0)
-                // libdogleg barfed. I quit out
-                goto done;
+                                           &ctx, Nstate);
+                if(norm2_error < 0)
+                    goto done;
+                p_solved = packed_state;
+                x_solved = x_pcg;
+            }
+            else
+            {
+                norm2_error = dogleg_optimize2(packed_state,
+                                               Nstate, ctx.Nmeasurements, ctx.N_j_nonzero,
+                                               (dogleg_callback_t*)&optimizer_callback, &ctx,
+                                               &dogleg_parameters,
+                                               &solver_context);
+
+                if(norm2_error < 0)
+                    // libdogleg barfed. I quit out
+                    goto done;
+                p_solved = solver_context->beforeStep->p;
+                x_solved = solver_context->beforeStep->x;
+            }
 
 #if 0
             // Not using dogleg_markOutliers() (for now?)
@@ -4984,7 +5722,7 @@ mrcal_optimize( // out
                               Nobservations_board,
                               calibration_object_width_n,
                               calibration_object_height_n,
-                              solver_context->beforeStep->x,
+                              x_solved,
                               observed_pixel_uncertainty,
                               verbose) &&
                  ({MSG("Threw out some outliers (have a total of %d now); going again", stats.Noutliers); true;}));
@@ -5024,7 +5762,7 @@ mrcal_optimize( // out
 
                 for(int i=0; i<Nmeasurements_regularization; i++)
                 {
-                    double x = solver_context->beforeStep->x[ctx.Nmeasurements-1 - i];
+                    double x = x_solved[ctx.Nmeasurements-1 - i];
                     norm2_err_regularization += x*x;
                 }
 
@@ -5056,13 +5794,3349 @@ mrcal_optimize( // out
         sqrt(norm2_error / ((double)ctx.Nmeasurements / 2.0));
 
     if(p_packed_final)
-        memcpy(p_packed_final, solver_context->beforeStep->p, Nstate*sizeof(double));
+        memcpy(p_packed_final, p_solved, Nstate*sizeof(double));
     if(x_final)
-        memcpy(x_final, solver_context->beforeStep->x, ctx.Nmeasurements*sizeof(double));
+        memcpy(x_final, x_solved, ctx.Nmeasurements*sizeof(double));
 
  done:
     if(solver_context != NULL)
         dogleg_freeContext(&solver_context);
+    free(x_pcg);
 
     return stats;
 }
+
+typedef struct
+{
+    int N;
+    // The next work item to hand out. Accessed atomically by all the workers
+    int i_next;
+    void (*work)(int i, void* cookie);
+    void* cookie;
+} parallel_for_context_t;
+
+static void* parallel_for_worker(void* _ctx)
+{
+    parallel_for_context_t* ctx = (parallel_for_context_t*)_ctx;
+    while(true)
+    {
+        int i = __atomic_fetch_add(&ctx->i_next, 1, __ATOMIC_RELAXED);
+        if(i >= ctx->N)
+            return NULL;
+        ctx->work(i, ctx->cookie);
+    }
+}
+
+void _mrcal_parallel_for(int N, int Nthreads,
+                         void (*work)(int i, void* cookie),
+                         void* cookie)
+{
+    if(N <= 0)
+        return;
+
+    if(Nthreads <= 0)
+    {
+        long Ncores = sysconf(_SC_NPROCESSORS_ONLN);
+        Nthreads = Ncores > 0 ? (int)Ncores : 1;
+    }
+    if(Nthreads > N)
+        Nthreads = N;
+
+    parallel_for_context_t ctx = { .N      = N,
+                                   .i_next = 0,
+                                   .work   = work,
+                                   .cookie = cookie };
+
+    // The calling thread is one of the workers, so I spawn Nthreads-1 more. If
+    // I can't create some of the threads, that's fine: the workers that I DO
+    // have will pick up the slack
+    pthread_t threads[Nthreads];
+    int Nthreads_started = 0;
+    for(int i=0; i<Nthreads-1; i++)
+    {
+        if(0 != pthread_create(&threads[Nthreads_started], NULL,
+                               &parallel_for_worker, &ctx))
+            break;
+        Nthreads_started++;
+    }
+
+    parallel_for_worker(&ctx);
+
+    for(int i=0; i<Nthreads_started; i++)
+        pthread_join(threads[i], NULL);
+}
+
+static void optimize_batch_work(int i, void* cookie)
+{
+    mrcal_optimize_problem_t* problem = &((mrcal_optimize_problem_t*)cookie)[i];
+
+    problem->stats =
+        mrcal_optimize( problem->p_packed,
+                        problem->buffer_size_p_packed,
+                        problem->x,
+                        problem->buffer_size_x,
+                        problem->intrinsics,
+                        problem->extrinsics_fromref,
+                        problem->frames_toref,
+                        problem->points,
+                        problem->calobject_warp,
+                        problem->Ncameras_intrinsics, problem->Ncameras_extrinsics,
+                        problem->Nframes,
+                        problem->Npoints, problem->Npoints_fixed,
+                        problem->observations_board,
+                        problem->observations_point,
+                        problem->Nobservations_board,
+                        problem->Nobservations_point,
+                        problem->observations_board_pool,
+                        problem->lensmodel,
+                        problem->observed_pixel_uncertainty,
+                        problem->imagersizes,
+                        problem->problem_selections,
+                        problem->problem_constants,
+                        problem->calibration_object_spacing,
+                        problem->calibration_object_width_n,
+                        problem->calibration_object_height_n,
+                        problem->verbose,
+                        false);
+}
+
+bool mrcal_optimize_batch( // out, in
+                           mrcal_optimize_problem_t* problems,
+
+                           // in
+                           int Nproblems,
+                           int Nthreads)
+{
+    _mrcal_parallel_for(Nproblems, Nthreads,
+                        &optimize_batch_work, problems);
+
+    bool result = true;
+    for(int i=0; i<Nproblems; i++)
+        if(problems[i].stats.rms_reproj_error__pixels < 0.0)
+        {
+            MSG("Problem %d in the batch failed to solve", i);
+            result = false;
+        }
+    return result;
+}
+
+// The uncertainty computation in http://mrcal.secretsauce.net/uncertainty.html
+// concludes that
+//
+//   Var(p*) = observed_pixel_uncertainty^2 inv(J*tJ*) J*[observations]t J*[observations] inv(J*tJ*)
+//
+// where p* and J* are the UNITLESS state and the jacobian respectively. In the
+// special case where all the measurements come from observations, this
+// simplifies to
+//
+//   Var(p*) = observed_pixel_uncertainty^2 inv(J*tJ*)
+//
+// I want Var(q) = dq/dp*[ief] Var(p*[ief]) dq/dp*[ief]t. dq/dp* = dq/dp D where
+// D is the diagonal matrix of state scales. It is far more efficient to compute
+// A = inv(J*tJ*) dq/dp*t than inv(J*tJ*) J*[observations]t: there's far less to
+// compute, and the matrices are far smaller. So
+//
+// - in the non-regularized case: Var(q) = dq/dp* A
+// - in the regularized case:     Var(q) = sum_i outer( (J*[observations] A)[i,:] )
+//
+// dq/dp*[ief] is nonzero only in the columns corresponding to the intrinsics
+// of this camera, the extrinsics of this camera and the frame poses. These
+// columns are the same for every query point
+#define UNCERTAINTY_CHUNK_NPOINTS 32
+
+typedef struct
+{
+    mrcal_uncertainty_what_t what;
+    const mrcal_point3_t*    p_cam;
+    int                      N;
+    bool                     atinfinity;
+
+    mrcal_lensmodel_t   lensmodel;
+    const double*       intrinsics;
+    int                 Nintrinsics;
+    const mrcal_pose_t* extrinsics_fromref;
+    const mrcal_pose_t* frames_toref;
+    int                 Nframes;
+
+    int i_intrinsics0;
+    int Nintrinsics_optimized;
+
+    // The state indices of the nonzero columns of dq/dp_ief, and how many
+    // there are
+    const int* istate_ief;
+    int        Nief;
+    // Where the extrinsics, frames live in the ief list. <0 if not present
+    int        iief_extrinsics;
+    int        iief_frames;
+
+    int                   Nstate;
+    const double*         state_scale;
+    // If non-NULL, the precomputed inv(J*tJ*)[ief,ief]. We use it instead of
+    // solving against the factorization
+    const double*         Var_ief;
+    cholmod_factor*       factorization;
+    const cholmod_sparse* Jt;
+    int                   Nmeasurements_observations;
+    double                observed_pixel_uncertainty;
+
+    double* out;
+
+    // set by the workers if anything failed
+    bool    failed;
+} projection_uncertainty_context_t;
+
+// Accumulates sum_i outer( (J[irow0:irow1,:] At)[i,:] ) for each pair of
+// columns of At, into Var. At is a dense (Nstate,Nrhs) array; each point is
+// represented by 2 consecutive columns, and Var has Nrhs/2 elements. Only the
+// upper triangle of each 2x2 block is accumulated: Var[][2] isn't touched.
+// Each row of J is applied to all the RHS at once, so J is read only once
+static void A_Jt_J_At_accumulate_rows(// out; accumulated
+                                      double (*Var)[4],
+
+                                      // in
+                                      const double* At, int Nrhs,
+                                      const int32_t* Jp,
+                                      const int32_t* Ji,
+                                      const double*  Jx,
+                                      int irow0, int irow1)
+{
+    double u[Nrhs];
+    for(int irow=irow0; irow<irow1; irow++)
+    {
+        memset(u, 0, Nrhs*sizeof(u[0]));
+        for(int32_t k=Jp[irow]; k<Jp[irow+1]; k++)
+        {
+            const double* Atrow = &At[Ji[k]*Nrhs];
+            for(int i=0; i<Nrhs; i++)
+                u[i] += Jx[k] * Atrow[i];
+        }
+        for(int i=0; i<Nrhs/2; i++)
+        {
+            Var[i][0] += u[2*i+0]*u[2*i+0];
+            Var[i][1] += u[2*i+0]*u[2*i+1];
+            Var[i][3] += u[2*i+1]*u[2*i+1];
+        }
+    }
+}
+
+// Computes dq/dp_ief for a single point, using the unpacked state: a (2,Nief)
+// array. Each row has the same layout as ctx->istate_ief
+static bool projection_uncertainty_dq_dpief(// out
+                                            double* dq_dpief,
+
+                                            // in
+                                            const mrcal_point3_t* p_cam,
+                                            const projection_uncertainty_context_t* ctx)
+{
+    int Nief = ctx->Nief;
+    memset(dq_dpief, 0, 2*Nief*sizeof(double));
+
+    // The pose variables. At infinity I only look at the rotations
+    int Npose = ctx->atinfinity ? 3 : 6;
+
+    mrcal_point3_t p_ref;
+    if(ctx->extrinsics_fromref != NULL)
+    {
+        if(ctx->atinfinity)
+            mrcal_rotate_point_r_full(p_ref.xyz, 0, NULL,0,0, NULL,0,0,
+                                      ctx->extrinsics_fromref->r.xyz, 0,
+                                      p_cam->xyz, 0, true);
+        else
+            mrcal_transform_point_rt_full(p_ref.xyz, 0, NULL,0,0, NULL,0,0,
+                                          ctx->extrinsics_fromref->r.xyz, 0,
+                                          p_cam->xyz, 0, true);
+    }
+    else
+        p_ref = *p_cam;
+
+    mrcal_point3_t dq_dpcam[2];
+    double         dq_dintrinsics[2*ctx->Nintrinsics];
+    mrcal_point2_t q;
+    if(!mrcal_project(&q, dq_dpcam, dq_dintrinsics,
+                      p_cam, 1, ctx->lensmodel, ctx->intrinsics))
+        return false;
+
+    for(int i=0; i<ctx->Nintrinsics_optimized; i++)
+    {
+        dq_dpief[0*Nief + i] = dq_dintrinsics[0*ctx->Nintrinsics + ctx->i_intrinsics0 + i];
+        dq_dpief[1*Nief + i] = dq_dintrinsics[1*ctx->Nintrinsics + ctx->i_intrinsics0 + i];
+    }
+
+    // dq/dpref. If the camera sits at the reference, this is dq/dpcam
+    double dq_dpref[2][3];
+    if(ctx->extrinsics_fromref != NULL)
+    {
+        double dpcam_dpose[3][6];
+        double dpcam_dpref[3][3];
+        mrcal_point3_t pcam_unused;
+        if(ctx->atinfinity)
+            mrcal_rotate_point_r_full(pcam_unused.xyz, 0,
+                                      &dpcam_dpose[0][0], 6*sizeof(double), sizeof(double),
+                                      &dpcam_dpref[0][0], 0, 0,
+                                      ctx->extrinsics_fromref->r.xyz, 0,
+                                      p_ref.xyz, 0, false);
+        else
+            mrcal_transform_point_rt_full(pcam_unused.xyz, 0,
+                                          &dpcam_dpose[0][0], 0, 0,
+                                          &dpcam_dpref[0][0], 0, 0,
+                                          ctx->extrinsics_fromref->r.xyz, 0,
+                                          p_ref.xyz, 0, false);
+
+        for(int i=0; i<2; i++)
+        {
+            for(int j=0; j<3; j++)
+                dq_dpref[i][j] =
+                    dq_dpcam[i].xyz[0]*dpcam_dpref[0][j] +
+                    dq_dpcam[i].xyz[1]*dpcam_dpref[1][j] +
+                    dq_dpcam[i].xyz[2]*dpcam_dpref[2][j];
+
+            if(ctx->iief_extrinsics >= 0)
+                for(int j=0; j<Npose; j++)
+                    dq_dpief[i*Nief + ctx->iief_extrinsics + j] =
+                        dq_dpcam[i].xyz[0]*dpcam_dpose[0][j] +
+                        dq_dpcam[i].xyz[1]*dpcam_dpose[1][j] +
+                        dq_dpcam[i].xyz[2]*dpcam_dpose[2][j];
+        }
+    }
+    else
+        for(int i=0; i<2; i++)
+            for(int j=0; j<3; j++)
+                dq_dpref[i][j] = dq_dpcam[i].xyz[j];
+
+    if(ctx->iief_frames >= 0)
+    {
+        // I represent the point in the coordinate system of each frame. Then I
+        // transform each one back to the reference coordinate system, and
+        // use the mean of those. I already have the mean, p_ref, so I only
+        // need the gradients
+        for(int iframe=0; iframe<ctx->Nframes; iframe++)
+        {
+            const mrcal_pose_t* frame = &ctx->frames_toref[iframe];
+
+            mrcal_point3_t p_frame, pref_unused;
+            double dpref_dframe[3][6];
+            if(ctx->atinfinity)
+            {
+                mrcal_rotate_point_r_full(p_frame.xyz, 0, NULL,0,0, NULL,0,0,
+                                          frame->r.xyz, 0,
+                                          p_ref.xyz, 0, true);
+                mrcal_rotate_point_r_full(pref_unused.xyz, 0,
+                                          &dpref_dframe[0][0], 6*sizeof(double), sizeof(double),
+                                          NULL, 0, 0,
+                                          frame->r.xyz, 0,
+                                          p_frame.xyz, 0, false);
+            }
+            else
+            {
+                mrcal_transform_point_rt_full(p_frame.xyz, 0, NULL,0,0, NULL,0,0,
+                                              frame->r.xyz, 0,
+                                              p_ref.xyz, 0, true);
+                mrcal_transform_point_rt_full(pref_unused.xyz, 0,
+                                              &dpref_dframe[0][0], 0, 0,
+                                              NULL, 0, 0,
+                                              frame->r.xyz, 0,
+                                              p_frame.xyz, 0, false);
+            }
+
+            for(int i=0; i<2; i++)
+                for(int j=0; j<Npose; j++)
+                    dq_dpief[i*Nief + ctx->iief_frames + iframe*Npose + j] =
+                        (dq_dpref[i][0]*dpref_dframe[0][j] +
+                         dq_dpref[i][1]*dpref_dframe[1][j] +
+                         dq_dpref[i][2]*dpref_dframe[2][j]) / (double)ctx->Nframes;
+        }
+    }
+
+    // And finally, I convert to the packed state. The state is in the
+    // denominator, so I unpack. No state_scale means that Var_ief is already in
+    // the unpacked state
+    if(ctx->state_scale != NULL)
+        for(int i=0; i<Nief; i++)
+        {
+            dq_dpief[0*Nief + i] *= ctx->state_scale[ctx->istate_ief[i]];
+            dq_dpief[1*Nief + i] *= ctx->state_scale[ctx->istate_ief[i]];
+        }
+    return true;
+}
+
+static void projection_uncertainty_write_output(// out
+                                                double* out,
+                                                // in
+                                                const double* Var,
+                                                const projection_uncertainty_context_t* ctx)
+{
+    double s2 = ctx->observed_pixel_uncertainty*ctx->observed_pixel_uncertainty;
+    double a = Var[0]*s2;
+    double b = Var[1]*s2;
+    double c = Var[3]*s2;
+
+    switch(ctx->what)
+    {
+    case MRCAL_UNCERTAINTY_COVARIANCE:
+        out[0] = a;
+        out[1] = b;
+        out[2] = b;
+        out[3] = c;
+        break;
+    case MRCAL_UNCERTAINTY_WORSTDIRECTION_STDEV:
+        *out = sqrt((a+c)/2. + sqrt( (a-c)*(a-c)/4. + b*b));
+        break;
+    case MRCAL_UNCERTAINTY_RMS_STDEV:
+        *out = sqrt((a+c)/2.);
+        break;
+    }
+}
+
+// Var(q) = dq/dp*[ief] Var_ief dq/dp*[ief]t for each point. No solving
+// needed; this is what we do when given the selected inverse
+static void projection_uncertainty_work_from_Var_ief(int ichunk,
+                                                     projection_uncertainty_context_t* ctx)
+{
+    int ipoint0 = ichunk*UNCERTAINTY_CHUNK_NPOINTS;
+    int Npoints = ctx->N - ipoint0;
+    if(Npoints > UNCERTAINTY_CHUNK_NPOINTS)
+        Npoints = UNCERTAINTY_CHUNK_NPOINTS;
+
+    const int Nief = ctx->Nief;
+
+    double* dq_dpief = malloc(2*Nief*sizeof(double));
+    double* g_Var    = malloc(2*Nief*sizeof(double));
+    if(dq_dpief == NULL || g_Var == NULL)
+    {
+        MSG("Couldn't allocate the work buffers");
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+        goto done;
+    }
+
+    int Nout_perpoint = ctx->what == MRCAL_UNCERTAINTY_COVARIANCE ? 4 : 1;
+    for(int i=0; i<Npoints; i++)
+    {
+        if(!projection_uncertainty_dq_dpief(dq_dpief,
+                                            &ctx->p_cam[ipoint0 + i],
+                                            ctx))
+        {
+            MSG("Couldn't project point %d", ipoint0 + i);
+            __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+            goto done;
+        }
+
+        // g_Var = dq/dp*[ief] Var_ief. Var_ief is symmetric, so I walk it
+        // row-first
+        memset(g_Var, 0, 2*Nief*sizeof(double));
+        for(int k=0; k<Nief; k++)
+        {
+            const double* Var_row = &ctx->Var_ief[k*Nief];
+            double g0 = dq_dpief[0*Nief + k];
+            double g1 = dq_dpief[1*Nief + k];
+            if(g0 == 0.0 && g1 == 0.0)
+                continue;
+            for(int l=0; l<Nief; l++)
+            {
+                g_Var[0*Nief + l] += g0*Var_row[l];
+                g_Var[1*Nief + l] += g1*Var_row[l];
+            }
+        }
+
+        double Var[4] = {};
+        for(int l=0; l<Nief; l++)
+        {
+            Var[0] += g_Var[0*Nief + l] * dq_dpief[0*Nief + l];
+            Var[1] += g_Var[0*Nief + l] * dq_dpief[1*Nief + l];
+            Var[3] += g_Var[1*Nief + l] * dq_dpief[1*Nief + l];
+        }
+        Var[2] = Var[1];
+
+        projection_uncertainty_write_output(&ctx->out[(ipoint0+i)*Nout_perpoint],
+                                            Var, ctx);
+    }
+
+ done:
+    free(dq_dpief);
+    free(g_Var);
+}
+
+static void projection_uncertainty_work(int ichunk, void* cookie)
+{
+    projection_uncertainty_context_t* ctx = (projection_uncertainty_context_t*)cookie;
+
+    if(ctx->Var_ief != NULL)
+    {
+        projection_uncertainty_work_from_Var_ief(ichunk, ctx);
+        return;
+    }
+
+    int ipoint0 = ichunk*UNCERTAINTY_CHUNK_NPOINTS;
+    int Npoints = ctx->N - ipoint0;
+    if(Npoints > UNCERTAINTY_CHUNK_NPOINTS)
+        Npoints = UNCERTAINTY_CHUNK_NPOINTS;
+
+    const int Nstate = ctx->Nstate;
+    const int Nief   = ctx->Nief;
+    const int Nrhs   = 2*Npoints;
+
+    // Each thread needs its own cholmod_common. The factorization itself is
+    // only read by the solve
+    cholmod_common common;
+    bool           inited_common = false;
+    double*        dq_dpief      = NULL;
+    double*        A_buffer      = NULL;
+    cholmod_dense* A             = NULL;
+    cholmod_dense* Y             = NULL;
+    cholmod_dense* E             = NULL;
+    bool           result        = false;
+
+    if(!cholmod_start(&common))
+    {
+        MSG("Error trying to cholmod_start");
+        goto done;
+    }
+    inited_common = true;
+
+    // The gradients for all the points in this chunk: (Npoints,2,Nief)
+    dq_dpief = malloc(Nrhs*Nief*sizeof(double));
+    // The dense RHS: dq/dp*t. Column-first (Nrhs,Nstate). And the solution A.
+    // If I need the regularized expression, I will also transpose A into
+    // (Nstate,Nrhs)
+    A_buffer = malloc((ctx->Nmeasurements_observations >= 0 ? 3 : 2) *
+                      Nrhs*Nstate*sizeof(double));
+    if(dq_dpief == NULL || A_buffer == NULL)
+    {
+        MSG("Couldn't allocate the work buffers");
+        goto done;
+    }
+
+    double* bt = A_buffer;
+    memset(bt, 0, Nrhs*Nstate*sizeof(double));
+    for(int i=0; i<Npoints; i++)
+    {
+        if(!projection_uncertainty_dq_dpief(&dq_dpief[2*i*Nief],
+                                            &ctx->p_cam[ipoint0 + i],
+                                            ctx))
+        {
+            MSG("Couldn't project point %d", ipoint0 + i);
+            goto done;
+        }
+        for(int j=0; j<2; j++)
+            for(int k=0; k<Nief; k++)
+                bt[(2*i+j)*Nstate + ctx->istate_ief[k]] = dq_dpief[(2*i+j)*Nief + k];
+    }
+
+    cholmod_dense b = {
+        .nrow  = Nstate,
+        .ncol  = Nrhs,
+        .nzmax = Nrhs * Nstate,
+        .d     = Nstate,
+        .x     = bt,
+        .xtype = CHOLMOD_REAL,
+        .dtype = CHOLMOD_DOUBLE };
+    cholmod_dense out = {
+        .nrow  = Nstate,
+        .ncol  = Nrhs,
+        .nzmax = Nrhs * Nstate,
+        .d     = Nstate,
+        .x     = &A_buffer[Nrhs*Nstate],
+        .xtype = CHOLMOD_REAL,
+        .dtype = CHOLMOD_DOUBLE };
+    A = &out;
+    if(!cholmod_solve2( CHOLMOD_A, ctx->factorization,
+                        &b, NULL,
+                        &A, NULL, &Y, &E,
+                        &common))
+    {
+        MSG("cholmod_solve2() failed");
+        goto done;
+    }
+    if( A != &out )
+    {
+        MSG("cholmod_solve2() reallocated out! We leaked memory");
+        A = NULL;
+        goto done;
+    }
+    const double* Ax = (const double*)out.x;
+
+    // Var[Npoints][2][2]
+    double Var[UNCERTAINTY_CHUNK_NPOINTS][4];
+    memset(Var, 0, sizeof(Var));
+
+    if(ctx->Nmeasurements_observations < 0)
+    {
+        // No regularization. Var = dq/dp* A
+        for(int i=0; i<Npoints; i++)
+            for(int j=0; j<2; j++)
+                for(int l=0; l<2; l++)
+                    for(int k=0; k<Nief; k++)
+                        Var[i][2*j+l] +=
+                            dq_dpief[(2*i+j)*Nief + k] *
+                            Ax[(2*i+l)*Nstate + ctx->istate_ief[k]];
+    }
+    else
+    {
+        // Regularized. I transpose A so that each state variable has all the
+        // RHS together. Then I can apply each row of J to all the points at
+        // once
+        double* At = &A_buffer[2*Nrhs*Nstate];
+        for(int i=0; i<Nrhs; i++)
+            for(int j=0; j<Nstate; j++)
+                At[j*Nrhs + i] = Ax[i*Nstate + j];
+
+        A_Jt_J_At_accumulate_rows(Var, At, Nrhs,
+                                  (const int32_t*)ctx->Jt->p,
+                                  (const int32_t*)ctx->Jt->i,
+                                  (const double* )ctx->Jt->x,
+                                  0, ctx->Nmeasurements_observations);
+    }
+
+    int Nout_perpoint = ctx->what == MRCAL_UNCERTAINTY_COVARIANCE ? 4 : 1;
+    for(int i=0; i<Npoints; i++)
+        projection_uncertainty_write_output(&ctx->out[(ipoint0+i)*Nout_perpoint],
+                                            Var[i], ctx);
+    result = true;
+
+ done:
+    if(inited_common)
+    {
+        cholmod_free_dense(&E, &common);
+        cholmod_free_dense(&Y, &common);
+        cholmod_finish(&common);
+    }
+    free(dq_dpief);
+    free(A_buffer);
+    if(!result)
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+}
+
+bool mrcal_projection_uncertainty( // out
+                                  double* out,
+
+                                  // in
+                                  mrcal_uncertainty_what_t what,
+                                  const mrcal_point3_t* p_cam,
+                                  int N,
+                                  bool atinfinity,
+
+                                  mrcal_lensmodel_t lensmodel,
+                                  const double* intrinsics,
+                                  const mrcal_pose_t* extrinsics_fromref,
+                                  const mrcal_pose_t* frames_toref,
+                                  int Nframes,
+
+                                  int istate_intrinsics,
+                                  int i_intrinsics0,
+                                  int Nintrinsics_optimized,
+                                  int istate_extrinsics,
+                                  int istate_frames,
+                                  const double* state_scale,
+
+                                  const double* Var_ief,
+                                  cholmod_factor* factorization,
+                                  const cholmod_sparse* Jt,
+                                  int Nmeasurements_observations,
+                                  double observed_pixel_uncertainty,
+                                  int Nthreads)
+{
+    if(N <= 0)
+        return true;
+
+    if(Var_ief == NULL && factorization == NULL)
+    {
+        MSG("Either the factorization or Var_ief must be given");
+        return false;
+    }
+    if(Var_ief == NULL && state_scale == NULL)
+    {
+        MSG("state_scale may be NULL only if Var_ief is given");
+        return false;
+    }
+
+    int Nintrinsics = mrcal_lensmodel_num_params(lensmodel);
+    // If we're given Var_ief, we may not have the factorization, and we don't
+    // know Nstate. The caller is responsible for passing consistent state
+    // indices in that case
+    int Nstate      = factorization != NULL ? (int)factorization->n : INT_MAX;
+
+    if(istate_intrinsics < 0)
+        Nintrinsics_optimized = 0;
+    if(i_intrinsics0 < 0 || i_intrinsics0 + Nintrinsics_optimized > Nintrinsics)
+    {
+        MSG("The optimized intrinsics [%d,%d) aren't in range of the %d intrinsics",
+            i_intrinsics0, i_intrinsics0 + Nintrinsics_optimized, Nintrinsics);
+        return false;
+    }
+    if(frames_toref == NULL || istate_frames < 0)
+    {
+        frames_toref  = NULL;
+        istate_frames = -1;
+        Nframes       = 0;
+    }
+    if(extrinsics_fromref == NULL)
+        istate_extrinsics = -1;
+    if(Var_ief == NULL &&
+       Nmeasurements_observations >= 0 &&
+       (Jt == NULL || (int)Jt->nrow != Nstate || (int)Jt->ncol < Nmeasurements_observations))
+    {
+        MSG("Regularized uncertainty needs a Jt with %d rows and at least %d cols",
+            Nstate, Nmeasurements_observations);
+        return false;
+    }
+
+    int Nief = mrcal_projection_uncertainty_state_indices(NULL, atinfinity, Nframes,
+                                                          istate_intrinsics, Nintrinsics_optimized,
+                                                          istate_extrinsics, istate_frames);
+    int istate_ief[Nief];
+    mrcal_projection_uncertainty_state_indices(istate_ief, atinfinity, Nframes,
+                                               istate_intrinsics, Nintrinsics_optimized,
+                                               istate_extrinsics, istate_frames);
+    int Npose           = atinfinity ? 3 : 6;
+    int iief_extrinsics = istate_extrinsics >= 0 ? Nintrinsics_optimized : -1;
+    int iief_frames     = istate_frames     >= 0 ? Nintrinsics_optimized + (istate_extrinsics >= 0 ? Npose : 0) : -1;
+
+    for(int i=0; i<Nief; i++)
+        if(istate_ief[i] >= Nstate)
+        {
+            MSG("State index %d out of bounds: Nstate = %d", istate_ief[i], Nstate);
+            return false;
+        }
+
+    projection_uncertainty_context_t ctx =
+        { .what                       = what,
+          .p_cam                      = p_cam,
+          .N                          = N,
+          .atinfinity                 = atinfinity,
+          .lensmodel                  = lensmodel,
+          .intrinsics                 = intrinsics,
+          .Nintrinsics                = Nintrinsics,
+          .extrinsics_fromref         = extrinsics_fromref,
+          .frames_toref               = frames_toref,
+          .Nframes                    = Nframes,
+          .i_intrinsics0              = i_intrinsics0,
+          .Nintrinsics_optimized      = Nintrinsics_optimized,
+          .istate_ief                 = istate_ief,
+          .Nief                       = Nief,
+          .iief_extrinsics            = iief_extrinsics,
+          .iief_frames                = iief_frames,
+          .Nstate                     = Nstate,
+          .state_scale                = state_scale,
+          .Var_ief                    = Var_ief,
+          .factorization              = factorization,
+          .Jt                         = Jt,
+          .Nmeasurements_observations = Nmeasurements_observations,
+          .observed_pixel_uncertainty = observed_pixel_uncertainty,
+          .out                        = out,
+          .failed                     = false };
+
+    int Nchunks = (N + UNCERTAINTY_CHUNK_NPOINTS-1) / UNCERTAINTY_CHUNK_NPOINTS;
+    _mrcal_parallel_for(Nchunks, Nthreads,
+                        &projection_uncertainty_work, &ctx);
+    return !ctx.failed;
+}
+
+// _mrcal_A_Jt_J_At() splits the rows of J into at most this many partitions.
+// Each partition has its own accumulators, and the partitions are summed in
+// order at the end. So the result doesn't depend on the number of threads
+#define A_JT_J_AT_NPARTITIONS_MAX   64
+// Each partition is processed in blocks of rows. Each block is applied to each
+// chunk of points in turn, so the block of J stays in cache, and is read from
+// memory only once
+#define A_JT_J_AT_NROWS_BLOCK      256
+#define A_JT_J_AT_CHUNK_NPOINTS     32
+
+typedef struct
+{
+    int N;
+    int Nstate;
+    int Nrows;
+    int Npartitions;
+
+    // (Nchunks, Nstate, 2*A_JT_J_AT_CHUNK_NPOINTS). The last chunk may be
+    // short; its columns are packed with the short width
+    const double*  At;
+    const int32_t* Jp;
+    const int32_t* Ji;
+    const double*  Jx;
+
+    // (Npartitions, N, 4)
+    double (*Var)[4];
+} A_Jt_J_At_context_t;
+
+static void A_Jt_J_At_work(int ipartition, void* cookie)
+{
+    const A_Jt_J_At_context_t* ctx = (const A_Jt_J_At_context_t*)cookie;
+
+    int irow0 = (int)( (int64_t) ipartition     * ctx->Nrows / ctx->Npartitions);
+    int irow1 = (int)( (int64_t)(ipartition+1) * ctx->Nrows / ctx->Npartitions);
+
+    double (*Var)[4] = &ctx->Var[ipartition*ctx->N];
+
+    for(int irow_block=irow0; irow_block<irow1; irow_block += A_JT_J_AT_NROWS_BLOCK)
+    {
+        int irow_block_end = irow_block + A_JT_J_AT_NROWS_BLOCK;
+        if(irow_block_end > irow1)
+            irow_block_end = irow1;
+
+        for(int ipoint0=0; ipoint0<ctx->N; ipoint0 += A_JT_J_AT_CHUNK_NPOINTS)
+        {
+            int Npoints = ctx->N - ipoint0;
+            if(Npoints > A_JT_J_AT_CHUNK_NPOINTS)
+                Npoints = A_JT_J_AT_CHUNK_NPOINTS;
+
+            A_Jt_J_At_accumulate_rows(&Var[ipoint0],
+                                      &ctx->At[2*ipoint0*ctx->Nstate], 2*Npoints,
+                                      ctx->Jp, ctx->Ji, ctx->Jx,
+                                      irow_block, irow_block_end);
+        }
+    }
+}
+
+bool _mrcal_A_Jt_J_At(// out
+                      double* out,
+
+                      // in
+                      const double* A,
+                      int N, int Nstate,
+                      const int32_t* Jp,
+                      const int32_t* Ji,
+                      const double*  Jx,
+                      int Nleading_rows_J,
+                      int Nthreads)
+{
+    if(N <= 0)
+        return true;
+
+    int Npartitions =
+        (Nleading_rows_J + A_JT_J_AT_NROWS_BLOCK-1) / A_JT_J_AT_NROWS_BLOCK;
+    if(Npartitions > A_JT_J_AT_NPARTITIONS_MAX)
+        Npartitions = A_JT_J_AT_NPARTITIONS_MAX;
+    if(Npartitions < 1)
+        Npartitions = 1;
+
+    double* At = malloc(2*(size_t)N*Nstate*sizeof(double));
+    double (*Var)[4] = calloc((size_t)Npartitions*N, sizeof(Var[0]));
+    if(At == NULL || Var == NULL)
+    {
+        MSG("Couldn't allocate the work buffers");
+        free(At);
+        free(Var);
+        return false;
+    }
+
+    // Each chunk of points gets its own (Nstate, 2*Npoints) block of At, so
+    // applying a row of J to a chunk reads contiguous memory
+    for(int ipoint0=0; ipoint0<N; ipoint0 += A_JT_J_AT_CHUNK_NPOINTS)
+    {
+        int Npoints = N - ipoint0;
+        if(Npoints > A_JT_J_AT_CHUNK_NPOINTS)
+            Npoints = A_JT_J_AT_CHUNK_NPOINTS;
+        const int Nrhs = 2*Npoints;
+
+        double*       Atchunk = &At[2*(size_t)ipoint0*Nstate];
+        const double* Achunk  = &A [2*(size_t)ipoint0*Nstate];
+        for(int i=0; i<Nrhs; i++)
+            for(int j=0; j<Nstate; j++)
+                Atchunk[j*Nrhs + i] = Achunk[i*Nstate + j];
+    }
+
+    A_Jt_J_At_context_t ctx =
+        { .N           = N,
+          .Nstate      = Nstate,
+          .Nrows       = Nleading_rows_J,
+          .Npartitions = Npartitions,
+          .At          = At,
+          .Jp          = Jp,
+          .Ji          = Ji,
+          .Jx          = Jx,
+          .Var         = Var };
+    _mrcal_parallel_for(Npartitions, Nthreads,
+                        &A_Jt_J_At_work, &ctx);
+
+    for(int i=0; i<N; i++)
+    {
+        double a = 0, b = 0, c = 0;
+        for(int ipartition=0; ipartition<Npartitions; ipartition++)
+        {
+            a += Var[ipartition*N + i][0];
+            b += Var[ipartition*N + i][1];
+            c += Var[ipartition*N + i][3];
+        }
+        out[4*i + 0] = a;
+        out[4*i + 1] = b;
+        out[4*i + 2] = b;
+        out[4*i + 3] = c;
+    }
+
+    free(At);
+    free(Var);
+    return true;
+}
+
+int mrcal_projection_uncertainty_state_indices( // out
+                                               int* istate_ief,
+
+                                               // in
+                                               bool atinfinity,
+                                               int Nframes,
+                                               int istate_intrinsics,
+                                               int Nintrinsics_optimized,
+                                               int istate_extrinsics,
+                                               int istate_frames)
+{
+    // The columns of dq/dp_ief that are nonzero, in order: intrinsics,
+    // extrinsics, frames. At infinity I only look at the rotations
+    int Npose = atinfinity ? 3 : 6;
+    int Nief  = 0;
+
+    if(istate_intrinsics >= 0)
+        for(int i=0; i<Nintrinsics_optimized; i++)
+        {
+            if(istate_ief != NULL) istate_ief[Nief] = istate_intrinsics + i;
+            Nief++;
+        }
+    if(istate_extrinsics >= 0)
+        for(int i=0; i<Npose; i++)
+        {
+            if(istate_ief != NULL) istate_ief[Nief] = istate_extrinsics + i;
+            Nief++;
+        }
+    if(istate_frames >= 0)
+        for(int iframe=0; iframe<Nframes; iframe++)
+            for(int i=0; i<Npose; i++)
+            {
+                if(istate_ief != NULL) istate_ief[Nief] = istate_frames + 6*iframe + i;
+                Nief++;
+            }
+    return Nief;
+}
+
+// Selected inversion. I compute the entries of Z = inv(JtJ) in the sparsity
+// pattern of the factor using the Takahashi recursion. CHOLMOD factors
+// P JtJ Pt = L D Lt, with L unit-lower-triangular. Then Z = Pt inv(Lt) inv(D)
+// inv(L) P, which means that (working in the permuted space)
+//
+//   Z = inv(D) inv(L) + (I - Lt) Z
+//
+// The upper triangle of inv(D) inv(L) is just inv(D), so for i >= j
+//
+//   Z[i,j] = delta_ij/D[j] - sum_{k>j, L[k,j] != 0} L[k,j] Z[i,k]
+//
+// Going through the columns in reverse, every Z[i,k] in this expression is in
+// the pattern of L, and has already been computed. Z is stored in the same
+// layout as L: Zx[] is indexed exactly like L->x
+static bool takahashi_lookup(// out
+                             double* z,
+                             // in
+                             int i, int j,
+                             const int32_t* Lp, const int32_t* Li,
+                             const double* Zx)
+{
+    // Z is symmetric; I only store the lower triangle
+    if(i < j) { int t = i; i = j; j = t; }
+
+    // Column j has the diagonal first, and then the sorted row indices
+    int32_t lo = Lp[j], hi = Lp[j+1]-1;
+    if(i == j)
+    {
+        *z = Zx[lo];
+        return true;
+    }
+    lo++;
+    while(lo <= hi)
+    {
+        int32_t mid = lo + (hi-lo)/2;
+        if(     Li[mid] == i) { *z = Zx[mid]; return true; }
+        else if(Li[mid] <  i) lo = mid+1;
+        else                  hi = mid-1;
+    }
+    return false;
+}
+
+static bool takahashi(// out
+                      double* Zx,
+                      // in
+                      const cholmod_factor* L)
+{
+    const int32_t* Lp = (const int32_t*)L->p;
+    const int32_t* Li = (const int32_t*)L->i;
+    const double*  Lx = (const double* )L->x;
+
+    for(int j=(int)L->n-1; j>=0; j--)
+    {
+        int32_t p0 = Lp[j];
+        int32_t p1 = Lp[j+1];
+
+        // Off-diagonal entries, from the bottom up
+        for(int32_t a=p1-1; a>p0; a--)
+        {
+            int    i = Li[a];
+            double s = 0.0;
+            for(int32_t b=p0+1; b<p1; b++)
+            {
+                double z;
+                if(!takahashi_lookup(&z, i, Li[b], Lp, Li, Zx))
+                {
+                    MSG("Z[%d,%d] isn't in the pattern of the factor. This is a bug",
+                        i, Li[b]);
+                    return false;
+                }
+                s += Lx[b]*z;
+            }
+            Zx[a] = -s;
+        }
+
+        double s = 0.0;
+        for(int32_t b=p0+1; b<p1; b++)
+            s += Lx[b]*Zx[b];
+        Zx[p0] = 1.0/Lx[p0] - s;
+    }
+    return true;
+}
+
+// Some entries of the selected inverse aren't in the pattern of the factor. I
+// compute those with solves, a chunk of columns at a time
+#define SELECTED_INVERSE_CHUNK_NRHS 32
+
+typedef struct
+{
+    double*               Var;
+    const int*            istate;
+    int                   Nistate;
+    cholmod_factor*       factorization;
+
+    // The columns of Var I'm computing by solving. Var[:,icol[k]] for each k.
+    // Only the entries in the lower triangle that the Takahashi recursion
+    // couldn't produce are written. The pattern of the factor and its inverse
+    // tell me which those are
+    const int*            icol_solve;
+    int                   Nsolve;
+    const int32_t*        Lp;
+    const int32_t*        Li;
+    const double*         Zx;
+    const int*            iperm;
+
+    // The regularization part of the Jacobian, for the correction
+    const cholmod_sparse* Jt;
+    int                   Nmeasurements_observations;
+    // X[istate,:] = (inv(JtJ) Jt[:,regularization])[istate,:] is stored here.
+    // Dense (Nistate,Nregularization)
+    double*               Xreg;
+    int                   Nregularization;
+
+    bool                  failed;
+} selected_inverse_context_t;
+
+// Solve against a chunk of dense right-hand-sides in B (Nstate,Nrhs),
+// column-first. The solution is returned in X of the same shape
+static bool selected_inverse_solve(// out
+                                   double* X,
+                                   // in
+                                   double* B, int Nrhs,
+                                   cholmod_factor* factorization,
+                                   cholmod_common* common)
+{
+    int Nstate = (int)factorization->n;
+    cholmod_dense b = {
+        .nrow  = Nstate,
+        .ncol  = Nrhs,
+        .nzmax = Nrhs * Nstate,
+        .d     = Nstate,
+        .x     = B,
+        .xtype = CHOLMOD_REAL,
+        .dtype = CHOLMOD_DOUBLE };
+    cholmod_dense out = {
+        .nrow  = Nstate,
+        .ncol  = Nrhs,
+        .nzmax = Nrhs * Nstate,
+        .d     = Nstate,
+        .x     = X,
+        .xtype = CHOLMOD_REAL,
+        .dtype = CHOLMOD_DOUBLE };
+    cholmod_dense* M = &out;
+    cholmod_dense* Y = NULL;
+    cholmod_dense* E = NULL;
+
+    bool result = true;
+    if(!cholmod_solve2( CHOLMOD_A, factorization,
+                        &b, NULL,
+                        &M, NULL, &Y, &E,
+                        common))
+    {
+        MSG("cholmod_solve2() failed");
+        result = false;
+    }
+    else if( M != &out )
+    {
+        MSG("cholmod_solve2() reallocated out! We leaked memory");
+        result = false;
+    }
+    cholmod_free_dense(&E, common);
+    cholmod_free_dense(&Y, common);
+    return result;
+}
+
+static void selected_inverse_work(int ichunk, void* cookie)
+{
+    selected_inverse_context_t* ctx = (selected_inverse_context_t*)cookie;
+
+    const int Nstate = (int)ctx->factorization->n;
+    const int N      = ctx->Nistate;
+
+    int Nchunks_solve = (ctx->Nsolve + SELECTED_INVERSE_CHUNK_NRHS-1) / SELECTED_INVERSE_CHUNK_NRHS;
+    bool solving_columns = ichunk < Nchunks_solve;
+    if(!solving_columns)
+        ichunk -= Nchunks_solve;
+
+    cholmod_common common;
+    bool           inited_common = false;
+    double*        B             = NULL;
+    bool           result        = false;
+
+    if(!cholmod_start(&common))
+    {
+        MSG("Error trying to cholmod_start");
+        goto done;
+    }
+    inited_common = true;
+
+    B = malloc((size_t)2*SELECTED_INVERSE_CHUNK_NRHS*Nstate*sizeof(double));
+    if(B == NULL)
+    {
+        MSG("Couldn't allocate the work buffers");
+        goto done;
+    }
+    double* X = &B[SELECTED_INVERSE_CHUNK_NRHS*Nstate];
+
+    if(solving_columns)
+    {
+        // Solve inv(JtJ) e_istate for each requested column
+        int k0   = ichunk*SELECTED_INVERSE_CHUNK_NRHS;
+        int Nrhs = ctx->Nsolve - k0;
+        if(Nrhs > SELECTED_INVERSE_CHUNK_NRHS)
+            Nrhs = SELECTED_INVERSE_CHUNK_NRHS;
+
+        memset(B, 0, (size_t)Nrhs*Nstate*sizeof(double));
+        for(int k=0; k<Nrhs; k++)
+            B[(size_t)k*Nstate + ctx->istate[ctx->icol_solve[k0+k]]] = 1.0;
+        if(!selected_inverse_solve(X, B, Nrhs, ctx->factorization, &common))
+            goto done;
+
+        // Each chunk writes only the lower-triangle entries of its own
+        // columns, and only those that the Takahashi recursion didn't produce.
+        // No two chunks write the same entry. The caller fills in the upper
+        // triangle afterwards
+        for(int k=0; k<Nrhs; k++)
+        {
+            int icol = ctx->icol_solve[k0+k];
+            for(int i=icol+1; i<N; i++)
+            {
+                double z;
+                if(takahashi_lookup(&z,
+                                    ctx->iperm[ctx->istate[i]],
+                                    ctx->iperm[ctx->istate[icol]],
+                                    ctx->Lp, ctx->Li, ctx->Zx))
+                    continue;
+                ctx->Var[(size_t)i*N + icol] = X[(size_t)k*Nstate + ctx->istate[i]];
+            }
+        }
+    }
+    else
+    {
+        // The regularization correction:
+        //   X = inv(JtJ) Jt[:,regularization]
+        //   correction = X[istate,:] X[istate,:]t
+        // Here I compute X[istate,:] for this chunk of columns. The product is
+        // evaluated separately, in selected_inverse_correction_work()
+        int jreg0 = ichunk*SELECTED_INVERSE_CHUNK_NRHS;
+        int j0    = ctx->Nmeasurements_observations + jreg0;
+        int Nrhs  = ctx->Nregularization - jreg0;
+        if(Nrhs > SELECTED_INVERSE_CHUNK_NRHS)
+            Nrhs = SELECTED_INVERSE_CHUNK_NRHS;
+
+        const int32_t* Jp = (const int32_t*)ctx->Jt->p;
+        const int32_t* Ji = (const int32_t*)ctx->Jt->i;
+        const double*  Jx = (const double* )ctx->Jt->x;
+
+        memset(B, 0, (size_t)Nrhs*Nstate*sizeof(double));
+        for(int k=0; k<Nrhs; k++)
+            for(int32_t l=Jp[j0+k]; l<Jp[j0+k+1]; l++)
+                B[(size_t)k*Nstate + Ji[l]] = Jx[l];
+        if(!selected_inverse_solve(X, B, Nrhs, ctx->factorization, &common))
+            goto done;
+
+        for(int i=0; i<N; i++)
+            for(int k=0; k<Nrhs; k++)
+                ctx->Xreg[(size_t)i*ctx->Nregularization + jreg0 + k] =
+                    X[(size_t)k*Nstate + ctx->istate[i]];
+    }
+    result = true;
+
+ done:
+    if(inited_common)
+        cholmod_finish(&common);
+    free(B);
+    if(!result)
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+}
+
+// The noise only comes from the observations, so if we have regularization,
+// Var(p*) = inv(JtJ) Jot Jo inv(JtJ). Jot Jo = JtJ - Jrt Jr, so Var(p*) =
+// inv(JtJ) - inv(JtJ) Jrt Jr inv(JtJ). This applies the correction to row i of
+// the lower triangle of Var. Each row is owned by one work item, and is summed
+// in a fixed order, so the result doesn't depend on the thread count
+static void selected_inverse_correction_work(int i, void* cookie)
+{
+    selected_inverse_context_t* ctx = (selected_inverse_context_t*)cookie;
+
+    const int     N    = ctx->Nistate;
+    const int     Nreg = ctx->Nregularization;
+    const double* xi   = &ctx->Xreg[(size_t)i*Nreg];
+    for(int j=0; j<=i; j++)
+    {
+        const double* xj = &ctx->Xreg[(size_t)j*Nreg];
+        double s = 0.0;
+        for(int k=0; k<Nreg; k++)
+            s += xi[k]*xj[k];
+        ctx->Var[(size_t)i*N + j] -= s;
+    }
+}
+
+bool mrcal_selected_inverse( // out
+                            double* Var,
+
+                            // in
+                            const int* istate,
+                            int Nistate,
+                            cholmod_factor* factorization,
+                            const cholmod_sparse* Jt,
+                            int Nmeasurements_observations,
+                            int Nthreads)
+{
+    const int N      = Nistate;
+    const int Nstate = (int)factorization->n;
+
+    for(int i=0; i<N; i++)
+        if(istate[i] < 0 || istate[i] >= Nstate)
+        {
+            MSG("State index %d out of bounds: Nstate = %d", istate[i], Nstate);
+            return false;
+        }
+    if(Nmeasurements_observations >= 0 &&
+       (Jt == NULL || (int)Jt->nrow != Nstate || (int)Jt->ncol < Nmeasurements_observations))
+    {
+        MSG("The regularization correction needs a Jt with %d rows and at least %d cols",
+            Nstate, Nmeasurements_observations);
+        return false;
+    }
+    if(N <= 0)
+        return true;
+
+    bool            result        = false;
+    bool            inited_common = false;
+    cholmod_common  common;
+    cholmod_factor* L             = NULL;
+    double*         Zx            = NULL;
+    int*            iperm         = NULL;
+    int*            icol_solve    = NULL;
+    double*         Xreg          = NULL;
+
+    if(!cholmod_start(&common))
+    {
+        MSG("Error trying to cholmod_start");
+        goto done;
+    }
+    inited_common = true;
+
+    // I need a simplicial LDLt factor with packed, monotonic columns. The
+    // factorization we were given may be something else, and I leave it alone
+    L = cholmod_copy_factor(factorization, &common);
+    if(L == NULL)
+    {
+        MSG("cholmod_copy_factor() failed");
+        goto done;
+    }
+    if(!cholmod_change_factor(CHOLMOD_REAL, false, false, true, true, L, &common))
+    {
+        MSG("cholmod_change_factor() failed");
+        goto done;
+    }
+    if(L->itype != CHOLMOD_INT)
+    {
+        MSG("I only support factors with 32-bit indices");
+        goto done;
+    }
+
+    // The Takahashi recursion needs the row indices in each column sorted.
+    // Simplicial factorizations produce them this way, but I make sure
+    {
+        const int32_t* Lp = (const int32_t*)L->p;
+        int32_t*       Li = (int32_t*)L->i;
+        double*        Lx = (double* )L->x;
+        for(int j=0; j<Nstate; j++)
+        {
+            if(Li[Lp[j]] != j)
+            {
+                MSG("Column %d of the factor doesn't start with the diagonal", j);
+                goto done;
+            }
+            // insertion sort. The columns are almost always sorted already
+            for(int32_t a=Lp[j]+2; a<Lp[j+1]; a++)
+                for(int32_t b=a; b>Lp[j]+1 && Li[b-1] > Li[b]; b--)
+                {
+                    int32_t ti = Li[b]; Li[b] = Li[b-1]; Li[b-1] = ti;
+                    double  tx = Lx[b]; Lx[b] = Lx[b-1]; Lx[b-1] = tx;
+                }
+        }
+    }
+
+    Zx    = malloc(((const int32_t*)L->p)[Nstate] * sizeof(double));
+    iperm = malloc(Nstate*sizeof(int));
+    if(Zx == NULL || iperm == NULL)
+    {
+        MSG("Couldn't allocate the work buffers");
+        goto done;
+    }
+    if(!takahashi(Zx, L))
+        goto done;
+
+    const int32_t* Perm = (const int32_t*)L->Perm;
+    for(int i=0; i<Nstate; i++)
+        iperm[i] = i;
+    if(Perm != NULL)
+        for(int i=0; i<Nstate; i++)
+            iperm[Perm[i]] = i;
+
+    // Pick out Var[istate,istate] from Z. Anything outside of the pattern of
+    // the factor (typically the cross-terms between different frames) is
+    // computed by solving
+    icol_solve = malloc(N*sizeof(int));
+    if(icol_solve == NULL)
+    {
+        MSG("Couldn't allocate the work buffers");
+        goto done;
+    }
+    // I fill in the lower triangle only, and symmetrize at the end
+    int Nsolve = 0;
+    for(int j=0; j<N; j++)
+    {
+        bool complete = true;
+        for(int i=j; i<N; i++)
+        {
+            double z;
+            if(takahashi_lookup(&z, iperm[istate[i]], iperm[istate[j]],
+                                (const int32_t*)L->p, (const int32_t*)L->i, Zx))
+                Var[(size_t)i*N + j] = z;
+            else
+                complete = false;
+        }
+        if(!complete)
+            icol_solve[Nsolve++] = j;
+    }
+
+    int Nregularization = 0;
+    if(Nmeasurements_observations >= 0)
+        Nregularization = (int)Jt->ncol - Nmeasurements_observations;
+    int Nchunks_solve          = (Nsolve          + SELECTED_INVERSE_CHUNK_NRHS-1) / SELECTED_INVERSE_CHUNK_NRHS;
+    int Nchunks_regularization = (Nregularization + SELECTED_INVERSE_CHUNK_NRHS-1) / SELECTED_INVERSE_CHUNK_NRHS;
+    if(Nregularization > 0)
+    {
+        Xreg = malloc((size_t)N*Nregularization*sizeof(double));
+        if(Xreg == NULL)
+        {
+            MSG("Couldn't allocate the work buffers");
+            goto done;
+        }
+    }
+
+    selected_inverse_context_t ctx =
+        { .Var                        = Var,
+          .istate                     = istate,
+          .Nistate                    = N,
+          .factorization              = factorization,
+          .icol_solve                 = icol_solve,
+          .Nsolve                     = Nsolve,
+          .Lp                         = (const int32_t*)L->p,
+          .Li                         = (const int32_t*)L->i,
+          .Zx                         = Zx,
+          .iperm                      = iperm,
+          .Jt                         = Jt,
+          .Nmeasurements_observations = Nmeasurements_observations,
+          .Xreg                       = Xreg,
+          .Nregularization            = Nregularization,
+          .failed                     = false };
+    _mrcal_parallel_for(Nchunks_solve + Nchunks_regularization, Nthreads,
+                        &selected_inverse_work, &ctx);
+    if(ctx.failed)
+        goto done;
+
+    if(Nregularization > 0)
+        _mrcal_parallel_for(N, Nthreads,
+                            &selected_inverse_correction_work, &ctx);
+
+    for(int i=0; i<N; i++)
+        for(int j=0; j<i; j++)
+            Var[(size_t)j*N + i] = Var[(size_t)i*N + j];
+
+    result = true;
+
+ done:
+    if(inited_common)
+    {
+        cholmod_free_factor(&L, &common);
+        cholmod_finish(&common);
+    }
+    free(Zx);
+    free(iperm);
+    free(icol_solve);
+    free(Xreg);
+    return result;
+}
+
+// Solves A x = b for a small dense symmetric positive-definite A (N,N) with a
+// Cholesky factorization. A is overwritten with the factor, and b with the
+// solution. Returns false if A isn't positive-definite
+static bool solve_spd_dense(double* A, double* b, int N)
+{
+    for(int j=0; j<N; j++)
+    {
+        double s = A[j*N + j];
+        for(int k=0; k<j; k++)
+            s -= A[j*N + k]*A[j*N + k];
+        if(!(s > 0.0))
+            return false;
+        A[j*N + j] = sqrt(s);
+        for(int i=j+1; i<N; i++)
+        {
+            double s2 = A[i*N + j];
+            for(int k=0; k<j; k++)
+                s2 -= A[i*N + k]*A[j*N + k];
+            A[i*N + j] = s2 / A[j*N + j];
+        }
+    }
+
+    for(int i=0; i<N; i++)
+    {
+        for(int k=0; k<i; k++)
+            b[i] -= A[i*N + k]*b[k];
+        b[i] /= A[i*N + i];
+    }
+    for(int i=N-1; i>=0; i--)
+    {
+        for(int k=i+1; k<N; k++)
+            b[i] -= A[k*N + i]*b[k];
+        b[i] /= A[i*N + i];
+    }
+    return true;
+}
+
+typedef struct
+{
+    mrcal_pose_t*         rt_cam_board;
+    const mrcal_point3_t* v;
+    const double*         weights;
+    int                   Nw, Nh;
+    double                spacing;
+} board_poses_context_t;
+
+// The reprojection error of the board in normalized (x/z,y/z) coordinates, and
+// optionally its gradient in JtJ (6,6) and Jtx (6,). Returns a negative value if
+// any point is behind the camera
+static double board_pose_cost(// out
+                              double* JtJ, double* Jtx,
+                              // in
+                              const mrcal_pose_t* rt,
+                              const board_poses_context_t* ctx,
+                              const mrcal_point3_t* v,
+                              const double* weights)
+{
+    if(JtJ != NULL)
+    {
+        memset(JtJ, 0, 6*6*sizeof(double));
+        memset(Jtx, 0, 6  *sizeof(double));
+    }
+
+    double cost = 0.0;
+    for(int i=0; i<ctx->Nw*ctx->Nh; i++)
+    {
+        if(weights[i] == 0.0)
+            continue;
+
+        const mrcal_point3_t p_board = {.x = (double)(i % ctx->Nw) * ctx->spacing,
+                                        .y = (double)(i / ctx->Nw) * ctx->spacing};
+        mrcal_point3_t p;
+        double J_rt[3][6];
+        mrcal_transform_point_rt(p.xyz, JtJ != NULL ? &J_rt[0][0] : NULL, NULL,
+                                 (const double*)rt, p_board.xyz);
+        if(p.z <= 0.0)
+            return -1.0;
+
+        const double sw = sqrt(weights[i]);
+        const double x[2] = { sw*(p.x/p.z - v[i].x/v[i].z),
+                              sw*(p.y/p.z - v[i].y/v[i].z) };
+        cost += x[0]*x[0] + x[1]*x[1];
+
+        if(JtJ != NULL)
+        {
+            // dx/dp
+            const double dx_dp[2][3] = { { sw/p.z, 0,      -sw*p.x/(p.z*p.z) },
+                                         { 0,      sw/p.z, -sw*p.y/(p.z*p.z) } };
+            double J[2][6] = {};
+            for(int k=0; k<2; k++)
+                for(int j=0; j<6; j++)
+                    for(int l=0; l<3; l++)
+                        J[k][j] += dx_dp[k][l]*J_rt[l][j];
+            for(int k=0; k<2; k++)
+                for(int j=0; j<6; j++)
+                {
+                    Jtx[j] += J[k][j]*x[k];
+                    for(int l=0; l<=j; l++)
+                        JtJ[j*6 + l] += J[k][j]*J[k][l];
+                }
+        }
+    }
+
+    if(JtJ != NULL)
+        for(int j=0; j<6; j++)
+            for(int l=j+1; l<6; l++)
+                JtJ[j*6 + l] = JtJ[l*6 + j];
+    return cost;
+}
+
+// Homography of the board plane, then a Levenberg-Marquardt refinement of the
+// reprojection error
+static bool board_pose_estimate(// out
+                                mrcal_pose_t* rt,
+                                // in
+                                const board_poses_context_t* ctx,
+                                const mrcal_point3_t* v,
+                                const double* weights)
+{
+    const int Npoints = ctx->Nw*ctx->Nh;
+
+    // The homography is estimated from normalized coordinates, to keep the
+    // linear system well-conditioned. I normalize the board and the image
+    // points to have a zero mean, and an RMS distance of sqrt(2) from the origin
+    double sw = 0.0, board_mean[2] = {}, image_mean[2] = {};
+    int Nvalid = 0;
+    for(int i=0; i<Npoints; i++)
+    {
+        if(weights[i] == 0.0)
+            continue;
+        if(!(v[i].z > 0.0) ||
+           !isfinite(v[i].x) || !isfinite(v[i].y) || !isfinite(v[i].z))
+            return false;
+        const double w = weights[i];
+        board_mean[0] += w * (double)(i % ctx->Nw) * ctx->spacing;
+        board_mean[1] += w * (double)(i / ctx->Nw) * ctx->spacing;
+        image_mean[0] += w * v[i].x/v[i].z;
+        image_mean[1] += w * v[i].y/v[i].z;
+        sw += w;
+        Nvalid++;
+    }
+    if(Nvalid < 4)
+        return false;
+    for(int k=0; k<2; k++)
+    {
+        board_mean[k] /= sw;
+        image_mean[k] /= sw;
+    }
+    double board_scale = 0.0, image_scale = 0.0;
+    for(int i=0; i<Npoints; i++)
+    {
+        if(weights[i] == 0.0)
+            continue;
+        const double w  = weights[i];
+        const double bx = (double)(i % ctx->Nw) * ctx->spacing - board_mean[0];
+        const double by = (double)(i / ctx->Nw) * ctx->spacing - board_mean[1];
+        const double ix = v[i].x/v[i].z - image_mean[0];
+        const double iy = v[i].y/v[i].z - image_mean[1];
+        board_scale += w * (bx*bx + by*by);
+        image_scale += w * (ix*ix + iy*iy);
+    }
+    if(!(board_scale > 0.0 && image_scale > 0.0))
+        return false;
+    board_scale = sqrt(2.0 * sw / board_scale);
+    image_scale = sqrt(2.0 * sw / image_scale);
+
+    // Solve for the normalized homography Hn with Hn[2][2] = 1:
+    //
+    //   u = (h0 X + h1 Y + h2) / (h6 X + h7 Y + 1)
+    //   v = (h3 X + h4 Y + h5) / (h6 X + h7 Y + 1)
+    //
+    // This is linear in h. I accumulate the normal equations
+    double AtA[8*8] = {}, Atb[8] = {};
+    for(int i=0; i<Npoints; i++)
+    {
+        if(weights[i] == 0.0)
+            continue;
+        const double w = weights[i];
+        const double X = ((double)(i % ctx->Nw) * ctx->spacing - board_mean[0]) * board_scale;
+        const double Y = ((double)(i / ctx->Nw) * ctx->spacing - board_mean[1]) * board_scale;
+        const double u = (v[i].x/v[i].z - image_mean[0]) * image_scale;
+        const double s = (v[i].y/v[i].z - image_mean[1]) * image_scale;
+
+        const double a[2][8] = { { X, Y, 1, 0, 0, 0, -u*X, -u*Y },
+                                 { 0, 0, 0, X, Y, 1, -s*X, -s*Y } };
+        const double b[2]    = { u, s };
+        for(int k=0; k<2; k++)
+            for(int j=0; j<8; j++)
+            {
+                Atb[j] += w * a[k][j]*b[k];
+                for(int l=0; l<8; l++)
+                    AtA[j*8 + l] += w * a[k][j]*a[k][l];
+            }
+    }
+    if(!solve_spd_dense(AtA, Atb, 8))
+        return false;
+
+    // Un-normalize: H = inv(Ti) Hn Tb where
+    //   Tb = [sb 0 -sb*mbx; 0 sb -sb*mby; 0 0 1]
+    //   Ti = [si 0 -si*mix; 0 si -si*miy; 0 0 1]
+    const double Hn[3][3] = { { Atb[0], Atb[1], Atb[2] },
+                              { Atb[3], Atb[4], Atb[5] },
+                              { Atb[6], Atb[7], 1.0    } };
+    const double Tb[3][3] = { { board_scale, 0,           -board_scale*board_mean[0] },
+                              { 0,           board_scale, -board_scale*board_mean[1] },
+                              { 0,           0,           1.0                        } };
+    const double Ti_inv[3][3] = { { 1.0/image_scale, 0,               image_mean[0] },
+                                  { 0,               1.0/image_scale, image_mean[1] },
+                                  { 0,               0,               1.0           } };
+    double HnTb[3][3] = {}, H[3][3] = {};
+    for(int i=0; i<3; i++)
+        for(int j=0; j<3; j++)
+            for(int k=0; k<3; k++)
+                HnTb[i][j] += Hn[i][k]*Tb[k][j];
+    for(int i=0; i<3; i++)
+        for(int j=0; j<3; j++)
+            for(int k=0; k<3; k++)
+                H[i][j] += Ti_inv[i][k]*HnTb[k][j];
+
+    // H = lambda [r0 r1 t]. The board must be in front of the camera, so t.z > 0
+    const double norm0  = sqrt(H[0][0]*H[0][0] + H[1][0]*H[1][0] + H[2][0]*H[2][0]);
+    const double norm1  = sqrt(H[0][1]*H[0][1] + H[1][1]*H[1][1] + H[2][1]*H[2][1]);
+    double lambda = (norm0 + norm1) / 2.0;
+    if(!(lambda > 0.0))
+        return false;
+    if(H[2][2] < 0.0)
+        lambda *= -1.0;
+
+    // The columns r0, r1 aren't exactly orthogonal, so I orthonormalize them
+    // symmetrically: c = r0+r1 and d = r0-r1 are orthogonal if |r0| = |r1|
+    double r0[3], r1[3], c[3], d[3];
+    for(int i=0; i<3; i++)
+    {
+        r0[i] = H[i][0] / (lambda > 0 ? norm0 : -norm0);
+        r1[i] = H[i][1] / (lambda > 0 ? norm1 : -norm1);
+        c[i]  = r0[i] + r1[i];
+        d[i]  = r0[i] - r1[i];
+    }
+    const double norm_c = sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]);
+    const double norm_d = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    if(!(norm_c > 0.0 && norm_d > 0.0))
+        return false;
+    double R[3][3];
+    for(int i=0; i<3; i++)
+    {
+        R[i][0] = (c[i]/norm_c + d[i]/norm_d) / M_SQRT2;
+        R[i][1] = (c[i]/norm_c - d[i]/norm_d) / M_SQRT2;
+    }
+    R[0][2] = R[1][0]*R[2][1] - R[2][0]*R[1][1];
+    R[1][2] = R[2][0]*R[0][1] - R[0][0]*R[2][1];
+    R[2][2] = R[0][0]*R[1][1] - R[1][0]*R[0][1];
+
+    mrcal_r_from_R(rt->r.xyz, NULL, &R[0][0]);
+    for(int i=0; i<3; i++)
+        rt->t.xyz[i] = H[i][2] / lambda;
+
+    // Refine with Levenberg-Marquardt
+    double JtJ[6*6], Jtx[6];
+    double cost = board_pose_cost(JtJ, Jtx, rt, ctx, v, weights);
+    if(cost < 0.0)
+        return false;
+    double mu = 1e-6;
+    for(int iteration=0; iteration<50; iteration++)
+    {
+        bool accepted = false;
+        double step[6];
+        while(mu < 1e10)
+        {
+            double A[6*6];
+            memcpy(A, JtJ, sizeof(A));
+            for(int j=0; j<6; j++)
+            {
+                A[j*6 + j] *= 1.0 + mu;
+                step[j]     = -Jtx[j];
+            }
+            if(solve_spd_dense(A, step, 6))
+            {
+                mrcal_pose_t rt_new;
+                for(int j=0; j<6; j++)
+                    ((double*)&rt_new)[j] = ((const double*)rt)[j] + step[j];
+                double cost_new = board_pose_cost(NULL, NULL, &rt_new, ctx, v, weights);
+                if(cost_new >= 0.0 && cost_new <= cost)
+                {
+                    *rt = rt_new;
+                    accepted = true;
+                    mu /= 10.0;
+                    break;
+                }
+            }
+            mu *= 10.0;
+        }
+        if(!accepted)
+            break;
+
+        double norm2_step = 0.0, norm2_rt = 0.0;
+        for(int j=0; j<6; j++)
+        {
+            norm2_step += step[j]*step[j];
+            norm2_rt   += ((const double*)rt)[j]*((const double*)rt)[j];
+        }
+        cost = board_pose_cost(JtJ, Jtx, rt, ctx, v, weights);
+        if(norm2_step < 1e-24 * (1.0 + norm2_rt))
+            break;
+    }
+
+    return true;
+}
+
+static void board_poses_work(int i, void* cookie)
+{
+    const board_poses_context_t* ctx = (const board_poses_context_t*)cookie;
+    const int Npoints = ctx->Nw*ctx->Nh;
+
+    if(!board_pose_estimate(&ctx->rt_cam_board[i], ctx,
+                            &ctx->v[i*Npoints], &ctx->weights[i*Npoints]))
+        for(int j=0; j<6; j++)
+            ((double*)&ctx->rt_cam_board[i])[j] = NAN;
+}
+
+bool mrcal_estimate_board_poses( // out
+                                 mrcal_pose_t* rt_cam_board,
+
+                                 // in
+                                 const mrcal_point3_t* v,
+                                 const double* weights,
+                                 int Nobservations,
+                                 int calibration_object_width_n,
+                                 int calibration_object_height_n,
+                                 double calibration_object_spacing,
+                                 int Nthreads)
+{
+    board_poses_context_t ctx = { .rt_cam_board = rt_cam_board,
+                                  .v            = v,
+                                  .weights      = weights,
+                                  .Nw           = calibration_object_width_n,
+                                  .Nh           = calibration_object_height_n,
+                                  .spacing      = calibration_object_spacing };
+    _mrcal_parallel_for(Nobservations, Nthreads,
+                        &board_poses_work, &ctx);
+
+    bool result = true;
+    for(int i=0; i<Nobservations; i++)
+        if(isnan(rt_cam_board[i].r.x))
+        {
+            MSG("Couldn't estimate the board pose in observation %d", i);
+            result = false;
+        }
+    return result;
+}
+
+// Finds the rotation R that maximizes trace(transpose(R) M). This is the
+// orthogonal Procrustes problem; if M = sum(outer(a,b)) then R is the rotation
+// that best maps the b vectors to the a vectors. I use Horn's quaternion
+// method: the optimal quaternion is the eigenvector of a symmetric (4,4) matrix
+// that corresponds to the largest eigenvalue. The eigenvectors are found with
+// the Jacobi eigenvalue algorithm
+static void rotation_nearest_to(// out
+                                double* R,       // (3,3)
+                                // in
+                                const double* M) // (3,3)
+{
+    // Horn's S[i][j] = sum(b_i a_j) = M[j][i]
+#define S(i,j) M[(j)*3 + (i)]
+    double N[4][4] =
+        { { S(0,0)+S(1,1)+S(2,2), S(1,2)-S(2,1),         S(2,0)-S(0,2),         S(0,1)-S(1,0)         },
+          { S(1,2)-S(2,1),        S(0,0)-S(1,1)-S(2,2),  S(0,1)+S(1,0),         S(2,0)+S(0,2)         },
+          { S(2,0)-S(0,2),        S(0,1)+S(1,0),        -S(0,0)+S(1,1)-S(2,2),  S(1,2)+S(2,1)         },
+          { S(0,1)-S(1,0),        S(2,0)+S(0,2),         S(1,2)+S(2,1),        -S(0,0)-S(1,1)+S(2,2)  } };
+#undef S
+    double V[4][4] = { {1,0,0,0}, {0,1,0,0}, {0,0,1,0}, {0,0,0,1} };
+
+    for(int sweep=0; sweep<50; sweep++)
+    {
+        double offdiagonal = 0.0, diagonal = 0.0;
+        for(int p=0; p<4; p++)
+        {
+            diagonal += N[p][p]*N[p][p];
+            for(int q=p+1; q<4; q++)
+                offdiagonal += N[p][q]*N[p][q];
+        }
+        if(offdiagonal <= 1e-30 * diagonal)
+            break;
+
+        for(int p=0; p<4; p++)
+            for(int q=p+1; q<4; q++)
+            {
+                if(N[p][q] == 0.0)
+                    continue;
+                const double theta = (N[q][q] - N[p][p]) / (2.0*N[p][q]);
+                const double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta*theta + 1.0));
+                const double c = 1.0 / sqrt(t*t + 1.0);
+                const double s = t*c;
+
+                for(int k=0; k<4; k++)
+                {
+                    const double Nkp = N[k][p], Nkq = N[k][q];
+                    N[k][p] = c*Nkp - s*Nkq;
+                    N[k][q] = s*Nkp + c*Nkq;
+                }
+                for(int k=0; k<4; k++)
+                {
+                    const double Npk = N[p][k], Nqk = N[q][k];
+                    N[p][k] = c*Npk - s*Nqk;
+                    N[q][k] = s*Npk + c*Nqk;
+                }
+                for(int k=0; k<4; k++)
+                {
+                    const double Vkp = V[k][p], Vkq = V[k][q];
+                    V[k][p] = c*Vkp - s*Vkq;
+                    V[k][q] = s*Vkp + c*Vkq;
+                }
+            }
+    }
+
+    int imax = 0;
+    for(int i=1; i<4; i++)
+        if(N[i][i] > N[imax][imax])
+            imax = i;
+    const double w = V[0][imax], x = V[1][imax], y = V[2][imax], z = V[3][imax];
+
+    R[0] = w*w + x*x - y*y - z*z; R[1] = 2.0*(x*y - w*z);         R[2] = 2.0*(x*z + w*y);
+    R[3] = 2.0*(x*y + w*z);       R[4] = w*w - x*x + y*y - z*z;   R[5] = 2.0*(y*z - w*x);
+    R[6] = 2.0*(x*z - w*y);       R[7] = 2.0*(y*z + w*x);         R[8] = w*w - x*x - y*y + z*z;
+}
+
+// One pair of observations of the same frame by two different cameras:
+// icam0 < icam1
+typedef struct
+{
+    int icam0, icam1;
+    int iobservation0, iobservation1;
+} camera_poses_covisible_pair_t;
+
+// An edge in the covisibility graph: a pair of cameras that observed the same
+// frames. The edge is made of pairs[ipair0:ipair0+Npairs]
+typedef struct
+{
+    int    icam0, icam1;
+    int    ipair0, Npairs;
+    // Rt_01: transforms points in the icam1 coord system to the icam0 coord
+    // system
+    double Rt_01[4*3];
+} camera_poses_edge_t;
+
+typedef struct
+{
+    camera_poses_edge_t*                 edges;
+    const camera_poses_covisible_pair_t* pairs;
+    const double*                        calobject_poses_local_Rt_cf;
+    int                                  Ncalobject_points;
+    // sum(p) and sum(outer(p,p)) of the calibration object points p
+    double                               calobject_sum[3];
+    double                               calobject_sum_outer[9];
+} camera_poses_context_t;
+
+static int camera_poses_compare_pairs(const void* _a, const void* _b)
+{
+    const camera_poses_covisible_pair_t* a = (const camera_poses_covisible_pair_t*)_a;
+    const camera_poses_covisible_pair_t* b = (const camera_poses_covisible_pair_t*)_b;
+    if(a->icam0         != b->icam0)         return a->icam0         < b->icam0         ? -1 : 1;
+    if(a->icam1         != b->icam1)         return a->icam1         < b->icam1         ? -1 : 1;
+    if(a->iobservation0 != b->iobservation0) return a->iobservation0 < b->iobservation0 ? -1 : 1;
+    return 0;
+}
+
+static int camera_poses_compare_edges_by_weight(const void* _a, const void* _b)
+{
+    const camera_poses_edge_t* a = *(const camera_poses_edge_t*const*)_a;
+    const camera_poses_edge_t* b = *(const camera_poses_edge_t*const*)_b;
+    // Descending weight. Ties are broken by the camera indices, so the result
+    // is deterministic
+    if(a->Npairs != b->Npairs) return a->Npairs > b->Npairs ? -1 : 1;
+    if(a->icam0  != b->icam0)  return a->icam0  < b->icam0  ? -1 : 1;
+    if(a->icam1  != b->icam1)  return a->icam1  < b->icam1  ? -1 : 1;
+    return 0;
+}
+
+// Computes the relative pose of the two cameras in an edge. The calibration
+// object points in each shared frame are transformed to both cameras, and the
+// Procrustes fit of all of these gives us the relative pose
+static void camera_poses_edge_work(int iedge, void* cookie)
+{
+    const camera_poses_context_t* ctx  = (const camera_poses_context_t*)cookie;
+    camera_poses_edge_t*          edge = &ctx->edges[iedge];
+
+    // I need sum(p0), sum(p1) and sum(outer(p0,p1)) where p0 = R0 p + t0 and
+    // p1 = R1 p + t1 for each calibration object point p in each shared frame.
+    // These are linear in the moments of the calibration object points, so I
+    // don't need to transform each point:
+    //
+    //   sum(p0)          = R0 sum(p) + N t0
+    //   sum(outer(p0,p1)) = R0 sum(outer(p,p)) R1t + R0 sum(p) t1t + t0 sum(p)t R1t + N t0 t1t
+    const double  Np    = (double)ctx->Ncalobject_points;
+    const double* sp    = ctx->calobject_sum;
+    const double* spp   = ctx->calobject_sum_outer;
+    double sum0[3] = {}, sum1[3] = {}, sum01[9] = {};
+    for(int ipair=edge->ipair0; ipair<edge->ipair0+edge->Npairs; ipair++)
+    {
+        const double* R0 = &ctx->calobject_poses_local_Rt_cf[ctx->pairs[ipair].iobservation0*4*3];
+        const double* R1 = &ctx->calobject_poses_local_Rt_cf[ctx->pairs[ipair].iobservation1*4*3];
+        const double* t0 = &R0[9];
+        const double* t1 = &R1[9];
+
+        double R0sp[3], R1sp[3], R0spp[9];
+        for(int j=0; j<3; j++)
+        {
+            R0sp[j] = R0[j*3+0]*sp[0] + R0[j*3+1]*sp[1] + R0[j*3+2]*sp[2];
+            R1sp[j] = R1[j*3+0]*sp[0] + R1[j*3+1]*sp[1] + R1[j*3+2]*sp[2];
+            for(int k=0; k<3; k++)
+                R0spp[j*3+k] = R0[j*3+0]*spp[0*3+k] + R0[j*3+1]*spp[1*3+k] + R0[j*3+2]*spp[2*3+k];
+        }
+        for(int j=0; j<3; j++)
+        {
+            sum0[j] += R0sp[j] + Np*t0[j];
+            sum1[j] += R1sp[j] + Np*t1[j];
+            for(int k=0; k<3; k++)
+                sum01[j*3 + k] +=
+                    R0spp[j*3+0]*R1[k*3+0] + R0spp[j*3+1]*R1[k*3+1] + R0spp[j*3+2]*R1[k*3+2] +
+                    R0sp[j]*t1[k] + t0[j]*R1sp[k] + Np*t0[j]*t1[k];
+        }
+    }
+
+    // Centered cross-covariance: sum(outer(p0-mean0, p1-mean1))
+    const double N = (double)(edge->Npairs * ctx->Ncalobject_points);
+    double M[9];
+    for(int j=0; j<3; j++)
+        for(int k=0; k<3; k++)
+            M[j*3 + k] = sum01[j*3 + k] - sum0[j]*sum1[k]/N;
+
+    double* R = &edge->Rt_01[0];
+    double* t = &edge->Rt_01[9];
+    rotation_nearest_to(R, M);
+    for(int j=0; j<3; j++)
+        t[j] = (sum0[j] - (R[j*3+0]*sum1[0] + R[j*3+1]*sum1[1] + R[j*3+2]*sum1[2])) / N;
+}
+
+bool mrcal_estimate_camera_poses( // out
+                                  double* Rt_0c,
+
+                                  // in
+                                  const double* calobject_poses_local_Rt_cf,
+                                  const int* indices_frame_camera,
+                                  int Nobservations,
+                                  int Ncameras,
+                                  int calibration_object_width_n,
+                                  int calibration_object_height_n,
+                                  double calibration_object_spacing,
+                                  int Nthreads)
+{
+    bool result = false;
+
+    camera_poses_covisible_pair_t* pairs      = NULL;
+    camera_poses_edge_t*           edges      = NULL;
+    camera_poses_edge_t**          edges_sorted = NULL;
+    int*                           adjacency0 = NULL;
+    int*                           adjacency  = NULL;
+    int*                           parent     = NULL;
+    int*                           queue      = NULL;
+    bool*                          tree       = NULL;
+    double*                        Rt         = NULL;
+    double*                        translation_work = NULL;
+
+    for(int i=0; i<(Ncameras-1)*4*3; i++)
+        Rt_0c[i] = NAN;
+
+    if(Ncameras <= 0)
+    {
+        MSG("Need at least one camera. Got Ncameras=%d", Ncameras);
+        goto done;
+    }
+
+    // Each frame is a contiguous set of observations. I count the covisible
+    // pairs, and make sure the data is ordered correctly
+    int Npairs = 0;
+    for(int i0=0; i0<Nobservations; )
+    {
+        const int iframe = indices_frame_camera[2*i0 + 0];
+        int i1 = i0+1;
+        while(i1 < Nobservations && indices_frame_camera[2*i1 + 0] == iframe)
+            i1++;
+        if(i1 < Nobservations && indices_frame_camera[2*i1 + 0] < iframe)
+        {
+            MSG("I'm assuming the frame indices are increasing monotonically");
+            goto done;
+        }
+        for(int i=i0; i<i1; i++)
+        {
+            const int icam = indices_frame_camera[2*i + 1];
+            if(icam < 0 || icam >= Ncameras)
+            {
+                MSG("Observation %d has icam=%d, which is out of bounds. Ncameras=%d",
+                    i, icam, Ncameras);
+                goto done;
+            }
+            for(int j=i0; j<i; j++)
+                if(indices_frame_camera[2*j + 1] == icam)
+                {
+                    MSG("Saw multiple camera%d observations in frame %d", icam, iframe);
+                    goto done;
+                }
+        }
+        Npairs += (i1-i0)*(i1-i0-1)/2;
+        i0 = i1;
+    }
+
+    pairs = malloc((Npairs > 0 ? Npairs : 1) * sizeof(pairs[0]));
+    if(pairs == NULL)
+    {
+        MSG("Couldn't allocate the covisibility pairs");
+        goto done;
+    }
+    int ipair = 0;
+    for(int i0=0; i0<Nobservations; )
+    {
+        const int iframe = indices_frame_camera[2*i0 + 0];
+        int i1 = i0+1;
+        while(i1 < Nobservations && indices_frame_camera[2*i1 + 0] == iframe)
+            i1++;
+        for(int i=i0; i<i1; i++)
+            for(int j=i+1; j<i1; j++)
+            {
+                const bool ordered = indices_frame_camera[2*i + 1] < indices_frame_camera[2*j + 1];
+                pairs[ipair++] = (camera_poses_covisible_pair_t)
+                    { .icam0         = indices_frame_camera[2*(ordered ? i : j) + 1],
+                      .icam1         = indices_frame_camera[2*(ordered ? j : i) + 1],
+                      .iobservation0 = ordered ? i : j,
+                      .iobservation1 = ordered ? j : i };
+            }
+        i0 = i1;
+    }
+
+    // The sorted pairs are grouped into the edges of the covisibility graph.
+    // Only the camera pairs that actually share frames are stored, so this
+    // scales with the number of observations, not with Ncameras^2
+    qsort(pairs, Npairs, sizeof(pairs[0]), &camera_poses_compare_pairs);
+    int Nedges = 0;
+    for(int i=0; i<Npairs; i++)
+        if(i == 0 ||
+           pairs[i].icam0 != pairs[i-1].icam0 ||
+           pairs[i].icam1 != pairs[i-1].icam1)
+            Nedges++;
+
+    const int Ncalobject_points = calibration_object_width_n*calibration_object_height_n;
+    edges        = malloc((Nedges > 0 ? Nedges : 1) * sizeof(edges[0]));
+    edges_sorted = malloc((Nedges > 0 ? Nedges : 1) * sizeof(edges_sorted[0]));
+    adjacency0   = calloc(Ncameras+1, sizeof(adjacency0[0]));
+    adjacency    = malloc((Nedges > 0 ? 2*Nedges : 1) * sizeof(adjacency[0]));
+    parent       = malloc(Ncameras * sizeof(parent[0]));
+    queue        = malloc(Ncameras * sizeof(queue[0]));
+    tree         = calloc(Nedges > 0 ? Nedges : 1, sizeof(tree[0]));
+    Rt           = malloc(Ncameras*4*3 * sizeof(Rt[0]));
+    translation_work = malloc(Ncameras*4 * sizeof(translation_work[0]));
+    if(edges == NULL || edges_sorted == NULL ||
+       adjacency0 == NULL || adjacency == NULL || parent == NULL ||
+       queue == NULL || tree == NULL || Rt == NULL || translation_work == NULL)
+    {
+        MSG("Couldn't allocate the covisibility graph");
+        goto done;
+    }
+
+    int iedge = -1;
+    for(int i=0; i<Npairs; i++)
+    {
+        if(i == 0 ||
+           pairs[i].icam0 != pairs[i-1].icam0 ||
+           pairs[i].icam1 != pairs[i-1].icam1)
+        {
+            iedge++;
+            edges[iedge] = (camera_poses_edge_t){ .icam0  = pairs[i].icam0,
+                                                  .icam1  = pairs[i].icam1,
+                                                  .ipair0 = i };
+        }
+        edges[iedge].Npairs++;
+    }
+
+    camera_poses_context_t ctx = { .edges                       = edges,
+                                   .pairs                       = pairs,
+                                   .calobject_poses_local_Rt_cf = calobject_poses_local_Rt_cf,
+                                   .Ncalobject_points           = Ncalobject_points };
+    // No calobject_warp. Good-enough for the seeding
+    for(int i=0; i<Ncalobject_points; i++)
+    {
+        const double p[3] = { (double)(i % calibration_object_width_n) * calibration_object_spacing,
+                              (double)(i / calibration_object_width_n) * calibration_object_spacing,
+                              0.0 };
+        for(int j=0; j<3; j++)
+        {
+            ctx.calobject_sum[j] += p[j];
+            for(int k=0; k<3; k++)
+                ctx.calobject_sum_outer[j*3+k] += p[j]*p[k];
+        }
+    }
+    _mrcal_parallel_for(Nedges, Nthreads,
+                        &camera_poses_edge_work, &ctx);
+
+    // I chain the pairwise poses along the maximum spanning tree of the graph,
+    // weighted by the number of shared frames (Kruskal's algorithm). parent[]
+    // is the union-find forest here
+    for(int i=0; i<Nedges; i++)
+        edges_sorted[i] = &edges[i];
+    qsort(edges_sorted, Nedges, sizeof(edges_sorted[0]), &camera_poses_compare_edges_by_weight);
+    for(int i=0; i<Ncameras; i++)
+        parent[i] = i;
+    for(int i=0; i<Nedges; i++)
+    {
+        int root0 = edges_sorted[i]->icam0;
+        int root1 = edges_sorted[i]->icam1;
+        while(parent[root0] != root0) root0 = parent[root0] = parent[parent[root0]];
+        while(parent[root1] != root1) root1 = parent[root1] = parent[parent[root1]];
+        if(root0 == root1)
+            continue;
+        parent[root1] = root0;
+        tree[edges_sorted[i] - edges] = true;
+    }
+
+    // Adjacency lists, in CSR form. Each entry is an edge index
+    for(int i=0; i<Nedges; i++)
+    {
+        adjacency0[edges[i].icam0+1]++;
+        adjacency0[edges[i].icam1+1]++;
+    }
+    for(int i=0; i<Ncameras; i++)
+        adjacency0[i+1] += adjacency0[i];
+    for(int i=0; i<Ncameras; i++)
+        parent[i] = adjacency0[i];
+    for(int i=0; i<Nedges; i++)
+    {
+        adjacency[parent[edges[i].icam0]++] = i;
+        adjacency[parent[edges[i].icam1]++] = i;
+    }
+
+    // Breadth-first traversal of the tree from camera 0. Rt[icam] is the
+    // transform TO camera 0 FROM camera icam. parent[icam] < 0 means "not yet
+    // reached"
+    for(int i=0; i<Ncameras; i++)
+        parent[i] = -1;
+    mrcal_identity_Rt(&Rt[0]);
+    parent[0] = 0;
+    int Nqueue = 0, iqueue = 0;
+    queue[Nqueue++] = 0;
+    while(iqueue < Nqueue)
+    {
+        const int icam = queue[iqueue++];
+        for(int j=adjacency0[icam]; j<adjacency0[icam+1]; j++)
+        {
+            const camera_poses_edge_t* edge = &edges[adjacency[j]];
+            if(!tree[adjacency[j]])
+                continue;
+            const int icam_next = edge->icam0 == icam ? edge->icam1 : edge->icam0;
+            if(parent[icam_next] >= 0)
+                continue;
+
+            if(edge->icam0 == icam)
+                mrcal_compose_Rt(&Rt[icam_next*4*3], &Rt[icam*4*3], edge->Rt_01);
+            else
+            {
+                double Rt_10[4*3];
+                mrcal_invert_Rt(Rt_10, edge->Rt_01);
+                mrcal_compose_Rt(&Rt[icam_next*4*3], &Rt[icam*4*3], Rt_10);
+            }
+            parent[icam_next] = icam;
+            queue[Nqueue++] = icam_next;
+        }
+    }
+
+    if(Nqueue != Ncameras)
+    {
+        for(int i=0; i<Ncameras; i++)
+            if(parent[i] < 0)
+                MSG("Camera %d has no chain of overlapping observations leading to camera 0", i);
+        goto done;
+    }
+
+    // The tree uses only a subset of the pairwise poses. I now use all of them:
+    // each camera pose is repeatedly replaced by the weighted average of the
+    // poses predicted by its neighbors (Gauss-Seidel iterations). I average the
+    // rotations first (chordal L2 mean, projected back onto SO(3)), and then
+    // solve for the translations given those rotations. Camera 0 stays fixed at
+    // the identity
+    for(int iteration=0; iteration<100; iteration++)
+    {
+        double max_change = 0.0;
+        for(int icam=1; icam<Ncameras; icam++)
+        {
+            double M[9] = {};
+            for(int j=adjacency0[icam]; j<adjacency0[icam+1]; j++)
+            {
+                const camera_poses_edge_t* edge = &edges[adjacency[j]];
+                const double w = (double)edge->Npairs;
+                // R_0icam = R_0n R_nicam
+                const int     icam_neighbor = edge->icam0 == icam ? edge->icam1 : edge->icam0;
+                const double* R_0n          = &Rt[icam_neighbor*4*3];
+                const double* R_01          = edge->Rt_01;
+                for(int a=0; a<3; a++)
+                    for(int b=0; b<3; b++)
+                        for(int k=0; k<3; k++)
+                            M[a*3+b] += w * R_0n[a*3+k] *
+                                (edge->icam1 == icam ? R_01[k*3+b] : R_01[b*3+k]);
+            }
+            double R[9];
+            rotation_nearest_to(R, M);
+            for(int k=0; k<9; k++)
+            {
+                const double d = fabs(R[k] - Rt[icam*4*3 + k]);
+                if(d > max_change) max_change = d;
+                Rt[icam*4*3 + k] = R[k];
+            }
+        }
+        if(max_change < 1e-12)
+            break;
+    }
+    // Given the rotations, the translations are linear. Each edge says
+    //
+    //   t_0c1 = R_0c0 t_01 + t_0c0
+    //
+    // I minimize the weighted sum of squared errors of these. The normal
+    // equations are L t = b, where L is the weighted Laplacian of the graph,
+    // without camera 0, since t_00 = 0. This is sparse and positive-definite if
+    // the graph is connected, so I solve it with conjugate gradients. I solve
+    // each of the x,y,z components separately: they share L
+    for(int k=0; k<3; k++)
+    {
+        double* x  = &translation_work[0*Ncameras];
+        double* r  = &translation_work[1*Ncameras];
+        double* p  = &translation_work[2*Ncameras];
+        double* Ap = &translation_work[3*Ncameras];
+
+        memset(r, 0, Ncameras*sizeof(double));
+        for(int i=0; i<Nedges; i++)
+        {
+            const double w = (double)edges[i].Npairs;
+            const double* R_0c0 = &Rt[edges[i].icam0*4*3];
+            const double* t_01  = &edges[i].Rt_01[9];
+            const double d = R_0c0[k*3+0]*t_01[0] + R_0c0[k*3+1]*t_01[1] + R_0c0[k*3+2]*t_01[2];
+            r[edges[i].icam1] += w*d;
+            r[edges[i].icam0] -= w*d;
+        }
+
+        // I start from the tree solution: r = b - L x
+        for(int icam=0; icam<Ncameras; icam++)
+            x[icam] = Rt[icam*4*3 + 9 + k];
+        for(int icam=1; icam<Ncameras; icam++)
+            for(int j=adjacency0[icam]; j<adjacency0[icam+1]; j++)
+            {
+                const camera_poses_edge_t* edge = &edges[adjacency[j]];
+                const int icam_neighbor = edge->icam0 == icam ? edge->icam1 : edge->icam0;
+                r[icam] -= (double)edge->Npairs * (x[icam] - x[icam_neighbor]);
+            }
+        r[0] = 0.0;
+
+        double norm2_r = 0.0, norm2_x = 0.0;
+        for(int icam=1; icam<Ncameras; icam++)
+        {
+            p[icam]  = r[icam];
+            norm2_r += r[icam]*r[icam];
+            norm2_x += x[icam]*x[icam];
+        }
+        p[0] = 0.0;
+
+        for(int iteration=0; iteration<Ncameras; iteration++)
+        {
+            if(norm2_r <= 1e-28 * (1.0 + norm2_x))
+                break;
+
+            double pAp = 0.0;
+            for(int icam=1; icam<Ncameras; icam++)
+            {
+                Ap[icam] = 0.0;
+                for(int j=adjacency0[icam]; j<adjacency0[icam+1]; j++)
+                {
+                    const camera_poses_edge_t* edge = &edges[adjacency[j]];
+                    const int icam_neighbor = edge->icam0 == icam ? edge->icam1 : edge->icam0;
+                    Ap[icam] += (double)edge->Npairs * (p[icam] - p[icam_neighbor]);
+                }
+                pAp += p[icam]*Ap[icam];
+            }
+            if(!(pAp > 0.0))
+                break;
+
+            const double alpha = norm2_r / pAp;
+            double norm2_r_new = 0.0;
+            for(int icam=1; icam<Ncameras; icam++)
+            {
+                x[icam]     += alpha*p[icam];
+                r[icam]     -= alpha*Ap[icam];
+                norm2_r_new += r[icam]*r[icam];
+            }
+            const double beta = norm2_r_new / norm2_r;
+            norm2_r = norm2_r_new;
+            for(int icam=1; icam<Ncameras; icam++)
+                p[icam] = r[icam] + beta*p[icam];
+        }
+
+        for(int icam=1; icam<Ncameras; icam++)
+            Rt[icam*4*3 + 9 + k] = x[icam];
+    }
+
+    memcpy(Rt_0c, &Rt[4*3], (Ncameras-1)*4*3*sizeof(double));
+    result = true;
+
+ done:
+    free(pairs);
+    free(edges);
+    free(edges_sorted);
+    free(adjacency0);
+    free(adjacency);
+    free(parent);
+    free(queue);
+    free(tree);
+    free(Rt);
+    free(translation_work);
+    return result;
+}
+
+typedef struct
+{
+    const mrcal_point2_t* q0;
+    const mrcal_point3_t* p0;
+    const mrcal_point3_t* v1;
+    const double*         weights;
+    int                   N, Nsets;
+    bool                  atinfinity;
+    double                focus_center[2];
+    double                focus_radius;
+} implied_Rt10_context_t;
+
+// The scale of the huber loss used in mrcal_implied_Rt10(). Residuals larger
+// than this (in rad^2; ~5deg) are treated as outliers, and contribute linearly
+// to the cost
+#define IMPLIED_RT10_HUBER_SCALE (5.*M_PI/180. * 5.*M_PI/180.)
+
+static bool implied_Rt10_in_focus(const implied_Rt10_context_t* ctx, int i)
+{
+    const double dx = ctx->q0[i].x - ctx->focus_center[0];
+    const double dy = ctx->q0[i].y - ctx->focus_center[1];
+    return dx*dx + dy*dy < ctx->focus_radius*ctx->focus_radius;
+}
+
+// The robust cost of the fit at rt, and optionally its iteratively-reweighted
+// normal equations in JtJ (Nstate,Nstate) and Jtx (Nstate,). If atinfinity,
+// only the rotation is fitted, and Nstate = 3. Otherwise Nstate = 6
+static double implied_Rt10_cost(// out
+                                double* JtJ, double* Jtx,
+                                // in
+                                const double* rt,
+                                const implied_Rt10_context_t* ctx)
+{
+    const int Nstate = ctx->atinfinity ? 3 : 6;
+    if(JtJ != NULL)
+    {
+        memset(JtJ, 0, Nstate*Nstate*sizeof(double));
+        memset(Jtx, 0, Nstate       *sizeof(double));
+    }
+
+    double cost = 0.0;
+    for(int i=0; i<ctx->N; i++)
+    {
+        if(!implied_Rt10_in_focus(ctx, i))
+            continue;
+
+        const mrcal_point3_t* v1 = &ctx->v1[i];
+        for(int iset=0; iset<ctx->Nsets; iset++)
+        {
+            const double w = ctx->weights != NULL ? ctx->weights[iset*ctx->N + i] : 1.0;
+            if(w == 0.0)
+                continue;
+
+            const mrcal_point3_t* p0 = &ctx->p0[iset*ctx->N + i];
+
+            // inner(a,b)/(mag(a)*mag(b)) = cos(th) ~ 1 - th^2/2. So the
+            // residual is x = th^2 * w
+            double x;
+            double J[6];
+            if(ctx->atinfinity)
+            {
+                // p0 contains unit vectors
+                mrcal_point3_t p;
+                double J_r[3][3];
+                mrcal_rotate_point_r(p.xyz, JtJ != NULL ? &J_r[0][0] : NULL, NULL,
+                                     rt, p0->xyz);
+                const double inner = p.x*v1->x + p.y*v1->y + p.z*v1->z;
+                x = 2.*(1. - inner) * w;
+                if(JtJ != NULL)
+                    for(int j=0; j<3; j++)
+                        J[j] = -2.*w*(v1->x*J_r[0][j] + v1->y*J_r[1][j] + v1->z*J_r[2][j]);
+            }
+            else
+            {
+                mrcal_point3_t p;
+                double J_rt[3][6];
+                mrcal_transform_point_rt(p.xyz, JtJ != NULL ? &J_rt[0][0] : NULL, NULL,
+                                         rt, p0->xyz);
+                const double mag = sqrt(p.x*p.x + p.y*p.y + p.z*p.z);
+                if(!(mag > 0.0))
+                    continue;
+                const double inner = p.x*v1->x + p.y*v1->y + p.z*v1->z;
+                x = 2.*(1. - inner/mag) * w;
+                if(JtJ != NULL)
+                    // dth2 = 2 (inner dmag - dinner mag)/ mag^2
+                    for(int j=0; j<6; j++)
+                    {
+                        const double dmag   = (p.x*J_rt[0][j] + p.y*J_rt[1][j] + p.z*J_rt[2][j]) / mag;
+                        const double dinner = v1->x*J_rt[0][j] + v1->y*J_rt[1][j] + v1->z*J_rt[2][j];
+                        J[j] = 2.*w*(inner*dmag - mag*dinner) / (mag*mag);
+                    }
+            }
+
+            // Huber loss: quadratic for small residuals, linear for large
+            // ones. The large ones are downweighted in the normal equations
+            const double f = IMPLIED_RT10_HUBER_SCALE;
+            double       weight_robust;
+            if(fabs(x) <= f)
+            {
+                cost         += x*x/2.;
+                weight_robust = 1.0;
+            }
+            else
+            {
+                cost         += f*fabs(x) - f*f/2.;
+                weight_robust = f/fabs(x);
+            }
+
+            if(JtJ != NULL)
+                for(int j=0; j<Nstate; j++)
+                {
+                    Jtx[j] += weight_robust*J[j]*x;
+                    for(int l=0; l<=j; l++)
+                        JtJ[j*Nstate + l] += weight_robust*J[j]*J[l];
+                }
+        }
+    }
+
+    if(JtJ != NULL)
+        for(int j=0; j<Nstate; j++)
+            for(int l=j+1; l<Nstate; l++)
+                JtJ[j*Nstate + l] = JtJ[l*Nstate + j];
+    return cost;
+}
+
+static bool implied_Rt10_validate_focus(const implied_Rt10_context_t* ctx)
+{
+    int Nfocus = 0;
+    for(int i=0; i<ctx->N; i++)
+        if(implied_Rt10_in_focus(ctx, i))
+            Nfocus++;
+    if(Nfocus < 3)
+    {
+        MSG("Focus region contained too few points");
+        return false;
+    }
+    return true;
+}
+
+static void implied_Rt10_solve(// out
+                               double* Rt10,
+                               // in
+                               const implied_Rt10_context_t* ctx)
+{
+    // Levenberg-Marquardt, starting from the identity transform. The residuals
+    // are proportional to th^2, so near a perfect fit the gradients vanish,
+    // and each step only halves the error. I thus iterate until the steps stop
+    // reducing the cost, instead of stopping early on a small gradient
+    const int Nstate = ctx->atinfinity ? 3 : 6;
+    double rt[6] = {};
+    double JtJ[6*6], Jtx[6];
+    double cost = implied_Rt10_cost(JtJ, Jtx, rt, ctx);
+    double mu = 1e-6;
+    for(int iteration=0; iteration<200; iteration++)
+    {
+        bool accepted = false;
+        double step[6] = {};
+        while(mu < 1e10)
+        {
+            double A[6*6];
+            memcpy(A, JtJ, Nstate*Nstate*sizeof(double));
+            for(int j=0; j<Nstate; j++)
+            {
+                A[j*Nstate + j] *= 1.0 + mu;
+                step[j]          = -Jtx[j];
+            }
+            if(solve_spd_dense(A, step, Nstate))
+            {
+                double rt_new[6];
+                for(int j=0; j<6; j++)
+                    rt_new[j] = rt[j] + step[j];
+                double cost_new = implied_Rt10_cost(NULL, NULL, rt_new, ctx);
+                if(cost_new < cost)
+                {
+                    memcpy(rt, rt_new, sizeof(rt));
+                    accepted = true;
+                    mu /= 10.0;
+                    break;
+                }
+            }
+            mu *= 10.0;
+        }
+        if(!accepted)
+            break;
+
+        double norm2_step = 0.0, norm2_rt = 0.0;
+        for(int j=0; j<Nstate; j++)
+        {
+            norm2_step += step[j]*step[j];
+            norm2_rt   += rt[j]*rt[j];
+        }
+        cost = implied_Rt10_cost(JtJ, Jtx, rt, ctx);
+        if(norm2_step < 1e-30 * (1.0 + norm2_rt))
+            break;
+    }
+
+    mrcal_R_from_r(Rt10, NULL, rt);
+    for(int j=0; j<3; j++)
+        Rt10[9+j] = rt[3+j];
+}
+
+typedef struct
+{
+    double*                       Rt10;
+    const mrcal_point3_t*         v1;
+    const double*                 weights;
+    const implied_Rt10_context_t* ctx;
+} implied_Rt10_batch_context_t;
+
+static void implied_Rt10_batch_work(int i, void* cookie)
+{
+    const implied_Rt10_batch_context_t* batch = (const implied_Rt10_batch_context_t*)cookie;
+    const implied_Rt10_context_t*       ctx   = batch->ctx;
+
+    implied_Rt10_context_t ctx_fit = *ctx;
+    ctx_fit.v1      = &batch->v1[i*ctx->N];
+    ctx_fit.weights = batch->weights != NULL ? &batch->weights[i*ctx->Nsets*ctx->N] : NULL;
+    implied_Rt10_solve(&batch->Rt10[i*4*3], &ctx_fit);
+}
+
+bool mrcal_implied_Rt10_batch( // out
+                               double* Rt10,
+
+                               // in
+                               const mrcal_point2_t* q0,
+                               const mrcal_point3_t* p0,
+                               const mrcal_point3_t* v1,
+                               const double* weights,
+                               int N,
+                               int Nsets,
+                               int Nfits,
+                               bool atinfinity,
+                               const double* focus_center,
+                               double focus_radius,
+                               int Nthreads)
+{
+    implied_Rt10_context_t ctx = { .q0           = q0,
+                                   .p0           = p0,
+                                   .N            = N,
+                                   .Nsets        = Nsets,
+                                   .atinfinity   = atinfinity,
+                                   .focus_radius = focus_radius };
+    if(focus_center != NULL)
+    {
+        ctx.focus_center[0] = focus_center[0];
+        ctx.focus_center[1] = focus_center[1];
+    }
+    if(!implied_Rt10_validate_focus(&ctx))
+        return false;
+
+    implied_Rt10_batch_context_t batch = { .Rt10    = Rt10,
+                                           .v1      = v1,
+                                           .weights = weights,
+                                           .ctx     = &ctx };
+    _mrcal_parallel_for(Nfits, Nthreads,
+                        &implied_Rt10_batch_work, &batch);
+    return true;
+}
+
+bool mrcal_implied_Rt10( // out
+                         double* Rt10,
+
+                         // in
+                         const mrcal_point2_t* q0,
+                         const mrcal_point3_t* p0,
+                         const mrcal_point3_t* v1,
+                         const double* weights,
+                         int N,
+                         int Nsets,
+                         bool atinfinity,
+                         const double* focus_center,
+                         double focus_radius)
+{
+    return mrcal_implied_Rt10_batch(Rt10,
+                                    q0, p0, v1, weights,
+                                    N, Nsets, 1,
+                                    atinfinity, focus_center, focus_radius,
+                                    1);
+}
+
+// Fitting a lens model to sampled projections, to convert a model from one lens
+// model to another. The state vector is split into a "dense" part (the
+// intrinsics of parametric models, and the extrinsics) and a "spline" part (the
+// control points of splined models). The x and y spline surfaces are
+// independent, and each only affects the nearby points, so the normal
+// equations of each surface form a banded matrix. I factor those with a banded
+// Cholesky decomposition, and eliminate the spline part with a Schur
+// complement. If only the control points are being fitted, the problem is
+// linear, and we converge in one step
+typedef struct
+{
+    const mrcal_point2_t* q;
+    const mrcal_point3_t* p;
+    int                   N;
+    mrcal_lensmodel_t     lensmodel;
+    int                   Nintrinsics;
+    mrcal_projection_precomputed_t precomputed;
+
+    bool optimize_rt;
+    // The dense state is intrinsics[i_intrinsics0 .. Nintrinsics-1], followed
+    // by rt if optimize_rt. Splined models have Nintrinsics_dense == 0
+    int  Ncore;
+    int  i_intrinsics0;
+    int  Nintrinsics_dense;
+    int  Ndense;
+
+    // Splined models only. Each of the x,y surfaces has Nspline control
+    // points. Row k of each banded matrix stores elements (k,k-bandwidth ..
+    // k), from the diagonal outwards
+    int    Nspline;
+    int    Nx;
+    int    bandwidth;
+    // I regularize the control points towards 0. Control points that affect
+    // no data would be undetermined otherwise
+    double lambda;
+} fit_intrinsics_context_t;
+
+typedef struct
+{
+    double* JtJ_dense;  // (Ndense,Ndense)
+    double* Jtx_dense;  // (Ndense,)
+    double* JtJ_spline; // (2,Nspline,bandwidth+1)
+    double* JtJ_cross;  // (2*Nspline,Ndense)
+    double* Jtx_spline; // (2*Nspline,)
+} fit_intrinsics_normal_t;
+
+#define SPLINE_BAND(A, k, l, ctx) (A)[(k)*((ctx)->bandwidth+1) + (k)-(l)]
+
+// In-place Cholesky factorization of a banded symmetric positive-definite
+// matrix, stored as described in fit_intrinsics_context_t. Returns false if the
+// matrix isn't positive-definite
+static bool banded_cholesky(double* A, int N, int bandwidth)
+{
+    for(int i=0; i<N; i++)
+    {
+        const int j0 = i-bandwidth > 0 ? i-bandwidth : 0;
+        for(int j=j0; j<=i; j++)
+        {
+            double s = A[i*(bandwidth+1) + i-j];
+            for(int k=j0; k<j; k++)
+                s -= A[i*(bandwidth+1) + i-k] * A[j*(bandwidth+1) + j-k];
+            if(j < i)
+                A[i*(bandwidth+1) + i-j] = s / A[j*(bandwidth+1)];
+            else
+            {
+                if(!(s > 0.0))
+                    return false;
+                A[i*(bandwidth+1)] = sqrt(s);
+            }
+        }
+    }
+    return true;
+}
+
+// Solves L Lt x = b, using the factor computed by banded_cholesky(). b is
+// overwritten with the solution
+static void banded_cholesky_solve(double* b, const double* L, int N, int bandwidth)
+{
+    for(int i=0; i<N; i++)
+    {
+        const int k0 = i-bandwidth > 0 ? i-bandwidth : 0;
+        for(int k=k0; k<i; k++)
+            b[i] -= L[i*(bandwidth+1) + i-k] * b[k];
+        b[i] /= L[i*(bandwidth+1)];
+    }
+    for(int i=N-1; i>=0; i--)
+    {
+        const int k1 = i+bandwidth < N-1 ? i+bandwidth : N-1;
+        for(int k=i+1; k<=k1; k++)
+            b[i] -= L[k*(bandwidth+1) + k-i] * b[k];
+        b[i] /= L[i*(bandwidth+1)];
+    }
+}
+
+// Returns the cost: the sum of the squared reprojection errors, plus the
+// regularization. If normal != NULL, the normal equations are computed also
+static double fit_intrinsics_cost(// out
+                                  const fit_intrinsics_normal_t* normal,
+
+                                  // in
+                                  const double* intrinsics,
+                                  const double* rt,
+                                  const fit_intrinsics_context_t* ctx)
+{
+    const int Ndense  = ctx->Ndense;
+    const int Nspline = ctx->Nspline;
+    if(normal != NULL)
+    {
+        memset(normal->JtJ_dense, 0, Ndense*Ndense*sizeof(double));
+        memset(normal->Jtx_dense, 0, Ndense*sizeof(double));
+        if(Nspline > 0)
+        {
+            memset(normal->JtJ_spline, 0, 2*Nspline*(ctx->bandwidth+1)*sizeof(double));
+            memset(normal->JtJ_cross,  0, 2*Nspline*Ndense*sizeof(double));
+            memset(normal->Jtx_spline, 0, 2*Nspline*sizeof(double));
+        }
+    }
+
+    double cost = 0.0;
+    for(int i=0; i<ctx->N; i++)
+    {
+        mrcal_point3_t pcam;
+        double         dpcam_drt[3*6];
+        if(ctx->optimize_rt)
+            mrcal_transform_point_rt(pcam.xyz,
+                                     normal != NULL ? dpcam_drt : NULL,
+                                     NULL,
+                                     rt, ctx->p[i].xyz);
+        else
+            pcam = ctx->p[i];
+
+        mrcal_pose_t   frame = {.r = {}, .t = pcam};
+        mrcal_point2_t q;
+        mrcal_point3_t dq_dpcam[2];
+        double  dq_dintrinsics_pool_double[2*(1+ctx->Nintrinsics-4)];
+        int     dq_dintrinsics_pool_int   [1];
+        double* dq_dfxy               = NULL;
+        double* dq_dintrinsics_nocore = NULL;
+        gradient_sparse_meta_t gradient_sparse_meta = {};
+
+        project( &q,
+                 normal != NULL ? dq_dintrinsics_pool_double : NULL,
+                 normal != NULL ? dq_dintrinsics_pool_int    : NULL,
+                 normal != NULL ? &dq_dfxy                   : NULL,
+                 normal != NULL ? &dq_dintrinsics_nocore     : NULL,
+                 normal != NULL ? &gradient_sparse_meta      : NULL,
+
+                 NULL, NULL, NULL,
+                 normal != NULL && ctx->optimize_rt ? dq_dpcam : NULL,
+                 NULL,
+
+                 // in
+                 intrinsics, NULL, &frame, NULL, true,
+                 ctx->lensmodel, &ctx->precomputed,
+                 0.0, 0,0);
+
+        const double x[2] = { q.x - ctx->q[i].x,
+                              q.y - ctx->q[i].y };
+        cost += x[0]*x[0] + x[1]*x[1];
+
+        if(normal == NULL)
+            continue;
+
+        // The dense gradient
+        double Jdense[2][Ndense > 0 ? Ndense : 1];
+        for(int i_xy=0; i_xy<2; i_xy++)
+        {
+            for(int j=0; j<ctx->Nintrinsics_dense; j++)
+            {
+                const int iintrinsic = ctx->i_intrinsics0 + j;
+                if(iintrinsic >= ctx->Ncore)
+                    Jdense[i_xy][j] =
+                        dq_dintrinsics_nocore[i_xy*(ctx->Nintrinsics-ctx->Ncore) +
+                                              iintrinsic - ctx->Ncore];
+                else if(iintrinsic == i_xy)
+                    Jdense[i_xy][j] = dq_dfxy[i_xy];
+                else if(iintrinsic == 2+i_xy)
+                    Jdense[i_xy][j] = 1.0;
+                else
+                    Jdense[i_xy][j] = 0.0;
+            }
+            if(ctx->optimize_rt)
+                for(int k=0; k<6; k++)
+                    Jdense[i_xy][ctx->Nintrinsics_dense + k] =
+                        dq_dpcam[i_xy].x * dpcam_drt[0*6 + k] +
+                        dq_dpcam[i_xy].y * dpcam_drt[1*6 + k] +
+                        dq_dpcam[i_xy].z * dpcam_drt[2*6 + k];
+
+            for(int j=0; j<Ndense; j++)
+            {
+                for(int l=0; l<Ndense; l++)
+                    normal->JtJ_dense[j*Ndense + l] += Jdense[i_xy][j]*Jdense[i_xy][l];
+                normal->Jtx_dense[j] += Jdense[i_xy][j]*x[i_xy];
+            }
+        }
+
+        if(gradient_sparse_meta.pool == NULL)
+            continue;
+
+        // The spline gradient. dq/dcontrolpoint = f ABCDx ABCDy
+        const int     len   = gradient_sparse_meta.run_side_length;
+        const double* ABCDx = &gradient_sparse_meta.pool[0];
+        const double* ABCDy = &gradient_sparse_meta.pool[len];
+        const int     k0    = (dq_dintrinsics_pool_int[0] - 4) / 2;
+
+        int    k   [len*len];
+        double Jcp [len*len];
+        for(int iy=0; iy<len; iy++)
+            for(int ix=0; ix<len; ix++)
+            {
+                k  [iy*len + ix] = k0 + iy*ctx->Nx + ix;
+                Jcp[iy*len + ix] = ABCDx[ix]*ABCDy[iy];
+            }
+
+        for(int i_xy=0; i_xy<2; i_xy++)
+        {
+            double* JtJ_spline = &normal->JtJ_spline[i_xy*Nspline*(ctx->bandwidth+1)];
+            for(int a=0; a<len*len; a++)
+            {
+                const double Ja = Jcp[a]*intrinsics[i_xy];
+                for(int b=0; b<len*len; b++)
+                    if(k[b] <= k[a])
+                        SPLINE_BAND(JtJ_spline, k[a], k[b], ctx) +=
+                            Ja * Jcp[b]*intrinsics[i_xy];
+
+                const int irow = i_xy*Nspline + k[a];
+                for(int j=0; j<Ndense; j++)
+                    normal->JtJ_cross[irow*Ndense + j] += Ja*Jdense[i_xy][j];
+                normal->Jtx_spline[irow] += Ja*x[i_xy];
+            }
+        }
+    }
+
+    for(int k=0; k<Nspline; k++)
+        for(int i_xy=0; i_xy<2; i_xy++)
+        {
+            const double c = intrinsics[4 + 2*k + i_xy];
+            cost += ctx->lambda * c*c;
+            if(normal != NULL)
+            {
+                SPLINE_BAND(&normal->JtJ_spline[i_xy*Nspline*(ctx->bandwidth+1)], k, k, ctx) +=
+                    ctx->lambda;
+                normal->Jtx_spline[i_xy*Nspline + k] += ctx->lambda * c;
+            }
+        }
+
+    return cost;
+}
+
+// Solves the LM-damped normal equations for the step. scratch has room for
+// 2*Nspline*(bandwidth+1 + Ndense + 1) + Nspline + Ndense*Ndense doubles
+static bool fit_intrinsics_step(// out
+                                double* step_dense,
+                                double* step_spline,
+
+                                // in
+                                const fit_intrinsics_normal_t* normal,
+                                double mu,
+                                const fit_intrinsics_context_t* ctx,
+                                double* scratch)
+{
+    const int Ndense  = ctx->Ndense;
+    const int Nspline = ctx->Nspline;
+    const int Nband   = Nspline*(ctx->bandwidth+1);
+
+    double* L   = scratch;                 // (2,Nspline,bandwidth+1)
+    double* Y   = &L[2*Nband];             // (2*Nspline,Ndense). S^-1 C
+    double* z   = &Y[2*Nspline*Ndense];    // (2*Nspline,).       S^-1 Jtx_spline
+    double* col = &z[2*Nspline];           // (Nspline,)
+    double* A   = &col[Nspline];           // (Ndense,Ndense)
+
+    // I have the blocks
+    //
+    //   [ S  C ] [ step_spline ] = - [ Jtx_spline ]
+    //   [ Ct D ] [ step_dense  ]     [ Jtx_dense  ]
+    //
+    // So (D - Ct S^-1 C) step_dense = Ct S^-1 Jtx_spline - Jtx_dense
+    //    step_spline                = -S^-1 Jtx_spline - S^-1 C step_dense
+    memcpy(A, normal->JtJ_dense, Ndense*Ndense*sizeof(double));
+    for(int j=0; j<Ndense; j++)
+    {
+        A[j*Ndense + j] *= 1.0 + mu;
+        step_dense[j]    = -normal->Jtx_dense[j];
+    }
+
+    if(Nspline > 0)
+    {
+        memcpy(L, normal->JtJ_spline, 2*Nband*sizeof(double));
+        for(int i_xy=0; i_xy<2; i_xy++)
+        {
+            for(int k=0; k<Nspline; k++)
+                SPLINE_BAND(&L[i_xy*Nband], k, k, ctx) *= 1.0 + mu;
+            if(!banded_cholesky(&L[i_xy*Nband], Nspline, ctx->bandwidth))
+                return false;
+        }
+
+        for(int i_xy=0; i_xy<2; i_xy++)
+        {
+            const double* Li = &L[i_xy*Nband];
+            for(int j=0; j<Ndense; j++)
+            {
+                for(int k=0; k<Nspline; k++)
+                    col[k] = normal->JtJ_cross[(i_xy*Nspline + k)*Ndense + j];
+                banded_cholesky_solve(col, Li, Nspline, ctx->bandwidth);
+                for(int k=0; k<Nspline; k++)
+                    Y[(i_xy*Nspline + k)*Ndense + j] = col[k];
+            }
+            memcpy(&z[i_xy*Nspline], &normal->Jtx_spline[i_xy*Nspline],
+                   Nspline*sizeof(double));
+            banded_cholesky_solve(&z[i_xy*Nspline], Li, Nspline, ctx->bandwidth);
+        }
+
+        for(int k=0; k<2*Nspline; k++)
+            for(int j=0; j<Ndense; j++)
+            {
+                const double Ckj = normal->JtJ_cross[k*Ndense + j];
+                for(int l=0; l<Ndense; l++)
+                    A[j*Ndense + l] -= Ckj * Y[k*Ndense + l];
+                step_dense[j] += Ckj * z[k];
+            }
+    }
+
+    if(Ndense > 0 &&
+       !solve_spd_dense(A, step_dense, Ndense))
+        return false;
+
+    for(int k=0; k<2*Nspline; k++)
+    {
+        step_spline[k] = -z[k];
+        for(int j=0; j<Ndense; j++)
+            step_spline[k] -= Y[k*Ndense + j] * step_dense[j];
+    }
+    return true;
+}
+
+static void fit_intrinsics_apply_step(// out
+                                      double* intrinsics,
+                                      double* rt,
+                                      // in
+                                      const double* step_dense,
+                                      const double* step_spline,
+                                      const fit_intrinsics_context_t* ctx)
+{
+    for(int j=0; j<ctx->Nintrinsics_dense; j++)
+        intrinsics[ctx->i_intrinsics0 + j] += step_dense[j];
+    if(ctx->optimize_rt)
+        for(int j=0; j<6; j++)
+            rt[j] += step_dense[ctx->Nintrinsics_dense + j];
+    for(int k=0; k<ctx->Nspline; k++)
+        for(int i_xy=0; i_xy<2; i_xy++)
+            intrinsics[4 + 2*k + i_xy] += step_spline[i_xy*ctx->Nspline + k];
+}
+
+bool mrcal_fit_intrinsics_to_points( // in,out
+                                     double* intrinsics,
+                                     double* rt_cam_ref,
+
+                                     // out
+                                     double* rms_error,
+
+                                     // in
+                                     const mrcal_point2_t* q,
+                                     const mrcal_point3_t* p,
+                                     int N,
+                                     mrcal_lensmodel_t lensmodel,
+                                     bool do_optimize_intrinsics_core)
+{
+    if(lensmodel.type == MRCAL_LENSMODEL_CAHVORE)
+    {
+        MSG("LENSMODEL_CAHVORE isn't supported: its gradients aren't implemented");
+        return false;
+    }
+
+    const mrcal_lensmodel_metadata_t meta = mrcal_lensmodel_metadata(lensmodel);
+
+    fit_intrinsics_context_t ctx = { .q           = q,
+                                     .p           = p,
+                                     .N           = N,
+                                     .lensmodel   = lensmodel,
+                                     .Nintrinsics = mrcal_lensmodel_num_params(lensmodel),
+                                     .optimize_rt = rt_cam_ref != NULL,
+                                     .Ncore       = meta.has_core ? 4 : 0 };
+    _mrcal_precompute_lensmodel_data(&ctx.precomputed, lensmodel);
+
+    if(lensmodel.type == MRCAL_LENSMODEL_SPLINED_STEREOGRAPHIC)
+    {
+        // The core is largely redundant with the spline, so it is never
+        // optimized here
+        const mrcal_LENSMODEL_SPLINED_STEREOGRAPHIC__config_t* config =
+            &lensmodel.LENSMODEL_SPLINED_STEREOGRAPHIC__config;
+        ctx.Nspline   = config->Nx * config->Ny;
+        ctx.Nx        = config->Nx;
+        ctx.bandwidth = config->order * (config->Nx + 1);
+    }
+    else
+    {
+        ctx.i_intrinsics0     = do_optimize_intrinsics_core ? 0 : ctx.Ncore;
+        ctx.Nintrinsics_dense = ctx.Nintrinsics - ctx.i_intrinsics0;
+    }
+    ctx.Ndense = ctx.Nintrinsics_dense + (ctx.optimize_rt ? 6 : 0);
+
+    const int Ndense  = ctx.Ndense;
+    const int Nspline = ctx.Nspline;
+    const int Nband   = Nspline*(ctx.bandwidth+1);
+
+    if(N*2 < Ndense)
+    {
+        MSG("Too few points to fit: have %d points, but need at least %d",
+            N, (Ndense+1)/2);
+        return false;
+    }
+
+    // Everything in one block:
+    // - normal: JtJ_dense, Jtx_dense, JtJ_spline, JtJ_cross, Jtx_spline
+    // - steps:  dense, spline
+    // - scratch for fit_intrinsics_step()
+    // - the candidate state: intrinsics, rt
+    const int Nbuffer =
+        Ndense*Ndense + Ndense + 2*Nband + 2*Nspline*Ndense + 2*Nspline +
+        Ndense + 2*Nspline +
+        2*Nband + 2*Nspline*(Ndense+1) + Nspline + Ndense*Ndense +
+        ctx.Nintrinsics + 6;
+    double* buffer = malloc(Nbuffer*sizeof(double));
+    if(buffer == NULL)
+    {
+        MSG("Couldn't allocate the fitting buffer");
+        return false;
+    }
+
+    fit_intrinsics_normal_t normal;
+    normal.JtJ_dense   = buffer;
+    normal.Jtx_dense   = &normal.JtJ_dense [Ndense*Ndense];
+    normal.JtJ_spline  = &normal.Jtx_dense [Ndense];
+    normal.JtJ_cross   = &normal.JtJ_spline[2*Nband];
+    normal.Jtx_spline  = &normal.JtJ_cross [2*Nspline*Ndense];
+    double* step_dense     = &normal.Jtx_spline[2*Nspline];
+    double* step_spline    = &step_dense[Ndense];
+    double* scratch        = &step_spline[2*Nspline];
+    double* intrinsics_new = &scratch[2*Nband + 2*Nspline*(Ndense+1) + Nspline + Ndense*Ndense];
+    double* rt_new         = &intrinsics_new[ctx.Nintrinsics];
+
+    double rt_identity[6] = {};
+    double* rt = ctx.optimize_rt ? rt_cam_ref : rt_identity;
+
+    double cost = fit_intrinsics_cost(&normal, intrinsics, rt, &ctx);
+    if(Nspline > 0)
+    {
+        // The regularization is scaled to be tiny compared to the data
+        double JtJ_max = 0.0;
+        for(int k=0; k<2*Nspline; k++)
+        {
+            const double JtJ_kk = SPLINE_BAND(normal.JtJ_spline, k, k, &ctx);
+            if(JtJ_kk > JtJ_max) JtJ_max = JtJ_kk;
+        }
+        ctx.lambda = 1e-9 * (JtJ_max > 0.0 ? JtJ_max : 1.0);
+        cost = fit_intrinsics_cost(&normal, intrinsics, rt, &ctx);
+    }
+
+    // Levenberg-Marquardt. Same logic as in implied_Rt10_solve()
+    double mu = 1e-6;
+    for(int iteration=0; iteration<100; iteration++)
+    {
+        bool   accepted = false;
+        double cost_new = cost;
+        while(mu < 1e10)
+        {
+            if(fit_intrinsics_step(step_dense, step_spline,
+                                   &normal, mu, &ctx, scratch))
+            {
+                memcpy(intrinsics_new, intrinsics, ctx.Nintrinsics*sizeof(double));
+                memcpy(rt_new,         rt,         6*sizeof(double));
+                fit_intrinsics_apply_step(intrinsics_new, rt_new,
+                                          step_dense, step_spline, &ctx);
+                cost_new = fit_intrinsics_cost(NULL, intrinsics_new, rt_new, &ctx);
+                if(cost_new < cost)
+                {
+                    memcpy(intrinsics, intrinsics_new, ctx.Nintrinsics*sizeof(double));
+                    memcpy(rt,         rt_new,         6*sizeof(double));
+                    accepted = true;
+                    mu /= 10.0;
+                    break;
+                }
+            }
+            mu *= 10.0;
+        }
+        if(!accepted)
+            break;
+
+        const double cost_prev = cost;
+        cost = fit_intrinsics_cost(&normal, intrinsics, rt, &ctx);
+        if(cost_prev - cost < 1e-12 * cost_prev)
+            break;
+    }
+
+    if(rms_error != NULL)
+    {
+        ctx.lambda = 0.0;
+        *rms_error = sqrt(fit_intrinsics_cost(NULL, intrinsics, rt, &ctx) / (double)N);
+    }
+
+    free(buffer);
+    return true;
+}
+
+// A counter-based random number generator: the k-th value depends only on the
+// seed and on k. So the values don't depend on the order in which they're
+// generated, and any thread can generate any value. This is the splitmix64
+// finalizer applied to the counter
+static uint64_t rng_counter_based(uint64_t seed, uint64_t counter)
+{
+    uint64_t z = seed + (counter+1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniformly-distributed in [-1,1)
+static double rng_uniform_pm1(uint64_t seed, uint64_t counter)
+{
+    return (double)(rng_counter_based(seed, counter) >> 11) * 0x1.0p-52 - 1.0;
+}
+
+typedef struct
+{
+    const mrcal_lensmodel_t*  lensmodels;
+    const double**            intrinsics;       // (Ncameras,) pointers
+    const double*             Rt_cam_ref;       // (Ncameras,4,3)
+    const int*                imagersizes;
+    int                       Ncameras;
+    int                       Npoints;          // in each board
+    const mrcal_point3_t*     board_reference;  // (Npoints,). Centered
+    const double*             board_center;
+    const double*             rt_ref_boardcenter;
+    const double*             rt_ref_boardcenter__noiseradius;
+    mrcal_board_visibility_t  which;
+    uint64_t                  seed;
+
+    // The current batch of candidate poses: candidate i has index k0+i
+    uint64_t                  k0;
+    mrcal_point2_t*           q;                // (Ncandidates,Ncameras,Npoints)
+    mrcal_point3_t*           p;                // (Ncandidates,Npoints)
+    double*                   Rt_ref_board;     // (Ncandidates,4,3)
+    bool*                     accepted;         // (Ncandidates,)
+} synthesize_board_context_t;
+
+static void synthesize_board_work(int i, void* cookie)
+{
+    const synthesize_board_context_t* ctx = (const synthesize_board_context_t*)cookie;
+    const int       Npoints = ctx->Npoints;
+    const uint64_t  k       = ctx->k0 + (uint64_t)i;
+
+    // Each candidate pose uses 6 random values
+    double rt_ref_boardcenter[6];
+    for(int j=0; j<6; j++)
+        rt_ref_boardcenter[j] =
+            ctx->rt_ref_boardcenter[j] +
+            rng_uniform_pm1(ctx->seed, 6*k + (uint64_t)j) * ctx->rt_ref_boardcenter__noiseradius[j];
+    double Rt_ref_boardcenter[4*3];
+    mrcal_Rt_from_rt(Rt_ref_boardcenter, NULL, rt_ref_boardcenter);
+
+    // The reported pose references the board corner, not its center
+    double* Rt_ref_board = &ctx->Rt_ref_board[i*4*3];
+    const double Rt_boardcenter_board[4*3] = { 1,0,0, 0,1,0, 0,0,1,
+                                               -ctx->board_center[0],
+                                               -ctx->board_center[1],
+                                               -ctx->board_center[2] };
+    mrcal_compose_Rt(Rt_ref_board, Rt_ref_boardcenter, Rt_boardcenter_board);
+
+    mrcal_point3_t* p = &ctx->p[i*Npoints];
+
+    bool all_cameras_see  = true;
+    bool some_cameras_see = false;
+    for(int icam=0; icam<ctx->Ncameras; icam++)
+    {
+        double Rt_cam_boardcenter[4*3];
+        mrcal_compose_Rt(Rt_cam_boardcenter, &ctx->Rt_cam_ref[icam*4*3], Rt_ref_boardcenter);
+        for(int ipt=0; ipt<Npoints; ipt++)
+            mrcal_transform_point_Rt(p[ipt].xyz, NULL, NULL,
+                                     Rt_cam_boardcenter, ctx->board_reference[ipt].xyz);
+
+        mrcal_point2_t* q = &ctx->q[(i*ctx->Ncameras + icam)*Npoints];
+        int Nvisible = 0;
+        if(mrcal_project(q, NULL, NULL,
+                         p, Npoints,
+                         ctx->lensmodels[icam], ctx->intrinsics[icam]))
+        {
+            const int W = ctx->imagersizes[2*icam + 0];
+            const int H = ctx->imagersizes[2*icam + 1];
+            for(int ipt=0; ipt<Npoints; ipt++)
+                if(q[ipt].x >= 0 && q[ipt].x < W &&
+                   q[ipt].y >= 0 && q[ipt].y < H)
+                    Nvisible++;
+        }
+        else
+        {
+            // Couldn't project. I report the whole board as out-of-view
+            for(int ipt=0; ipt<Npoints; ipt++)
+                q[ipt] = (mrcal_point2_t){.x = -1., .y = -1.};
+        }
+
+        bool sees;
+        if(ctx->which == MRCAL_ALL_CAMERAS_MUST_SEE_FULL_BOARD ||
+           ctx->which == MRCAL_SOME_CAMERAS_MUST_SEE_FULL_BOARD)
+            sees = Nvisible == Npoints;
+        else
+            sees = Nvisible > Npoints/2;
+
+        all_cameras_see  = all_cameras_see  && sees;
+        some_cameras_see = some_cameras_see || sees;
+    }
+
+    ctx->accepted[i] =
+        (ctx->which == MRCAL_ALL_CAMERAS_MUST_SEE_FULL_BOARD ||
+         ctx->which == MRCAL_ALL_CAMERAS_MUST_SEE_HALF_BOARD) ?
+        all_cameras_see : some_cameras_see;
+}
+
+bool mrcal_synthesize_board_observations( // out
+                                          mrcal_point2_t* q,
+                                          double* Rt_ref_board,
+
+                                          // in
+                                          const mrcal_lensmodel_t* lensmodels,
+                                          const double* intrinsics,
+                                          const double* rt_cam_ref,
+                                          const int* imagersizes,
+                                          int Ncameras,
+                                          int object_width_n,
+                                          int object_height_n,
+                                          double object_spacing,
+                                          const mrcal_point2_t* calobject_warp,
+                                          const double* rt_ref_boardcenter,
+                                          const double* rt_ref_boardcenter__noiseradius,
+                                          int Nframes,
+                                          mrcal_board_visibility_t which,
+                                          uint64_t seed,
+                                          int Nthreads)
+{
+    // Candidate poses are evaluated in batches. Each batch is processed in
+    // parallel, and then the accepted poses are collected in order. I take the
+    // first Nframes accepted candidates, so the results don't depend on the
+    // batch size or on the thread count
+    const int Ncandidates_max = 1024;
+    // If I haven't found a single acceptable pose after this many tries, I
+    // give up
+    const uint64_t Ncandidates_giveup = 1000000;
+
+    const int Npoints = object_width_n*object_height_n;
+
+    const double* intrinsics_cameras[Ncameras];
+    double        Rt_cam_ref[Ncameras*4*3];
+    for(int icam=0; icam<Ncameras; icam++)
+    {
+        intrinsics_cameras[icam] = intrinsics;
+        intrinsics += mrcal_lensmodel_num_params(lensmodels[icam]);
+        mrcal_Rt_from_rt(&Rt_cam_ref[icam*4*3], NULL, &rt_cam_ref[icam*6]);
+    }
+
+    // The same geometry as in synthesize_board_observations() in
+    // synthetic_data.py: the board from ref_calibration_object(), shifted to
+    // put the origin at the center
+    const double board_center[3] = { (double)(object_height_n-1)*object_spacing/2.,
+                                     (double)(object_width_n -1)*object_spacing/2.,
+                                     0. };
+
+    bool result = false;
+
+    mrcal_point3_t* board_reference = malloc(Npoints*sizeof(board_reference[0]));
+    mrcal_point2_t* q_candidates    = malloc((size_t)Ncandidates_max*Ncameras*Npoints*sizeof(q_candidates[0]));
+    mrcal_point3_t* p_candidates    = malloc((size_t)Ncandidates_max*Npoints*sizeof(p_candidates[0]));
+    double*         Rt_candidates   = malloc(Ncandidates_max*4*3*sizeof(Rt_candidates[0]));
+    bool*           accepted        = malloc(Ncandidates_max*sizeof(accepted[0]));
+    if(board_reference == NULL || q_candidates == NULL || p_candidates == NULL ||
+       Rt_candidates == NULL || accepted == NULL)
+    {
+        MSG("Couldn't allocate the candidate buffers");
+        goto done;
+    }
+
+    // The grid, with the same warping as in project()
+    for(int y=0; y<object_height_n; y++)
+        for(int x=0; x<object_width_n; x++)
+        {
+            mrcal_point3_t* pt = &board_reference[y*object_width_n + x];
+            *pt = (mrcal_point3_t){.x = (double)x * object_spacing,
+                                   .y = (double)y * object_spacing};
+            if(calobject_warp != NULL)
+            {
+                double xr = (double)x / (double)(object_width_n -1);
+                double yr = (double)y / (double)(object_height_n-1);
+                pt->z += calobject_warp->x * 4. * xr * (1. - xr);
+                pt->z += calobject_warp->y * 4. * yr * (1. - yr);
+            }
+            for(int j=0; j<3; j++)
+                pt->xyz[j] -= board_center[j];
+        }
+
+    synthesize_board_context_t ctx =
+        { .lensmodels                      = lensmodels,
+          .intrinsics                      = intrinsics_cameras,
+          .Rt_cam_ref                      = Rt_cam_ref,
+          .imagersizes                     = imagersizes,
+          .Ncameras                        = Ncameras,
+          .Npoints                         = Npoints,
+          .board_reference                 = board_reference,
+          .board_center                    = board_center,
+          .rt_ref_boardcenter              = rt_ref_boardcenter,
+          .rt_ref_boardcenter__noiseradius = rt_ref_boardcenter__noiseradius,
+          .which                           = which,
+          .seed                            = seed,
+          .q                               = q_candidates,
+          .p                               = p_candidates,
+          .Rt_ref_board                    = Rt_candidates,
+          .accepted                        = accepted };
+
+    int Nfound = 0;
+    while(Nfound < Nframes)
+    {
+        if(Nfound == 0 && ctx.k0 >= Ncandidates_giveup)
+        {
+            MSG("Couldn't find any board poses satisfying the visibility requirements after %" PRIu64 " tries. Giving up",
+                ctx.k0);
+            goto done;
+        }
+
+        // I expect most candidates to be accepted, so I try a few more than
+        // I need
+        int Ncandidates = 2*(Nframes - Nfound);
+        if(Ncandidates < 16)              Ncandidates = 16;
+        if(Ncandidates > Ncandidates_max) Ncandidates = Ncandidates_max;
+
+        _mrcal_parallel_for(Ncandidates, Nthreads,
+                            &synthesize_board_work, &ctx);
+
+        for(int i=0; i<Ncandidates && Nfound < Nframes; i++)
+        {
+            if(!accepted[i])
+                continue;
+            memcpy(&q[Nfound*Ncameras*Npoints],
+                   &q_candidates[i*Ncameras*Npoints],
+                   Ncameras*Npoints*sizeof(q[0]));
+            memcpy(&Rt_ref_board[Nfound*4*3],
+                   &Rt_candidates[i*4*3],
+                   4*3*sizeof(Rt_ref_board[0]));
+            Nfound++;
+        }
+        ctx.k0 += (uint64_t)Ncandidates;
+    }
+    result = true;
+
+ done:
+    free(board_reference);
+    free(q_candidates);
+    free(p_candidates);
+    free(Rt_candidates);
+    free(accepted);
+    return result;
+}
@@ -245,8 +245,8 @@ bool mrcal_knots_for_splined_models( double* ux, double* uy,
 // and very sparse gradients. THIS function reports the gradients densely,
 // however, so it is inefficient for splined models.
 //
-// This function supports CAHVORE distortions only if we don't ask for any
-// gradients
+// This function supports CAHVORE distortions only if we don't ask for the
+// gradients in respect to the intrinsics
 //
 // Projecting out-of-bounds points (beyond the field of view) returns undefined
 // values. Generally things remain continuous even as we move off the imager
@@ -281,8 +281,6 @@ bool mrcal_project( // out
 // mrcal_project(). For OpenCV models specifically, OpenCV has
 // cvUndistortPoints() (and cv2.undistortPoints()), but these are unreliable:
 // https://github.com/opencv/opencv/issues/8811
-//
-// This function does NOT support CAHVORE
 bool mrcal_unproject( // out
                      mrcal_point3_t* v,
 
@@ -293,6 +291,74 @@ bool mrcal_unproject( // out
                      // core, distortions concatenated
                      const double* intrinsics);
 
+// Unproject a large batch of pixel coordinates
+//
+// Identical to mrcal_unproject(), but the points are split into chunks, and the
+// chunks are handed out to Nthreads threads (Nthreads <= 0 means "use all the
+// available cores"). Useful for the models whose unprojection is expensive,
+// such as CAHVORE, or when unprojecting whole images
+bool mrcal_unproject_batch( // out
+                            mrcal_point3_t* v,
+
+                            // in
+                            const mrcal_point2_t* q,
+                            int N,
+                            mrcal_lensmodel_t lensmodel,
+                            // core, distortions concatenated
+                            const double* intrinsics,
+                            int Nthreads);
+
+
+// The fractional-pixel resolution of the fixed-point rectification maps. Same
+// as OpenCV's INTER_TAB_SIZE
+#define MRCAL_RECTIFICATION_INTERPOLATION_TABLE_SIZE 32
+
+// Compute the stereo rectification maps
+//
+// This is the core of stereo_rectify_prepare() in stereo.py. The rectified
+// images have Nel rows and Naz columns: pixel (iaz,iel) observes the direction
+// at azimuth az[iaz] and elevation el[iel] in the rectified coordinate system
+// (see stereo_unproject() in stereo.py for the definition). This direction is
+// rotated into each camera, and projected with that camera's lens model. The
+// rows are distributed among Nthreads threads (Nthreads <= 0 means "use all the
+// available cores").
+//
+// R_cam0_stereo rotates the rectified coordinate system to camera 0, and
+// R_cam1_cam0 rotates camera 0 to camera 1. Both are (3,3) row-first arrays.
+// lensmodels points to the two lens models.
+//
+// The maps are written in one of two formats: exactly one of these must be
+// requested, with the other pointer(s) set to NULL
+//
+// - rectification_maps: float32 maps of shape (2,Nel,Naz,2): the pixel
+//   coordinate (x,y) in each camera. Usable directly by cv2.remap()
+//
+// - rectification_maps_fixed_xy, rectification_maps_fixed_interpolation: the
+//   same maps in OpenCV's fixed-point format, as produced by cv2.convertMaps()
+//   with dstmap1type=CV_16SC2. rectification_maps_fixed_xy is an int16 array of
+//   shape (2,Nel,Naz,2) with the whole part of each pixel coordinate.
+//   rectification_maps_fixed_interpolation is a uint16 array of shape
+//   (2,Nel,Naz), with the fractional parts, in units of
+//   1/MRCAL_RECTIFICATION_INTERPOLATION_TABLE_SIZE pixels:
+//   y_fractional*MRCAL_RECTIFICATION_INTERPOLATION_TABLE_SIZE + x_fractional.
+//   cv2.remap() uses these without converting them
+//
+// Returns true on success
+bool mrcal_rectification_maps( // output
+                               float*    rectification_maps,
+                               int16_t*  rectification_maps_fixed_xy,
+                               uint16_t* rectification_maps_fixed_interpolation,
+
+                               // input
+                               const mrcal_lensmodel_t* lensmodels,
+                               const double* intrinsics0,
+                               const double* intrinsics1,
+                               const double* R_cam0_stereo,
+                               const double* R_cam1_cam0,
+                               const double* az, int Naz,
+                               const double* el, int Nel,
+                               int Nthreads);
+
 
 // Project the given camera-coordinate-system points using a stereographic model
 //
@@ -431,6 +497,17 @@ typedef struct
     // input are respected regardless
     bool do_apply_outlier_rejection         : 1;
 
+    // If true, solve each optimization step with a matrix-free
+    // preconditioned conjugate-gradient method instead of factoring J^T J.
+    // This uses much less memory for very large problems, at the cost of more
+    // iterations
+    bool do_solve_with_pcg                  : 1;
+
+    // If true, the PCG solver stores the values of the Jacobian in single
+    // precision, halving the size of J. The products with J are still
+    // accumulated in double precision. Requires do_solve_with_pcg
+    bool do_store_jacobian_float32          : 1;
+
 } mrcal_problem_selections_t;
 
 // Constants used in a mrcal optimization. This is similar to
@@ -620,6 +697,301 @@ mrcal_optimize( // out
 
                 bool check_gradient);
 
+// One problem in a batch passed to mrcal_optimize_batch(). The members have
+// the same meaning as the identically-named arguments to mrcal_optimize()
+typedef struct
+{
+    // out
+    mrcal_stats_t stats;
+
+    // Each one of these output pointers may be NULL
+    double* p_packed;
+    int     buffer_size_p_packed;
+    double* x;
+    int     buffer_size_x;
+
+    // out, in
+    double*         intrinsics;
+    mrcal_pose_t*   extrinsics_fromref;
+    mrcal_pose_t*   frames_toref;
+    mrcal_point3_t* points;
+    mrcal_point2_t* calobject_warp;
+
+    // in
+    int Ncameras_intrinsics, Ncameras_extrinsics, Nframes;
+    int Npoints, Npoints_fixed;
+
+    const mrcal_observation_board_t* observations_board;
+    const mrcal_observation_point_t* observations_point;
+    int Nobservations_board;
+    int Nobservations_point;
+
+    // out, in: new outliers are marked here
+    mrcal_point3_t* observations_board_pool;
+
+    mrcal_lensmodel_t                lensmodel;
+    double                           observed_pixel_uncertainty;
+    const int*                       imagersizes;
+    mrcal_problem_selections_t       problem_selections;
+    const mrcal_problem_constants_t* problem_constants;
+    double                           calibration_object_spacing;
+    int                              calibration_object_width_n;
+    int                              calibration_object_height_n;
+    bool                             verbose;
+} mrcal_optimize_problem_t;
+
+// Solve a batch of independent optimization problems in parallel
+//
+// Each problem is solved with mrcal_optimize(), and its result is written into
+// problems[i].stats. The problems are handed out to Nthreads worker threads one
+// at a time, so problems of very different difficulty still keep all the
+// threads busy. Nthreads <= 0 means "use all the available cores".
+//
+// The problems are solved concurrently, so they must not share any of their
+// output or in-out buffers. Read-only inputs (imagersizes, observations_board,
+// etc) may be shared. Note that observations_board_pool is written-to if
+// outlier rejection is enabled.
+//
+// Returns true if ALL the problems were solved successfully. If some of them
+// failed, false is returned, and the failed problems have
+// stats.rms_reproj_error__pixels < 0
+bool mrcal_optimize_batch( // out, in
+                           mrcal_optimize_problem_t* problems,
+
+                           // in
+                           int Nproblems,
+                           int Nthreads);
+
+// Estimate the poses of a flat calibration object from monocular observations
+//
+// This is used to seed the calibration: each observation is solved
+// independently. v contains the observation vectors (unprojected pixel
+// observations; their length doesn't matter) of each point in each
+// observation: Nobservations*calibration_object_height_n*calibration_object_width_n
+// of them, in the same order as the board observations passed to
+// mrcal_optimize(). Each point is weighted by the corresponding value in
+// "weights"; a weight of 0 means "ignore this point". At least 4 points in each
+// observation must be usable.
+//
+// For each observation we compute the homography of the board plane, and
+// decompose it into an initial pose. This pose is then refined by minimizing
+// the reprojection error in the normalized (x/z, y/z) coordinates. The
+// observations are handed out to Nthreads threads (Nthreads <= 0 means "use all
+// the available cores").
+//
+// The poses are written to rt_cam_board: the transformation TO the camera FROM
+// the board. Returns true if ALL the poses were estimated successfully. If
+// some failed, false is returned, and the failed poses are set to NaN
+bool mrcal_estimate_board_poses( // out
+                                 mrcal_pose_t* rt_cam_board,
+
+                                 // in
+                                 const mrcal_point3_t* v,
+                                 const double* weights,
+                                 int Nobservations,
+                                 int calibration_object_width_n,
+                                 int calibration_object_height_n,
+                                 double calibration_object_spacing,
+                                 int Nthreads);
+
+// Estimate the relative poses of cameras observing a moving calibration object
+//
+// This is used to seed the calibration. We have the pose of the calibration
+// object in each observation (from mrcal_estimate_board_poses(), for instance).
+// Cameras observing the same frame are related through those poses. I build
+// the covisibility graph: an edge for each pair of cameras that observed at
+// least one common frame. The relative pose of each such pair is computed with a
+// Procrustes fit over all the shared frames. These are distributed over
+// Nthreads threads (Nthreads <= 0 means "use all the available cores").
+//
+// The pairwise poses are chained to camera 0 along the maximum spanning tree of
+// the graph, weighted by the number of shared frames. That estimate is then
+// refined using ALL the edges: the rotations are averaged, and then the
+// translations, with each edge weighted by its number of shared frames.
+//
+// indices_frame_camera is an array of Nobservations (iframe,icam) pairs, in the
+// same order as calobject_poses_local_Rt_cf: the Rt transformations TO each
+// observing camera FROM the calibration object, stored as (4,3) arrays. The
+// frame indices must increase monotonically, and each frame may be observed by
+// each camera at most once. The calibration object warp is ignored.
+//
+// The Ncameras-1 (4,3) Rt transformations TO camera 0 FROM each of cameras
+// 1..Ncameras-1 are written to Rt_0c. Returns false on error, with Rt_0c set to
+// NaN. If some cameras aren't connected to camera 0 in the graph, a message is
+// printed for each one, and false is returned
+bool mrcal_estimate_camera_poses( // out
+                                  double* Rt_0c,
+
+                                  // in
+                                  const double* calobject_poses_local_Rt_cf,
+                                  const int* indices_frame_camera,
+                                  int Nobservations,
+                                  int Ncameras,
+                                  int calibration_object_width_n,
+                                  int calibration_object_height_n,
+                                  double calibration_object_spacing,
+                                  int Nthreads);
+
+// Compute the implied-by-the-intrinsics transformation to fit two cameras'
+// projections
+//
+// This is used to compare two lens models: see the docs for the
+// mrcal.implied_Rt10__from_unprojections() Python function for a detailed
+// description. We have a grid of N pixel coordinates q0, and the corresponding
+// unprojections p0 from camera 0 and v1 from camera 1. v1 contains unit
+// vectors. p0 contains Nsets sets of N vectors each: all of these are fitted to
+// the same v1. If atinfinity, p0 contains unit vectors, and only the rotation
+// is fitted. Otherwise p0 contains points at the distance of interest, and the
+// full transformation is fitted.
+//
+// We minimize the th^2 * weight residuals, where th is the angle between the
+// transformed p0 and v1, with a Huber loss to reject outliers. The weights
+// array has the same shape as p0 without the last dimension. It may be NULL to
+// weigh all the points equally. Points with a weight of 0 are ignored. All the
+// data must be finite: invalid points should be given a weight of 0. Only the
+// points with q0 within focus_radius of focus_center are used. focus_center may
+// be NULL to mean (0,0). At least 3 such points must exist.
+//
+// The (4,3) Rt transformation TO camera 1 FROM camera 0 is written to Rt10. If
+// atinfinity, the translation is 0. Returns false on error
+bool mrcal_implied_Rt10( // out
+                         double* Rt10,
+
+                         // in
+                         const mrcal_point2_t* q0,
+                         const mrcal_point3_t* p0,
+                         const mrcal_point3_t* v1,
+                         const double* weights,
+                         int N,
+                         int Nsets,
+                         bool atinfinity,
+                         const double* focus_center,
+                         double focus_radius);
+
+// Compute the implied-by-the-intrinsics transformations for many camera pairs
+//
+// Identical to mrcal_implied_Rt10(), but Nfits transformations are fitted at
+// the same time, all of them from the same camera 0. This is used to compare N
+// models to each other. q0 and p0 are shared by all the fits. v1 contains
+// Nfits sets of N unit vectors: one for each camera 1. weights contains Nfits
+// sets of (Nsets,N) values, or it is NULL. The fits are handed out to Nthreads
+// threads (Nthreads <= 0 means "use all the available cores").
+//
+// The Nfits (4,3) transformations are written to Rt10. Returns false on error
+bool mrcal_implied_Rt10_batch( // out
+                               double* Rt10,
+
+                               // in
+                               const mrcal_point2_t* q0,
+                               const mrcal_point3_t* p0,
+                               const mrcal_point3_t* v1,
+                               const double* weights,
+                               int N,
+                               int Nsets,
+                               int Nfits,
+                               bool atinfinity,
+                               const double* focus_center,
+                               double focus_radius,
+                               int Nthreads);
+
+// Fit a lens model to a set of projections
+//
+// This is used to convert a model from one lens model to another: we sample
+// the imager, unproject with the original model, and fit the new model to
+// reproject these points to the sampled pixels. We minimize the reprojection
+// errors of the N points p projecting to the pixel coordinates q. This is a
+// dedicated solver: much faster than setting up the same problem for
+// mrcal_optimize(). Splined models are fitted linearly: their control points
+// are solved directly with a sparse factorization, and they converge in one
+// step if we're not also fitting the extrinsics. The control points are
+// regularized very lightly towards 0, so control points that affect no data
+// remain at 0. The core of splined models is never optimized: it's largely
+// redundant with the spline. LENSMODEL_CAHVORE isn't supported.
+//
+// intrinsics contains the seed on input, and the fitted parameters on output.
+// If rt_cam_ref is non-NULL, the extrinsics are fitted as well: p are in the
+// reference coordinate system, and rt_cam_ref contains the seed (usually 0) on
+// input, and the fitted transformation on output. If rt_cam_ref is NULL, p are
+// in the camera coordinate system. The core of parametric models is fitted
+// only if do_optimize_intrinsics_core. If rms_error is non-NULL, the RMS
+// reprojection error of the fit is written to it, in pixels.
+//
+// All the data must be finite. Returns false on error
+bool mrcal_fit_intrinsics_to_points( // in,out
+                                     double* intrinsics,
+                                     double* rt_cam_ref,
+
+                                     // out
+                                     double* rms_error,
+
+                                     // in
+                                     const mrcal_point2_t* q,
+                                     const mrcal_point3_t* p,
+                                     int N,
+                                     mrcal_lensmodel_t lensmodel,
+                                     bool do_optimize_intrinsics_core);
+
+// Which synthetic board poses are usable. See
+// mrcal_synthesize_board_observations()
+typedef enum
+{
+    // The board is fully visible by all the cameras
+    MRCAL_ALL_CAMERAS_MUST_SEE_FULL_BOARD,
+    // The board is fully visible by at least one camera
+    MRCAL_SOME_CAMERAS_MUST_SEE_FULL_BOARD,
+    // More than half of the board is visible by all the cameras
+    MRCAL_ALL_CAMERAS_MUST_SEE_HALF_BOARD,
+    // More than half of the board is visible by at least one camera
+    MRCAL_SOME_CAMERAS_MUST_SEE_HALF_BOARD
+} mrcal_board_visibility_t;
+
+// Produce synthetic chessboard observations
+//
+// This is the C implementation of the mrcal.synthesize_board_observations()
+// Python function; see its docs for a detailed description. Random board poses
+// are generated around rt_ref_boardcenter, with each element perturbed
+// uniformly within rt_ref_boardcenter__noiseradius. Each pose is projected into
+// each of the Ncameras cameras, and the poses that don't satisfy the "which"
+// visibility requirement are thrown out, until we have Nframes poses.
+//
+// The random numbers come from a counter-based generator: the i-th candidate
+// pose is a function of the seed and of i only. The candidates are evaluated by
+// Nthreads threads (Nthreads <= 0 means "use all the available cores"), and we
+// keep the first Nframes acceptable candidates. So the output depends on the
+// seed, but not on the number of threads.
+//
+// The cameras are described by lensmodels (Ncameras,), intrinsics (all the
+// cameras' intrinsics, concatenated), rt_cam_ref (Ncameras,6) and imagersizes
+// (Ncameras,2). The board geometry is given by object_width_n,
+// object_height_n, object_spacing and calobject_warp (may be NULL for a flat
+// board).
+//
+// We write the pixel observations to q (Nframes,Ncameras,object_height_n,
+// object_width_n) and the board poses to Rt_ref_board (Nframes,4,3). These
+// poses transform the corner-referenced board, as in project(). We report ALL
+// the corners, even the out-of-view ones. Returns false on error: if no
+// acceptable pose can be found at all, for instance
+bool mrcal_synthesize_board_observations( // out
+                                          mrcal_point2_t* q,
+                                          double* Rt_ref_board,
+
+                                          // in
+                                          const mrcal_lensmodel_t* lensmodels,
+                                          const double* intrinsics,
+                                          const double* rt_cam_ref,
+                                          const int* imagersizes,
+                                          int Ncameras,
+                                          int object_width_n,
+                                          int object_height_n,
+                                          double object_spacing,
+                                          const mrcal_point2_t* calobject_warp,
+                                          const double* rt_ref_boardcenter,
+                                          const double* rt_ref_boardcenter__noiseradius,
+                                          int Nframes,
+                                          mrcal_board_visibility_t which,
+                                          uint64_t seed,
+                                          int Nthreads);
+
 
 // This is cholmod_sparse. I don't want to include the full header that defines
 // it in mrcal.h, and I don't need to: mrcal.h just needs to know that it's a
@@ -702,6 +1074,157 @@ bool mrcal_optimizer_callback(// out
                              bool verbose);
 
 
+// What mrcal_projection_uncertainty() reports for each query point
+typedef enum
+{
+    // The full (2,2) covariance matrix Var(q)
+    MRCAL_UNCERTAINTY_COVARIANCE,
+    // The worst-direction standard deviation: sqrt of the larger eigenvalue of
+    // Var(q)
+    MRCAL_UNCERTAINTY_WORSTDIRECTION_STDEV,
+    // The RMS of the worst and best direction standard deviations:
+    // sqrt(trace(Var(q))/2)
+    MRCAL_UNCERTAINTY_RMS_STDEV
+} mrcal_uncertainty_what_t;
+
+// These are CHOLMOD structures. As with cholmod_sparse above, mrcal.h just
+// needs to know that they're structures
+struct cholmod_factor_struct;
+
+// Compute the projection uncertainty of camera-referenced points
+//
+// This is the C implementation of the Python mrcal.projection_uncertainty(): it
+// propagates the noise in the calibration-object observations through the
+// optimization to the projection of each query point p_cam. See
+// http://mrcal.secretsauce.net/uncertainty.html for the derivation.
+//
+// For each point we compute the sparse gradient dq/dp_ief: the sensitivity of
+// the projection to the intrinsics, extrinsics and frame poses that were
+// optimized. All the points share the same sparsity pattern. Then we solve
+// against the given factorization of JtJ, and assemble the requested output.
+// The points are processed in chunks, each chunk with a single multiple-RHS
+// solve. The chunks are distributed among Nthreads threads (Nthreads <= 0
+// means "use all the available cores").
+//
+// The factorization and Jt are the ones at the optimum of the calibration
+// problem: the factorization of Jt*J computed by mrcal_optimizer_callback()
+// and the Python CHOLMOD_factorization. Both use the packed, unitless state.
+// The factorization is only read. If Nmeasurements_observations < 0, we assume
+// there's no regularization: all the measurements are observations, and the
+// simplified expression is used. Jt may be NULL in that case.
+//
+// The camera whose uncertainty we're evaluating is described by the
+// intrinsics, extrinsics_fromref and the locations of those variables in the
+// state vector. The frames_toref are ALL the calibration object poses. They
+// should be NULL if the frames are not being optimized. extrinsics_fromref
+// should be NULL if this camera defines the reference coordinate system.
+//
+// state_scale[i] is the scale applied to state variable i when unpacking it.
+// This is what mrcal_unpack_solver_state_vector() applies to a vector of 1.0.
+// state_scale may be NULL only if Var_ief is given in the unpacked state
+//
+// If atinfinity, the points are infinitely far away; only the rotations
+// matter, and the magnitude of p_cam is ignored.
+//
+// Returns true on success. The output is stored in out: an array of shape
+// (N,2,2) if what == MRCAL_UNCERTAINTY_COVARIANCE or (N,) otherwise
+bool mrcal_projection_uncertainty( // out
+                                  double* out,
+
+                                  // in
+                                  mrcal_uncertainty_what_t what,
+                                  const mrcal_point3_t* p_cam,
+                                  int N,
+                                  bool atinfinity,
+
+                                  mrcal_lensmodel_t lensmodel,
+                                  const double* intrinsics,
+                                  const mrcal_pose_t* extrinsics_fromref, // May be NULL
+                                  const mrcal_pose_t* frames_toref,       // May be NULL
+                                  int Nframes,
+
+                                  // Where the variables live in the packed
+                                  // state vector. <0 if not being optimized
+                                  int istate_intrinsics,
+                                  // Which of the intrinsics are being optimized:
+                                  // Nintrinsics_optimized values, starting at
+                                  // intrinsics[i_intrinsics0]
+                                  int i_intrinsics0,
+                                  int Nintrinsics_optimized,
+                                  int istate_extrinsics,
+                                  int istate_frames,
+                                  const double* state_scale,
+
+                                  // The precomputed inv(J*tJ*)[ief,ief] from
+                                  // mrcal_selected_inverse() with the state
+                                  // indices from
+                                  // mrcal_projection_uncertainty_state_indices().
+                                  // May be NULL. If given, we use it instead of
+                                  // solving against the factorization, and the
+                                  // factorization, Jt may be NULL
+                                  const double* Var_ief,
+                                  struct cholmod_factor_struct* factorization,
+                                  const struct cholmod_sparse_struct* Jt,
+                                  int Nmeasurements_observations,
+                                  double observed_pixel_uncertainty,
+                                  int Nthreads);
+
+// The state indices of the variables that affect the projection of a point
+// through the camera being evaluated by mrcal_projection_uncertainty(). These
+// are the "ief" variables: the optimized intrinsics, the extrinsics and the
+// frames, in that order. At infinity only the rotations are included.
+//
+// Returns the number of indices. If istate_ief is non-NULL, the indices are
+// written there. Call with istate_ief = NULL to get the size of the buffer
+int mrcal_projection_uncertainty_state_indices( // out
+                                               int* istate_ief,
+
+                                               // in
+                                               bool atinfinity,
+                                               int Nframes,
+                                               int istate_intrinsics,
+                                               int Nintrinsics_optimized,
+                                               int istate_extrinsics,
+                                               int istate_frames);
+
+// Compute the selected blocks of the covariance of the packed state
+//
+// Computes Var[i,j] = inv(J*tJ*)[istate[i],istate[j]] for all i,j < Nistate,
+// where J* is the Jacobian at the optimum in the packed, unitless state. The
+// output Var is a dense, symmetric (Nistate,Nistate) array.
+//
+// If Nmeasurements_observations >= 0, the measurements past the first
+// Nmeasurements_observations are regularization terms, and do not contribute
+// noise. We then return the observation-only covariance
+//
+//   inv(J*tJ*) J*[observations]t J*[observations] inv(J*tJ*)
+//
+// which is computed by correcting inv(J*tJ*) with the regularization part of
+// Jt. If Nmeasurements_observations < 0, Jt may be NULL.
+//
+// The entries of inv(J*tJ*) that are in the sparsity pattern of the Cholesky
+// factor are computed with the Takahashi recursion: no solves are necessary.
+// The remaining entries (usually the cross-terms between different frames) and
+// the regularization correction are computed by solving, in Nthreads threads
+// (Nthreads <= 0 means "use all the available cores"). The factorization is
+// only read. The correction needs a (Nistate, Nregularization) work buffer. The
+// result doesn't depend on Nthreads
+//
+// With Var and the state indices from
+// mrcal_projection_uncertainty_state_indices(), each projection uncertainty
+// query is a small quadratic form; see mrcal_projection_uncertainty()
+bool mrcal_selected_inverse( // out
+                            double* Var,
+
+                            // in
+                            const int* istate,
+                            int Nistate,
+                            struct cholmod_factor_struct* factorization,
+                            const struct cholmod_sparse_struct* Jt,
+                            int Nmeasurements_observations,
+                            int Nthreads);
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //////////////////// Layout of the measurement and state vectors
 ////////////////////////////////////////////////////////////////////////////////
@@ -849,5 +1372,71 @@ int mrcal_num_states_calobject_warp(mrcal_problem_selections_t problem_selection
                                     int Nobservations_board);
 
 
+
+////////////////////////////////////////////////////////////////////////////////
+//////////////////// Cameramodel io
+////////////////////////////////////////////////////////////////////////////////
+
+// A camera model, as read from a .cameramodel file
+//
+// This is returned by mrcal_read_cameramodel_string() and
+// mrcal_read_cameramodel_file(). The structure is allocated as one block, with
+// all the variable-length data following it. It must be freed with
+// mrcal_free_cameramodel()
+typedef struct
+{
+    // The "extrinsics" of the model: the rt transformation TO the camera
+    // coordinate system FROM the reference coordinate system
+    double            rt_cam_ref[6];
+    unsigned int      imagersize[2];
+    mrcal_lensmodel_t lensmodel;
+
+    // The "valid_intrinsics_region" contour. valid_intrinsics_region is NULL if
+    // the model doesn't have one. Nvalid_intrinsics_region = 0 with a non-NULL
+    // valid_intrinsics_region means "the intrinsics are valid nowhere"
+    int             Nvalid_intrinsics_region;
+    mrcal_point2_t* valid_intrinsics_region;
+
+    // The camera index in the optimization inputs. <0 if not given
+    int icam_intrinsics;
+
+    // The "optimization_inputs" and "projection_uncertainty_cache" data. These
+    // are stored in the file as byte strings (compressed, and encoded to
+    // ascii); that's what we have here. These are NULL if not given. The
+    // strings are \0-terminated, and the _len values don't include the \0
+    const char* optimization_inputs;
+    int         optimization_inputs_len;
+    const char* projection_uncertainty_cache;
+    int         projection_uncertainty_cache_len;
+
+    // mrcal_lensmodel_num_params(lensmodel) values
+    double intrinsics[];
+} mrcal_cameramodel_t;
+
+// Parse a .cameramodel from a string
+//
+// The string doesn't need to be \0-terminated: len is its length. If len <= 0,
+// we use strlen(string) instead. The models are stored as a python dict
+// literal; this function parses the subset of the python syntax that the
+// cameramodels use. Returns a newly-allocated mrcal_cameramodel_t, which must be
+// freed with mrcal_free_cameramodel(). On error, a message is printed, and NULL
+// is returned.
+//
+// The "lensmodel", "intrinsics", "extrinsics" and "imagersize" keys are
+// required. The legacy key names ("lens_model", "distortion_model",
+// "icam_intrinsics_optimization_inputs") and the legacy "DISTORTION_..." lens
+// model names are accepted. Unknown keys are ignored
+mrcal_cameramodel_t* mrcal_read_cameramodel_string(const char* string, int len);
+
+// Read a .cameramodel file
+//
+// This is a wrapper around mrcal_read_cameramodel_string(). See its
+// documentation for the details
+mrcal_cameramodel_t* mrcal_read_cameramodel_file  (const char* filename);
+
+// Free a model returned by mrcal_read_cameramodel_string() or
+// mrcal_read_cameramodel_file(), and set *cameramodel to NULL
+void                 mrcal_free_cameramodel(mrcal_cameramodel_t** cameramodel);
+
 // Public ABI stuff, that's not for end-user consumption
 #include "mrcal_internal.h"
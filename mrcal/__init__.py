@@ -25,4 +25,5 @@ from .model_analysis        import *
 from .synthetic_data        import *
 from .calibration           import *
 from .image_transforms      import *
+from .model_registry        import *
 from .utils                 import *
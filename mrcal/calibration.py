@@ -10,8 +10,8 @@ mrcal.calibration.fff() or mrcal.fff(). The latter is preferred.
 import numpy as np
 import numpysane as nps
 import sys
+import os
 import re
-import cv2
 import mrcal
 
 def compute_chessboard_corners(Nw, Nh,
@@ -19,7 +19,8 @@ def compute_chessboard_corners(Nw, Nh,
                                corners_cache_vnl = None,
                                jobs              = 1,
                                exclude_images    = set(),
-                               extracol          = 'level'):
+                               extracol          = 'level',
+                               process_observation = None):
     r'''Compute the chessboard observations and returns them in a usable form
 
 SYNOPSIS
@@ -63,6 +64,13 @@ elif extracol == 'weight': the 4th column is already represented as a weight, so
 
 else: I hard-code the output weight to 1.0
 
+The corners cache may also be a binary file produced by
+mrcal.corners_cache_vnl_to_binary() (or the mrcal-convert-corners-cache tool).
+This contains the same data, but is mapped into memory instead of being parsed.
+This is much faster for large caches. The format is detected from the file
+contents. A binary cache is only used for reading: the detector output is
+always written as a vnlog.
+
 ARGUMENTS
 
 - Nw, Nh: the width and height of the point grid in the calibration object we're
@@ -88,7 +96,8 @@ ARGUMENTS
   and the results will be written to that file. So the same function call can be
   used to both compute the corners initially, and to reuse the pre-computed
   corners with subsequent calls. This exists to save time where re-analyzing the
-  same data multiple times.
+  same data multiple times. An existing file may be a vnlog or a binary cache
+  written by mrcal.corners_cache_vnl_to_binary()
 
 - jobs: a GNU-Make style parallelization flag. Indicates how many parallel
   processes should be invoked when computing the corners. If given, a numerical
@@ -109,6 +118,17 @@ ARGUMENTS
     ignored: we set output weight = -1
   - '' the 4th column should be ignored, and I set the output weight to 1.0
 
+- process_observation: an optional callable, defaulting to None. If given, this
+  is called as process_observation(path, icam, observation) for each board
+  observation as soon as it is ingested. path is the image path, as it will
+  appear in the returned files_sorted. icam is the camera index. observation is
+  an array of shape (object_height_n,object_width_n,3), as it will appear in the
+  returned observations. Nothing is known about the frame indices at this point.
+  When running mrgingham, this is called while it's still processing the later
+  images, so any per-observation work (seeding the board pose, for instance) can
+  overlap the corner detection. The observations excluded from the result are
+  not passed here at all
+
 RETURNED VALUES
 
 This function returns a tuple (observations, indices_frame_camera, files_sorted)
@@ -142,7 +162,7 @@ which mrcal.optimize() expects
     import shutil
     from tempfile import mkstemp
     import io
-    import copy
+    import contextlib
 
     def get_corner_observations(Nw, Nh, globs, corners_cache_vnl, exclude_images=set()):
         r'''Return dot observations, from a cache or from mrgingham
@@ -191,14 +211,16 @@ which mrcal.optimize() expects
             corners_dir = os.path.dirname( corners_cache_vnl )
 
         def accum_files(f):
+            # Returns the camera index of this file, or None if it matches none
+            # of the globs
             for icam in range(Ncameras):
                 g = globs[icam]
                 if g[0] != '/':
                     g = '*/' + g
                 if fnmatch.fnmatch(os.path.abspath(f), g):
                     files_per_camera[icam].append(f)
-                    return True
-            return False
+                    return icam
+            return None
 
 
         pipe_corners_write_fd          = None
@@ -234,116 +256,114 @@ which mrcal.optimize() expects
                 pipe_corners_write_fd,pipe_corners_write_tmpfilename = mkstemp('.vnl')
                 sys.stderr.write("Will save corners to '{}'\n".format(corners_cache_vnl))
 
-            corners_output = subprocess.Popen(args_mrgingham, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
-                                              encoding='ascii')
+            corners_output = subprocess.Popen(args_mrgingham, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
             pipe_corners_read = corners_output.stdout
         else:
             # Have an existing cache file. Just read it
             if reading_pipe:
                 pipe_corners_read = corners_cache_vnl
+            elif _is_corners_cache_binary(corners_cache_vnl):
+                # This is mapped into memory below
+                pipe_corners_read = None
             else:
-                pipe_corners_read = open(corners_cache_vnl, 'r', encoding='ascii')
+                pipe_corners_read = open(corners_cache_vnl, 'rb')
             corners_output    = None
 
 
         mapping = {}
-        context0 = dict(f            = '',
-                        igrid        = 0,
-                        Nvalidpoints = 0)
-
-        # The default weight is 1.0
-        context0['grid'] = np.ones( (Nh*Nw,3), dtype=float)
-
-        context = copy.deepcopy(context0)
-
-        def finish_chessboard_observation():
-            nonlocal context
-            if context['igrid']:
-                if Nw*Nh != context['igrid']:
-                    raise Exception("File '{}' expected to have {} points, but got {}". \
-                                    format(context['f'], Nw*Nh, context['igrid']))
-                if context['f'] not in exclude_images and \
-                   context['Nvalidpoints'] > 3:
-                    # There is a bit of ambiguity here. The image path stored in
-                    # the 'corners_cache_vnl' file is relative to what? It could be
-                    # relative to the directory the corners_cache_vnl lives in, or it
-                    # could be relative to the current directory. The image
-                    # doesn't necessarily need to exist. I implement a few
-                    # heuristics to figure this out
-                    if corners_dir is None          or \
-                       context['f'][0] == '/'       or \
-                       os.path.isfile(context['f']):
-                        filename_canonical = os.path.normpath(context['f'])
-                    else:
-                        filename_canonical = os.path.join(corners_dir, context['f'])
-                    if accum_files(filename_canonical):
-                        mapping[filename_canonical] = context['grid'].reshape(Nh,Nw,3)
-                context = copy.deepcopy(context0)
-
-        for line in pipe_corners_read:
-            if pipe_corners_write_fd is not None:
-                os.write(pipe_corners_write_fd, line.encode())
 
-            if line[0] == '#':
-                continue
-            m = re.match('(\S+)\s+(.*?)$', line)
-            if m is None:
-                raise Exception("Unexpected line in the corners output: '{}'".format(line))
-            if m.group(2)[:2] == '- ':
-                # No observations for this image. Done with this image; move on
-                finish_chessboard_observation()
-                continue
-            if context['f'] != m.group(1):
-                # Got data for the next image. Finish out this one
-                finish_chessboard_observation()
-                context['f'] = m.group(1)
-
-            # The row may have 2 or 3 values: if 3, it contains a decimation
-            # level of the corner observation (used for the weight). If 2, a
-            # weight of 1.0 is assumed. The weight array is pre-filled with 1.0.
-            # A decimation level of - will be used to set weight <0 which means
-            # "ignore this point"
-            fields = m.group(2).split()
-            if len(fields) < 2:
-                raise Exception("'corners.vnl' data rows must contain a filename and 2 or 3 values. Instead got line '{}'".format(line))
-            else:
-                context['grid'][context['igrid'],:2] = (float(fields[0]),float(fields[1]))
-                context['Nvalidpoints'] += 1
-                if len(fields) == 3 and extracol != '':
-                    if fields[2] == '-':
-                        # ignore this point
-                        context['grid'][context['igrid'],2] = -1.0
-                        context['Nvalidpoints'] -= 1
-                    else:
-                        l = float(fields[2])
-                        if l < 0:
-                            # ignore this point
-                            context['grid'][context['igrid'],2] = -1.0
-                            context['Nvalidpoints'] -= 1
-                        else:
-                            if extracol == 'weight':
-                                context['grid'][context['igrid'],2] = l
-                            else:
-                                # convert decimation level to weight. The weight is
-                                # 2^(-level). I.e. level-0 -> weight=1, level-1 ->
-                                # weight=0.5, etc
-                                context['grid'][context['igrid'],2] = 1. / (1 << int(l))
-                    # else use the 1.0 that's already there
-
-            context['igrid'] += 1
-
-        finish_chessboard_observation()
+        def filename_canonical(f):
+            # There is a bit of ambiguity here. The image path stored in the
+            # 'corners_cache_vnl' file is relative to what? It could be relative
+            # to the directory the corners_cache_vnl lives in, or it could be
+            # relative to the current directory. The image doesn't necessarily
+            # need to exist. I implement a few heuristics to figure this out
+            if corners_dir is None or \
+               f[0] == '/'         or \
+               os.path.isfile(f):
+                return os.path.normpath(f)
+            return os.path.join(corners_dir, f)
+
+        def accum_observations(filenames, x, y, extra):
+            # x,y,extra are arrays of shape (Nimages,Nh*Nw). I convert them all
+            # at once, and store views into the result in the mapping
+            grids = np.ones( (len(filenames),Nh*Nw,3), dtype=float)
+            grids[...,0] = x
+            grids[...,1] = y
+            Nvalidpoints = np.full( (len(filenames),), Nh*Nw)
+
+            if extracol != '':
+                # extra < 0 means "ignore this point". extra is NaN if the row
+                # had no extra column: the default weight of 1.0 is kept
+                invalid = extra < 0
+                have    = ~np.isnan(extra) & ~invalid
+                if extracol == 'weight':
+                    grids[...,2][have] = extra[have]
+                else:
+                    # convert decimation level to weight. The weight is
+                    # 2^(-level). I.e. level-0 -> weight=1, level-1 ->
+                    # weight=0.5, etc
+                    grids[...,2][have] = 1. / 2.**np.trunc(extra[have])
+                grids[...,2][invalid] = -1.0
+                Nvalidpoints -= np.count_nonzero(invalid, axis=-1)
+
+            grids = grids.reshape(len(filenames),Nh,Nw,3)
+            for i in range(len(filenames)):
+                if filenames[i] in exclude_images or \
+                   Nvalidpoints[i] <= 3:
+                    continue
+                f    = filename_canonical(filenames[i])
+                icam = accum_files(f)
+                if icam is not None:
+                    mapping[f] = grids[i]
+                    if process_observation is not None:
+                        process_observation(f, icam, grids[i])
+
+        if corners_output is None and not reading_pipe and \
+           pipe_corners_read is None:
+            # Binary cache. I map it into memory, and convert all the
+            # observations at once. No text parsing at all
+            cache = _read_corners_cache_binary(corners_cache_vnl)
+            Npoints_per_image = np.diff(cache['image_point_offsets'])
+            i = Npoints_per_image != 0
+            if np.any(Npoints_per_image[i] != Nw*Nh):
+                ibad = np.nonzero(i & (Npoints_per_image != Nw*Nh))[0][0]
+                raise Exception("File '{}' expected to have {} points, but got {}". \
+                                format(cache['filenames'][ibad], Nw*Nh, Npoints_per_image[ibad]))
+            ipoint = nps.dummy(cache['image_point_offsets'][:-1][i].astype(np.intp), -1) + \
+                np.arange(Nw*Nh)
+            accum_observations([cache['filenames'][j] for j in np.nonzero(i)[0]],
+                               cache['x'][ipoint],
+                               cache['y'][ipoint],
+                               cache['extra'][ipoint])
+        else:
+            # The text is read and parsed in a separate thread, and I process
+            # each block of observations here as soon as it's available. If
+            # we're running the detector, this happens while it's still working
+            # on the later images
+            with contextlib.closing(_iterate_in_thread(_corners_vnl_runs(pipe_corners_read,
+                                                                         pipe_corners_write_fd))) \
+                 as blocks:
+                for runs in blocks:
+                    for f,points in runs:
+                        if len(points) != Nw*Nh:
+                            raise Exception("File '{}' expected to have {} points, but got {}". \
+                                            format(f, Nw*Nh, len(points)))
+                    # shape (N,Nh*Nw,3)
+                    points = nps.cat(*[points for f,points in runs])
+                    accum_observations([f for f,points in runs],
+                                       points[...,0], points[...,1], points[...,2])
 
         if corners_output is not None:
             sys.stderr.write("Done computing chessboard corners\n")
 
             if corners_output.wait() != 0:
-                err = corners_output.stderr.read()
+                err = corners_output.stderr.read().decode(errors='replace')
                 raise Exception("mrgingham failed: {}".format(err))
             if pipe_corners_write_fd is not None:
                 os.close(pipe_corners_write_fd)
                 shutil.move(pipe_corners_write_tmpfilename, corners_cache_vnl)
-        elif not reading_pipe:
+        elif pipe_corners_read is not None and not reading_pipe:
             pipe_corners_read.close()
 
         # If I have multiple cameras, I use the filenames to figure out what
@@ -374,8 +394,6 @@ which mrcal.optimize() expects
         return mapping,files_per_camera
 
 
-    indices_frame_camera = np.array((), dtype=np.int32)
-    observations         = np.array((), dtype=float)
 
     # basic logic is this:
     #   for frames:
@@ -391,6 +409,9 @@ which mrcal.optimize() expects
     files_sorted = sorted(mapping_file_corners.keys(), key=lambda f: file_framenocameraindex[f][1])
     files_sorted = sorted(files_sorted,                key=lambda f: file_framenocameraindex[f][0])
 
+    # I allocate the outputs once, and fill them in
+    indices_frame_camera = np.zeros((len(files_sorted),2),         dtype=np.int32)
+    observations         = np.zeros((len(files_sorted),Nh,Nw,3),   dtype=float)
     i_observation = 0
 
     iframe_last = None
@@ -403,16 +424,302 @@ which mrcal.optimize() expects
             index_frame += 1
             iframe_last = iframe
 
-        indices_frame_camera = nps.glue(indices_frame_camera,
-                                        np.array((index_frame, icam), dtype=np.int32),
-                                        axis=-2)
-        observations = nps.glue(observations,
-                                mapping_file_corners[f],
-                                axis=-4)
+        indices_frame_camera[i_observation] = (index_frame, icam)
+        observations        [i_observation] = mapping_file_corners[f]
+        i_observation += 1
 
     return observations, indices_frame_camera, files_sorted
 
 
+def _corners_vnl_runs(pipe, write_fd = None):
+    r'''Parses a corners vnlog, yielding the observations as they become available
+
+    The text is read in blocks, and each block is parsed in C by
+    mrcal._mrcal._corners_vnl_parse(). After each block we yield a list of the
+    runs that are complete: (filename, points) tuples, where points is an array
+    of shape (N,3). Each row of points is (x,y,extra), where "extra" is the raw
+    4th column: a decimation level or a weight. It is -1 if that column is '-'
+    (the point should be ignored), and NaN if the column is missing. Images with
+    no observations ('filename - - -') produce no runs.
+
+    The pipe may be a text or a binary stream. If it's a pipe from a running
+    process, we parse each block as soon as it arrives, and the caller sees the
+    data for each image shortly after it's written.
+
+    If write_fd is not None, everything we read is also written to it
+
+    '''
+
+    # The last non-empty run of the previous block. The next block might
+    # continue it
+    pending  = None
+    leftover = b''
+
+    while True:
+        if hasattr(pipe, 'read1'):
+            # Binary stream. read1() returns whatever is available, without
+            # waiting for the whole block
+            block = pipe.read1(1 << 20)
+        else:
+            block = pipe.read(1 << 20)
+        if isinstance(block, str):
+            block = block.encode()
+        if write_fd is not None and len(block):
+            os.write(write_fd, block)
+
+        if len(block):
+            # I parse complete lines only
+            text = leftover + block
+            i    = text.rfind(b'\n')
+            if i < 0:
+                leftover = text
+                continue
+            text,leftover = text[:i+1],text[i+1:]
+        else:
+            # End of the data. The last line might not end with a newline
+            text,leftover = leftover,b''
+
+        runs = []
+        if len(text):
+            filenames,image_point_offsets,points = \
+                mrcal._mrcal._corners_vnl_parse(text)
+            for i in range(len(filenames)):
+                p = points[image_point_offsets[i]:image_point_offsets[i+1]]
+                if i == 0 and pending is not None and \
+                   len(p) and filenames[0] == pending[0]:
+                    # This block continues the run from the previous block
+                    pending = (pending[0], nps.glue(pending[1], p, axis=-2))
+                    continue
+                if pending is not None:
+                    runs.append(pending)
+                pending = (filenames[i], p) if len(p) else None
+
+        if len(block) == 0:
+            if pending is not None:
+                runs.append(pending)
+            if len(runs):
+                yield runs
+            return
+
+        if len(runs):
+            yield runs
+
+
+def _iterate_in_thread(iterable, maxsize = 4):
+    r'''Evaluates an iterable in a separate thread
+
+    Yields the same items as "iterable". The items are computed by a worker
+    thread, so the caller can work on each item while the next one is being
+    computed. Any exception raised by the iterable is re-raised here.
+
+    At most maxsize items are buffered: the worker waits for the caller to
+    catch up. If the caller stops iterating (or raises an exception), the
+    worker stops too, and the thread is joined when this generator is closed.
+    So the caller should close it explicitly, with contextlib.closing() for
+    instance
+
+    '''
+
+    import threading
+    import queue
+
+    q    = queue.Queue(maxsize = maxsize)
+    stop = threading.Event()
+
+    def put(item):
+        # Returns False if the caller has gone away
+        while not stop.is_set():
+            try:
+                q.put(item, timeout = 0.1)
+                return True
+            except queue.Full:
+                pass
+        return False
+
+    def worker():
+        try:
+            for x in iterable:
+                if not put( (x, None, False) ):
+                    return
+        except BaseException as e:
+            put( (None, e, False) )
+            return
+        put( (None, None, True) )
+
+    thread = threading.Thread(target = worker, daemon = True)
+    thread.start()
+
+    try:
+        while True:
+            x,e,done = q.get()
+            if e is not None:
+                raise e
+            if done:
+                break
+            yield x
+    finally:
+        stop.set()
+        thread.join()
+
+
+# The binary corners cache. All values are little-endian. The file is
+#
+#   header
+#   image_point_offsets: uint64 (Nimages+1,). The points of image i are
+#                        [image_point_offsets[i], image_point_offsets[i+1])
+#   filename_offsets:    uint64 (Nimages+1,). Same, for the bytes in "filenames"
+#   x:                   float32 (Npoints,)
+#   y:                   float32 (Npoints,)
+#   extra:               float32 (Npoints,). As in _corners_vnl_runs()
+#   filenames:           the utf-8 filenames, concatenated
+_corners_cache_binary_magic   = b'MRCALCRN'
+_corners_cache_binary_version = 1
+_corners_cache_binary_header_dtype = \
+    np.dtype( [('magic',            'S8'),
+               ('version',          '<u4'),
+               ('Nimages',          '<u4'),
+               ('Npoints',          '<u8'),
+               ('Nfilenames_bytes', '<u8')] )
+
+def _is_corners_cache_binary(path):
+    with open(path, 'rb') as f:
+        return f.read(len(_corners_cache_binary_magic)) == _corners_cache_binary_magic
+
+
+def _read_corners_cache_binary(path):
+    r'''Maps a binary corners cache into memory
+
+    Returns a dict with keys image_point_offsets, filenames, x, y, extra. The
+    numerical arrays are read-only np.memmap objects: nothing is read from disk
+    until it is accessed. "filenames" is a list of strings
+
+    '''
+
+    header = np.fromfile(path, dtype = _corners_cache_binary_header_dtype, count = 1)
+    if len(header) != 1 or header['magic'][0] != _corners_cache_binary_magic:
+        raise Exception(f"'{path}' is not a binary corners cache")
+    header = header[0]
+    if header['version'] != _corners_cache_binary_version:
+        raise Exception(f"'{path}' is a binary corners cache of unsupported version {header['version']}; I only know about version {_corners_cache_binary_version}")
+
+    Nimages = int(header['Nimages'])
+    Npoints = int(header['Npoints'])
+
+    offset = _corners_cache_binary_header_dtype.itemsize
+    def section(dtype, N):
+        nonlocal offset
+        dtype = np.dtype(dtype)
+        if N == 0:
+            # np.memmap() can't map empty arrays
+            a = np.zeros((0,), dtype=dtype)
+        else:
+            a = np.memmap(path, dtype=dtype, mode='r', offset=offset, shape=(N,))
+        offset += N*dtype.itemsize
+        return a
+
+    image_point_offsets = section('<u8', Nimages+1)
+    filename_offsets    = section('<u8', Nimages+1)
+    x                   = section('<f4', Npoints)
+    y                   = section('<f4', Npoints)
+    extra               = section('<f4', Npoints)
+    filenames           = section('u1',  int(header['Nfilenames_bytes']))
+
+    if offset != os.path.getsize(path):
+        raise Exception(f"Binary corners cache '{path}' is truncated or corrupt: expected {offset} bytes, but it has {os.path.getsize(path)}")
+
+    # The offsets index the utf-8 bytes, so I slice first, and then decode
+    filenames = bytes(filenames)
+    filenames = [ filenames[filename_offsets[i]:filename_offsets[i+1]].decode() \
+                  for i in range(Nimages) ]
+    return dict(image_point_offsets = image_point_offsets,
+                filenames           = filenames,
+                x                   = x,
+                y                   = y,
+                extra               = extra)
+
+
+def corners_cache_vnl_to_binary(corners_cache_vnl, corners_cache_binary):
+    r'''Converts a vnlog corners cache to the binary format
+
+SYNOPSIS
+
+    mrcal.corners_cache_vnl_to_binary('corners.vnl', 'corners.bin')
+
+    observations, indices_frame_camera, paths = \
+        mrcal.compute_chessboard_corners(10, 10,
+                                         ('frame*-cam0.jpg','frame*-cam1.jpg'),
+                                         "corners.bin")
+
+mrcal.compute_chessboard_corners() can read its corners cache from a vnlog (what
+mrgingham produces) or from a binary file written by this function. The data is
+the same, but the binary file is mapped into memory, and is used without any
+text parsing. For large caches this is MUCH faster. The coordinates and the
+level/weight column are stored as 32-bit floats: this loses precision below
+~1e-4 pixels, far below the accuracy of any corner detector.
+
+Images with no observations ('filename - - -' rows) are omitted: they wouldn't
+be used in any case.
+
+The binary file stores the corners column-by-column, with a table of per-image
+offsets and a table of filenames. The layout is described in
+mrcal/calibration.py. The filenames are stored as they appear in the vnlog.
+Relative paths are interpreted relative to the directory containing the binary
+file, just as they would be for a vnlog in that directory.
+
+ARGUMENTS
+
+- corners_cache_vnl: the vnlog to read. Either a path or a python file object
+
+- corners_cache_binary: the path of the binary file to write
+
+RETURNED VALUE
+
+None
+
+    '''
+
+    import io
+
+    if isinstance(corners_cache_vnl, io.IOBase):
+        pipe = corners_cache_vnl
+    else:
+        pipe = open(corners_cache_vnl, 'rb')
+
+    filenames           = []
+    image_point_offsets = [0]
+    points              = []
+    try:
+        for runs in _corners_vnl_runs(pipe):
+            for f,p in runs:
+                filenames.append(f.encode())
+                image_point_offsets.append(image_point_offsets[-1] + len(p))
+                points.append(p)
+    finally:
+        if pipe is not corners_cache_vnl:
+            pipe.close()
+
+    # shape (Npoints,3)
+    points = nps.glue(*points, np.zeros((0,3)), axis=-2)
+
+    header = np.zeros((1,), dtype=_corners_cache_binary_header_dtype)
+    header['magic']            = _corners_cache_binary_magic
+    header['version']          = _corners_cache_binary_version
+    header['Nimages']          = len(filenames)
+    header['Npoints']          = len(points)
+    header['Nfilenames_bytes'] = sum(len(f) for f in filenames)
+
+    filename_offsets = np.cumsum([0] + [len(f) for f in filenames])
+
+    with open(corners_cache_binary, 'wb') as f:
+        f.write(header.tobytes())
+        f.write(np.array(image_point_offsets, dtype='<u8').tobytes())
+        f.write(np.array(filename_offsets,    dtype='<u8').tobytes())
+        f.write(np.array(points[:,0],         dtype='<f4').tobytes())
+        f.write(np.array(points[:,1],         dtype='<f4').tobytes())
+        f.write(np.array(points[:,2],         dtype='<f4').tobytes())
+        f.write(b''.join(filenames))
+
+
 def estimate_monocular_calobject_poses_Rt_tocam( indices_frame_camera,
                                                  observations,
                                                  object_spacing,
@@ -480,9 +787,11 @@ We have pixel observations of a known calibration object, and we want to
 estimate the pose of this object in the coordinate system of the camera that
 produced these observations. This function ingests a number of such
 observations, and solves this "PnP problem" separately for each one. The
-observations may come from any lens model; everything is reprojected to a
-pinhole model first. This function is a wrapper around the solvePnP() openCV
-call, which does all the work.
+observations may come from any lens model; everything is unprojected to
+observation vectors first. The poses are then computed by the C library
+(mrcal_estimate_board_poses()): each one is seeded from a homography, and then
+refined to minimize the reprojection error. The observations are processed in
+parallel.
 
 ARGUMENTS
 
@@ -517,104 +826,33 @@ camera coordinate system FROM the calibration object coordinate system.
 
     """
 
-    # I'm given models. I remove the distortion so that I can pass the data
-    # on to solvePnP()
     lensmodels_intrinsics_data = [ m.intrinsics() if type(m) is mrcal.cameramodel else m for m in models_or_intrinsics ]
-    lensmodels      = [di[0] for di in lensmodels_intrinsics_data]
-    intrinsics_data = [di[1] for di in lensmodels_intrinsics_data]
-
-    if not all([mrcal.lensmodel_metadata(m)['has_core'] for m in lensmodels]):
-        raise Exception("this currently works only with models that have an fxfycxcy core. It might not be required. Take a look at the following code if you want to add support")
-
-    fx = [ i[0] for i in intrinsics_data ]
-    fy = [ i[1] for i in intrinsics_data ]
-    cx = [ i[2] for i in intrinsics_data ]
-    cy = [ i[3] for i in intrinsics_data ]
 
     Nobservations = indices_frame_camera.shape[0]
 
-    # Reproject all the observations to a pinhole model
-    observations = observations.copy()
-    for i_observation in range(Nobservations):
-        icam = indices_frame_camera[i_observation,1]
+    # I unproject all the observations of each camera at once. The board poses
+    # are then computed from these observation vectors, so any lens model works
+    v = np.zeros( observations.shape[:-1] + (3,), dtype=float)
+    for icam in np.unique(indices_frame_camera[:,1]):
+        i_observations = indices_frame_camera[:,1] == icam
+        v[i_observations] = \
+            mrcal.unproject(np.ascontiguousarray(observations[i_observations,...,:2]),
+                            *lensmodels_intrinsics_data[icam])
 
-        v = mrcal.unproject(observations[i_observation,...,:2],
-                            lensmodels[icam], intrinsics_data[icam])
-        observations[i_observation,...,:2] = \
-            mrcal.project(v, 'LENSMODEL_PINHOLE',
-                          intrinsics_data[icam][:4])
+    # I pick off those points where the point observation is valid
+    weights = ( (observations[..., 0] >= 0) * \
+                (observations[..., 1] >= 0) * \
+                (observations[..., 2] >= 0) ).astype(float)
 
-    # this wastes memory, but makes it easier to keep track of which data goes
-    # with what
-    Rt_cf_all = np.zeros( (Nobservations, 4, 3), dtype=float)
+    # No calobject_warp. Good-enough for the seeding
+    rt_cf_all = mrcal._mrcal._estimate_board_poses(v, weights,
+                                                   calibration_object_spacing = object_spacing)
 
-    object_height_n,object_width_n = observations.shape[-3:-1]
+    i_failed = np.nonzero(~np.isfinite(rt_cf_all[:,0]))[0]
+    if len(i_failed):
+        raise Exception(f"Couldn't estimate the calibration object pose in observations {list(i_failed)} (indices_frame_camera = {indices_frame_camera[i_failed].tolist()})")
 
-    # No calobject_warp. Good-enough for the seeding
-    full_object = mrcal.ref_calibration_object(object_width_n, object_height_n, object_spacing)
-
-    for i_observation in range(Nobservations):
-
-        icam = indices_frame_camera[i_observation,1]
-        camera_matrix = np.array((( fx[icam], 0,        cx[icam]), \
-                                  ( 0,        fy[icam], cy[icam]), \
-                                  ( 0,        0,          1.)))
-
-        # shape (Nh,Nw,3)
-        d = observations[i_observation, ...]
-
-        # shape (Nh,Nw,6); each row is an x,y,weight pixel observation followed
-        # by the xyz coord of the point in the calibration object
-        d = nps.glue(d, full_object, axis=-1)
-
-        # shape (Nh*Nw,6)
-        d = nps.clump( d, n=2)
-
-        # I pick off those rows where the point observation is valid. Result
-        # should be (N,6) where N <= object_height_n*object_width_n
-        i = (d[..., 0] >= 0) * (d[..., 1] >= 0) * (d[..., 2] >= 0)
-        d = d[i,:]
-
-        # copying because cv2.solvePnP() requires contiguous memory apparently
-        observations_local = np.array(d[:,:2][..., np.newaxis])
-        ref_object         = np.array(d[:,3:][..., np.newaxis])
-        result,rvec,tvec   = cv2.solvePnP(np.array(ref_object),
-                                        np.array(observations_local),
-                                        camera_matrix, None)
-        if not result:
-            raise Exception("solvePnP failed!")
-        if tvec[2] <= 0:
-
-            # The object ended up behind the camera. I flip it, and try to solve
-            # again
-            result,rvec,tvec = cv2.solvePnP(np.array(ref_object),
-                                            np.array(observations_local),
-                                            camera_matrix, None,
-                                            rvec, -tvec,
-                                            useExtrinsicGuess = True)
-            if not result:
-                raise Exception("retried solvePnP failed!")
-            if tvec[2] <= 0:
-                raise Exception("retried solvePnP says that tvec.z <= 0")
-
-
-        Rt_cf = mrcal.Rt_from_rt(nps.glue(rvec.ravel(), tvec.ravel(), axis=-1))
-
-        # visualize the fit
-        # x_cam    = nps.matmult(Rt_cf[:3,:],ref_object)[..., 0] + Rt_cf[3,:]
-        # x_imager = x_cam[...,:2]/x_cam[...,(2,)] * focal + (imagersize-1)/2
-        # import gnuplotlib as gp
-        # gp.plot( (x_imager[:,0],x_imager[:,1], dict(legend='solved')),
-        #          (observations_local[:,0,0],observations_local[:,1,0], dict(legend='observed')),
-        #          square=1,xrange=(0,4000),yrange=(4000,0),
-        #          wait=1)
-        # import IPython
-        # IPython.embed()
-        # sys.exit()
-
-        Rt_cf_all[i_observation, :, :] = Rt_cf
-
-    return Rt_cf_all
+    return mrcal.Rt_from_rt(rt_cf_all)
 
 
 def _estimate_camera_poses( calobject_poses_local_Rt_cf, indices_frame_camera, \
@@ -636,254 +874,30 @@ def _estimate_camera_poses( calobject_poses_local_Rt_cf, indices_frame_camera, \
     indices_frame_camintrinsics_camextrinsics, which mrcal.optimize() expects
     '''
 
-    import heapq
-
-
     object_height_n,object_width_n = observations.shape[-3:-1]
     Ncameras = np.max(indices_frame_camera[:,1]) + 1
 
     # I need to compute an estimate of the pose of each camera in the coordinate
     # system of camera0. This is only possible if there're enough overlapping
     # observations. For instance if camera1 has overlapping observations with
-    # camera2, but neight overlap with camera0, then I can't relate camera1,2 to
-    # camera0. However if camera2 has overlap with camera2, then I can compute
-    # the relative pose of camera2 from its overlapping observations with
-    # camera0. And I can compute the camera1-camera2 pose from its overlapping
-    # data, and then transform to the camera0 coord system using the
+    # camera2, but neither overlap with camera0, then I can't relate camera1,2
+    # to camera0. However if camera2 has overlap with camera0, then I can
+    # compute the relative pose of camera2 from its overlapping observations
+    # with camera0. And I can compute the camera1-camera2 pose from its
+    # overlapping data, and then transform to the camera0 coord system using the
     # previously-computed camera2-camera0 pose
     #
-    # I do this by solving a shortest-path problem using Dijkstra's algorithm to
-    # find a set of pair overlaps between cameras that leads to camera0. I favor
-    # edges with large numbers of shared observed frames
-
-    # list of camera-i to camera-0 transforms. I keep doing stuff until this
-    # list is full of valid data
-    Rt_0c = [None] * (Ncameras-1)
-
-    def compute_pairwise_Rt(icam_to, icam_from):
-
-        # I want to assume that icam_from > icam_to. If it's not true, compute the
-        # opposite transform, and invert
-        if icam_to > icam_from:
-            Rt = compute_pairwise_Rt(icam_from, icam_to)
-            return mrcal.invert_Rt(Rt)
-
-        if icam_to == icam_from:
-            raise Exception("Got icam_to == icam_from ( = {} ). This was probably a mistake".format(icam_to))
-
-        # Now I KNOW that icam_from > icam_to
-
-
-        Nobservations = indices_frame_camera.shape[0]
-
-        # This is a hack. I look at the correspondence of camera0 to camera i for i
-        # in 1:N-1. I ignore all correspondences between cameras i,j if i!=0 and
-        # j!=0. Good enough for now
-        #
-        # No calobject_warp. Good-enough for the seeding
-        full_object = mrcal.ref_calibration_object(object_width_n,object_height_n,
-                                                       object_spacing)
-
-        A = np.array(())
-        B = np.array(())
-
-        # I traverse my observation list, and pick out observations from frames
-        # that had data from both my cameras
-        iframe_last = -1
-        d0  = None
-        d1  = None
-        Rt0 = None
-        Rt1 = None
-        for i_observation in range(Nobservations):
-            iframe_this,icam_this = indices_frame_camera[i_observation, ...]
-            if iframe_this != iframe_last:
-                d0  = None
-                d1  = None
-                Rt0 = None
-                Rt1 = None
-                iframe_last = iframe_this
-
-            # The cameras appear in order. And above I made sure that icam_from >
-            # icam_to, so I take advantage of that here
-            if icam_this == icam_to:
-                if Rt0 is not None:
-                    raise Exception("Saw multiple camera{} observations in frame {}".format(icam_this,
-                                                                                            iframe_this))
-                Rt0 = calobject_poses_local_Rt_cf[i_observation, ...]
-                d0  = observations[i_observation, ..., :2]
-            elif icam_this == icam_from:
-                if Rt0 is None: # have camera1 observation, but not camera0
-                    continue
-
-                if Rt1 is not None:
-                    raise Exception("Saw multiple camera{} observations in frame {}".format(icam_this,
-                                                                                            iframe_this))
-                Rt1 = calobject_poses_local_Rt_cf[i_observation, ...]
-                d1  = observations[i_observation, ..., :2]
-
-
-
-                # d looks at one frame and has shape (object_height_n,object_width_n,7). Each row is
-                #   xy pixel observation in left camera
-                #   xy pixel observation in right camera
-                #   xyz coord of dot in the calibration object coord system
-                d = nps.glue( d0, d1, full_object, axis=-1 )
-
-                # squash dims so that d is (object_height_n*object_width_n,7)
-                d = nps.clump(d, n=2)
-
-                ref_object = nps.clump(full_object, n=2)
-
-                # # It's possible that I could have incomplete views of the
-                # # calibration object, so I pull out only those point
-                # # observations that have a complete view. In reality, I
-                # # currently don't accept any incomplete views, and much outside
-                # # code would need an update to support that. This doesn't hurt, however
-
-                # # d looks at one frame and has shape (10,10,7). Each row is
-                # #   xy pixel observation in left camera
-                # #   xy pixel observation in right camera
-                # #   xyz coord of dot in the calibration object coord system
-                # d = nps.glue( d0, d1, full_object, axis=-1 )
-
-                # # squash dims so that d is (object_height_n*object_width_n,7)
-                # d = nps.transpose(nps.clump(nps.mv(d, -1, -3), n=2))
-
-                # # I pick out those points that have observations in both frames
-                # i = (d[..., 0] >= 0) * (d[..., 1] >= 0) * (d[..., 2] >= 0) * (d[..., 3] >= 0)
-                # d = d[i,:]
-
-                # # ref_object is (N,3)
-                # ref_object = d[:,4:]
-
-                A = nps.glue(A, nps.matmult( ref_object, nps.transpose(Rt0[:3,:])) + Rt0[3,:],
-                             axis = -2)
-                B = nps.glue(B, nps.matmult( ref_object, nps.transpose(Rt1[:3,:])) + Rt1[3,:],
-                             axis = -2)
-
-        return mrcal.align_procrustes_points_Rt01(A, B)
-
-
-    def compute_connectivity_matrix():
-        r'''Returns a connectivity matrix of camera observations
-
-        Returns a symmetric (Ncamera,Ncamera) matrix of integers, where each
-        entry contains the number of frames containing overlapping observations
-        for that pair of cameras
-
-        '''
-
-        camera_connectivity = np.zeros( (Ncameras,Ncameras), dtype=int )
-        def finish_frame(i0, i1):
-            for ic0 in range(i0, i1):
-                for ic1 in range(ic0+1, i1+1):
-                    camera_connectivity[indices_frame_camera[ic0,1], indices_frame_camera[ic1,1]] += 1
-                    camera_connectivity[indices_frame_camera[ic1,1], indices_frame_camera[ic0,1]] += 1
-
-        f_current       = -1
-        i_start_current = -1
-
-        for i in range(len(indices_frame_camera)):
-            f,c = indices_frame_camera[i]
-            if f < f_current:
-                raise Exception("I'm assuming the frame indices are increasing monotonically")
-            if f > f_current:
-                # first camera in this observation
-                f_current = f
-                if i_start_current >= 0:
-                    finish_frame(i_start_current, i-1)
-                i_start_current = i
-        finish_frame(i_start_current, len(indices_frame_camera)-1)
-        return camera_connectivity
-
-
-    shared_frames = compute_connectivity_matrix()
-
-    class Node:
-        def __init__(self, camera_idx):
-            self.camera_idx    = camera_idx
-            self.from_idx      = -1
-            self.cost_to_node  = None
-
-        def __lt__(self, other):
-            return self.cost_to_node < other.cost_to_node
-
-        def visit(self):
-            '''Dijkstra's algorithm'''
-            self.finish()
-
-            for neighbor_idx in range(Ncameras):
-                if neighbor_idx == self.camera_idx                  or \
-                   shared_frames[neighbor_idx,self.camera_idx] == 0:
-                    continue
-                neighbor = nodes[neighbor_idx]
-
-                if neighbor.visited():
-                    continue
-
-                cost_edge = Node.compute_edge_cost(shared_frames[neighbor_idx,self.camera_idx])
-
-                cost_to_neighbor_via_node = self.cost_to_node + cost_edge
-                if not neighbor.seen():
-                    neighbor.cost_to_node = cost_to_neighbor_via_node
-                    neighbor.from_idx     = self.camera_idx
-                    heapq.heappush(heap, neighbor)
-                else:
-                    if cost_to_neighbor_via_node < neighbor.cost_to_node:
-                        neighbor.cost_to_node = cost_to_neighbor_via_node
-                        neighbor.from_idx     = self.camera_idx
-                        heapq.heapify(heap) # is this the most efficient "update" call?
-
-        def finish(self):
-            '''A shortest path was found'''
-            if self.camera_idx == 0:
-                # This is the reference camera. Nothing to do
-                return
-
-            Rt_fc = compute_pairwise_Rt(self.from_idx, self.camera_idx)
-
-            if self.from_idx == 0:
-                Rt_0c[self.camera_idx-1] = Rt_fc
-                return
-
-            Rt_0f = Rt_0c[self.from_idx-1]
-            Rt_0c[self.camera_idx-1] = mrcal.compose_Rt( Rt_0f, Rt_fc)
-
-        def visited(self):
-            '''Returns True if this node went through the heap and has then been visited'''
-            return self.camera_idx == 0 or Rt_0c[self.camera_idx-1] is not None
-
-        def seen(self):
-            '''Returns True if this node has been in the heap'''
-            return self.cost_to_node is not None
-
-        @staticmethod
-        def compute_edge_cost(shared_frames):
-            # I want to MINIMIZE cost, so I MAXIMIZE the shared frames count and
-            # MINIMIZE the hop count. Furthermore, I really want to minimize the
-            # number of hops, so that's worth many shared frames.
-            cost = 100000 - shared_frames
-            assert(cost > 0) # dijkstra's algorithm requires this to be true
-            return cost
-
-
-
-    nodes = [Node(i) for i in range(Ncameras)]
-    nodes[0].cost_to_node = 0
-    heap = []
-
-    nodes[0].visit()
-    while heap:
-        node_top = heapq.heappop(heap)
-        node_top.visit()
-
-    if any([x is None for x in Rt_0c]):
-        raise Exception("ERROR: Don't have complete camera observations overlap!\n" +
-                        ("Past-camera-0 Rt:\n{}\n".format(Rt_0c))                   +
-                        ("Shared observations matrix:\n{}\n".format(shared_frames)))
-
-
-    return np.ascontiguousarray(nps.cat(*Rt_0c))
+    # The C library does this on the covisibility graph of the cameras. The
+    # pairwise poses are chained along the maximum spanning tree (favoring edges
+    # with large numbers of shared observed frames), and then refined using all
+    # the overlapping pairs
+    return \
+        mrcal._mrcal._estimate_camera_poses( np.ascontiguousarray(calobject_poses_local_Rt_cf, dtype=float),
+                                             np.ascontiguousarray(indices_frame_camera,        dtype=np.int32),
+                                             Ncameras                    = int(Ncameras),
+                                             calibration_object_width_n  = object_width_n,
+                                             calibration_object_height_n = object_height_n,
+                                             calibration_object_spacing  = object_spacing)
 
 
 def estimate_joint_frame_poses(calobject_Rt_camera_frame,
@@ -1016,93 +1030,82 @@ system FROM the calibration object coordinate system.
 
     '''
 
-    Rt_ref_cam = mrcal.invert_Rt( extrinsics_Rt_fromref )
-
-
-    def Rt_ref_frame(i_observation0, i_observation1):
-        R'''Given a range of observations corresponding to the same frame, estimate the
-        pose of that frame
-
-        '''
-
-        def Rt_ref_frame__single_observation(i_observation):
-            r'''Transform from the board coords to the reference coords'''
-            iframe,icam = indices_frame_camera[i_observation, ...]
-
-            Rt_cam_frame = calobject_Rt_camera_frame[i_observation, :,:]
-            if icam == 0:
-                return Rt_cam_frame
-
-            return mrcal.compose_Rt( Rt_ref_cam[icam-1, ...], Rt_cam_frame)
-
-
-        # frame poses should map FROM the frame coord system TO the ref coord
-        # system (camera 0).
-
-        # special case: if there's a single observation, I just use it
-        if i_observation1 - i_observation0 == 1:
-            return Rt_ref_frame__single_observation(i_observation0)
-
-        # Multiple cameras have observed the object for this frame. I have an
-        # estimate of these for each camera. I merge them in a lame way: I
-        # average out the positions of each point, and fit the calibration
-        # object into the mean point cloud
-        #
-        # No calobject_warp. Good-enough for the seeding
-        obj = mrcal.ref_calibration_object(object_width_n, object_height_n,
-                                               object_spacing)
-
-        sum_obj_unproj = obj*0
-        for i_observation in range(i_observation0, i_observation1):
-            Rt = Rt_ref_frame__single_observation(i_observation)
-            sum_obj_unproj += mrcal.transform_point_Rt(Rt, obj)
-
-        mean_obj_ref = sum_obj_unproj / (i_observation1 - i_observation0)
-
-        # Got my point cloud. fit
-
-        # transform both to shape = (N*N, 3)
-        obj          = nps.clump(obj,  n=2)
-        mean_obj_ref = nps.clump(mean_obj_ref, n=2)
-        return mrcal.align_procrustes_points_Rt01( mean_obj_ref, obj )
-
-
-
-
-    frames_rt_toref = np.array(())
-
-    iframe_current          = -1
-    i_observation_framestart = -1;
+    Nobservations = indices_frame_camera.shape[0]
+    if Nobservations == 0:
+        return np.zeros((0,6), dtype=float)
+
+    # frame poses should map FROM the frame coord system TO the ref coord
+    # system (camera 0). I compute this for each observation at once. Camera 0
+    # is the reference, so its transform is the identity
+    Rt_ref_cam = nps.glue( mrcal.identity_Rt(),
+                           nps.atleast_dims(mrcal.invert_Rt(extrinsics_Rt_fromref), -3),
+                           axis = -3 )
+    Rt_ref_frame_observation = \
+        mrcal.compose_Rt( Rt_ref_cam[indices_frame_camera[:,1]],
+                          calobject_Rt_camera_frame )
+
+    # I group the observations by frame with a single sort. A stable sort keeps
+    # the observations within each frame in order
+    iframe        = indices_frame_camera[:,0]
+    isort         = np.argsort(iframe, kind='stable')
+    iframe_sorted = iframe[isort]
+    i_observation_framestart = \
+        np.nonzero( nps.glue(np.array((True,)),
+                             iframe_sorted[1:] != iframe_sorted[:-1],
+                             axis=-1) )[0]
+    Nobservations_frame = np.diff( nps.glue(i_observation_framestart,
+                                            np.array((Nobservations,)),
+                                            axis=-1) )
+
+    # Multiple cameras may have observed the object in each frame. I have an
+    # estimate of these for each camera. I merge them in a lame way: I average
+    # out the positions of each point, and fit the calibration object into the
+    # mean point cloud.
+    #
+    # Each transformed point is R p + t, so the mean point cloud is
+    # mean(R) p + mean(t). The Procrustes fit of the calibration object to it
+    # needs only the moments of the calibration object: the mean point cloud
+    # minus its mean is mean(R) (p - mean(p)), so the cross-covariance is
+    # M = mean(R) C where C = sum(outer(p - mean(p), p - mean(p))). This is
+    # identical to fitting the explicit mean point cloud, without ever
+    # computing it
+    #
+    # No calobject_warp. Good-enough for the seeding
+    Rt_mean = \
+        np.add.reduceat(Rt_ref_frame_observation[isort],
+                        i_observation_framestart,
+                        axis = 0) / nps.dummy(Nobservations_frame, -1, -1)
 
-    for i_observation in range(indices_frame_camera.shape[0]):
-        iframe,icam = indices_frame_camera[i_observation, ...]
+    obj        = nps.clump( mrcal.ref_calibration_object(object_width_n, object_height_n,
+                                                         object_spacing),
+                            n = 2)
+    obj_mean   = np.mean(obj, axis=-2)
+    obj_center = obj - obj_mean
+    C          = nps.matmult( nps.transpose(obj_center), obj_center )
 
-        if iframe != iframe_current:
-            if i_observation_framestart >= 0:
-                Rt = Rt_ref_frame(i_observation_framestart,
-                                  i_observation)
-                frames_rt_toref = nps.glue(frames_rt_toref,
-                                           mrcal.rt_from_Rt(Rt),
-                                           axis=-2)
+    Mt = nps.matmult(Rt_mean[...,:3,:], C)
+    V,S,Ut = np.linalg.svd(Mt)
 
-            i_observation_framestart = i_observation
-            iframe_current          = iframe
+    # det(R) is now +1 or -1. If it's -1, then this contains a mirror, and thus
+    # is not a physical rotation. I compensate by negating the least-important
+    # pair of singular vectors
+    V[np.linalg.det(nps.matmult(V, Ut)) < 0, :, 2] *= -1
+    R = nps.matmult(V, Ut)
 
-    if i_observation_framestart >= 0:
-        Rt = Rt_ref_frame(i_observation_framestart,
-                          indices_frame_camera.shape[0])
-        frames_rt_toref = nps.glue(frames_rt_toref,
-                                   mrcal.rt_from_Rt(Rt),
-                                   axis=-2)
+    # t = mean(cloud) - R mean(p)
+    t = \
+        nps.inner(Rt_mean[...,:3,:], obj_mean) + Rt_mean[...,3,:] - \
+        nps.inner(R,                 obj_mean)
 
-    return frames_rt_toref
+    return mrcal.rt_from_Rt( nps.glue(R, nps.dummy(t,-2), axis=-2) )
 
 
 def seed_pinhole( imagersizes,
                   focal_estimate,
                   indices_frame_camera,
                   observations,
-                  object_spacing):
+                  object_spacing,
+                  calobject_poses_local_Rt_cf = None):
     r'''Compute an optimization seed for a camera calibration
 
 SYNOPSIS
@@ -1188,6 +1191,14 @@ ARGUMENTS
   object_height_n,object_width_n arguments, but here we get those from the shape
   of the observations array
 
+- calobject_poses_local_Rt_cf: optional array of shape (Nobservations,4,3),
+  defaulting to None. If given, these are the poses of the calibration object in
+  each observation, in the coordinate system of the observing camera, already
+  computed by mrcal.estimate_monocular_calobject_poses_Rt_tocam() with the
+  pinhole intrinsics described below. This is useful if the caller computed
+  these poses ahead of time, while ingesting the observations. If None, we
+  compute them here
+
 RETURNED VALUES
 
 We return a tuple:
@@ -1232,11 +1243,12 @@ We return a tuple:
     # The result has dimensions (N,4,3)
     intrinsics = [('LENSMODEL_PINHOLE', np.array((focal_estimate,focal_estimate, (imagersize[0]-1.)/2,(imagersize[1]-1.)/2,))) \
                   for imagersize in imagersizes]
-    calobject_poses_local_Rt_cf = \
-        mrcal.estimate_monocular_calobject_poses_Rt_tocam( indices_frame_camera,
-                                                           observations,
-                                                           object_spacing,
-                                                           intrinsics)
+    if calobject_poses_local_Rt_cf is None:
+        calobject_poses_local_Rt_cf = \
+            mrcal.estimate_monocular_calobject_poses_Rt_tocam( indices_frame_camera,
+                                                               observations,
+                                                               object_spacing,
+                                                               intrinsics)
     # these map FROM the coord system of the calibration object TO the coord
     # system of this camera
 
@@ -1245,7 +1257,8 @@ We return a tuple:
     # to their camera. I can move around the two sets of point clouds to try to
     # match them up, and this will give me an estimate of the relative pose of
     # the two cameras in respect to each other. I need to set up the
-    # correspondences, and mrcal.align_procrustes_points_Rt01() does the rest
+    # correspondences, and mrcal_estimate_camera_poses() in the C library does
+    # the rest
     #
     # I get transformations that map points in camera-cami coord system to 0th
     # camera coord system. Rt have dimensions (N-1,4,3)
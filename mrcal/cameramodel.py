@@ -31,6 +31,7 @@ import warnings
 import io
 import copy
 import base64
+import os
 
 import mrcal
 
@@ -239,7 +240,18 @@ future
         base64.b85encode(data_bytes.getvalue())
 
 
-def _deserialize_optimization_inputs(data_bytes):
+# Keys renamed since older models were written: new name -> old name
+_optimization_inputs_legacy_keys = \
+    dict( do_optimize_intrinsics_core        = 'do_optimize_intrinsic_core',
+          do_optimize_intrinsics_distortions = 'do_optimize_intrinsic_distortions')
+# Keys older models stored, but that are no longer used
+_optimization_inputs_obsolete_keys = ('calibration_object_width_n',
+                                      'calibration_object_height_n')
+
+
+def _deserialize_optimization_inputs(data_bytes,
+                                     key     = None,
+                                     decoded = False):
     r'''Convert an ascii string for the optimization-input to a full dict
 
 This is an internal function.
@@ -248,48 +260,317 @@ This is an internal function.
 This is the inverse of _serialize_optimization_inputs(). See the docstring of
 that function for details
 
+The base85 decoding is the slow part. If decoded: data_bytes has already been
+passed through base64.b85decode(); this allows the caller to decode once, and to
+reuse the result. The .npz data is decompressed one array at a time, as the
+arrays are accessed. So if a key is given, we decompress and return only that
+one value
+
     '''
 
-    optimization_inputs_bytes = io.BytesIO(base64.b85decode(data_bytes))
+    if not decoded:
+        data_bytes = base64.b85decode(data_bytes)
 
-    _optimization_inputs = np.load(optimization_inputs_bytes, allow_pickle = False)
+    _optimization_inputs = np.load(io.BytesIO(data_bytes), allow_pickle = False)
 
     # Now I need to post-process my output array. Numpy converts everything
     # to numpy arrays for some reason, even things that aren't numpy arrays.
     # So I find everything that's an array of shape (), and convert it to
     # the actual thing contained in the array
-    optimization_inputs = dict()
-    for k in _optimization_inputs.keys():
+    def get(k):
         arr = _optimization_inputs[k]
         if arr.shape == ():
             arr = arr.item()
         if type(arr) is str and arr == '':
             arr = None
-        optimization_inputs[k] = arr
+        return arr
 
     # for legacy compatibility
-    def renamed(s0, s1, d):
-        if s0 in d and not s1 in d:
-            d[s1] = d[s0]
-            del d[s0]
-    renamed('do_optimize_intrinsic_core',
-            'do_optimize_intrinsics_core',
-            optimization_inputs)
-    renamed('do_optimize_intrinsic_distortions',
-            'do_optimize_intrinsics_distortions',
-            optimization_inputs)
-    # renamed('icam_intrinsics_optimization_inputs',
-    #         'icam_intrinsics',
-    #         optimization_inputs)
-
-    if 'calibration_object_width_n'  in optimization_inputs:
-        del optimization_inputs['calibration_object_width_n' ]
-    if 'calibration_object_height_n' in optimization_inputs:
-        del optimization_inputs['calibration_object_height_n']
+    def stored_key(k):
+        if k not in _optimization_inputs.files and \
+           k in _optimization_inputs_legacy_keys and \
+           _optimization_inputs_legacy_keys[k] in _optimization_inputs.files:
+            return _optimization_inputs_legacy_keys[k]
+        return k
+
+    if key is not None:
+        if key in _optimization_inputs_obsolete_keys or \
+           stored_key(key) not in _optimization_inputs.files:
+            raise KeyError(key)
+        return get(stored_key(key))
+
+    optimization_inputs = dict()
+    for k in _optimization_inputs.files:
+        if k in _optimization_inputs_obsolete_keys:
+            continue
+        optimization_inputs[k] = get(k)
+
+    for k in _optimization_inputs_legacy_keys:
+        if stored_key(k) != k:
+            optimization_inputs[k] = optimization_inputs[stored_key(k)]
+            del optimization_inputs[stored_key(k)]
 
     return optimization_inputs
 
 
+def _serialize_projection_uncertainty_cache(cache):
+    r'''Convert a projection-uncertainty cache to an ascii string
+
+This is an internal function.
+
+The cache is a dict with two arrays:
+
+- istate_ief: the state indices of the intrinsics, extrinsics and frame
+  variables described by the covariance
+
+- Var_ief: the symmetric covariance of those variables. Only its upper triangle
+  is stored, as Var_ief_triu
+
+These are stored with np.savez_compressed(), and encoded with
+base64.b85encode(), just like the optimization_inputs. But unlike the
+optimization_inputs, this has a fixed set of keys, and no non-array values
+
+    '''
+
+    Var_ief = cache['Var_ief']
+    data_bytes = io.BytesIO()
+    np.savez_compressed(data_bytes,
+                        istate_ief   = np.asarray(cache['istate_ief'], dtype=np.int32),
+                        Var_ief_triu = Var_ief[np.triu_indices(Var_ief.shape[0])])
+    return \
+        base64.b85encode(data_bytes.getvalue())
+
+
+def _deserialize_projection_uncertainty_cache(data_bytes):
+    r'''Convert an ascii string for the projection-uncertainty cache to a dict
+
+This is an internal function.
+
+This is the inverse of _serialize_projection_uncertainty_cache(). See the
+docstring of that function for details. Returns None if the data doesn't
+describe a valid cache
+
+    '''
+
+    try:
+        arrays = np.load(io.BytesIO(base64.b85decode(data_bytes)),
+                         allow_pickle = False)
+        istate_ief   = arrays['istate_ief']
+        Var_ief_triu = arrays['Var_ief_triu']
+    except Exception:
+        return None
+
+    N = len(istate_ief)
+    if istate_ief.ndim != 1 or \
+       Var_ief_triu.shape != (N*(N+1)//2,):
+        return None
+
+    Var_ief = np.zeros((N,N), dtype=float)
+    i = np.triu_indices(N)
+    Var_ief[i]   = Var_ief_triu
+    Var_ief.T[i] = Var_ief_triu
+    return dict(istate_ief = istate_ief,
+                Var_ief    = Var_ief)
+
+
+# The binary cameramodel container. This holds the same data as the
+# .cameramodel text files, but the optimization_inputs are stored as raw arrays
+# that can be mapped into memory instead of being decoded. The layout:
+#
+# - The header: _cameramodel_binary_header_dtype
+# - The model itself, in the text format, without the optimization_inputs and
+#   without the projection_uncertainty_cache
+# - The array table: Narrays records of _cameramodel_binary_array_dtype
+# - The arrays. Each one starts at a multiple of _cameramodel_binary_alignment
+#   bytes from the start of the file
+#
+# The optimization_inputs values are stored as arrays named
+# "optimization_inputs/KEY". Non-array values are stored as arrays of shape (),
+# with None stored as '', as in _serialize_optimization_inputs(). The
+# projection_uncertainty_cache is stored as its encoded string, in an array of
+# bytes named "projection_uncertainty_cache"
+_cameramodel_binary_magic     = b'MRCALMDL'
+_cameramodel_binary_version   = 1
+_cameramodel_binary_alignment = 64
+_cameramodel_binary_max_ndim  = 8
+_cameramodel_binary_header_dtype = \
+    np.dtype( [('magic',           'S8'),
+               ('version',         '<u4'),
+               ('Narrays',         '<u4'),
+               ('Ntext_bytes',     '<u8'),
+               ('icam_intrinsics', '<i8')] )
+_cameramodel_binary_array_dtype = \
+    np.dtype( [('name',   'S64'),
+               ('dtype',  'S16'),
+               ('ndim',   '<u4'),
+               ('shape',  '<u8', (_cameramodel_binary_max_ndim,)),
+               ('offset', '<u8')] )
+
+
+def _file_identity(path):
+    r'''Returns a tuple that changes if the given file is modified or replaced
+
+    "path" is a filename or a file descriptor'''
+    st = os.fstat(path) if isinstance(path, int) else os.stat(path)
+    return (st.st_dev, st.st_ino, st.st_size, st.st_mtime_ns)
+
+
+def _is_cameramodel_binary(path):
+    try:
+        with open(path, 'rb') as f:
+            return f.read(len(_cameramodel_binary_magic)) == _cameramodel_binary_magic
+    except:
+        return False
+
+
+def _read_cameramodel_binary(path):
+    r'''Reads the metadata of a binary cameramodel container
+
+    Returns a dict with keys
+
+    - text: the model in the text format, without the optimization_inputs
+    - icam_intrinsics: an integer or None
+    - arrays: a dict mapping each array name to its (dtype,shape,offset)
+    - identity: the _file_identity() of the file we read
+
+    The arrays themselves aren't read here: _map_cameramodel_binary_arrays()
+    does that. Everything is read from one open file, so if the file is
+    replaced while we're reading it, we still see a consistent result
+
+    '''
+
+    with open(path, 'rb') as f:
+        identity = _file_identity(f.fileno())
+        size     = identity[2]
+
+        header = np.frombuffer(f.read(_cameramodel_binary_header_dtype.itemsize),
+                               dtype = _cameramodel_binary_header_dtype)
+        if len(header) != 1 or header['magic'][0] != _cameramodel_binary_magic:
+            raise CameramodelParseException(f"'{path}' is not a binary cameramodel")
+        header = header[0]
+        if header['version'] != _cameramodel_binary_version:
+            raise CameramodelParseException(f"'{path}' is a binary cameramodel of unsupported version {header['version']}; I only know about version {_cameramodel_binary_version}")
+
+        Ntext_bytes = int(header['Ntext_bytes'])
+        Narrays     = int(header['Narrays'])
+
+        text  = f.read(Ntext_bytes)
+        table = np.frombuffer(f.read(Narrays * _cameramodel_binary_array_dtype.itemsize),
+                              dtype = _cameramodel_binary_array_dtype)
+    if len(text) != Ntext_bytes or len(table) != Narrays:
+        raise CameramodelParseException(f"Binary cameramodel '{path}' is truncated")
+
+    arrays = dict()
+    for a in table:
+        dtype = np.dtype(a['dtype'].decode())
+        shape = tuple(int(x) for x in a['shape'][:a['ndim']])
+        if int(a['offset']) + dtype.itemsize * int(np.prod(shape)) > size:
+            raise CameramodelParseException(f"Binary cameramodel '{path}' is truncated or corrupt")
+        arrays[a['name'].decode()] = (dtype, shape, int(a['offset']))
+
+    icam_intrinsics = int(header['icam_intrinsics'])
+    return dict(text            = text.decode(),
+                icam_intrinsics = icam_intrinsics if icam_intrinsics >= 0 else None,
+                arrays          = arrays,
+                identity        = identity)
+
+
+def _map_cameramodel_binary_arrays(path, arrays, names, writeable = True,
+                                   identity = None):
+    r'''Maps the given arrays from a binary cameramodel into memory
+
+    Returns a list of numpy arrays, one for each of the given names. These are
+    views into the file: nothing is read until it is accessed. If writeable,
+    these are copy-on-write views: modifying the arrays doesn't touch the file.
+    Otherwise the arrays are read-only. Each call creates new views
+
+    If identity is given, this is the identity of the file that "arrays" was
+    read from. If the file we open has a different identity, it was replaced
+    in the meantime, and we raise FileNotFoundError
+
+    '''
+
+    import mmap
+    with open(path, 'rb') as f:
+        if identity is not None and _file_identity(f.fileno()) != identity:
+            raise FileNotFoundError(f"Binary cameramodel '{path}' was replaced while it was being read")
+        buf = mmap.mmap(f.fileno(), 0,
+                        access = mmap.ACCESS_COPY if writeable else mmap.ACCESS_READ)
+    result = []
+    for name in names:
+        dtype,shape,offset = arrays[name]
+        result.append( np.frombuffer(buf,
+                                     dtype  = dtype,
+                                     count  = int(np.prod(shape)),
+                                     offset = offset).reshape(shape) )
+    return result
+
+
+def _cameramodel_from_binary(path, binary):
+    r'''Builds a cameramodel from the result of _read_cameramodel_binary()
+
+    Nothing is re-read from the header or the text of the file: the model
+    matches the given metadata, even if the file has been replaced since it was
+    read
+
+    '''
+
+    model = cameramodel.__new__(cameramodel)
+    model._read_binary_into_self(path, binary)
+    return model
+
+
+def _write_cameramodel_binary(f, text, icam_intrinsics, arrays):
+    r'''Writes a binary cameramodel container to an open binary file
+
+    text is the model in the text format, without the optimization_inputs.
+    arrays is a dict of name: numpy array
+
+    '''
+
+    text   = text.encode()
+    names  = list(arrays.keys())
+    # Not np.ascontiguousarray(): that would turn the scalars of shape () into
+    # arrays of shape (1,)
+    arrays = [np.require(arrays[k], requirements = 'C') for k in names]
+    for name,a in zip(names,arrays):
+        if a.dtype.hasobject:
+            raise Exception(f"Can't write '{name}' into a binary cameramodel: it contains python objects")
+        if a.ndim > _cameramodel_binary_max_ndim:
+            raise Exception(f"Can't write '{name}' into a binary cameramodel: it has ndim={a.ndim}, but at most {_cameramodel_binary_max_ndim} are supported")
+        if len(name.encode()) > _cameramodel_binary_array_dtype['name'].itemsize:
+            raise Exception(f"Can't write '{name}' into a binary cameramodel: the name is too long")
+
+    def aligned(x):
+        return (x + _cameramodel_binary_alignment - 1) // _cameramodel_binary_alignment * _cameramodel_binary_alignment
+
+    header = np.zeros((1,), dtype = _cameramodel_binary_header_dtype)
+    header['magic']           = _cameramodel_binary_magic
+    header['version']         = _cameramodel_binary_version
+    header['Narrays']         = len(arrays)
+    header['Ntext_bytes']     = len(text)
+    header['icam_intrinsics'] = icam_intrinsics if icam_intrinsics is not None else -1
+
+    table = np.zeros((len(arrays),), dtype = _cameramodel_binary_array_dtype)
+    offset = aligned(header.nbytes + len(text) + table.nbytes)
+    for i in range(len(arrays)):
+        table['name'  ][i] = names[i].encode()
+        table['dtype' ][i] = arrays[i].dtype.str.encode()
+        table['ndim'  ][i] = arrays[i].ndim
+        table['shape' ][i,:arrays[i].ndim] = arrays[i].shape
+        table['offset'][i] = offset
+        offset = aligned(offset + arrays[i].nbytes)
+
+    f.write(header.tobytes())
+    f.write(text)
+    f.write(table.tobytes())
+    written = header.nbytes + len(text) + table.nbytes
+    for i in range(len(arrays)):
+        f.write(b'\0' * (int(table['offset'][i]) - written))
+        f.write(arrays[i].tobytes())
+        written = int(table['offset'][i]) + arrays[i].nbytes
+
+
 class cameramodel(object):
     r'''A class that describes the lens parameters and geometry of a single camera
 
@@ -404,8 +685,11 @@ A sample valid .cameramodel file:
 
     '''
 
-    def _write(self, f, note=None):
-        r'''Writes out this camera model to an open file'''
+    def _write(self, f, note=None, with_optimization_inputs = True):
+        r'''Writes out this camera model to an open file
+
+        If not with_optimization_inputs, the optimization_inputs and the
+        projection_uncertainty_cache are omitted. The binary writer uses this'''
 
         if note is not None:
             for l in note.splitlines():
@@ -447,7 +731,7 @@ A sample valid .cameramodel file:
             f.write(("    'icam_intrinsics': {:d},\n").format(self._icam_intrinsics))
         f.write("\n")
 
-        if self._optimization_inputs_string is not None:
+        if with_optimization_inputs and self._has_optimization_inputs():
             f.write(r"""    # The optimization inputs contain all the data used to compute this model.
     # This contains ALL the observations for ALL the cameras in the solve. The uses of
     # this are to be able to compute projection uncertainties, to visualize the
@@ -460,11 +744,68 @@ A sample valid .cameramodel file:
     # elsewhere, the original solve can still be used to represent the camera-relative
     # projection uncertainties
 """)
-            f.write(f"    'optimization_inputs': {self._optimization_inputs_string},\n\n")
+            f.write(f"    'optimization_inputs': {self._optimization_inputs_encoded()},\n\n")
+
+            if self._projection_uncertainty_cache_string is not None:
+                f.write(r"""    # A cache of the covariance of the parameters that affect the projection
+    # through this camera. This is computed from the optimization inputs above,
+    # and is stored so that projection uncertainties can be evaluated without
+    # re-solving. It's invalidated along with the optimization inputs
+""")
+                f.write(f"    'projection_uncertainty_cache': {self._projection_uncertainty_cache_string},\n\n")
 
         f.write("}\n")
 
 
+    def _write_binary(self, f, note=None, arrays=None):
+        r'''Writes out this camera model to an open binary file, in the binary format
+
+        arrays is an optional dict of name: numpy array of additional data to
+        store in the file'''
+
+        text = io.StringIO()
+        self._write(text, note, with_optimization_inputs = False)
+
+        arrays = dict(arrays) if arrays is not None else dict()
+        if self._has_optimization_inputs():
+            for k,v in self._optimization_inputs_raw().items():
+                # Same normalization as in _serialize_optimization_inputs()
+                if v is None: v = ''
+                arrays['optimization_inputs/' + k] = np.asarray(v)
+            if self._projection_uncertainty_cache_string is not None:
+                arrays['projection_uncertainty_cache'] = \
+                    np.frombuffer(self._projection_uncertainty_cache_string, dtype=np.uint8)
+
+        _write_cameramodel_binary(f, text.getvalue(),
+                                  self._icam_intrinsics if self._has_optimization_inputs() else None,
+                                  arrays)
+
+
+    def _read_binary_into_self(self, path, binary = None):
+        r'''Reads in a model from a binary cameramodel file
+
+        The optimization_inputs are not read: they're mapped into memory when
+        they're asked for. If binary is given, this is the result of
+        _read_cameramodel_binary(path) that the caller already has'''
+
+        if binary is None:
+            binary = _read_cameramodel_binary(path)
+        self._read_into_self(binary['text'])
+
+        if any(k.startswith('optimization_inputs/') for k in binary['arrays']):
+            if binary['icam_intrinsics'] is None:
+                raise CameramodelParseException(f"Binary cameramodel '{path}' has optimization_inputs, but icam_intrinsics NOT given")
+            self._optimization_inputs_mapped = dict(path     = os.path.abspath(path),
+                                                    arrays   = binary['arrays'],
+                                                    identity = binary['identity'])
+            self._icam_intrinsics = binary['icam_intrinsics']
+            if 'projection_uncertainty_cache' in binary['arrays']:
+                self._projection_uncertainty_cache_string = \
+                    _map_cameramodel_binary_arrays(path, binary['arrays'],
+                                                   ('projection_uncertainty_cache',),
+                                                   identity = binary['identity'])[0].tobytes()
+
+
     def _read_into_self(self, f):
         r'''Reads in a model from an open file, or the model given as a string
 
@@ -482,13 +823,26 @@ A sample valid .cameramodel file:
             s    = f
             name = None
 
-        try:
-            model = ast.literal_eval(s)
-        except:
-            if name is None:
-                raise CameramodelParseException("Failed to parse cameramodel!\n")
-            else:
-                raise CameramodelParseException("Failed to parse cameramodel '{}'\n".format(name))
+        model = None
+
+        # Try the fast C parser first. It only looks at dicts, so I don't call
+        # it on other data (cahvor models, for instance), to avoid spurious
+        # error messages. If it fails for any reason, I fall back to the
+        # python parser, which produces the diagnostics
+        if re.match(r'\s*(#[^\n]*\n\s*)*\{', s):
+            try:
+                model = mrcal._mrcal._read_cameramodel_string(s.encode() if isinstance(s,str) else s)
+            except:
+                model = None
+
+        if model is None:
+            try:
+                model = ast.literal_eval(s)
+            except:
+                if name is None:
+                    raise CameramodelParseException("Failed to parse cameramodel!\n")
+                else:
+                    raise CameramodelParseException("Failed to parse cameramodel '{}'\n".format(name))
 
         # for legacy compatibility
         def renamed(s0, s1, d):
@@ -546,6 +900,8 @@ A sample valid .cameramodel file:
                 raise CameramodelParseException("'optimization_inputs' is given, but it's not a byte string. type(optimization_inputs)={}". \
                                                 format(type(model['optimization_inputs'])))
             self._optimization_inputs_string           = model['optimization_inputs']
+            self._optimization_inputs_decoded          = None
+            self._optimization_inputs_mapped           = None
 
             if 'icam_intrinsics' not in model:
                 raise CameramodelParseException("'optimization_inputs' is given, but icam_intrinsics NOT given")
@@ -554,9 +910,19 @@ A sample valid .cameramodel file:
             if model['icam_intrinsics'] < 0:
                 raise CameramodelParseException("'icam_intrinsics' is given, but it's <0. Must be >= 0")
             self._icam_intrinsics = model['icam_intrinsics']
+
+            self._projection_uncertainty_cache_string = None
+            if 'projection_uncertainty_cache' in model:
+                if not isinstance(model['projection_uncertainty_cache'], bytes):
+                    raise CameramodelParseException("'projection_uncertainty_cache' is given, but it's not a byte string. type(projection_uncertainty_cache)={}". \
+                                                    format(type(model['projection_uncertainty_cache'])))
+                self._projection_uncertainty_cache_string = model['projection_uncertainty_cache']
         else:
             self._optimization_inputs_string          = None
+            self._optimization_inputs_decoded         = None
+            self._optimization_inputs_mapped          = None
             self._icam_intrinsics = None
+            self._projection_uncertainty_cache_string = None
 
     def __init__(self,
 
@@ -707,7 +1073,11 @@ ARGUMENTS
                 self._intrinsics                 = copy.deepcopy(file_or_model._intrinsics)
                 self._valid_intrinsics_region    = copy.deepcopy(mrcal.close_contour(file_or_model._valid_intrinsics_region))
                 self._optimization_inputs_string = copy.deepcopy(file_or_model._optimization_inputs_string)
+                self._optimization_inputs_decoded = file_or_model._optimization_inputs_decoded
+                self._optimization_inputs_mapped  = file_or_model._optimization_inputs_mapped
                 self._icam_intrinsics            = copy.deepcopy(file_or_model._icam_intrinsics)
+                self._projection_uncertainty_cache_string = \
+                    copy.deepcopy(file_or_model._projection_uncertainty_cache_string)
                 return
 
             if type(file_or_model) is str:
@@ -725,6 +1095,10 @@ ARGUMENTS
                     self._read_into_self(modelfile.getvalue())
                     return
 
+                if file_or_model != '-' and _is_cameramodel_binary(file_or_model):
+                    self._read_binary_into_self(file_or_model)
+                    return
+
                 # Some readable file. Read it!
                 def tryread(f):
                     modelstring = f.read()
@@ -828,7 +1202,7 @@ ARGUMENTS
             ')'
 
 
-    def write(self, f, note=None, cahvor=False):
+    def write(self, f, note=None, cahvor=False, binary=False):
         r'''Write out this camera model to disk
 
 SYNOPSIS
@@ -837,7 +1211,18 @@ SYNOPSIS
 
 We write the contents of the given mrcal.cameramodel object to the given
 filename or a given pre-opened file. If the filename is 'xxx.cahvor' or if
-cahvor: we use the legacy cahvor file format for output
+cahvor: we use the legacy cahvor file format for output. If the filename is
+'xxx.cameramodelb' or if binary: we use the binary cameramodel format.
+
+The binary format contains the same data as the text format, but the
+optimization_inputs are stored as raw arrays instead of being compressed and
+encoded as text. This makes the files larger, but much faster to write and to
+read: when reading, the arrays are mapped into memory, and
+optimization_inputs() returns copy-on-write views into the file. This is useful
+for models with large optimization_inputs. The format of a model file is
+detected when reading it, so the two formats can be used interchangeably, and
+converted losslessly into each other by reading and writing a model. The
+binary file must not be modified while a model read from it is in use
 
 ARGUMENTS
 
@@ -850,6 +1235,10 @@ ARGUMENTS
 - cahvor: an optional boolean, defaulting to False. If True: we write out the
   data using the legacy .cahvor file format
 
+- binary: an optional boolean, defaulting to False. If True: we write out the
+  data using the binary cameramodel format. If writing to an opened file, it
+  must have been opened in binary mode
+
 RETURNED VALUES
 
 None
@@ -865,10 +1254,17 @@ None
                 from . import cahvor
                 cahvor.write(f, self, note)
 
+            elif binary or re.match(".*\.cameramodelb$", f):
+                with open(f, 'wb') as openedfile:
+                    self._write_binary( openedfile, note )
+
             else:
                 with open(f, 'w') as openedfile:
                     self._write( openedfile, note )
 
+        elif binary:
+            self._write_binary( f, note )
+
         else:
             self._write( f, note )
 
@@ -984,6 +1380,11 @@ tuple where
         else:
             self._optimization_inputs_string = None
             self._icam_intrinsics            = None
+        self._optimization_inputs_decoded = None
+        self._optimization_inputs_mapped  = None
+
+        # Any cached uncertainty data came from the old optimization inputs
+        self._projection_uncertainty_cache_string = None
 
 
     def _extrinsics_rt(self, toref, rt=None):
@@ -1278,13 +1679,15 @@ If this is a getter (no arguments given), returns a a numpy array of shape
         return True
 
 
-    def optimization_inputs(self):
+    def optimization_inputs(self, key = None):
         r'''Get the original optimization inputs
 
 SYNOPSIS
 
     p,x,j = mrcal.optimizer_callback(**model.optimization_inputs())[:3]
 
+    observations = model.optimization_inputs('observations_board')
+
 This function retrieves the optimization inputs: a dict containing all the data
 that was used to compute the contents of this model. These are the kwargs
 passable to mrcal.optimize() and mrcal.optimizer_callback(), that describe the
@@ -1296,23 +1699,141 @@ together. The optimization inputs aren't a part of the intrinsics per se, but
 modifying any part of the intrinsics invalidates the optimization inputs, so it
 makes sense to set them all together
 
+The optimization inputs are stored encoded, and are decoded only when they're
+first asked for, so reading a model and using it for projection doesn't pay for
+them. The decoded data is kept for subsequent calls. Each call returns a new
+dict, which the caller is free to modify. If only some values are needed, they
+can be requested by key: only the requested arrays are decompressed then.
+
 ARGUMENTS
 
-None
+- key: optional string. If given, we return only optimization_inputs[key],
+  without decompressing the other values. If omitted, we return the full dict
 
 RETURNED VALUE
 
-The optimization_inputs dict, or None if one isn't stored in this model.
+The optimization_inputs dict, or None if one isn't stored in this model. If a
+key was given, we return the one value instead, raising a KeyError if it isn't
+in the optimization_inputs.
         '''
 
-        if self._optimization_inputs_string is None:
+        if not self._has_optimization_inputs():
             return None
-        x = _deserialize_optimization_inputs(self._optimization_inputs_string)
+
+        x = self._optimization_inputs_raw(key)
+        if key is not None:
+            if key == 'extrinsics_rt_fromref' and x is None:
+                x = np.zeros((0,6), dtype=float)
+            return x
+
         if x['extrinsics_rt_fromref'] is None:
             x['extrinsics_rt_fromref'] = np.zeros((0,6), dtype=float)
         return x
 
 
+    def _has_optimization_inputs(self):
+        return \
+            self._optimization_inputs_string is not None or \
+            self._optimization_inputs_mapped is not None
+
+
+    def _optimization_inputs_raw(self, key = None):
+        r'''Returns the stored optimization_inputs, as they were stored
+
+This is an internal function. The caller must make sure we have
+optimization_inputs. If read from a binary model, these are copy-on-write
+views into the file. Otherwise they're decoded from the text representation.
+The decoded data is cached
+
+        '''
+
+        if self._optimization_inputs_mapped is not None:
+            path   = self._optimization_inputs_mapped['path']
+            arrays = self._optimization_inputs_mapped['arrays']
+            prefix = 'optimization_inputs/'
+            # The arrays are mapped from the file when they're asked for, so
+            # the file must not have changed since the model was read
+            try:
+                identity = _file_identity(path)
+            except:
+                identity = None
+            if identity != self._optimization_inputs_mapped['identity']:
+                raise Exception(f"The binary cameramodel '{path}' was modified or removed since this model was read, so its optimization_inputs are no longer available. Read the model again")
+            if key is not None:
+                if prefix + key not in arrays:
+                    raise KeyError(key)
+                keys = [key]
+            else:
+                keys = [k[len(prefix):] for k in arrays if k.startswith(prefix)]
+            values = _map_cameramodel_binary_arrays(path, arrays,
+                                                    [prefix + k for k in keys])
+            # Scalars and None are stored as arrays of shape (); as in
+            # _deserialize_optimization_inputs()
+            def get(arr):
+                if arr.shape == ():
+                    arr = arr.item()
+                if type(arr) is str and arr == '':
+                    arr = None
+                return arr
+            if key is not None:
+                return get(values[0])
+            return { k: get(v) for k,v in zip(keys,values) }
+
+        if self._optimization_inputs_decoded is None:
+            self._optimization_inputs_decoded = \
+                base64.b85decode(self._optimization_inputs_string)
+        return _deserialize_optimization_inputs(self._optimization_inputs_decoded,
+                                                key     = key,
+                                                decoded = True)
+
+
+    def _optimization_inputs_encoded(self):
+        r'''Returns the optimization_inputs in the text representation
+
+This is an internal function. If the optimization_inputs were read from a binary
+model, they are encoded here, and the result is cached
+
+        '''
+
+        if self._optimization_inputs_string is None and \
+           self._optimization_inputs_mapped is not None:
+            self._optimization_inputs_string = \
+                _serialize_optimization_inputs(self._optimization_inputs_raw())
+        return self._optimization_inputs_string
+
+
+    def _projection_uncertainty_cache(self, cache=None):
+        r'''Get or set the cached projection-uncertainty data
+
+This is an internal function, used by mrcal.projection_uncertainty().
+
+Evaluating the projection uncertainty requires the covariance of the
+parameters that affect the projection through this camera. Computing it
+requires re-evaluating the optimization problem described by the
+optimization_inputs, and factoring it. This is slow, so
+mrcal.projection_uncertainty(..., cache=True) stores the result here, and it is
+written to disk with the model. Any change to the optimization inputs (setting
+the intrinsics) invalidates the cache.
+
+If called with cache=None, this is a getter, and we return the cached dict or
+None if nothing valid is cached. Otherwise, this is a setter, and the given dict
+is cached. It must contain the arrays 'istate_ief' and 'Var_ief'. See
+_serialize_projection_uncertainty_cache() for the format
+
+        '''
+
+        if cache is None:
+            if self._projection_uncertainty_cache_string is None:
+                return None
+            return _deserialize_projection_uncertainty_cache(self._projection_uncertainty_cache_string)
+
+        if not self._has_optimization_inputs():
+            raise Exception("This model has no optimization_inputs, so there's nothing to cache")
+
+        self._projection_uncertainty_cache_string = \
+            _serialize_projection_uncertainty_cache(cache)
+
+
     def icam_intrinsics(self):
         r'''Get the camera index indentifying this camera at optimization time
 
@@ -513,6 +513,11 @@ ARGUMENTS
   dtype=np.float32, since the internals of this function are provided by
   cv2.remap()
 
+  Alternately, mapxy may be a tuple (xy, interpolation) containing the map in
+  OpenCV's fixed-point format, as returned by
+  mrcal.stereo_rectify_prepare(fixed_point_maps = True) or by
+  cv2.convertMaps(..., dstmap1type=cv2.CV_16SC2)
+
 RETURNED VALUE
 
 A numpy array of shape (..., Nheight, Nwidth) containing the transformed image.
@@ -521,6 +526,13 @@ A numpy array of shape (..., Nheight, Nwidth) containing the transformed image.
 
     # necessary to avoid opencv crashing
     if not isinstance(image, np.ndarray): raise Exception("'image' must be a numpy array")
+    if isinstance(mapxy, tuple):
+        if len(mapxy) != 2 or \
+           not isinstance(mapxy[0], np.ndarray) or \
+           not isinstance(mapxy[1], np.ndarray):
+            raise Exception("A fixed-point 'mapxy' must be a tuple of two numpy arrays")
+        return cv2.remap(image, mapxy[0], mapxy[1],
+                         cv2.INTER_LINEAR)
     if not isinstance(mapxy, np.ndarray): raise Exception("'mapxy' must be a numpy array")
     return cv2.remap(image, mapxy, None,
                      cv2.INTER_LINEAR)
@@ -157,220 +157,63 @@ report a full Rt transformation with the t component set to 0
 
     # This is very similar in spirit to what compute_Rcorrected_dq_dintrinsics() did
     # (removed in commit 4240260), but that function worked analytically, while this
-    # one explicitly computes the rotation by matching up known vectors.
+    # one explicitly computes the rotation by matching up known vectors. The fit
+    # is done in C by mrcal_implied_Rt10_batch()
 
-    import scipy.optimize
+    return \
+        _implied_Rt10__from_unprojections_batch(q0, p0, nps.dummy(v1, 0),
+                                                None if weights is None else nps.dummy(weights, 0),
+                                                atinfinity,
+                                                focus_center, focus_radius,
+                                                Nthreads = 1)[0]
+
+
+def _implied_Rt10__from_unprojections_batch(q0, p0, v1, weights,
+                                            atinfinity,
+                                            focus_center, focus_radius,
+                                            Nthreads = 0):
+    r'''Fit the implied-by-the-intrinsics transformations for many camera pairs
+
+Same as implied_Rt10__from_unprojections(), but fits Nfits transformations at
+once, all from the same camera 0. v1 has shape (Nfits,Nh,Nw,3) and weights (if
+not None) has shape (Nfits,...,Nh,Nw). The fits are distributed over Nthreads
+threads. Returns an array of shape (Nfits,4,3)
+
+    '''
+
+    Nfits = v1.shape[0]
+    N     = q0.shape[0]*q0.shape[1]
+
+    # The C code wants flat arrays of points: q0 of shape (N,2), p0 of shape
+    # (Nsets,N,3), v1 of shape (Nfits,N,3) and weights of shape (Nfits,Nsets,N).
+    # All the leading dimensions of p0 and weights are collapsed into Nsets
+    p0 = np.array(p0, dtype=float).reshape(-1,    N,3)
+    v1 = np.array(v1, dtype=float).reshape(Nfits, N,3)
+    Nsets = p0.shape[0]
 
     if weights is None:
-        weights = np.ones(p0.shape[:-1], dtype=float)
+        weights = np.ones((Nfits,Nsets,N), dtype=float)
     else:
         # Any inf/nan weight or vector are set to 0
-        weights = weights.copy()
+        weights = np.array(weights, dtype=float).reshape(Nfits,Nsets,N)
         weights[ ~np.isfinite(weights) ] = 0.0
 
-    p0 = p0.copy()
-    v1 = v1.copy()
-
-    # p0 had shape (..., Nh,Nw,3). Collapse all the leading dimensions into one
-    # And do the same for weights
-    p0      = nps.clump(p0,      n = len(p0.shape)     -3)
-    weights = nps.clump(weights, n = len(weights.shape)-2)
-
-    i_nan_p0 = ~np.isfinite(p0)
+    i_nan_p0 = ~np.all(np.isfinite(p0), axis=-1)
     p0[i_nan_p0] = 0.
-    weights[i_nan_p0[...,0]] = 0.0
-    weights[i_nan_p0[...,1]] = 0.0
-    weights[i_nan_p0[...,2]] = 0.0
+    weights[:, i_nan_p0] = 0.0
 
-    i_nan_v1 = ~np.isfinite(v1)
+    i_nan_v1 = ~np.all(np.isfinite(v1), axis=-1)
     v1[i_nan_v1] = 0.
-    weights[..., i_nan_v1[...,0]] = 0.0
-    weights[..., i_nan_v1[...,1]] = 0.0
-    weights[..., i_nan_v1[...,2]] = 0.0
-
-    # We try to match the geometry in a particular region
-    q_off_center = q0 - focus_center
-    i = nps.norm2(q_off_center) < focus_radius*focus_radius
-    if np.count_nonzero(i)<3:
-        raise Exception("Focus region contained too few points")
-
-    p0_cut  = p0     [...,i, :]
-    v1_cut  = v1     [    i, :]
-    weights = weights[...,i   ]
-
-    def residual_jacobian_rt(rt):
-
-        # rtp0 has shape (...,N,3)
-        rtp0, drtp0_drt, _ = \
-            mrcal.transform_point_rt(rt, p0_cut,
-                                     get_gradients = True)
-
-        # inner(a,b)/(mag(a)*mag(b)) = cos(x) ~ 1 - x^2/2
-        # Each of these has shape (...,N)
-        mag_rtp0 = nps.mag(rtp0)
-        inner    = nps.inner(rtp0, v1_cut)
-        th2      = 2.* (1.0 - inner / mag_rtp0)
-        x        = th2 * weights
-
-        # shape (...,N,6)
-        dmag_rtp0_drt = nps.matmult( nps.dummy(rtp0, -2),   # shape (...,N,1,3)
-                                     drtp0_drt              # shape (...,N,3,6)
-                                     # matmult has shape (...,N,1,6)
-                                   )[...,0,:] / \
-                                   nps.dummy(mag_rtp0, -1)  # shape (...,N,1)
-        # shape (..., N,6)
-        dinner_drt    = nps.matmult( nps.dummy(v1_cut, -2), # shape (    N,1,3)
-                                     drtp0_drt              # shape (...,N,3,6)
-                                     # matmult has shape (...,N,1,6)
-                                   )[...,0,:]
-
-        # dth2 = 2 (inner dmag_rtp0 - dinner mag_rtp0)/ mag_rtp0^2
-        # shape (...,N,6)
-        J = 2. * \
-            (nps.dummy(inner,    -1) * dmag_rtp0_drt - \
-             nps.dummy(mag_rtp0, -1) * dinner_drt) / \
-             nps.dummy(mag_rtp0*mag_rtp0, -1) * \
-             nps.dummy(weights,-1)
-        return x.ravel(), nps.clump(J, n=len(J.shape)-1)
-
-
-    def residual_jacobian_r(r):
-
-        # rp0     has shape (N,3)
-        # drp0_dr has shape (N,3,3)
-        rp0, drp0_dr, _ = \
-            mrcal.rotate_point_r(r, p0_cut,
-                                 get_gradients = True)
-
-        # inner(a,b)/(mag(a)*mag(b)) ~ cos(x) ~ 1 - x^2/2
-        # Each of these has shape (N)
-        inner = nps.inner(rp0, v1_cut)
-        th2   = 2.* (1.0 - inner)
-        x     = th2 * weights
-
-        # shape (N,3)
-        dinner_dr = nps.matmult( nps.dummy(v1_cut, -2), # shape (N,1,3)
-                                 drp0_dr                # shape (N,3,3)
-                                 # matmult has shape (N,1,3)
-                               )[:,0,:]
-
-        J = -2. * dinner_dr * nps.dummy(weights,-1)
-        return x, J
-
-
-    cache = {'rt': None}
-    def residual(rt, f):
-        if cache['rt'] is None or not np.array_equal(rt,cache['rt']):
-            cache['rt'] = rt
-            cache['x'],cache['J'] = f(rt)
-        return cache['x']
-    def jacobian(rt, f):
-        if cache['rt'] is None or not np.array_equal(rt,cache['rt']):
-            cache['rt'] = rt
-            cache['x'],cache['J'] = f(rt)
-        return cache['J']
-
-
-    # # gradient check
-    # import gnuplotlib as gp
-    # rt0 = np.random.random(6)*1e-3
-    # x0,J0 = residual_jacobian_rt(rt0)
-    # drt = np.random.random(6)*1e-7
-    # rt1 = rt0+drt
-    # x1,J1 = residual_jacobian_rt(rt1)
-    # dx_theory = nps.matmult(J0, nps.transpose(drt)).ravel()
-    # dx_got    = x1-x0
-    # relerr = (dx_theory-dx_got) / ( (np.abs(dx_theory)+np.abs(dx_got))/2. )
-    # gp.plot(relerr, wait=1, title='rt')
-    # r0 = np.random.random(3)*1e-3
-    # x0,J0 = residual_jacobian_r(r0)
-    # dr = np.random.random(3)*1e-7
-    # r1 = r0+dr
-    # x1,J1 = residual_jacobian_r(r1)
-    # dx_theory = nps.matmult(J0, nps.transpose(dr)).ravel()
-    # dx_got    = x1-x0
-    # relerr = (dx_theory-dx_got) / ( (np.abs(dx_theory)+np.abs(dx_got))/2. )
-    # gp.plot(relerr, wait=1, title='r')
-    # sys.exit()
-
-
-    # I was using loss='soft_l1', but it behaved strangely. For large
-    # f_scale_deg it should be equivalent to loss='linear', but I was seeing
-    # large diffs when comparing a model to itself:
-    #
-    #   ./mrcal-show-projection-diff --gridn 50 28 test/data/cam0.splined.cameramodel{,} --distance 3
-    #
-    # f_scale_deg needs to be > 0.1 to make test-projection-diff.py pass, so
-    # there was an uncomfortably-small usable gap for f_scale_deg. loss='huber'
-    # should work similar-ish to 'soft_l1', and it works even for high
-    # f_scale_deg
-    f_scale_deg = 5
-    loss        = 'huber'
-
-    if atinfinity:
-
-
-        # This is similar to a basic procrustes fit, but here we're using an L1
-        # cost function
-
-        r = np.random.random(3) * 1e-3
-
-        res = scipy.optimize.least_squares(residual,
-                                           r,
-                                           jac=jacobian,
-                                           method='trf',
-
-                                           loss=loss,
-                                           f_scale = (f_scale_deg * np.pi/180.)**2.,
-                                           # max_nfev=1,
-                                           args=(residual_jacobian_r,),
-
-                                           # Without this, the optimization was
-                                           # ending too quickly, and I was
-                                           # seeing not-quite-optimal solutions.
-                                           # Especially for
-                                           # very-nearly-identical rotations.
-                                           # This is tested by diffing the same
-                                           # model in test-projection-diff.py.
-                                           # I'd like to set this to None to
-                                           # disable the comparison entirely,
-                                           # but that requires scipy >= 1.3.0.
-                                           # So instead I set the threshold so
-                                           # low that it's effectively disabled
-                                           gtol = np.finfo(float).eps,
-                                           verbose=0)
-        Rt = np.zeros((4,3), dtype=float)
-        Rt[:3,:] = mrcal.R_from_r(res.x)
-        return Rt
+    weights *= ~nps.dummy(i_nan_v1, -2)
 
-    else:
-
-        rt = np.random.random(6) * 1e-3
-
-        res = scipy.optimize.least_squares(residual,
-                                           rt,
-                                           jac=jacobian,
-                                           method='trf',
-
-                                           loss=loss,
-                                           f_scale = (f_scale_deg * np.pi/180.)**2.,
-                                           # max_nfev=1,
-                                           args=(residual_jacobian_rt,),
-
-                                           # Without this, the optimization was
-                                           # ending too quickly, and I was
-                                           # seeing not-quite-optimal solutions.
-                                           # Especially for
-                                           # very-nearly-identical rotations.
-                                           # This is tested by diffing the same
-                                           # model in test-projection-diff.py.
-                                           # I'd like to set this to None to
-                                           # disable the comparison entirely,
-                                           # but that requires scipy >= 1.3.0.
-                                           # So instead I set the threshold so
-                                           # low that it's effectively disabled
-                                           gtol = np.finfo(float).eps )
-        return mrcal.Rt_from_rt(res.x)
+    return \
+        mrcal._mrcal._implied_Rt10(np.ascontiguousarray(nps.clump(q0, n=2), dtype=float),
+                                   p0, v1,
+                                   weights      = weights,
+                                   atinfinity   = atinfinity,
+                                   focus_center = np.array(focus_center, dtype=float).ravel(),
+                                   focus_radius = float(focus_radius),
+                                   Nthreads     = Nthreads)
 
 
 def worst_direction_stdev(cov):
@@ -442,297 +285,13 @@ broadcasting
     return np.sqrt((a+c)/2 + np.sqrt( (a-c)*(a-c)/4 + b*b))
 
 
-def _projection_uncertainty_make_output( factorization, Jpacked, dq_dpief_packed,
-                                         Nmeasurements_observations,
-                                         observed_pixel_uncertainty, what ):
-    r'''Helper for projection uncertainty functions
-
-    The given factorization uses the packed, unitless state: p*.
-
-    The given Jpacked uses the packed, unitless state: p*. Jpacked applies to
-    all observations. The leading Nmeasurements_observations rows apply to the
-    observations of the calibration object, and we use just those for the input
-    noise propagation. if Nmeasurements_observations is None: assume that ALL
-    the measurements come from the calibration object observations; a simplifed
-    expression can be used in this case
-
-    The given dq_dpief_packed uses the packed, unitless state p*, so it already
-    includes the multiplication by D in the expressions below. It's sparse, but
-    stored densely, so it already includes the multiplication by S
-
-    The uncertainty computation in
-    http://mrcal.secretsauce.net/uncertainty.html concludes that
-
-      Var(p*) = observed_pixel_uncertainty^2 inv(J*tJ*) J*[observations]t J*[observations] inv(J*tJ*)
-
-    where p* and J* are the UNITLESS state and the jacobian respectively.
-
-    In the special case where all the measurements come from
-    observations, this simplifies to
-
-      Var(p*) = observed_pixel_uncertainty^2 inv(J*tJ*)
-
-    My factorization is of packed (scaled, unitless) flavors of J (J*). So
-
-      Var(p) = D Var(p*) D
-
-    I want Var(q) = dq/dp[ief] Var(p[ief]) dq/dp[ief]t. Let S = [I 0] where the
-    specific nonzero locations specify the locations of [ief]:
-
-      Var(p[ief]) = S Var(p) St
-
-    So
-
-      Var(q) = dq/dp[ief] S D Var(p*) D St dq/dp[ief]t
-
-    In the regularized case I have
-
-      Var(q) = dq/dp[ief] S D inv(J*tJ*) J*[observations]t J*[observations] inv(J*tJ*) D St dq/dp[ief]t observed_pixel_uncertainty^2
-
-    It is far more efficient to compute inv(J*tJ*) D St dq/dp[ief]t than
-    inv(J*tJ*) J*[observations]t: there's far less to compute, and the matrices
-    are far smaller. Thus I don't compute the covariances directly.
-
-    In the non-regularized case:
-
-      Var(q) = dq/dp[ief] S D inv(J*tJ*) D St dq/dp[ief]t
-
-      1. solve( J*tJ*, D St dq/dp[ief]t)
-         The result has shape (Nstate,2)
-
-      2. pre-multiply by dq/dp[ief] S D
-
-      3. multiply by observed_pixel_uncertainty^2
-
-    In the regularized case:
-
-      Var(q) = dq/dp[ief] S D inv(J*tJ*) J*[observations]t J*[observations] inv(J*tJ*) D St dq/dp[ief]t
-
-      1. solve( J*tJ*, D St dq/dp[ief]t)
-         The result has shape (Nstate,2)
-
-      2. Pre-multiply by J*[observations]
-         The result has shape (Nmeasurements_observations,2)
-
-      3. Compute the sum of the outer products of each row
-
-      4. multiply by observed_pixel_uncertainty^2
-
-    '''
-
-    # shape (2,Nstate)
-    A = factorization.solve_xt_JtJ_bt( dq_dpief_packed )
-    if Nmeasurements_observations is not None:
-        # I have regularization. Use the more complicated expression
-
-        # I see no python way to do matrix multiplication with sparse matrices,
-        # so I have my own routine in C. AND the C routine does the outer
-        # product, so there's no big temporary expression. It's much faster
-        Var_dq = mrcal._mrcal_npsp._A_Jt_J_At(A, Jpacked.indptr, Jpacked.indices, Jpacked.data,
-                                                     Nleading_rows_J = Nmeasurements_observations)
-    else:
-        # No regularization. Use the simplified expression
-        Var_dq = nps.matmult(dq_dpief_packed, nps.transpose(A))
-
-    if what == 'covariance':           return Var_dq * observed_pixel_uncertainty*observed_pixel_uncertainty
-    if what == 'worstdirection-stdev': return worst_direction_stdev(Var_dq) * observed_pixel_uncertainty
-    if what == 'rms-stdev':            return np.sqrt(nps.trace(Var_dq)/2.) * observed_pixel_uncertainty
-    else: raise Exception("Shouldn't have gotten here. There's a bug")
-
-
-def _projection_uncertainty( p_cam,
-                             lensmodel, intrinsics_data,
-                             extrinsics_rt_fromref, frames_rt_toref,
-                             factorization, Jpacked, optimization_inputs,
-                             istate_intrinsics, istate_extrinsics, istate_frames,
-                             slice_optimized_intrinsics,
-                             Nmeasurements_observations,
-                             observed_pixel_uncertainty,
-                             what):
-    r'''Helper for projection_uncertainty()
-
-    See docs for _projection_uncertainty_make_output() and
-    projection_uncertainty()
-
-    This function does all the work when observing points with a finite range
-
-    '''
-
-    Nstate = Jpacked.shape[-1]
-    dq_dpief = np.zeros(p_cam.shape[:-1] + (2,Nstate), dtype=float)
-
-    if frames_rt_toref is not None:
-        Nframes = len(frames_rt_toref)
-
-    if extrinsics_rt_fromref is not None:
-        p_ref = \
-            mrcal.transform_point_rt( mrcal.invert_rt(extrinsics_rt_fromref),
-                                      p_cam )
-    else:
-        p_ref = p_cam
-
-    if frames_rt_toref is not None:
-        # The point in the coord system of all the frames. I index the frames on
-        # axis -2
-        p_frames = mrcal.transform_point_rt( mrcal.invert_rt(frames_rt_toref),
-                                             nps.dummy(p_ref,-2) )
-
-        # I now have the observed point represented in the coordinate system of the
-        # frames. This is indendent of any intrinsics-implied rotation, or anything
-        # of the sort. I project this point back to pixels, through noisy estimates
-        # of the frames, extrinsics and intrinsics.
-        #
-        # I transform each frame-represented point back to the reference coordinate
-        # system, and I average out each estimate to get the one p_ref I will use. I
-        # already have p_ref, so I don't actually need to compute the value; I just
-        # need the gradients
-
-        # dprefallframes_dframes has shape (..., Nframes,3,6)
-        _, \
-        dprefallframes_dframes, \
-        _ = mrcal.transform_point_rt( frames_rt_toref, p_frames,
-                                      get_gradients = True)
-
-        # shape (..., 3,6*Nframes)
-        # /Nframes because I compute the mean over all the frames
-        dpref_dframes = nps.clump( nps.mv(dprefallframes_dframes, -3, -2),
-                                   n = -2 ) / Nframes
-
-    _, dq_dpcam, dq_dintrinsics = \
-        mrcal.project( p_cam, lensmodel, intrinsics_data,
-                       get_gradients = True)
-
-    if istate_intrinsics is not None:
-        dq_dintrinsics_optimized = dq_dintrinsics[..., slice_optimized_intrinsics]
-        Nintrinsics = dq_dintrinsics_optimized.shape[-1]
-        dq_dpief[..., istate_intrinsics:istate_intrinsics+Nintrinsics] = \
-            dq_dintrinsics_optimized
-
-    if extrinsics_rt_fromref is not None:
-        _, dpcam_drt, dpcam_dpref = \
-            mrcal.transform_point_rt(extrinsics_rt_fromref, p_ref,
-                                     get_gradients = True)
-
-        dq_dpief[..., istate_extrinsics:istate_extrinsics+6] = \
-            nps.matmult(dq_dpcam, dpcam_drt)
-
-        if frames_rt_toref is not None:
-            dq_dpief[..., istate_frames:istate_frames+Nframes*6] = \
-                nps.matmult(dq_dpcam, dpcam_dpref, dpref_dframes)
-    else:
-        if frames_rt_toref is not None:
-            dq_dpief[..., istate_frames:istate_frames+Nframes*6] = \
-                nps.matmult(dq_dpcam, dpref_dframes)
-
-    # Make dq_dpief use the packed state. I call "unpack_state" because the
-    # state is in the denominator
-    mrcal.unpack_state(dq_dpief, **optimization_inputs)
-    return \
-        _projection_uncertainty_make_output( factorization, Jpacked,
-                                             dq_dpief, Nmeasurements_observations,
-                                             observed_pixel_uncertainty,
-                                             what)
-
-
-def _projection_uncertainty_rotationonly( p_cam,
-                                          lensmodel, intrinsics_data,
-                                          extrinsics_rt_fromref, frames_rt_toref,
-                                          factorization, Jpacked, optimization_inputs,
-                                          istate_intrinsics, istate_extrinsics, istate_frames,
-                                          slice_optimized_intrinsics,
-                                          Nmeasurements_observations,
-                                          observed_pixel_uncertainty,
-                                          what):
-    r'''Helper for projection_uncertainty()
-
-    See docs for _projection_uncertainty_make_output() and
-    projection_uncertainty()
-
-    This function does all the work when observing points at infinity
-
-    '''
-
-    Nstate = Jpacked.shape[-1]
-    dq_dpief = np.zeros(p_cam.shape[:-1] + (2,Nstate), dtype=float)
-
-    if frames_rt_toref is not None:
-        Nframes = len(frames_rt_toref)
-
-    if extrinsics_rt_fromref is not None:
-        p_ref = \
-            mrcal.rotate_point_r( -extrinsics_rt_fromref[..., :3], p_cam )
-    else:
-        p_ref = p_cam
-
-    if frames_rt_toref is not None:
-        # The point in the coord system of all the frames. I index the frames on
-        # axis -2
-        p_frames = mrcal.rotate_point_r( -frames_rt_toref[...,:3],
-                                         nps.dummy(p_ref,-2) )
-
-        # I now have the observed point represented in the coordinate system of the
-        # frames. This is indendent of any intrinsics-implied rotation, or anything
-        # of the sort. I project this point back to pixels, through noisy estimates
-        # of the frames, extrinsics and intrinsics.
-        #
-        # I transform each frame-represented point back to the reference coordinate
-        # system, and I average out each estimate to get the one p_ref I will use. I
-        # already have p_ref, so I don't actually need to compute the value; I just
-        # need the gradients
-
-        # dprefallframes_dframesr has shape (..., Nframes,3,3)
-        _, \
-        dprefallframes_dframesr, \
-        _ = mrcal.rotate_point_r( frames_rt_toref[...,:3], p_frames,
-                                  get_gradients = True)
-
-    _, dq_dpcam, dq_dintrinsics = \
-        mrcal.project( p_cam, lensmodel, intrinsics_data,
-                       get_gradients = True)
-
-    if istate_intrinsics is not None:
-        dq_dintrinsics_optimized = dq_dintrinsics[..., slice_optimized_intrinsics]
-        Nintrinsics = dq_dintrinsics_optimized.shape[-1]
-        dq_dpief[..., istate_intrinsics:istate_intrinsics+Nintrinsics] = \
-            dq_dintrinsics_optimized
-
-    if extrinsics_rt_fromref is not None:
-        _, dpcam_dr, dpcam_dpref = \
-            mrcal.rotate_point_r(extrinsics_rt_fromref[...,:3], p_ref,
-                                 get_gradients = True)
-        dq_dpief[..., istate_extrinsics:istate_extrinsics+3] = \
-            nps.matmult(dq_dpcam, dpcam_dr)
-
-        if frames_rt_toref is not None:
-
-            dq_dpref = nps.matmult(dq_dpcam, dpcam_dpref)
-
-            # dprefallframes_dframesr has shape (..., Nframes,3,3)
-            for i in range(Nframes):
-                dq_dpief[..., istate_frames+6*i:istate_frames+6*i+3] = \
-                    nps.matmult(dq_dpref, dprefallframes_dframesr[...,i,:,:]) / Nframes
-    else:
-        if frames_rt_toref is not None:
-            # dprefallframes_dframesr has shape (..., Nframes,3,3)
-            for i in range(Nframes):
-                dq_dpief[..., istate_frames+6*i:istate_frames+6*i+3] = \
-                    nps.matmult(dq_dpcam, dprefallframes_dframesr[...,i,:,:]) / Nframes
-
-    # Make dq_dpief use the packed state. I call "unpack_state" because the
-    # state is in the denominator
-    mrcal.unpack_state(dq_dpief, **optimization_inputs)
-    return \
-        _projection_uncertainty_make_output( factorization, Jpacked,
-                                             dq_dpief, Nmeasurements_observations,
-                                             observed_pixel_uncertainty,
-                                             what)
-
-
 def projection_uncertainty( p_cam, model,
                             atinfinity = False,
 
                             # what we're reporting
-                            what = 'covariance'):
+                            what = 'covariance',
+                            Nthreads = 0,
+                            cache    = False):
     r'''Compute the projection uncertainty of a camera-referenced point
 
 This is the interface to the uncertainty computations described in
@@ -841,6 +400,19 @@ broadcasts on p_cam only. We accept
   - 'rms-stdev':            return the RMS of the worst and best direction
                             standard deviations
 
+- Nthreads: optional integer, defaults to 0. The points are processed in
+  chunks, and the chunks are distributed among this many threads. <= 0 means
+  "use all the available cores". The result does not depend on this
+
+- cache: optional boolean, defaults to False. The uncertainty computation needs
+  the covariance of the intrinsics, extrinsics and frame poses. If the model
+  contains a valid cached covariance (because it was computed with cache=True
+  earlier, possibly in another process that then wrote the model to disk), we
+  use it, and no solves are needed. Otherwise, if cache: we compute the full
+  covariance, and store it in the model; it will be written to disk with it.
+  This is worth it if the model will be queried many times. If not cache: we
+  compute only what's needed for the given points, and the model isn't touched
+
 RETURN VALUE
 
 A numpy array of uncertainties. If p_cam has shape (..., 3) then:
@@ -921,13 +493,7 @@ else:                    we return an array of shape (...)
         raise Exception("optimization_inputs are unavailable in this model. Uncertainty cannot be computed")
 
     if not optimization_inputs.get('do_optimize_extrinsics'):
-        raise Exception("Computing uncertainty if !do_optimize_extrinsics not supported currently. This is possible, but not implemented. _projection_uncertainty...() would need a path for fixed extrinsics like they already do for fixed frames")
-
-    Jpacked,factorization = \
-        mrcal.optimizer_callback( **optimization_inputs )[2:]
-
-    if factorization is None:
-        raise Exception("Cannot compute the uncertainty: factorization computation failed")
+        raise Exception("Computing uncertainty if !do_optimize_extrinsics not supported currently. This is possible, but not implemented. mrcal_projection_uncertainty() would need a path for fixed extrinsics like it already has for fixed frames")
 
     # The intrinsics,extrinsics,frames MUST come from the solve when
     # evaluating the uncertainties. The user is allowed to update the
@@ -945,23 +511,25 @@ else:                    we return an array of shape (...)
 
     if not optimization_inputs.get('do_optimize_intrinsics_core') and \
        not optimization_inputs.get('do_optimize_intrinsics_distortions'):
-        istate_intrinsics          = None
-        slice_optimized_intrinsics = None
+        istate_intrinsics     = -1
+        i_intrinsics0         = 0
+        Nintrinsics_optimized = 0
     else:
         istate_intrinsics = mrcal.state_index_intrinsics(icam_intrinsics, **optimization_inputs)
 
-        i0,i1 = None,None # everything by default
-
         has_core     = mrcal.lensmodel_metadata(lensmodel)['has_core']
         Ncore        = 4 if has_core else 0
-        Ndistortions = mrcal.lensmodel_num_params(lensmodel) - Ncore
+        Nintrinsics  = mrcal.lensmodel_num_params(lensmodel)
+        Ndistortions = Nintrinsics - Ncore
 
+        # everything by default
+        i_intrinsics0         = 0
+        Nintrinsics_optimized = Nintrinsics
         if not optimization_inputs.get('do_optimize_intrinsics_core'):
-            i0 = Ncore
+            i_intrinsics0          = Ncore
+            Nintrinsics_optimized -= Ncore
         if not optimization_inputs.get('do_optimize_intrinsics_distortions'):
-            i1 = -Ndistortions
-
-        slice_optimized_intrinsics  = slice(i0,i1)
+            Nintrinsics_optimized -= Ndistortions
 
     try:
         istate_frames = mrcal.state_index_frames(0, **optimization_inputs)
@@ -970,47 +538,360 @@ else:                    we return an array of shape (...)
 
     if icam_extrinsics < 0:
         extrinsics_rt_fromref = None
-        istate_extrinsics     = None
+        istate_extrinsics     = -1
     else:
         extrinsics_rt_fromref = optimization_inputs['extrinsics_rt_fromref'][icam_extrinsics]
         istate_extrinsics     = mrcal.state_index_extrinsics (icam_extrinsics, **optimization_inputs)
 
     frames_rt_toref = None
-    if optimization_inputs.get('do_optimize_frames'):
+    if optimization_inputs.get('do_optimize_frames') and \
+       istate_frames is not None and istate_frames >= 0:
         frames_rt_toref = optimization_inputs.get('frames_rt_toref')
+    if frames_rt_toref is None:
+        istate_frames = -1
+
+    observed_pixel_uncertainty = optimization_inputs['observed_pixel_uncertainty']
+
+    # The state variables that affect the projection. This matches the layout
+    # in mrcal_projection_uncertainty_state_indices(). I cache the covariance
+    # of the full poses; atinfinity uses the rotation subset of it
+    istate_ief = [ np.arange(istate_intrinsics, istate_intrinsics+Nintrinsics_optimized) ] \
+                 if istate_intrinsics >= 0 else []
+    if istate_extrinsics >= 0:
+        istate_ief.append( np.arange(istate_extrinsics, istate_extrinsics+6) )
+    if istate_frames >= 0:
+        istate_ief.append( np.arange(istate_frames, istate_frames + 6*len(frames_rt_toref)) )
+    istate_ief = np.hstack(istate_ief).astype(np.int32) if len(istate_ief) else \
+                 np.zeros((0,), dtype=np.int32)
+
+    Var_ief = _projection_uncertainty_Var_ief(model, optimization_inputs, istate_ief,
+                                              compute  = cache,
+                                              Nthreads = Nthreads)
+
+    if Var_ief is not None:
+        if atinfinity:
+            # Only the intrinsics and the rotation parts of the poses
+            irotation = np.ones((len(istate_ief),), dtype=bool)
+            irotation[Nintrinsics_optimized:] = \
+                ((np.arange(len(istate_ief) - Nintrinsics_optimized)) % 6) < 3
+            Var_ief = Var_ief[irotation][:,irotation]
+        Var_ief = np.ascontiguousarray(Var_ief)
+
+        # Var_ief is expressed in the unpacked state, so no state scaling is
+        # needed, and I don't need the factorization
+        factorization              = None
+        Jp,Ji,Jx                   = None,None,None
+        Nmeasurements_observations = -1
+        state_scale                = None
+    else:
+        Jpacked,factorization = \
+            mrcal.optimizer_callback( **optimization_inputs )[2:]
+
+        if factorization is None:
+            raise Exception("Cannot compute the uncertainty: factorization computation failed")
+
+        Nmeasurements_observations = mrcal.num_measurements_boards(**optimization_inputs)
+        if Nmeasurements_observations == mrcal.num_measurements(**optimization_inputs):
+            # Note the special-case where I'm using all the observations. A
+            # simplified expression can be used in this case, and I don't need J
+            Nmeasurements_observations = -1
+            Jp,Ji,Jx                   = None,None,None
+        else:
+            Jp = np.ascontiguousarray(Jpacked.indptr,  dtype=np.int32)
+            Ji = np.ascontiguousarray(Jpacked.indices, dtype=np.int32)
+            Jx = np.ascontiguousarray(Jpacked.data,    dtype=float)
+
+        # The scaling of each state variable. The uncertainty computation works
+        # in the packed, unitless state, so the gradients must be scaled by
+        # this. I call "unpack_state" because the state is in the denominator
+        state_scale = np.ones( (Jpacked.shape[-1],), dtype=float)
+        mrcal.unpack_state(state_scale, **optimization_inputs)
+
+    def contiguous_or_none(x):
+        if x is None: return None
+        return np.ascontiguousarray(x, dtype=float)
+
+    # The heavy lifting is in C: it computes the gradients, and either
+    # evaluates the quadratic form with Var_ief or solves against the
+    # factorization for each point, in parallel. If atinfinity, all
+    # translations are ignored
+    return \
+        mrcal._mrcal._projection_uncertainty(
+            p_cam                      = np.ascontiguousarray(p_cam, dtype=float),
+            lensmodel                  = lensmodel,
+            intrinsics                 = contiguous_or_none(intrinsics_data),
+            extrinsics_rt_fromref      = contiguous_or_none(extrinsics_rt_fromref),
+            frames_rt_toref            = contiguous_or_none(frames_rt_toref),
+            factorization              = factorization,
+            Jp                         = Jp,
+            Ji                         = Ji,
+            Jx                         = Jx,
+            Nmeasurements_observations = Nmeasurements_observations,
+            state_scale                = state_scale,
+            istate_intrinsics          = istate_intrinsics,
+            i_intrinsics0              = i_intrinsics0,
+            Nintrinsics_optimized      = Nintrinsics_optimized,
+            istate_extrinsics          = istate_extrinsics,
+            istate_frames              = istate_frames,
+            observed_pixel_uncertainty = observed_pixel_uncertainty,
+            atinfinity                 = bool(atinfinity),
+            what                       = what,
+            Var_ief                    = Var_ief,
+            Nthreads                   = Nthreads)
+
+
+def _projection_uncertainty_Var_ief(model, optimization_inputs, istate_ief,
+                                    compute  = False,
+                                    Nthreads = 0):
+    r'''Helper for projection_uncertainty()
+
+    Returns the covariance of the state variables istate_ief, in the unpacked
+    state, due to the observation noise only, without the
+    observed_pixel_uncertainty^2 factor. This is a block of inv(JtJ) at the
+    optimum, corrected for regularization.
 
+    If the model has a valid cached result, that is returned immediately.
+    Otherwise, if not compute, we return None. If compute, we compute the
+    covariance, and store it in the model's cache. This is expensive: we need
+    to re-evaluate the optimization problem, factor JtJ, and compute all the
+    blocks of its inverse
+
+    '''
+
+    cache = model._projection_uncertainty_cache()
+    if cache is not None and \
+       np.array_equal(cache['istate_ief'], istate_ief):
+        return cache['Var_ief']
+    if not compute:
+        return None
+
+    Jpacked,factorization = \
+        mrcal.optimizer_callback( **optimization_inputs )[2:]
+
+    if factorization is None:
+        raise Exception("Cannot compute the uncertainty: factorization computation failed")
 
     Nmeasurements_observations = mrcal.num_measurements_boards(**optimization_inputs)
     if Nmeasurements_observations == mrcal.num_measurements(**optimization_inputs):
-        # Note the special-case where I'm using all the observations
-        Nmeasurements_observations = None
+        # Note the special-case where I'm using all the observations. A
+        # simplified expression can be used in this case, and I don't need J
+        Var_ief_packed = factorization.selected_inverse(istate_ief,
+                                                        Nthreads = Nthreads)
+    else:
+        Var_ief_packed = \
+            factorization.selected_inverse(istate_ief,
+                                           Nmeasurements_observations = Nmeasurements_observations,
+                                           Jp = np.ascontiguousarray(Jpacked.indptr,  dtype=np.int32),
+                                           Ji = np.ascontiguousarray(Jpacked.indices, dtype=np.int32),
+                                           Jx = np.ascontiguousarray(Jpacked.data,    dtype=float),
+                                           Nthreads = Nthreads)
+
+    # The factorization uses the packed, unitless state. I convert to the
+    # unpacked state: Var(p) = D Var(p*) D. I call "unpack_state" because the
+    # state is in the denominator
+    state_scale = np.ones( (Jpacked.shape[-1],), dtype=float)
+    mrcal.unpack_state(state_scale, **optimization_inputs)
+    scale   = state_scale[istate_ief]
+    Var_ief = Var_ief_packed * nps.outer(scale, scale)
 
-    observed_pixel_uncertainty = optimization_inputs['observed_pixel_uncertainty']
+    model._projection_uncertainty_cache( dict(istate_ief = istate_ief,
+                                              Var_ief    = Var_ief) )
+    return Var_ief
 
-    # Two distinct paths here that are very similar, but different-enough to not
-    # share any code. If atinfinity, I ignore all translations
-    if not atinfinity:
-        return \
-            _projection_uncertainty(p_cam,
-                                    lensmodel, intrinsics_data,
-                                    extrinsics_rt_fromref, frames_rt_toref,
-                                    factorization, Jpacked, optimization_inputs,
-                                    istate_intrinsics, istate_extrinsics, istate_frames,
-                                    slice_optimized_intrinsics,
-                                    Nmeasurements_observations,
-                                    observed_pixel_uncertainty,
-                                    what)
-    else:
-        return \
-            _projection_uncertainty_rotationonly(p_cam,
-                                                 lensmodel, intrinsics_data,
-                                                 extrinsics_rt_fromref, frames_rt_toref,
-                                                 factorization, Jpacked, optimization_inputs,
-                                                 istate_intrinsics, istate_extrinsics, istate_frames,
-                                                 slice_optimized_intrinsics,
-                                                 Nmeasurements_observations,
-                                                 observed_pixel_uncertainty,
-                                                 what)
+
+def projection_uncertainty_montecarlo( p_cam, model,
+                                       Nsamples   = 100,
+                                       atinfinity = False,
+
+                                       # what we're reporting
+                                       what       = 'covariance',
+                                       Nthreads   = 0):
+    r'''Empirically compute the projection uncertainty of a camera-referenced point
+
+SYNOPSIS
+
+    model = mrcal.cameramodel("xxx.cameramodel")
+
+    q        = np.array((123., 443.))
+    distance = 10.0
+
+    pcam = distance * mrcal.unproject(q, *model.intrinsics(), normalize=True)
+
+    print(mrcal.projection_uncertainty_montecarlo(pcam,
+                                                  model    = model,
+                                                  Nsamples = 200,
+                                                  what     = 'worstdirection-stdev'))
+    ===> 0.5
+
+    print(mrcal.projection_uncertainty(pcam,
+                                       model = model,
+                                       what  = 'worstdirection-stdev'))
+    ===> 0.5
+
+This is an empirical counterpart to mrcal.projection_uncertainty(). Instead of
+propagating the expected input noise through the linearized optimization
+problem, we simulate it: we perturb the calibration-object observations in the
+model's optimization_inputs with gaussian noise of the model's
+observed_pixel_uncertainty, re-solve each perturbed problem, and reproject the
+query points through each perturbed solution. The returned statistics describe
+the spread of the resulting pixel coordinates.
+
+This is what test-projection-uncertainty.py does to validate the analytical
+uncertainty computation. It is useful to run the same check in production, to
+make sure that the linearization assumptions made by projection_uncertainty()
+hold for a particular calibration.
+
+Each sample is warm-started from the solution stored in the model, so the
+solves converge quickly. All the samples are solved in parallel with
+mrcal.optimize_batch(). The noise is generated using numpy's global random
+number generator, so call np.random.seed() for reproducible results.
+
+The perturbed point is reprojected in the same way that projection_uncertainty()
+linearizes it: the query point is transformed into the coordinate system of
+each calibration object pose, and the mean of the perturbed reference-frame
+representations is projected through the perturbed extrinsics and intrinsics.
+The outliers in the solution are kept fixed: outlier rejection is disabled in
+the perturbed solves.
+
+ARGUMENTS
+
+- p_cam: a numpy array of shape (..., 3). This is the set of camera-coordinate
+  points where we're querying uncertainty. if not atinfinity: then the full 3D
+  coordinates of p_cam are significant, even distance to the camera. if
+  atinfinity: the distance to the camera is ignored.
+
+- model: a mrcal.cameramodel object containing the optimization_inputs used to
+  compute it
+
+- Nsamples: optional integer, defaults to 100. How many perturbed problems to
+  solve. The error in the estimated covariance decreases as 1/sqrt(Nsamples)
+
+- atinfinity: optional boolean, defaults to False. If True, we want to know the
+  projection uncertainty, looking at a point infinitely-far away. We ignore all
+  the translation components of the poses
+
+- what: optional string, defaults to 'covariance'. This chooses what kind of
+  output we want. The known options are the same as in
+  projection_uncertainty():
+
+  - 'covariance':           return a full (2,2) covariance matrix Var(q) for
+                            each p_cam
+  - 'worstdirection-stdev': return the worst-direction standard deviation for
+                            each p_cam
+
+  - 'rms-stdev':            return the RMS of the worst and best direction
+                            standard deviations
+
+- Nthreads: optional integer specifying how many threads to use for the solves.
+  If omitted or <= 0, we use all the available cores
+
+RETURN VALUE
+
+A numpy array of uncertainties. If p_cam has shape (..., 3) then:
+
+if what == 'covariance': we return an array of shape (..., 2,2)
+else:                    we return an array of shape (...)
+
+    '''
+
+    what_known = set(('covariance', 'worstdirection-stdev', 'rms-stdev'))
+    if not what in what_known:
+        raise Exception(f"'what' kwarg must be in {what_known}, but got '{what}'")
+
+    lensmodel = model.intrinsics()[0]
+
+    optimization_inputs = model.optimization_inputs()
+    if optimization_inputs is None:
+        raise Exception("optimization_inputs are unavailable in this model. Uncertainty cannot be computed")
+
+    observed_pixel_uncertainty = optimization_inputs.get('observed_pixel_uncertainty')
+    if observed_pixel_uncertainty is None or observed_pixel_uncertainty <= 0:
+        raise Exception("optimization_inputs don't contain a valid observed_pixel_uncertainty. Uncertainty cannot be computed")
+
+    observations_board = optimization_inputs.get('observations_board')
+    if observations_board is None or observations_board.size == 0:
+        raise Exception("optimization_inputs have no chessboard observations to perturb. Uncertainty cannot be computed")
+
+    icam_intrinsics = model.icam_intrinsics()
+    icam_extrinsics = mrcal.corresponding_icam_extrinsics(icam_intrinsics, **optimization_inputs)
+
+    do_optimize_frames = optimization_inputs.get('do_optimize_frames', True)
+
+    # The noise. Each observation has weight w: its stdev is
+    # observed_pixel_uncertainty/w. Outliers (w <= 0) are left alone
+    weight = observations_board[...,2]
+    sigma  = np.zeros(weight.shape, dtype=float)
+    i      = weight > 0
+    sigma[i] = observed_pixel_uncertainty / weight[i]
+
+    problems = []
+    for isample in range(Nsamples):
+        # Each sample gets its own copies of the arrays that the solver writes
+        # to. The solution in the model is the seed
+        problem = dict(optimization_inputs)
+        for k in ('intrinsics', 'extrinsics_rt_fromref', 'frames_rt_toref',
+                  'points', 'calobject_warp'):
+            if problem.get(k) is not None:
+                problem[k] = np.array(problem[k])
+
+        problem['observations_board'] = np.array(observations_board)
+        problem['observations_board'][...,:2] += \
+            np.random.randn(*weight.shape, 2) * nps.dummy(sigma, -1)
+
+        problem['do_apply_outlier_rejection'] = False
+        problem['verbose']                    = False
+        problems.append(problem)
+
+    stats = mrcal.optimize_batch(problems, Nthreads = Nthreads)
+    if any(s is None for s in stats):
+        raise Exception("Some of the perturbed problems failed to solve")
+
+    def transform(rt, p, inverted = False):
+        if atinfinity:
+            return mrcal.rotate_point_r   (rt[...,:3], p, inverted = inverted)
+        else:
+            return mrcal.transform_point_rt(rt, p, inverted = inverted)
+
+    def extrinsics(optimization_inputs):
+        if icam_extrinsics < 0: return None
+        return optimization_inputs['extrinsics_rt_fromref'][icam_extrinsics]
+
+    extrinsics_baseline = extrinsics(optimization_inputs)
+    if extrinsics_baseline is None: p_ref = p_cam
+    else:                           p_ref = transform(extrinsics_baseline, p_cam, inverted = True)
+
+    if do_optimize_frames:
+        # shape (..., Nframes, 3). The point in the coord system of all the
+        # frames
+        p_frames = transform(optimization_inputs['frames_rt_toref'],
+                             nps.dummy(p_ref,-2),
+                             inverted = True)
+
+    # shape (Nsamples, ..., 2)
+    q = np.zeros((Nsamples,) + p_cam.shape[:-1] + (2,), dtype=float)
+    for isample in range(Nsamples):
+        problem = problems[isample]
+
+        if do_optimize_frames:
+            p_ref_sample = np.mean( transform(problem['frames_rt_toref'], p_frames),
+                                    axis = -2 )
+        else:
+            p_ref_sample = p_ref
+
+        rt_cam_ref = extrinsics(problem)
+        if rt_cam_ref is None: p_cam_sample = p_ref_sample
+        else:                  p_cam_sample = transform(rt_cam_ref, p_ref_sample)
+
+        q[isample] = mrcal.project(p_cam_sample, lensmodel,
+                                   problem['intrinsics'][icam_intrinsics])
+
+    dq = q - np.mean(q, axis=0)
+    Var_dq = np.mean(nps.outer(dq,dq), axis=0)
+
+    if what == 'covariance':           return Var_dq
+    if what == 'worstdirection-stdev': return worst_direction_stdev(Var_dq)
+    if what == 'rms-stdev':            return np.sqrt(nps.trace(Var_dq)/2.)
+    else: raise Exception("Shouldn't have gotten here. There's a bug")
 
 
 def projection_diff(models,
@@ -1022,7 +903,8 @@ def projection_diff(models,
                     use_uncertainties= True,
                     focus_center     = None,
                     focus_radius     = -1.,
-                    implied_Rt10     = None):
+                    implied_Rt10     = None,
+                    Nthreads         = 0):
     r'''Compute the difference in projection between N models
 
 SYNOPSIS
@@ -1055,7 +937,9 @@ produces a visualization.
 In the most common case we're given exactly 2 models to compare, and we compute
 the differences in projection of each point. If we're given more than 2 models,
 we instead compute the standard deviation of the differences between models 1..N
-and model0.
+and model0. The differences between each model and model0 are returned also.
+Comparing many models is efficient: the imager is sampled once, the models are
+unprojected and the implied transformations are fitted in parallel, in C.
 
 We do this:
 
@@ -1172,6 +1056,10 @@ ARGUMENTS
   instead of fitting it. If omitted, I compute the transformation. Exclusive
   with focus_center, focus_radius. Valid only if exactly two models are given.
 
+- Nthreads: optional integer, defaulting to 0. How many threads to use for the
+  unprojections and the fits of the implied transformations. <= 0 means "use
+  all the available cores"
+
 RETURNED VALUE
 
 A tuple
@@ -1182,8 +1070,10 @@ A tuple
   len(models)==2: this is nps.mag(diff)
 
 - diff: a numpy array of shape (gridn_height,gridn_width,2) containing the
-  vector of differences at each cell. If len(models)>2 this isn't defined, so
-  None is returned
+  vector of differences at each cell. If len(models)>2 this is an array of shape
+  (len(models)-1,gridn_height,gridn_width,2), with slice i containing the
+  differences between model i+1 and model 0. If multiple distances were given,
+  each cell contains the difference at the best-fitting distance
 
 - q0: a numpy array of shape (gridn_height,gridn_width,2) containing the pixel
   coordinates of each grid cell
@@ -1223,12 +1113,18 @@ A tuple
     lensmodels      = [model.intrinsics()[0] for model in models]
     intrinsics_data = [model.intrinsics()[1] for model in models]
 
-    # v  shape (Ncameras,Nheight,Nwidth,3)
+    # The imager is sampled once, and each model unprojects the same grid in
+    # parallel. This is equivalent to mrcal.sample_imager_unproject()
+    #
     # q0 shape (         Nheight,Nwidth,2)
-    v,q0 = mrcal.sample_imager_unproject(gridn_width, gridn_height,
-                                         W, H,
-                                         lensmodels, intrinsics_data,
-                                         normalize = True)
+    # v  shape (Ncameras,Nheight,Nwidth,3)
+    q0 = mrcal.sample_imager(gridn_width, gridn_height, W, H)
+    v  = nps.cat(*[ mrcal._mrcal._unproject_batch(q0,
+                                                  lensmodels[i],
+                                                  np.ascontiguousarray(intrinsics_data[i], dtype=float),
+                                                  Nthreads = Nthreads) \
+                    for i in range(len(models)) ])
+    v /= nps.dummy(nps.mag(v), -1)
 
     if focus_radius == 0:
         use_uncertainties = False
@@ -1284,12 +1180,13 @@ A tuple
             # clean those up, as well as any inf/nan in v (from failed
             # unprojections)
             implied_Rt10 = \
-                implied_Rt10__from_unprojections(q0,
-                                                 v[0,...] * distance,
-                                                 v[1,...],
-                                                 weights,
-                                                 atinfinity,
-                                                 focus_center, focus_radius)
+                _implied_Rt10__from_unprojections_batch(q0,
+                                                        v[0,...] * distance,
+                                                        v[1:2,...],
+                                                        None if weights is None else nps.dummy(weights, 0),
+                                                        atinfinity,
+                                                        focus_center, focus_radius,
+                                                        Nthreads = Nthreads)[0]
 
         q1 = mrcal.project( mrcal.transform_point_Rt(implied_Rt10,
                                                      v[0,...] * distance),
@@ -1302,44 +1199,39 @@ A tuple
         difflen = np.min( difflen, axis=-3)
     else:
 
-        # Many models. Look at the stdev
-        def get_implied_Rt10( i0, i1,
-                              focus_center, focus_radius):
-            v0 = v[i0,...]
-            v1 = v[i1,...]
-
-            if focus_radius == 0:
-                return mrcal.identity_Rt()
-
+        # Many models. All the transformations are from camera 0, so they're
+        # fitted together
+        if focus_radius == 0:
+            implied_Rt10 = np.tile(mrcal.identity_Rt(), (len(models)-1,1,1))
+        else:
             if uncertainties is not None:
-                weights = 1.0 / (uncertainties[i0]*uncertainties[i1])
+                # shape (Ncameras-1,len(distance),Nh,Nw)
+                weights = 1.0 / (uncertainties[0]*nps.cat(*uncertainties[1:]))
             else:
                 weights = None
-
-            return \
-                implied_Rt10__from_unprojections(q0, v0*distance, v1,
-                                                 weights, atinfinity,
-                                                 focus_center, focus_radius)
-        def get_reprojections(q0, implied_Rt10,
-                              lensmodel, intrinsics_data):
-            q1 = mrcal.project(mrcal.transform_point_Rt(implied_Rt10,
-                                                        v[0,...]*distance),
-                               lensmodel, intrinsics_data)
-            # returning shape (len(distance),Nheight,Nwidth,2)
-            return nps.atleast_dims(q1, -4)
-
-        implied_Rt10 = nps.cat(*[ get_implied_Rt10(0,i,
-                                                   focus_center, focus_radius) \
-                                  for i in range(1,len(v))])
+            implied_Rt10 = \
+                _implied_Rt10__from_unprojections_batch(q0,
+                                                        v[0,...] * distance,
+                                                        v[1:,...],
+                                                        weights,
+                                                        atinfinity,
+                                                        focus_center, focus_radius,
+                                                        Nthreads = Nthreads)
 
         # shape (Ncameras-1,len(distance),Nheight,Nwidth,2)
-        grids = nps.cat(*[get_reprojections(q0, implied_Rt10[i-1],
-                                            lensmodels[i], intrinsics_data[i]) \
-                          for i in range(1,len(v))])
-
-        diff    = None
-        difflen = np.sqrt(np.mean( np.min(nps.norm2(grids-q0),
-                                          axis=-3),
+        grids = nps.cat(*[ nps.atleast_dims( mrcal.project(mrcal.transform_point_Rt(implied_Rt10[i-1],
+                                                                                    v[0,...]*distance),
+                                                           lensmodels[i], intrinsics_data[i]),
+                                             -4) \
+                           for i in range(1,len(models))])
+
+        # The diffs at the best-fitting distance. shape (Ncameras-1,Nheight,Nwidth,2)
+        diff = grids - q0
+        idistance = np.argmin(nps.norm2(diff), axis=-3)
+        diff = np.take_along_axis(diff,
+                                  nps.dummy(nps.dummy(idistance, -3), -1),
+                                  axis=-4)[...,0,:,:,:]
+        difflen = np.sqrt(np.mean( nps.norm2(diff),
                                    axis=0))
 
     return difflen, diff, q0, implied_Rt10
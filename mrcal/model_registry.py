@@ -0,0 +1,354 @@
+#!/usr/bin/python3
+
+'''A registry of camera models shared between processes
+
+SYNOPSIS
+
+    # In each worker process
+    registry = mrcal.cameramodel_registry()
+
+    def precompute(model):
+        W,H = model.imagersize()
+        q   = np.ascontiguousarray( nps.mv( nps.cat(*np.meshgrid(np.arange(W),
+                                                                 np.arange(H))),
+                                            0,-1), dtype=float)
+        return dict( mask_valid = mrcal.is_within_valid_intrinsics_region(q, model) )
+
+    model, arrays = registry.load('left', 'left.cameramodel',
+                                  compute_arrays = precompute)
+
+All functions are exported into the mrcal module. So you can call these via
+mrcal.model_registry.fff() or mrcal.fff(). The latter is preferred.
+
+'''
+
+import numpy as np
+import os
+import re
+import tempfile
+import fcntl
+import mrcal
+
+from .cameramodel import \
+    _file_identity,                 \
+    _read_cameramodel_binary,       \
+    _map_cameramodel_binary_arrays, \
+    _cameramodel_from_binary
+
+
+class cameramodel_registry(object):
+    r'''A registry of camera models, shared between processes
+
+SYNOPSIS
+
+    registry = mrcal.cameramodel_registry()
+
+    # Reads 'left.cameramodel' and calls compute_arrays() if this is the first
+    # process to ask for 'left', or if the file has changed since it was
+    # published. Otherwise simply maps the published data
+    model, arrays = registry.load('left', 'left.cameramodel',
+                                  compute_arrays = lambda model: \
+                                    dict(mapxy = mrcal.image_transformation_map(model, model_pinhole)))
+
+    image_pinhole = mrcal.transform_image(image, arrays['mapxy'])
+
+Services with many worker processes often have each worker load the same
+models, and compute the same data derived from them: reprojection maps, masks
+of the valid-intrinsics region, etc. This class allows this work to be done
+once. The first process publishes a model and its derived arrays into shared
+memory, and the other processes attach to it by name.
+
+Each registry entry is a binary cameramodel file (see the docs for
+mrcal.cameramodel.write()) with the derived arrays stored alongside the model.
+The entries live in a directory in shared memory: /dev/shm if it exists. When
+attaching, the arrays are mapped into memory read-only. All processes share the
+same physical pages, so attaching is cheap regardless of the size of the data.
+
+Entries loaded from a file record the identity of that file (inode, size,
+modification time). load() compares the identity against the file on disk, and
+republishes if they differ. Each process also caches the entries it has
+attached, so a load() of an unchanged entry costs two stat() calls. Publishing
+replaces the entry atomically, so a process never sees a partially-written
+entry. Arrays obtained before a republish remain valid: they keep referring to
+the old data. The optimization_inputs of an attached model are mapped from the
+entry when asked for, so they are unavailable after the entry was replaced.
+
+The registry is just a directory of files, so there's nothing to start or stop.
+Entries persist until they are removed with remove(), or until the machine
+reboots.
+
+    '''
+
+    def __init__(self, directory = None):
+        r'''Opens a registry of camera models
+
+SYNOPSIS
+
+    registry = mrcal.cameramodel_registry()
+
+All the processes that use the same directory share the same registry. The
+directory is created if it doesn't exist.
+
+ARGUMENTS
+
+- directory: optional path to the directory that contains the registry. If
+  omitted, we use a per-user directory in /dev/shm, if that exists, or in the
+  temporary directory otherwise
+
+        '''
+
+        if directory is None:
+            root = '/dev/shm' if os.path.isdir('/dev/shm') else tempfile.gettempdir()
+            directory = os.path.join(root, f"mrcal-cameramodel-registry-{os.getuid()}")
+        os.makedirs(directory, mode = 0o700, exist_ok = True)
+        self._directory = directory
+
+        # The entries this process has attached: name -> (identity of the entry
+        # file, model, arrays)
+        self._attached = dict()
+        # The identity of the source file of each entry attached by load()
+        self._attached_source = dict()
+
+
+    def _path(self, name):
+        if not re.match(r'[A-Za-z0-9_.+-]+$', name) or name[0] == '.':
+            raise Exception(f"Invalid registry entry name '{name}'. Names may contain only letters, numbers and the characters _.+- and may not start with '.'")
+        return os.path.join(self._directory, name + '.cameramodelb')
+
+
+    def publish(self, name, model, arrays = None, source = None):
+        r'''Publishes a camera model and its derived arrays into the registry
+
+SYNOPSIS
+
+    registry.publish('left', model,
+                     arrays = dict(mapxy = mapxy))
+
+Stores the given model and arrays under the given name, replacing any existing
+entry with that name. The entry is replaced atomically: processes attaching at
+the same time see either the old or the new entry. load() calls this function
+as needed; call it directly to publish models that don't come from a file.
+
+ARGUMENTS
+
+- name: the name of the entry. May contain only letters, numbers and the
+  characters _.+-
+
+- model: the mrcal.cameramodel object to store
+
+- arrays: optional dict of string: numpy array. The derived data to store with
+  the model. The arrays must contain plain data, not python objects
+
+- source: optional filename. If given, the identity of this file is stored in
+  the entry, and load() republishes the entry if this file has changed
+
+RETURNED VALUE
+
+None
+
+        '''
+
+        path = self._path(name)
+
+        arrays_write = dict()
+        if arrays is not None:
+            for k,v in arrays.items():
+                arrays_write['registry/arrays/' + k] = np.asarray(v)
+        if source is not None:
+            arrays_write['registry/source_identity'] = \
+                np.array(_file_identity(source), dtype=np.int64)
+
+        fd,path_tmp = tempfile.mkstemp(dir    = self._directory,
+                                       prefix = '.' + name + '.',
+                                       suffix = '.tmp')
+        try:
+            with os.fdopen(fd, 'wb') as f:
+                model._write_binary(f, arrays = arrays_write)
+            os.replace(path_tmp, path)
+        except:
+            os.unlink(path_tmp)
+            raise
+
+
+    def attach(self, name):
+        r'''Attaches to a published camera model
+
+SYNOPSIS
+
+    model, arrays = registry.attach('left')
+
+Returns the model and arrays most recently published under the given name. The
+arrays are read-only views of the shared data. If this process has already
+attached to this entry, and it hasn't been republished since, the cached
+objects are returned. Raises an exception if no such entry exists.
+
+ARGUMENTS
+
+- name: the name of the entry
+
+RETURNED VALUE
+
+A tuple (model, arrays):
+
+- model: the mrcal.cameramodel object. This is shared by all the callers of
+  attach() in this process, so it should not be modified. Make a copy with
+  mrcal.cameramodel(model) if needed
+
+- arrays: a dict of string: numpy array. The read-only derived arrays that were
+  published with the model
+
+        '''
+
+        path = self._path(name)
+        identity = _file_identity(path)
+
+        attached = self._attached.get(name)
+        if attached is not None and attached[0] == identity:
+            return attached[1],attached[2]
+
+        # The model and the arrays must come from the same entry. If the entry
+        # is republished while I'm reading it, I try again
+        prefix = 'registry/arrays/'
+        while True:
+            entry = _read_cameramodel_binary(path)
+            names = [k for k in entry['arrays'] if k.startswith(prefix)]
+            try:
+                model  = _cameramodel_from_binary(path, entry)
+                arrays = dict( zip( [k[len(prefix):] for k in names],
+                                    _map_cameramodel_binary_arrays(path, entry['arrays'], names,
+                                                                   writeable = False,
+                                                                   identity  = entry['identity']) ) )
+            except FileNotFoundError:
+                continue
+            break
+
+        self._attached[name] = (entry['identity'], model, arrays)
+        return model,arrays
+
+
+    def is_current(self, name, source):
+        r'''Reports whether a registry entry is up-to-date with its source file
+
+SYNOPSIS
+
+    if not registry.is_current('left', 'left.cameramodel'):
+        ....
+
+ARGUMENTS
+
+- name: the name of the entry
+
+- source: the filename of the model the entry was loaded from
+
+RETURNED VALUE
+
+True if the entry exists, and was published from the given file in its current
+state. False otherwise
+
+        '''
+
+        try:
+            entry = _read_cameramodel_binary(self._path(name))
+        except:
+            return False
+        if 'registry/source_identity' not in entry['arrays']:
+            return False
+        identity = _map_cameramodel_binary_arrays(self._path(name), entry['arrays'],
+                                                  ('registry/source_identity',),
+                                                  writeable = False)[0]
+        try:
+            return tuple(int(x) for x in identity) == _file_identity(source)
+        except:
+            return False
+
+
+    def load(self, name, filename, compute_arrays = None):
+        r'''Attaches to a camera model, publishing it first if needed
+
+SYNOPSIS
+
+    model, arrays = registry.load('left', 'left.cameramodel',
+                                  compute_arrays = lambda model: \
+                                    dict(mapxy = mrcal.image_transformation_map(model, model_pinhole)))
+
+If the entry with the given name was published from the given file, and the
+file hasn't changed since, we simply attach to it. Otherwise we read the file,
+call compute_arrays(model), publish the results, and attach to them. If several
+processes do this at the same time, only one of them does the work: the others
+wait for it, and then attach.
+
+ARGUMENTS
+
+- name: the name of the entry
+
+- filename: the model file to read. Any format that mrcal.cameramodel() can read
+  is accepted
+
+- compute_arrays: optional function that takes the mrcal.cameramodel that was
+  read, and returns a dict of string: numpy array. These are the derived arrays
+  published with the model. If omitted, only the model is published
+
+RETURNED VALUE
+
+A tuple (model, arrays), as returned by attach()
+
+        '''
+
+        path = self._path(name)
+
+        # The cheap path: this process has attached to this entry already, and
+        # nothing changed since
+        attached = self._attached.get(name)
+        if attached is not None:
+            try:
+                if attached[0] == _file_identity(path) and \
+                   self._attached_source.get(name) == _file_identity(filename):
+                    return attached[1],attached[2]
+            except FileNotFoundError:
+                pass
+
+        if not self.is_current(name, filename):
+            with open(path + '.lock', 'w') as lock:
+                fcntl.flock(lock, fcntl.LOCK_EX)
+                # Somebody else may have published the entry while I was
+                # waiting for the lock
+                if not self.is_current(name, filename):
+                    model = mrcal.cameramodel(filename)
+                    arrays = compute_arrays(model) if compute_arrays is not None else None
+                    self.publish(name, model, arrays, source = filename)
+
+        result = self.attach(name)
+        self._attached_source[name] = _file_identity(filename)
+        return result
+
+
+    def remove(self, name):
+        r'''Removes a camera model from the registry
+
+SYNOPSIS
+
+    registry.remove('left')
+
+Processes that have attached to this entry keep their model and arrays. Does
+nothing if no such entry exists. The lock file used by load() is left alone:
+another process may be holding the lock
+
+ARGUMENTS
+
+- name: the name of the entry
+
+RETURNED VALUE
+
+None
+
+        '''
+
+        # I never remove the lock file. Another process could be holding a lock
+        # on it, and if I unlinked it, the next load() would lock a new file,
+        # and the two would no longer exclude each other
+        try:
+            os.unlink(self._path(name))
+        except FileNotFoundError:
+            pass
+        self._attached.pop(name, None)
+        self._attached_source.pop(name, None)
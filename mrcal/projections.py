@@ -13,8 +13,6 @@ mrcal.projections.fff() or mrcal.fff(). The latter is preferred.
 
 import numpy as np
 import numpysane as nps
-import sys
-import scipy.optimize
 
 import mrcal
 
@@ -123,9 +121,9 @@ https://github.com/opencv/opencv/issues/8811
 
 Broadcasting is fully supported across q and intrinsics_data.
 
-Models that have no gradients available cannot use mrcal_unproject() in C, but
-CAN still use this mrcal.unproject() Python routine: a slower routine is
-employed that uses numerical differences instead of analytical gradients.
+LENSMODEL_CAHVORE unprojection is more expensive than the others, so when
+unprojecting with a single set of CAHVORE intrinsics, the points are split among
+several threads.
 
 ARGUMENTS
 
@@ -162,66 +160,20 @@ by default. To get normalized vectors, pass normalize=True
 
     '''
 
-    if lensmodel != 'LENSMODEL_CAHVORE':
+    if lensmodel == 'LENSMODEL_CAHVORE' and \
+       out is None                       and \
+       isinstance(q, np.ndarray)         and \
+       np.asarray(intrinsics_data).ndim == 1:
+        # CAHVORE unprojection is expensive, so I split the points among
+        # several threads. This doesn't broadcast, so I use it only if I'm not
+        # broadcasting the intrinsics
+        v = mrcal._mrcal._unproject_batch(np.ascontiguousarray(q, dtype=float),
+                                          lensmodel,
+                                          np.ascontiguousarray(intrinsics_data, dtype=float))
+    else:
         # Main path. Internal function must have a different argument order so
         # that all the broadcasting stuff is in the leading arguments
         v = mrcal._mrcal_npsp._unproject(q, intrinsics_data, lensmodel=lensmodel, out=out)
-        if normalize:
-            v /= nps.dummy(nps.mag(v), -1)
-        return v
-
-    # CAHVORE. This is a reimplementation of the C code. It's barely maintained,
-    # and here for legacy compatibility only
-
-    if q is None: return q
-    if q.size == 0:
-        s = q.shape
-        return np.zeros(s[:-1] + (3,))
-
-    if out is not None:
-        raise Exception("unproject(..., out) is unsupported if out is not None and lensmodel == 'LENSMODEL_CAHVORE'")
-
-    fxy = intrinsics_data[ :2]
-    cxy = intrinsics_data[2:4]
-
-    # undistort the q, by running an optimizer
-
-    # I optimize each point separately because the internal optimization
-    # algorithm doesn't know that each point is independent, so if I optimized
-    # it all together, it would solve a dense linear system whose size is linear
-    # in Npoints. The computation time thus would be much slower than
-    # linear(Npoints)
-    @nps.broadcast_define( ((2,),), )
-    def undistort_this(q0):
-
-        def cost_no_gradients(vxy, *args, **kwargs):
-            '''Optimization functions'''
-            return \
-                mrcal.project(np.array((vxy[0],vxy[1],1.)), lensmodel, intrinsics_data) - \
-                q0
-
-        # seed assuming distortions aren't there
-        vxy_seed = (q0 - cxy) / fxy
-
-        # no gradients available
-        result = scipy.optimize.least_squares(cost_no_gradients, vxy_seed,
-                                              '3-point')
-
-        vxy = result.x
-
-        # This needs to be precise; if it isn't, I barf. Shouldn't happen
-        # very often
-        if np.sqrt(result.cost/2.) > 1e-3:
-            if not unproject.__dict__.get('already_complained'):
-                sys.stderr.write("WARNING: unproject() wasn't able to precisely compute some points. Returning nan for those. Will complain just once\n")
-                unproject.already_complained = True
-            return np.array((np.nan,np.nan))
-        return vxy
-
-    vxy = undistort_this(q)
-
-    # I append a 1. shape = (..., 3)
-    v = nps.glue(vxy, np.ones( vxy.shape[:-1] + (1,) ), axis=-1)
     if normalize:
         v /= nps.dummy(nps.mag(v), -1)
     return v
@@ -17,7 +17,8 @@ def stereo_rectify_prepare(models,
                            az0_deg           = None,
                            el0_deg           = 0,
                            pixels_per_deg_az = None,
-                           pixels_per_deg_el = None):
+                           pixels_per_deg_el = None,
+                           fixed_point_maps  = False):
 
     r'''Precompute everything needed for stereo rectification and matching
 
@@ -185,6 +186,13 @@ ARGUMENTS
 
 - pixels_per_deg_el: same as pixels_per_deg_az but in the elevation direction
 
+- fixed_point_maps: optional boolean, defaulting to False. If True, the
+  transformation maps are returned in OpenCV's fixed-point format instead of as
+  float32 pixel coordinates. This is what cv2.remap() uses internally, so it is
+  faster for rectifying many images, and uses less memory. The pixel
+  coordinates are quantized to 1/32 of a pixel. See the description of the
+  returned values below
+
 RETURNED VALUES
 
 We return a tuple
@@ -193,6 +201,15 @@ We return a tuple
   each camera. Each map can be used to mrcal.transform_image() images to the
   rectified space
 
+  If not fixed_point_maps, each map is a numpy array of shape (Nel,Naz,2) and
+  dtype np.float32 containing the pixel coordinates in each camera. If
+  fixed_point_maps, each map is a tuple (xy, interpolation), as produced by
+  cv2.convertMaps(..., dstmap1type=cv2.CV_16SC2): xy is a numpy array of shape
+  (Nel,Naz,2) and dtype np.int16 containing the whole pixel coordinates, and
+  interpolation is a numpy array of shape (Nel,Naz) and dtype np.uint16
+  containing the fractional parts, in units of 1/32 pixels: y_fractional*32 +
+  x_fractional
+
 - cookie: a dict describing the rectified space. Intended as input to
   stereo_unproject() and stereo_range(). See the description above for more
   detail
@@ -387,11 +404,24 @@ We return a tuple
                                 Nel),
                     -1 )
 
-    # v has shape (Nel,Naz,3)
-    v = stereo_unproject(az, el)
-
-    v0 = nps.matmult( nps.dummy(v,  -2), R_stereo_cam0 )[...,0,:]
-    v1 = nps.matmult( nps.dummy(v0, -2), Rt01[:3,:]    )[...,0,:]
+    # The maps are computed in C: for each rectified pixel we take the
+    # stereo_unproject() direction, rotate it into each camera, and project it.
+    # Rt10[:3,:] is R_cam1_cam0
+    rectification_maps = \
+        mrcal._mrcal._rectification_maps(*models[0].intrinsics(),
+                                         *models[1].intrinsics(),
+                                         R_cam0_stereo = np.ascontiguousarray(R_cam0_stereo),
+                                         R_cam1_cam0   = Rt10[:3,:],
+                                         az            = az,
+                                         el            = el.ravel(),
+                                         fixed_point   = fixed_point_maps)
+    if fixed_point_maps:
+        rectification_maps = \
+            tuple( (rectification_maps[0][i], rectification_maps[1][i]) \
+                   for i in range(2) )
+    else:
+        rectification_maps = \
+            tuple(rectification_maps)
 
     cookie = \
         dict( Rt_cam0_stereo    = nps.glue(R_cam0_stereo, np.zeros((3,)), axis=-2),
@@ -406,10 +436,7 @@ We return a tuple
               pixels_per_deg_el = pixels_per_deg_el,
             )
 
-    return                                                                \
-        (mrcal.project( v0, *models[0].intrinsics()).astype(np.float32),  \
-         mrcal.project( v1, *models[1].intrinsics()).astype(np.float32)), \
-        cookie
+    return rectification_maps, cookie
 
 
 def stereo_unproject(az                = None,
@@ -128,7 +128,9 @@ def synthesize_board_observations(models,
                                   rt_ref_boardcenter__noiseradius,
                                   Nframes,
 
-                                  which = 'all_cameras_must_see_full_board'):
+                                  which    = 'all_cameras_must_see_full_board',
+                                  seed     = None,
+                                  Nthreads = 0):
     r'''Produce synthetic chessboard observations
 
 SYNOPSIS
@@ -238,6 +240,17 @@ ARGUMENTS
     that produce observations that are AT LEAST HALF visible by AT LEAST ONE
     camera.
 
+- seed: optional integer. If None (the default), the board poses are sampled
+  with numpy's global random number generator. Otherwise the observations are
+  generated in C by a counter-based random number generator seeded with this
+  value. This is much faster, and the results depend only on the seed: they're
+  identical regardless of the number of threads used. Useful for large
+  Monte-Carlo studies
+
+- Nthreads: optional integer, used only if seed is not None. How many threads to
+  use to generate the observations. If <= 0 (the default), we use all the
+  available cores
+
 RETURNED VALUES
 
 We return a tuple:
@@ -284,6 +297,28 @@ We return a tuple:
 
     Ncameras = len(models)
 
+    if seed is not None:
+        if calobject_warp is not None:
+            calobject_warp = np.ascontiguousarray(calobject_warp, dtype=float)
+        return \
+            mrcal._mrcal._synthesize_board_observations( \
+                [m.intrinsics()[0] for m in models],
+                np.ascontiguousarray(nps.glue(*[m.intrinsics()[1] for m in models],
+                                              axis=-1),
+                                     dtype=float),
+                np.ascontiguousarray(nps.cat(*[m.extrinsics_rt_fromref() for m in models]),
+                                     dtype=float),
+                np.ascontiguousarray(nps.cat(*[m.imagersize() for m in models]),
+                                     dtype=np.int32),
+                object_width_n, object_height_n, object_spacing,
+                np.ascontiguousarray(rt_ref_boardcenter,              dtype=float),
+                np.ascontiguousarray(rt_ref_boardcenter__noiseradius, dtype=float),
+                Nframes,
+                calobject_warp = calobject_warp,
+                which          = which,
+                seed           = seed,
+                Nthreads       = Nthreads)
+
     # I move the board, and keep the cameras stationary.
     #
     # Camera coords: x,y with pixels, z forward
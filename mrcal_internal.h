@@ -44,15 +44,21 @@ void _mrcal_project_internal_opencv( // outputs
                                     int N,
                                     const double* intrinsics,
                                     int Nintrinsics);
+// Implemented in cahvore.cc
 bool _mrcal_project_internal_cahvore( // out
                                      mrcal_point2_t* out,
+                                     mrcal_point3_t* dq_dp, // may be NULL
 
                                      // in
                                      const mrcal_point3_t* v,
                                      int N,
 
                                      // core, distortions concatenated
-                                     const double* intrinsics);
+                                     const double* intrinsics,
+
+                                     // if true, failures aren't reported on
+                                     // stderr
+                                     bool quiet);
 bool _mrcal_project_internal( // out
                              mrcal_point2_t* q,
 
@@ -101,3 +107,30 @@ int _mrcal_num_j_nonzero(int Nobservations_board,
                          const mrcal_observation_point_t* observations_point,
                          mrcal_problem_selections_t problem_selections,
                          mrcal_lensmodel_t lensmodel);
+
+// Call work(i,cookie) for each i in [0,N), using Nthreads threads (including
+// the calling thread). Nthreads <= 0 means "use all the available cores". The
+// indices are handed out one at a time, so uneven workloads are balanced
+// automatically. Returns when all the work is done
+void _mrcal_parallel_for(int N, int Nthreads,
+                         void (*work)(int i, void* cookie),
+                         void* cookie);
+
+// Computes matmult(A[i], Jt, J, At[i]) for each of the N given A[i]. J is sparse,
+// stored by row in the CHOLMOD/scipy.sparse.csr_matrix representation
+// (Jp,Ji,Jx). Only the leading Nleading_rows_J rows of J are used. A is a dense
+// row-first array of shape (N,2,Nstate); out is a row-first array of shape
+// (N,2,2). All the A[i] are evaluated in a single pass over J, split over
+// Nthreads threads (Nthreads <= 0 means "use all the available cores"). The
+// result doesn't depend on Nthreads
+bool _mrcal_A_Jt_J_At(// out
+                      double* out,
+
+                      // in
+                      const double* A,
+                      int N, int Nstate,
+                      const int32_t* Jp,
+                      const int32_t* Ji,
+                      const double*  Jx,
+                      int Nleading_rows_J,
+                      int Nthreads);
@@ -49,4 +49,80 @@ testutils.confirm_equal(xt, xt_ref,
                         eps       = 1e-6,
                         msg       = "solve_xt_JtJ_bt produces the correct result")
 
+# A bigger, sparser problem for the selected inverse. Many of the entries of
+# inv(JtJ) we ask for are outside of the sparsity pattern of the factor
+np.random.seed(0)
+Nstate                     = 30
+Nmeasurements              = 80
+Nmeasurements_observations = 70
+Jdense = np.random.random((Nmeasurements,Nstate))
+Jdense[np.random.random(Jdense.shape) < 0.85] = 0
+Jdense[:Nstate,:] += np.eye(Nstate)
+Jsparse = csr_matrix(Jdense)
+Jp = Jsparse.indptr .astype(np.int32)
+Ji = Jsparse.indices.astype(np.int32)
+Jx = Jsparse.data
+
+F      = mrcal.CHOLMOD_factorization(Jsparse)
+istate = np.array((2, 29, 7, 8, 9, 15, 0), dtype=np.int32)
+
+invJtJ = np.linalg.inv(nps.matmult(nps.transpose(Jdense), Jdense))
+testutils.confirm_equal(F.selected_inverse(istate),
+                        invJtJ[istate][:,istate],
+                        relative  = True,
+                        worstcase = True,
+                        eps       = 1e-6,
+                        msg       = "selected_inverse produces the correct result")
+testutils.confirm_equal(F.selected_inverse(np.arange(Nstate)),
+                        invJtJ,
+                        relative  = True,
+                        worstcase = True,
+                        eps       = 1e-6,
+                        msg       = "selected_inverse produces the correct result for the full state")
+
+Jobservations = Jdense[:Nmeasurements_observations]
+Var_ref       = nps.matmult(invJtJ,
+                            nps.transpose(Jobservations), Jobservations,
+                            invJtJ)
+Var = F.selected_inverse(istate,
+                         Nmeasurements_observations = Nmeasurements_observations,
+                         Jp = Jp, Ji = Ji, Jx = Jx)
+testutils.confirm_equal(Var,
+                        Var_ref[istate][:,istate],
+                        relative  = True,
+                        worstcase = True,
+                        eps       = 1e-6,
+                        msg       = "selected_inverse produces the correct observations-only covariance")
+testutils.confirm(F.selected_inverse(istate,
+                                     Nmeasurements_observations = Nmeasurements_observations,
+                                     Jp = Jp, Ji = Ji, Jx = Jx) is Var,
+                  msg = "selected_inverse caches its results")
+
+# The factorization settings change how we factor, but not the results
+bt = np.random.random((100,Nstate))
+xt_ref = nps.transpose(np.linalg.solve(nps.matmult(nps.transpose(Jdense), Jdense),
+                                       nps.transpose(bt)))
+for kwargs in ( dict(),
+                dict(supernodal = False),
+                dict(supernodal = True),
+                dict(supernodal = 'auto'),
+                dict(supernodal = False, ordering = 'natural'),
+                dict(ordering   = 'amd', Nthreads = 2) ):
+    F = mrcal.CHOLMOD_factorization(Jsparse, **kwargs)
+    testutils.confirm_equal(F.solve_xt_JtJ_bt(bt), xt_ref,
+                            relative  = True,
+                            worstcase = True,
+                            eps       = 1e-6,
+                            msg       = f"solve_xt_JtJ_bt produces the correct result with {kwargs}")
+    stats = F.stats()
+    if kwargs.get('supernodal') != 'auto':
+        # supernodal=None means "simplicial"
+        testutils.confirm_equal(stats['supernodal'], bool(kwargs.get('supernodal')),
+                                msg = f"stats() reports the factorization method with {kwargs}")
+    if 'ordering' in kwargs:
+        testutils.confirm_equal(stats['ordering'], kwargs['ordering'],
+                                msg = f"stats() reports the ordering with {kwargs}")
+    testutils.confirm_equal(stats['Nrhs_solved'], len(bt),
+                            msg = f"stats() counts the solved vectors with {kwargs}")
+
 testutils.finish()
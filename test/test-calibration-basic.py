@@ -12,6 +12,7 @@ import sys
 import numpy as np
 import numpysane as nps
 import os
+import tempfile
 
 testdir = os.path.dirname(os.path.realpath(__file__))
 
@@ -112,6 +113,46 @@ intrinsics_data,extrinsics_rt_fromref,frames_rt_toref = \
                        observations         = observations,
                        object_spacing       = object_spacing)
 
+# The monocular board poses from the perfect observations and the true models
+# should match the truth. The seeding ignores calobject_warp, so this isn't exact
+Rt_cam_board_ref = \
+    nps.clump( mrcal.compose_Rt( nps.dummy(nps.cat(*[m.extrinsics_Rt_fromref() for m in models_ref]), 0),
+                                 nps.dummy(Rt_cam0_board_ref, -3) ),
+               n = 2 )
+Rt_cam_board_monocular = \
+    mrcal.estimate_monocular_calobject_poses_Rt_tocam( indices_frame_camera,
+                                                       observations_ref,
+                                                       object_spacing,
+                                                       models_ref )
+testutils.confirm_equal( Rt_cam_board_monocular, Rt_cam_board_ref,
+                         worstcase = True,
+                         eps = 0.02,
+                         msg = "Monocular board poses match the truth")
+
+# And the camera poses from the true board poses should match the truth exactly
+Rt_0c = \
+    mrcal._mrcal._estimate_camera_poses( Rt_cam_board_ref,
+                                         indices_frame_camera,
+                                         Ncameras                    = Ncameras,
+                                         calibration_object_width_n  = object_width_n,
+                                         calibration_object_height_n = object_height_n,
+                                         calibration_object_spacing  = object_spacing)
+testutils.confirm_equal( mrcal.invert_Rt(Rt_0c),
+                         nps.cat(*[m.extrinsics_Rt_fromref() for m in models_ref[1:]]),
+                         worstcase = True,
+                         eps = 1e-6,
+                         msg = "Camera poses from the true board poses match the truth")
+
+testutils.confirm_equal( mrcal.estimate_joint_frame_poses(Rt_cam_board_ref,
+                                                          nps.cat(*[m.extrinsics_Rt_fromref() for m in models_ref[1:]]),
+                                                          indices_frame_camera,
+                                                          object_width_n, object_height_n,
+                                                          object_spacing),
+                         frames_ref,
+                         worstcase = True,
+                         eps = 1e-6,
+                         msg = "Joint frame poses from the true poses match the truth")
+
 # I have a pinhole intrinsics estimate. Mount it into a full distortiony model,
 # seeded with random numbers
 intrinsics = np.zeros((Ncameras,Nintrinsics), dtype=float)
@@ -224,6 +265,41 @@ models_solved = \
 #     for i in range(1,Ncameras):
 #         models_solved[i].write(f'/tmp/tst{i}.cameramodel')
 
+# The optimization_inputs survive a write/read cycle. They're decoded lazily,
+# and may be queried one key at a time
+with tempfile.NamedTemporaryFile(suffix = '.cameramodel') as f:
+    models_solved[1].write(f.name)
+    model_read = mrcal.cameramodel(f.name)
+testutils.confirm_equal( model_read.optimization_inputs('frames_rt_toref'),
+                         optimization_inputs['frames_rt_toref'],
+                         msg = "optimization_inputs('frames_rt_toref') after reading the model")
+testutils.confirm_equal( model_read.optimization_inputs()['observations_board'],
+                         optimization_inputs['observations_board'],
+                         msg = "optimization_inputs()['observations_board'] after reading the model")
+
+# Same thing with the binary format. And converting back to the text format is
+# lossless
+with tempfile.NamedTemporaryFile(suffix = '.cameramodelb') as f, \
+     tempfile.NamedTemporaryFile(suffix = '.cameramodel')  as f_text:
+    model_read.write(f.name)
+    model_read_binary = mrcal.cameramodel(f.name)
+    model_read_binary.write(f_text.name)
+    model_read_text = mrcal.cameramodel(f_text.name)
+
+    for what,m in (("binary",                    model_read_binary),
+                   ("binary, converted to text", model_read_text)):
+        optimization_inputs_read = m.optimization_inputs()
+        testutils.confirm( sorted(optimization_inputs_read.keys()) == \
+                           sorted(model_read.optimization_inputs().keys()),
+                           msg = f"optimization_inputs() keys from the {what} model")
+        for k in ('frames_rt_toref','observations_board','indices_frame_camintrinsics_camextrinsics'):
+            testutils.confirm_equal( optimization_inputs_read[k],
+                                     optimization_inputs[k],
+                                     msg = f"optimization_inputs()['{k}'] from the {what} model")
+        testutils.confirm_equal( m.icam_intrinsics(),
+                                 models_solved[1].icam_intrinsics(),
+                                 msg = f"icam_intrinsics() from the {what} model")
+
 
 testutils.confirm_equal(rmserr, 0,
                         eps = 2.5,
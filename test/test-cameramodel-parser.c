@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../mrcal.h"
+
+#include "test-harness.h"
+
+static void check_fails(const char* string)
+{
+    mrcal_cameramodel_t* m = mrcal_read_cameramodel_string(string, 0);
+    confirm(m == NULL);
+    mrcal_free_cameramodel(&m);
+}
+
+int main(int argc, char* argv[])
+{
+    mrcal_cameramodel_t* m;
+
+    m = mrcal_read_cameramodel_string(
+        "# a comment\n"
+        "{\n"
+        "    'lensmodel':  'LENSMODEL_OPENCV4',\n"
+        "    # intrinsics are fx,fy,cx,cy,distortion0,distortion1,....\n"
+        "    'intrinsics': [ 1761.181055, 1761.250444, 1965.706996, 1087.518797, -0.01266096516, 0.03590794372, -0.0002547045941, 0.0005275929652,],\n"
+        "    'extrinsics': [ 2e-2, -3e-1, -1e-2,  1., 2, -3., ],\n"
+        "    'imagersize': [ 4000, 2200 ],\n"
+        "    'valid_intrinsics_region': [[0,0], [10,0], (10,5), [0,0]],\n"
+        "    'some_key_I_do_not_know': {'a': (1, [2,3], \"x\"), 'b': None, 'c': True},\n"
+        "    'optimization_inputs': b'abc\\x00\\n\\'\\\\d',\n"
+        "}\n",
+        0);
+    confirm(m != NULL);
+    if(m != NULL)
+    {
+        confirm_eq_int(m->lensmodel.type, MRCAL_LENSMODEL_OPENCV4);
+        confirm_eq_double(m->intrinsics[0], 1761.181055, 1e-12);
+        confirm_eq_double(m->intrinsics[7], 0.0005275929652, 1e-12);
+        confirm_eq_double(m->rt_cam_ref[0], 2e-2, 1e-12);
+        confirm_eq_double(m->rt_cam_ref[5], -3., 1e-12);
+        confirm_eq_int(m->imagersize[0], 4000);
+        confirm_eq_int(m->imagersize[1], 2200);
+        confirm_eq_int(m->Nvalid_intrinsics_region, 4);
+        if(m->Nvalid_intrinsics_region == 4)
+        {
+            confirm_eq_double(m->valid_intrinsics_region[2].x, 10., 1e-12);
+            confirm_eq_double(m->valid_intrinsics_region[2].y,  5., 1e-12);
+        }
+        confirm_eq_int(m->icam_intrinsics, -1);
+        confirm_eq_int(m->optimization_inputs_len, 8);
+        confirm(m->optimization_inputs != NULL &&
+                0 == memcmp(m->optimization_inputs, "abc\0\n'\\d", 8));
+        confirm(m->projection_uncertainty_cache == NULL);
+    }
+    mrcal_free_cameramodel(&m);
+    confirm(m == NULL);
+
+    // Legacy key names. The lens model comes from the legacy
+    // 'distortion_model' key, with the legacy DISTORTION_... name
+    m = mrcal_read_cameramodel_string(
+        "{'distortion_model': \"DISTORTION_CAHVOR\",\n"
+        " 'intrinsics': [1,2,3,4,5,6,7,8,9],\n"
+        " 'extrinsics': [0,0,0,0,0,0],\n"
+        " 'imagersize': [10,20],\n"
+        " 'icam_intrinsics_optimization_inputs': 3}",
+        0);
+    confirm(m != NULL);
+    if(m != NULL)
+    {
+        confirm_eq_int(m->lensmodel.type, MRCAL_LENSMODEL_CAHVOR);
+        confirm_eq_int(m->icam_intrinsics, 3);
+        confirm(m->valid_intrinsics_region == NULL);
+        confirm(m->optimization_inputs     == NULL);
+    }
+    mrcal_free_cameramodel(&m);
+
+    // A configured lens model. The string length is given explicitly, and the
+    // data after it is ignored
+    const char* splined =
+        "{'lensmodel': 'LENSMODEL_SPLINED_STEREOGRAPHIC_order=3_Nx=2_Ny=2_fov_x_deg=100',"
+        " 'intrinsics': [1,2,3,4, 0,0,0,0,0,0,0,0],"
+        " 'extrinsics': [0,0,0,0,0,0],"
+        " 'imagersize': [10,20],"
+        " 'icam_intrinsics': 1,"
+        " 'icam_intrinsics_optimization_inputs': 3}garbage";
+    m = mrcal_read_cameramodel_string(splined, strlen(splined) - strlen("garbage"));
+    confirm(m != NULL);
+    if(m != NULL)
+    {
+        confirm_eq_int(m->lensmodel.type, MRCAL_LENSMODEL_SPLINED_STEREOGRAPHIC);
+        confirm_eq_int(m->lensmodel.LENSMODEL_SPLINED_STEREOGRAPHIC__config.Nx, 2);
+        confirm_eq_int(m->icam_intrinsics, 1);
+    }
+    mrcal_free_cameramodel(&m);
+
+    // Errors
+    check_fails(splined);
+    check_fails("");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0,0]}");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3],   'extrinsics': [0,0,0,0,0,0], 'imagersize': [10,20]}");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0],   'imagersize': [10,20]}");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0,0], 'imagersize': [10.5,20]}");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0,0], 'imagersize': [10,20]");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0,0], 'imagersize': [10,20] 'x': 5}");
+    check_fails("{'lensmodel': 'LENSMODEL_NOTAMODEL', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0,0], 'imagersize': [10,20]}");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0,0], 'imagersize': [10,20], 'x': foo}");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0,0], 'imagersize': [10,20], 'x': 'unterminated}");
+    check_fails("{'lensmodel': 'LENSMODEL_PINHOLE', 'intrinsics': [1,2,3,4], 'extrinsics': [0,0,0,0,0,0], 'imagersize': [10,20], 'optimization_inputs': 'not bytes'}");
+
+    TEST_FOOTER();
+}
@@ -91,4 +91,65 @@ testutils.confirm_equal( 0, difflen[icenter[0],icenter[1]],
                          eps = 0.1,
                          msg = "Low-enough diff at the center")
 
+
+########## The fitting function itself should recover a known model exactly
+model_opencv8 = mrcal.cameramodel(f"{testdir}/data/cam0.opencv8.cameramodel")
+lensmodel,intrinsics_ref = model_opencv8.intrinsics()
+
+v,q = mrcal.sample_imager_unproject(40, None,
+                                    *model_opencv8.imagersize(),
+                                    lensmodel, intrinsics_ref,
+                                    normalize = True)
+p = nps.clump(v, n=2) * 3.
+q = nps.clump(q, n=2)
+i = np.isfinite(p[:,0])
+p = np.ascontiguousarray(p[i])
+q = np.ascontiguousarray(q[i])
+
+rt_cam_ref_ref = np.array((1e-3, -2e-3, 3e-3, 0.01, -0.02, 0.005))
+intrinsics = intrinsics_ref.copy()
+intrinsics[4:] *= 0.9
+rms = mrcal.fit_intrinsics_to_points(q, p, lensmodel, intrinsics)
+testutils.confirm_equal( rms, 0,
+                         eps = 1e-6,
+                         msg = "fit_intrinsics_to_points() fits a known model")
+testutils.confirm_equal( mrcal.project(p, lensmodel, intrinsics), q,
+                         eps = 1e-6,
+                         worstcase = True,
+                         msg = "fit_intrinsics_to_points() reproduces the projections")
+
+p_ref = mrcal.transform_point_rt( mrcal.invert_rt(rt_cam_ref_ref), p )
+intrinsics = intrinsics_ref.copy()
+rt_cam_ref = np.zeros((6,), dtype=float)
+rms = mrcal.fit_intrinsics_to_points(q, p_ref, lensmodel, intrinsics,
+                                     rt_cam_ref = rt_cam_ref)
+testutils.confirm_equal( rms, 0,
+                         eps = 1e-6,
+                         msg = "fit_intrinsics_to_points() fits a known model and transformation")
+testutils.confirm_equal( rt_cam_ref, rt_cam_ref_ref,
+                         eps = 1e-6,
+                         worstcase = True,
+                         msg = "fit_intrinsics_to_points() recovers a known transformation")
+
+# Splined models are fitted linearly: the fit should reproduce the projections
+# of the reference splined model
+lensmodel_splined,intrinsics_splined_ref = model_splined.intrinsics()
+v,q = mrcal.sample_imager_unproject(40, None,
+                                    *model_splined.imagersize(),
+                                    lensmodel_splined, intrinsics_splined_ref,
+                                    normalize = True)
+p = nps.clump(v, n=2) * 3.
+q = nps.clump(q, n=2)
+i = np.isfinite(p[:,0])
+p = np.ascontiguousarray(p[i])
+q = np.ascontiguousarray(q[i])
+intrinsics = intrinsics_splined_ref.copy()
+intrinsics[4:] = 0
+rms = mrcal.fit_intrinsics_to_points(q, p, lensmodel_splined, intrinsics)
+testutils.confirm_equal( rms, 0,
+                         eps = 0.01,
+                         msg = "fit_intrinsics_to_points() fits a splined model")
+testutils.confirm_equal( intrinsics[:4], intrinsics_splined_ref[:4],
+                         msg = "fit_intrinsics_to_points() leaves the splined core alone")
+
 testutils.finish()
@@ -0,0 +1,170 @@
+#!/usr/bin/python3
+
+r'''Tests the ingestion of the chessboard corners
+
+I convert a vnlog corners cache to the binary format, and make sure that
+mrcal.compute_chessboard_corners() reports the same observations from both, and
+that these match the reference in test/data/test-corners-cache-ref.npz. That
+reference was produced by the pure-Python vnlog parser that predates the binary
+cache. I also make sure that non-ASCII filenames work, and that the incremental
+parsing of a vnlog stream works
+
+'''
+
+import sys
+import numpy as np
+import numpysane as nps
+import os
+import tempfile
+import io
+import atexit
+import shutil
+
+testdir = os.path.dirname(os.path.realpath(__file__))
+
+# I import the LOCAL mrcal since that's what I'm testing
+sys.path[:0] = f"{testdir}/..",
+import mrcal
+import testutils
+
+workdir = tempfile.mkdtemp()
+def cleanup():
+    global workdir
+    try:
+        shutil.rmtree(workdir)
+        workdir = None
+    except:
+        pass
+atexit.register(cleanup)
+
+globs = ('frame*-cam0.xxx','frame*-cam1.xxx')
+
+# The images paths are relative to the directory of the cache, so I put both
+# caches into the same directory
+vnl = f"{workdir}/corners.vnl"
+with open(f"{testdir}/data/synthetic-board-observations.vnl", "r") as f:
+    lines = f.readlines()
+# I mark some points as "ignore", with both '-' and negative levels, and I add
+# an image with no observations
+with open(vnl, "w") as f:
+    i = 0
+    for l in lines:
+        if l[0] != '#':
+            fields = l.split()
+            if   i % 7  == 0: fields[3] = '-'
+            elif i % 11 == 0: fields[3] = '-2'
+            l = ' '.join(fields) + '\n'
+            i += 1
+        f.write(l)
+    f.write("frame000003-cam0.xxx - - -\n")
+
+binary = f"{workdir}/corners.bin"
+mrcal.corners_cache_vnl_to_binary(vnl, binary)
+
+ref = np.load(f"{testdir}/data/test-corners-cache-ref.npz")
+
+for extracol in ('level','weight',''):
+    observations_vnl, indices_frame_camera_vnl, paths_vnl = \
+        mrcal.compute_chessboard_corners(10, 10, globs, vnl,
+                                         extracol = extracol)
+    observations_bin, indices_frame_camera_bin, paths_bin = \
+        mrcal.compute_chessboard_corners(10, 10, globs, binary,
+                                         extracol = extracol)
+
+    observations_ref = ref[f"observations_{extracol if extracol else 'none'}"]
+    testutils.confirm_equal(observations_vnl, observations_ref,
+                            worstcase = True,
+                            msg = f"extracol='{extracol}': vnlog observations match the reference")
+    testutils.confirm_equal(indices_frame_camera_vnl, ref['indices_frame_camera'],
+                            msg = f"extracol='{extracol}': vnlog indices_frame_camera match the reference")
+    testutils.confirm([os.path.basename(p) for p in paths_vnl] == list(ref['paths']),
+                      msg = f"extracol='{extracol}': vnlog paths match the reference")
+
+    testutils.confirm_equal(observations_bin.shape, observations_vnl.shape,
+                            msg = f"extracol='{extracol}': same observations shape")
+    # The binary cache stores 32-bit floats
+    testutils.confirm_equal(observations_bin, observations_vnl,
+                            eps = 1e-3,
+                            worstcase = True,
+                            msg = f"extracol='{extracol}': same observations")
+    testutils.confirm_equal(indices_frame_camera_bin, indices_frame_camera_vnl,
+                            msg = f"extracol='{extracol}': same indices_frame_camera")
+    testutils.confirm(paths_bin == paths_vnl,
+                      msg = f"extracol='{extracol}': same paths")
+
+# Non-ASCII filenames. The filenames of the binary cache are stored as utf-8,
+# and multi-byte characters in one filename must not disturb the others
+vnl_unicode    = f"{workdir}/corners-unicode.vnl"
+binary_unicode = f"{workdir}/corners-unicode.bin"
+globs_unicode  = ('frame*-camé0.xxx','frame*-cam1.xxx')
+with open(vnl, "r") as f:
+    data = f.read()
+with open(vnl_unicode, "w", encoding='utf-8') as f:
+    f.write(data.replace('-cam0.xxx', '-camé0.xxx'))
+mrcal.corners_cache_vnl_to_binary(vnl_unicode, binary_unicode)
+
+paths_ref_unicode = [p.replace('-cam0.xxx', '-camé0.xxx') for p in ref['paths']]
+for what,path in (('vnlog',vnl_unicode),('binary',binary_unicode)):
+    observations, indices_frame_camera, paths = \
+        mrcal.compute_chessboard_corners(10, 10, globs_unicode, path)
+    testutils.confirm_equal(observations, ref['observations_level'],
+                            eps = 1e-3,
+                            worstcase = True,
+                            msg = f"{what} cache with non-ASCII filenames: observations match the reference")
+    testutils.confirm_equal(indices_frame_camera, ref['indices_frame_camera'],
+                            msg = f"{what} cache with non-ASCII filenames: indices_frame_camera match the reference")
+    testutils.confirm([os.path.basename(p) for p in paths] == paths_ref_unicode,
+                      msg = f"{what} cache with non-ASCII filenames: paths match the reference")
+
+# The vnlog is parsed in blocks, as it's read. I feed it in small blocks to
+# split the observations of each image between blocks. And I check that each
+# observation is reported to process_observation() as it's ingested
+class trickle(io.RawIOBase):
+    def __init__(self, data):
+        self.data = data
+    def readable(self):
+        return True
+    def read1(self, n = -1):
+        block,self.data = self.data[:37],self.data[37:]
+        return block
+
+with open(vnl, "rb") as f:
+    data = f.read()
+
+observations_vnl, indices_frame_camera_vnl, paths_vnl = \
+    mrcal.compute_chessboard_corners(10, 10, globs, vnl)
+
+processed = dict()
+def process_observation(path, icam, observation):
+    processed[path] = (icam, observation.copy())
+observations_trickle, indices_frame_camera_trickle, paths_trickle = \
+    mrcal.compute_chessboard_corners(10, 10, globs, trickle(data),
+                                     process_observation = process_observation)
+testutils.confirm_equal(observations_trickle, observations_vnl,
+                        worstcase = True,
+                        msg = "Parsing in small blocks produces the same observations")
+testutils.confirm_equal(indices_frame_camera_trickle, indices_frame_camera_vnl,
+                        msg = "Parsing in small blocks produces the same indices_frame_camera")
+testutils.confirm(sorted(processed.keys()) == sorted(os.path.basename(p) for p in paths_vnl),
+                  msg = "process_observation() sees each observation")
+testutils.confirm_equal(nps.cat(*[processed[os.path.basename(p)][1] for p in paths_vnl]),
+                        observations_vnl,
+                        worstcase = True,
+                        msg = "process_observation() sees the reported observations")
+testutils.confirm_equal(np.array([processed[os.path.basename(p)][0] for p in paths_vnl]),
+                        indices_frame_camera_vnl[:,1],
+                        msg = "process_observation() sees the correct camera indices")
+
+# Truncated files are rejected
+with open(binary, "rb") as f:
+    data = f.read()
+with open(binary, "wb") as f:
+    f.write(data[:-3])
+try:
+    mrcal.compute_chessboard_corners(10, 10, globs, binary)
+except:
+    testutils.confirm(True, msg = "Truncated binary cache is rejected")
+else:
+    testutils.confirm(False, msg = "Truncated binary cache is rejected")
+
+testutils.finish()
@@ -0,0 +1,109 @@
+#!/usr/bin/python3
+
+r'''Tests the cameramodel registry shared between processes'''
+
+import sys
+import numpy as np
+import numpysane as nps
+import os
+import time
+import multiprocessing
+
+testdir = os.path.dirname(os.path.realpath(__file__))
+
+# I import the LOCAL mrcal since that's what I'm testing
+sys.path[:0] = f"{testdir}/..",
+import mrcal
+import testutils
+
+
+import tempfile
+import atexit
+import shutil
+workdir = tempfile.mkdtemp()
+def cleanup():
+    global workdir
+    try:
+        shutil.rmtree(workdir)
+        workdir = None
+    except:
+        pass
+atexit.register(cleanup)
+
+
+filename = f"{workdir}/model.cameramodel"
+mrcal.cameramodel(f"{testdir}/data/cam0.opencv8.cameramodel").write(filename)
+
+Ncompute = 0
+def compute_arrays(model):
+    global Ncompute
+    Ncompute += 1
+    W,H = model.imagersize()
+    return dict( q = mrcal.project( np.array(((0,0,1.),(1,0,1.))), *model.intrinsics() ),
+                 mask = np.ones( (H//100,W//100), dtype=bool) )
+
+
+registry = mrcal.cameramodel_registry(f"{workdir}/registry")
+
+model,arrays = registry.load('cam0', filename, compute_arrays)
+testutils.confirm_equal( Ncompute, 1,
+                         msg = "First load() computes the arrays")
+testutils.confirm_equal( model.intrinsics()[1],
+                         mrcal.cameramodel(filename).intrinsics()[1],
+                         msg = "The published model matches the file")
+testutils.confirm_equal( arrays['q'],
+                         mrcal.project( np.array(((0,0,1.),(1,0,1.))),
+                                        *mrcal.cameramodel(filename).intrinsics() ),
+                         msg = "The published arrays are correct")
+testutils.confirm( not arrays['q'].flags.writeable,
+                   msg = "The published arrays are read-only")
+
+registry.load('cam0', filename, compute_arrays)
+testutils.confirm_equal( Ncompute, 1,
+                         msg = "Subsequent load() reuses the published data")
+
+
+# Another process attaches to the data without recomputing it
+def child(queue):
+    global Ncompute
+    Ncompute = 0
+    registry = mrcal.cameramodel_registry(f"{workdir}/registry")
+    model,arrays = registry.load('cam0', filename, compute_arrays)
+    queue.put( (Ncompute, np.array(arrays['q'])) )
+
+queue = multiprocessing.Queue()
+process = multiprocessing.Process(target = child, args = (queue,))
+process.start()
+Ncompute_child, q_child = queue.get()
+process.join()
+testutils.confirm_equal( Ncompute_child, 0,
+                         msg = "Another process attaches without recomputing")
+testutils.confirm_equal( q_child, arrays['q'],
+                         msg = "Another process sees the same arrays")
+
+
+# Modifying the source file invalidates the entry
+m = mrcal.cameramodel(filename)
+lensmodel,intrinsics = m.intrinsics()
+intrinsics[0] *= 1.1
+m.intrinsics( (lensmodel,intrinsics) )
+# make sure the modification time changes
+time.sleep(0.01)
+m.write(filename)
+testutils.confirm( not registry.is_current('cam0', filename),
+                   msg = "is_current() notices the modified file")
+model_new,arrays_new = registry.load('cam0', filename, compute_arrays)
+testutils.confirm_equal( Ncompute, 2,
+                         msg = "load() republishes after the file changed")
+testutils.confirm_equal( model_new.intrinsics()[1][0], intrinsics[0],
+                         msg = "The republished model has the new data")
+testutils.confirm( np.max(np.abs(arrays['q'] - arrays_new['q'])) > 1.,
+                   msg = "The old arrays still contain the old data")
+
+registry.remove('cam0')
+testutils.confirm( not registry.is_current('cam0', filename),
+                   msg = "remove() removes the entry")
+testutils.confirm( os.path.exists(f"{workdir}/registry/cam0.cameramodelb.lock"),
+                   msg = "remove() leaves the lock file alone")
+
+testutils.finish()
@@ -0,0 +1,130 @@
+#!/usr/bin/python3
+
+r'''Tests mrcal.optimize_batch()
+
+I generate a number of independent noisy calibration problems, and make sure
+that solving them as a batch produces the same results as solving them one at a
+time with mrcal.optimize()
+
+'''
+
+import sys
+import numpy as np
+import numpysane as nps
+import os
+import copy
+
+testdir = os.path.dirname(os.path.realpath(__file__))
+
+# I import the LOCAL mrcal since that's what I'm testing
+sys.path[:0] = f"{testdir}/..",
+import mrcal
+import testutils
+
+from test_calibration_helpers import sample_dqref
+
+# I want the RNG to be deterministic
+np.random.seed(0)
+
+models_ref = ( mrcal.cameramodel(f"{testdir}/data/cam0.opencv8.cameramodel"),
+               mrcal.cameramodel(f"{testdir}/data/cam1.opencv8.cameramodel") )
+
+lensmodel = 'LENSMODEL_OPENCV4'
+for m in models_ref:
+    m.intrinsics( intrinsics = (lensmodel, m.intrinsics()[1][:8]))
+
+models_ref[0].extrinsics_rt_fromref(np.zeros((6,), dtype=float))
+models_ref[1].extrinsics_rt_fromref(np.array((0.08,0.2,0.02, 1., 0.9,0.1)))
+
+imagersizes = nps.cat( *[m.imagersize() for m in models_ref] )
+Ncameras    = len(models_ref)
+Nframes     = 20
+Nproblems   = 6
+
+pixel_uncertainty_stdev = 1.5
+object_spacing          = 0.1
+object_width_n          = 10
+object_height_n         = 9
+
+q_ref,Rt_cam0_board_ref = \
+    mrcal.synthesize_board_observations(models_ref,
+                                        object_width_n, object_height_n, object_spacing,
+                                        None,
+                                        np.array((0.,  0.,  0., -2,   0,  4.0)),
+                                        np.array((np.pi/180.*30., np.pi/180.*30., np.pi/180.*20., 2.5, 2.5, 2.0)),
+                                        Nframes)
+
+observations_ref = nps.clump( nps.glue(q_ref,
+                                       np.ones(q_ref.shape[:-1] + (1,)),
+                                       axis=-1),
+                              n=2)
+
+indices_frame_camintrinsics_camextrinsics = \
+    np.array([ (iframe, icam, icam-1) \
+               for iframe in range(Nframes) \
+               for icam in range(Ncameras) ],
+             dtype = np.int32)
+
+intrinsics = nps.cat( *[m.intrinsics()[1] for m in models_ref] )
+
+optimization_inputs0 = \
+    dict( intrinsics                                = intrinsics,
+          extrinsics_rt_fromref                     = nps.atleast_dims(models_ref[1].extrinsics_rt_fromref(), -2),
+          frames_rt_toref                           = mrcal.rt_from_Rt(Rt_cam0_board_ref),
+          points                                    = None,
+          observations_board                        = observations_ref,
+          indices_frame_camintrinsics_camextrinsics = indices_frame_camintrinsics_camextrinsics,
+          observations_point                        = None,
+          indices_point_camintrinsics_camextrinsics = None,
+          lensmodel                                 = lensmodel,
+          calobject_warp                            = None,
+          imagersizes                               = imagersizes,
+          calibration_object_spacing                = object_spacing,
+          verbose                                   = False,
+          observed_pixel_uncertainty                = pixel_uncertainty_stdev,
+          do_optimize_calobject_warp                = False,
+          do_apply_regularization                   = True,
+          do_apply_outlier_rejection                = False)
+
+# Each problem gets its own noise, and its own copy of all the arrays
+problems = []
+for i in range(Nproblems):
+    optimization_inputs = copy.deepcopy(optimization_inputs0)
+    optimization_inputs['observations_board'] = \
+        sample_dqref(observations_ref, pixel_uncertainty_stdev)[1]
+    problems.append(optimization_inputs)
+
+problems_sequential = copy.deepcopy(problems)
+stats_sequential = [ mrcal.optimize(**p) for p in problems_sequential ]
+
+for Nthreads in (1,3,0):
+    problems_batch = copy.deepcopy(problems)
+    stats_batch    = mrcal.optimize_batch(problems_batch, Nthreads = Nthreads)
+
+    testutils.confirm_equal( len(stats_batch), Nproblems,
+                             msg = f"Nthreads={Nthreads}: got one result per problem")
+
+    for i in range(Nproblems):
+        testutils.confirm_equal( stats_batch[i]['rms_reproj_error__pixels'],
+                                 stats_sequential[i]['rms_reproj_error__pixels'],
+                                 msg = f"Nthreads={Nthreads}: problem {i}: same rms error as the sequential solve")
+        testutils.confirm_equal( stats_batch[i]['p_packed'],
+                                 stats_sequential[i]['p_packed'],
+                                 worstcase = True,
+                                 msg = f"Nthreads={Nthreads}: problem {i}: same packed state as the sequential solve")
+        testutils.confirm_equal( problems_batch[i]['intrinsics'],
+                                 problems_sequential[i]['intrinsics'],
+                                 worstcase = True,
+                                 msg = f"Nthreads={Nthreads}: problem {i}: intrinsics updated in-place")
+
+# Problems that write to the same memory must be rejected
+problems_shared = copy.deepcopy(problems[:2])
+problems_shared[1]['intrinsics'] = problems_shared[0]['intrinsics']
+try:
+    mrcal.optimize_batch(problems_shared)
+except:
+    testutils.confirm(True, msg = "Problems sharing output arrays are rejected")
+else:
+    testutils.confirm(False, msg = "Problems sharing output arrays are rejected")
+
+testutils.finish()
@@ -0,0 +1,158 @@
+#!/usr/bin/python3
+
+r'''Tests the matrix-free PCG solver in mrcal.optimize()
+
+I solve noisy calibration problems with the default sparse-Cholesky solver and
+with do_solve_with_pcg, and make sure the two produce the same results. And I
+make sure that storing the Jacobian in single precision
+(do_store_jacobian_float32) doesn't affect the solution either
+
+'''
+
+import sys
+import numpy as np
+import numpysane as nps
+import os
+import copy
+
+testdir = os.path.dirname(os.path.realpath(__file__))
+
+# I import the LOCAL mrcal since that's what I'm testing
+sys.path[:0] = f"{testdir}/..",
+import mrcal
+import testutils
+
+from test_calibration_helpers import sample_dqref
+
+# I want the RNG to be deterministic
+np.random.seed(0)
+
+models_ref = ( mrcal.cameramodel(f"{testdir}/data/cam0.opencv8.cameramodel"),
+               mrcal.cameramodel(f"{testdir}/data/cam1.opencv8.cameramodel") )
+
+lensmodel = 'LENSMODEL_OPENCV4'
+for m in models_ref:
+    m.intrinsics( intrinsics = (lensmodel, m.intrinsics()[1][:8]))
+
+models_ref[0].extrinsics_rt_fromref(np.zeros((6,), dtype=float))
+models_ref[1].extrinsics_rt_fromref(np.array((0.08,0.2,0.02, 1., 0.9,0.1)))
+
+imagersizes = nps.cat( *[m.imagersize() for m in models_ref] )
+Ncameras    = len(models_ref)
+Nframes     = 20
+
+pixel_uncertainty_stdev = 1.5
+object_spacing          = 0.1
+object_width_n          = 10
+object_height_n         = 9
+
+q_ref,Rt_cam0_board_ref = \
+    mrcal.synthesize_board_observations(models_ref,
+                                        object_width_n, object_height_n, object_spacing,
+                                        None,
+                                        np.array((0.,  0.,  0., -2,   0,  4.0)),
+                                        np.array((np.pi/180.*30., np.pi/180.*30., np.pi/180.*20., 2.5, 2.5, 2.0)),
+                                        Nframes)
+
+observations_ref = nps.clump( nps.glue(q_ref,
+                                       np.ones(q_ref.shape[:-1] + (1,)),
+                                       axis=-1),
+                              n=2)
+
+indices_frame_camintrinsics_camextrinsics = \
+    np.array([ (iframe, icam, icam-1) \
+               for iframe in range(Nframes) \
+               for icam in range(Ncameras) ],
+             dtype = np.int32)
+
+intrinsics = nps.cat( *[m.intrinsics()[1] for m in models_ref] )
+
+# I perturb the seed, so that the solvers have some work to do
+optimization_inputs0 = \
+    dict( intrinsics                                = intrinsics * (1. + 1e-3*np.random.randn(*intrinsics.shape)),
+          extrinsics_rt_fromref                     = nps.atleast_dims(models_ref[1].extrinsics_rt_fromref(), -2) + 1e-3*np.random.randn(1,6),
+          frames_rt_toref                           = mrcal.rt_from_Rt(Rt_cam0_board_ref) + 1e-3*np.random.randn(Nframes,6),
+          points                                    = None,
+          observations_board                        = sample_dqref(observations_ref, pixel_uncertainty_stdev)[1],
+          indices_frame_camintrinsics_camextrinsics = indices_frame_camintrinsics_camextrinsics,
+          observations_point                        = None,
+          indices_point_camintrinsics_camextrinsics = None,
+          lensmodel                                 = lensmodel,
+          calobject_warp                            = np.array((0.001, 0.001)),
+          imagersizes                               = imagersizes,
+          calibration_object_spacing                = object_spacing,
+          verbose                                   = False,
+          observed_pixel_uncertainty                = pixel_uncertainty_stdev,
+          do_apply_regularization                   = True)
+
+for do_apply_outlier_rejection in (False, True):
+    optimization_inputs_cholesky = copy.deepcopy(optimization_inputs0)
+    optimization_inputs_pcg      = copy.deepcopy(optimization_inputs0)
+
+    stats_cholesky = mrcal.optimize(**optimization_inputs_cholesky,
+                                    do_apply_outlier_rejection = do_apply_outlier_rejection)
+    stats_pcg      = mrcal.optimize(**optimization_inputs_pcg,
+                                    do_apply_outlier_rejection = do_apply_outlier_rejection,
+                                    do_solve_with_pcg          = True)
+
+    what = f"do_apply_outlier_rejection={do_apply_outlier_rejection}"
+    testutils.confirm_equal( stats_pcg['Noutliers'],
+                             stats_cholesky['Noutliers'],
+                             msg = f"{what}: PCG solve finds the same outliers")
+    testutils.confirm_equal( stats_pcg['rms_reproj_error__pixels'],
+                             stats_cholesky['rms_reproj_error__pixels'],
+                             eps = 1e-6,
+                             msg = f"{what}: PCG solve has the same rms error")
+    testutils.confirm_equal( stats_pcg['p_packed'],
+                             stats_cholesky['p_packed'],
+                             worstcase = True,
+                             eps       = 1e-4,
+                             msg = f"{what}: PCG solve converges to the same state")
+    testutils.confirm_equal( stats_pcg['x'],
+                             stats_cholesky['x'],
+                             worstcase = True,
+                             eps       = 1e-4,
+                             msg = f"{what}: PCG solve produces the same measurements")
+    testutils.confirm_equal( optimization_inputs_pcg['intrinsics'],
+                             optimization_inputs_cholesky['intrinsics'],
+                             worstcase = True,
+                             relative  = True,
+                             eps       = 1e-6,
+                             msg = f"{what}: PCG solve updates the intrinsics in-place")
+
+optimization_inputs_float64 = copy.deepcopy(optimization_inputs0)
+optimization_inputs_float32 = copy.deepcopy(optimization_inputs0)
+stats_float64 = mrcal.optimize(**optimization_inputs_float64,
+                               do_apply_outlier_rejection = False,
+                               do_solve_with_pcg          = True)
+stats_float32 = mrcal.optimize(**optimization_inputs_float32,
+                               do_apply_outlier_rejection = False,
+                               do_solve_with_pcg          = True,
+                               do_store_jacobian_float32  = True)
+testutils.confirm_equal( stats_float32['rms_reproj_error__pixels'],
+                         stats_float64['rms_reproj_error__pixels'],
+                         eps = 1e-6,
+                         msg = "float32 Jacobian: same rms error")
+testutils.confirm_equal( stats_float32['p_packed'],
+                         stats_float64['p_packed'],
+                         worstcase = True,
+                         eps       = 1e-3,
+                         msg = "float32 Jacobian: same state")
+testutils.confirm_equal( optimization_inputs_float32['intrinsics'],
+                         optimization_inputs_float64['intrinsics'],
+                         worstcase = True,
+                         relative  = True,
+                         eps       = 1e-5,
+                         msg = "float32 Jacobian: same intrinsics")
+
+# libdogleg can't use a single-precision Jacobian
+try:
+    mrcal.optimize(**copy.deepcopy(optimization_inputs0),
+                   do_apply_outlier_rejection = False,
+                   do_store_jacobian_float32  = True)
+except RuntimeError:
+    testutils.confirm(True, msg = "float32 Jacobian without PCG is rejected")
+else:
+    testutils.confirm(False, msg = "float32 Jacobian without PCG is rejected")
+
+testutils.finish()
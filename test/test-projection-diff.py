@@ -72,6 +72,36 @@ testutils.confirm_equal( 0, nps.mag(implied_Rt10[3,:]),
                          msg = "diff(model,model) at 3m should produce a rotation of 0 m")
 
 
+########## A known transformation should be recovered exactly, with invalid
+########## points ignored
+v0,q0 = mrcal.sample_imager_unproject(40, None,
+                                      *model_opencv8.imagersize(),
+                                      *model_opencv8.intrinsics(),
+                                      normalize = True)
+rt10_ref = np.array((1e-2, -2e-2, 5e-3, 0.1, -0.05, 0.02))
+
+v1 = mrcal.rotate_point_r(rt10_ref[:3], v0)
+v1[0,0,:] = np.nan
+implied_Rt10 = mrcal.implied_Rt10__from_unprojections(q0, v0, v1)
+testutils.confirm_equal( implied_Rt10[:3,:], mrcal.R_from_r(rt10_ref[:3]),
+                         eps = 1e-6,
+                         worstcase = True,
+                         msg = "implied_Rt10__from_unprojections() recovers a known rotation at infinity")
+testutils.confirm_equal( implied_Rt10[3,:], np.zeros((3,)),
+                         eps = 1e-12,
+                         worstcase = True,
+                         msg = "implied_Rt10__from_unprojections() at infinity reports t = 0")
+
+p0 = v0 * 5.
+v1 = mrcal.transform_point_rt(rt10_ref, p0)
+v1 /= nps.dummy(nps.mag(v1), -1)
+implied_Rt10 = mrcal.implied_Rt10__from_unprojections(q0, p0, v1,
+                                                      atinfinity = False)
+testutils.confirm_equal( implied_Rt10, mrcal.Rt_from_rt(rt10_ref),
+                         eps = 1e-5,
+                         worstcase = True,
+                         msg = "implied_Rt10__from_unprojections() recovers a known transformation")
+
 ########## Check outlier handling when computing diffs without uncertainties.
 ########## The model may only fit in one regions. Using data outside of that
 ########## region poisons the solve unless we treat those measurements as
@@ -97,4 +127,45 @@ testutils.confirm_equal( 0, difflen[icenter[0],icenter[1]],
                          eps = 0.1,
                          msg = "Low-enough diff with low focus_radius")
 
+########## Many models at once. Each per-model diff should match the 2-model
+########## diff, and the stdev should be computed from those
+difflen, diff, q0, implied_Rt10 = \
+    mrcal.projection_diff( (model_opencv8,model_splined,model_opencv8,model_splined),
+                           gridn_width       = gridn_width,
+                           distance          = (5,10),
+                           use_uncertainties = False,
+                           focus_radius      = 366)
+testutils.confirm_equal( diff.shape, (3,) + q0.shape,
+                         msg = "N-model diff returns per-model diffs")
+testutils.confirm_equal( implied_Rt10.shape, (3,4,3),
+                         msg = "N-model diff returns per-model transformations")
+# The opencv8 model may not be able to unproject the corners, so I ignore any
+# nan
+testutils.confirm_equal( np.nan_to_num(difflen),
+                         np.nan_to_num(np.sqrt(np.mean(nps.norm2(diff), axis=0))),
+                         worstcase = True,
+                         msg = "N-model diff reports the stdev of the per-model diffs")
+testutils.confirm_equal( np.nan_to_num(diff[1]), np.zeros(diff[1].shape),
+                         eps = 1e-6,
+                         worstcase = True,
+                         relative  = False,
+                         msg = "N-model diff of a model with itself is 0")
+for i in (0,2):
+    difflen2, _, _, implied_Rt10_2 = \
+        mrcal.projection_diff( (model_opencv8,model_splined),
+                               gridn_width       = gridn_width,
+                               distance          = (5,10),
+                               use_uncertainties = False,
+                               focus_radius      = 366)
+    testutils.confirm_equal( np.nan_to_num(nps.mag(diff[i])), np.nan_to_num(difflen2),
+                             eps = 1e-6,
+                             worstcase = True,
+                             relative  = False,
+                             msg = f"N-model diff {i} matches the 2-model diff")
+    testutils.confirm_equal( implied_Rt10[i], implied_Rt10_2,
+                             eps = 1e-9,
+                             worstcase = True,
+                             relative  = False,
+                             msg = f"N-model transformation {i} matches the 2-model transformation")
+
 testutils.finish()
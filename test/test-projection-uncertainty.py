@@ -813,6 +813,85 @@ for icam in (0,3):
                             relative  = True,
                             msg = f"var(dq) (infinity) is invariant to point scale for camera {icam}")
 
+for icam in (0,3):
+    # The C kernel processes the points in chunks, and spreads the chunks across
+    # threads. The result must not depend on the thread count
+    if icam >= args.Ncameras: break
+
+    q_grid     = mrcal.sample_imager(20, 15, *models_baseline[icam].imagersize())
+    p_cam_grid = mrcal.unproject( q_grid, *models_baseline[icam].intrinsics(),
+                                  normalize = True) * 10.
+    Var_dq_grid_1thread = \
+        mrcal.projection_uncertainty( p_cam_grid,
+                                      model    = models_baseline[icam],
+                                      Nthreads = 1 )
+    for Nthreads in (3,0):
+        Var_dq_grid = \
+            mrcal.projection_uncertainty( p_cam_grid,
+                                          model    = models_baseline[icam],
+                                          Nthreads = Nthreads )
+        testutils.confirm_equal(Var_dq_grid, Var_dq_grid_1thread,
+                                eps       = 1e-9,
+                                worstcase = True,
+                                relative  = True,
+                                msg = f"var(dq) on a grid with Nthreads={Nthreads} matches the single-threaded result for camera {icam}")
+    Var_dq_point = \
+        mrcal.projection_uncertainty( p_cam_grid[7,11],
+                                      model    = models_baseline[icam],
+                                      Nthreads = 1 )
+    testutils.confirm_equal(Var_dq_grid_1thread[7,11], Var_dq_point,
+                            eps       = 1e-9,
+                            worstcase = True,
+                            relative  = True,
+                            msg = f"var(dq) of a point in a grid matches var(dq) of the point alone for camera {icam}")
+
+for icam in (0,3):
+    # With cache=True, the covariance computed by projection_uncertainty() is
+    # cached in the model, and written to disk with it. A model read from disk
+    # should use the cache, and not re-solve. Without cache=True the model isn't
+    # touched
+    if icam >= args.Ncameras: break
+
+    p_cam_baseline = mrcal.unproject( q0_baseline, *models_baseline[icam].intrinsics(),
+                                      normalize = True)
+    Var_dq_ref = \
+        mrcal.projection_uncertainty( p_cam_baseline * 1.0,
+                                      model = models_baseline[icam] )
+    testutils.confirm(models_baseline[icam]._projection_uncertainty_cache() is None,
+                      msg = f"projection_uncertainty() doesn't populate the cache by default for camera {icam}")
+    Var_dq_cached = \
+        mrcal.projection_uncertainty( p_cam_baseline * 1.0,
+                                      model = models_baseline[icam],
+                                      cache = True )
+    testutils.confirm_equal(Var_dq_cached, Var_dq_ref,
+                            worstcase = True,
+                            relative  = True,
+                            msg = f"var(dq) with cache=True matches the factorization path for camera {icam}")
+    models_baseline[icam].write(f'{workdir}/out.cameramodel')
+    model_read = mrcal.cameramodel(f'{workdir}/out.cameramodel')
+
+    cache_ref  = models_baseline[icam]._projection_uncertainty_cache()
+    cache_read = model_read._projection_uncertainty_cache()
+    testutils.confirm(cache_read is not None,
+                      msg = f"projection uncertainty cache was written to disk for camera {icam}")
+    if cache_read is not None:
+        testutils.confirm_equal(cache_read['Var_ief'], cache_ref['Var_ief'],
+                                worstcase = True,
+                                relative  = True,
+                                msg = f"projection uncertainty cache survives a write/read for camera {icam}")
+
+    Var_dq_read = \
+        mrcal.projection_uncertainty( p_cam_baseline * 1.0,
+                                      model = model_read )
+    testutils.confirm_equal(Var_dq_read, Var_dq_ref,
+                            worstcase = True,
+                            relative  = True,
+                            msg = f"var(dq) from the cached covariance matches for camera {icam}")
+
+    model_read.intrinsics(model_read.intrinsics())
+    testutils.confirm(model_read._projection_uncertainty_cache() is None,
+                      msg = f"setting the intrinsics invalidates the projection uncertainty cache for camera {icam}")
+
 if args.no_sampling:
     testutils.finish()
     sys.exit()
@@ -958,6 +1037,31 @@ q_sampled,Var_dq = check_uncertainties_at(q0_baseline, 0)
 for idistance in range(1,len(args.distances)):
     check_uncertainties_at(q0_baseline, idistance)
 
+if args.reproject_perturbed == 'mean-frames':
+    # The built-in sampler should reproduce the same statistics. It perturbs
+    # the noisy baseline observations instead of the true ones, but in the
+    # linear regime that doesn't matter
+    distance   = args.distances[0]
+    atinfinity = distance is None
+    if atinfinity: distance = 1e5
+
+    for icam in range(args.Ncameras):
+        p_cam_baseline = mrcal.unproject(q0_baseline, lensmodel, intrinsics_baseline[icam],
+                                         normalize = True) * distance
+        testutils.confirm_equal( \
+            mrcal.projection_uncertainty_montecarlo(p_cam_baseline,
+                                                    model      = models_baseline[icam],
+                                                    Nsamples   = args.Nsamples,
+                                                    atinfinity = atinfinity,
+                                                    what       = 'worstdirection-stdev'),
+            mrcal.projection_uncertainty(p_cam_baseline,
+                                         model      = models_baseline[icam],
+                                         atinfinity = atinfinity,
+                                         what       = 'worstdirection-stdev'),
+            eps = 0.2,
+            relative = True,
+            msg = f"projection_uncertainty_montecarlo() matches projection_uncertainty() for camera {icam}")
+
 if not (args.explore or \
         args.show_distribution or \
         args.make_documentation_plots is not None):
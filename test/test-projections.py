@@ -117,6 +117,27 @@ check( ('LENSMODEL_CAHVORE', np.array((4842.918, 4842.771, 1970.528, 1085.302,
                  [ 872.53696336, -731.32905711]]))
 
 
+# A big batch of CAHVORE unprojections. These are split among threads, unless
+# the intrinsics broadcast. Both paths should produce the same result
+intrinsics = ('LENSMODEL_CAHVORE', np.array((4842.918, 4842.771, 1970.528, 1085.302,
+                                             -0.001, 0.002, -0.637, -0.002, 0.016, 1e-2, 2e-2, 3e-2, 0.4)))
+q = nps.mv( nps.cat(*np.meshgrid(np.linspace(100, 3900, 40),
+                                 np.linspace(100, 2100, 30))),
+            0, -1)
+v = mrcal.unproject(q, *intrinsics)
+testutils.confirm_equal( mrcal.project(v, *intrinsics), q,
+                         worstcase = True,
+                         eps = 1e-6,
+                         msg = "Unprojecting a batch of CAHVORE points")
+v_broadcasted = mrcal.unproject(q, intrinsics[0],
+                                # shape (2,1,1,Nintrinsics)
+                                nps.dummy(nps.cat(intrinsics[1], intrinsics[1]), -2, -2))
+testutils.confirm_equal( v_broadcasted[0], v,
+                         worstcase = True,
+                         eps = 1e-8,
+                         msg = "Unprojecting a batch of CAHVORE points with broadcasted intrinsics")
+
+
 # Note that some of the projected points are behind the camera (z<0), which is
 # possible with these models. Also note that some of the projected points are
 # off the imager (x<0). This is aphysical, but it just means that the model was
@@ -37,4 +37,57 @@ meta_ref = {'has_core': 1,
 testutils.confirm_equal(meta, meta_ref,
                         msg="lensmodel_metadata() keys")
 
+
+# The C synthetic-observation generator depends on the seed, but not on the
+# number of threads
+model_opencv8 = mrcal.cameramodel(f"{testdir}/data/cam0.opencv8.cameramodel")
+model_opencv8 = mrcal.cameramodel( intrinsics = model_opencv8.intrinsics(),
+                                   imagersize = model_opencv8.imagersize() )
+args = ( (model_opencv8,model_opencv8),
+         10,12,0.1, np.array((0.002, -0.001)),
+         np.array((0.,0.,0., 0.,0.,2.)),
+         np.array((0.1,0.1,0.1, 0.3,0.3,0.3)),
+         20 )
+q1,Rt1 = mrcal.synthesize_board_observations(*args, seed = 5, Nthreads = 1)
+q4,Rt4 = mrcal.synthesize_board_observations(*args, seed = 5, Nthreads = 4)
+testutils.confirm_equal(q4, q1,
+                        eps = 0,
+                        worstcase = True,
+                        msg="synthesize_board_observations(seed) doesn't depend on Nthreads: q")
+testutils.confirm_equal(Rt4, Rt1,
+                        eps = 0,
+                        worstcase = True,
+                        msg="synthesize_board_observations(seed) doesn't depend on Nthreads: Rt")
+q_ref = mrcal.project( mrcal.transform_point_Rt( nps.mv(Rt1, -3, -5),
+                                                 mrcal.ref_calibration_object(10,12,0.1,
+                                                                              np.array((0.002, -0.001))) ),
+                       *model_opencv8.intrinsics())
+testutils.confirm_equal(q1[:,0,...], q_ref,
+                        eps = 1e-6,
+                        worstcase = True,
+                        msg="synthesize_board_observations(seed) returns consistent q,Rt")
+
+# _A_Jt_J_At() evaluates many A at once, with a sparse J
+import scipy.sparse
+J = scipy.sparse.random(500, 40, density = 0.1, format = 'csr',
+                        random_state = np.random.default_rng(0))
+A = np.random.default_rng(1).random((10,2,40))
+Nleading_rows_J = 400
+args = (A,
+        J.indptr .astype(np.int32),
+        J.indices.astype(np.int32),
+        J.data   .astype(float))
+J_leading = J[:Nleading_rows_J].toarray()
+AJtJAt_ref = nps.matmult(A, nps.transpose(J_leading), J_leading, nps.transpose(A))
+testutils.confirm_equal(mrcal._mrcal_npsp._A_Jt_J_At(*args, Nleading_rows_J = Nleading_rows_J),
+                        AJtJAt_ref,
+                        worstcase = True,
+                        relative  = True,
+                        msg="_A_Jt_J_At() with many A")
+testutils.confirm_equal(mrcal._mrcal_npsp._A_Jt_J_At(*args, Nleading_rows_J = Nleading_rows_J, Nthreads = 3),
+                        mrcal._mrcal_npsp._A_Jt_J_At(*args, Nleading_rows_J = Nleading_rows_J, Nthreads = 1),
+                        eps = 0,
+                        worstcase = True,
+                        msg="_A_Jt_J_At() doesn't depend on Nthreads")
+
 testutils.finish()
@@ -127,6 +127,38 @@ testutils.confirm_equal( cookie['baseline'],
                          nps.mag(rt01[3:]),
                          msg='funny stereo: baseline')
 
+# The maps are computed in C. Make sure they match the straightforward
+# computation: unproject the rectified directions, rotate them into each camera,
+# and project
+vstereo = mrcal.stereo_unproject(cookie['az_row'], cookie['el_col'])
+vcam0   = mrcal.rotate_point_R(Rt_cam0_stereo[:3,:], vstereo)
+vcam1   = mrcal.rotate_point_r(-rt01[:3], vcam0)
+for icam,(v,model) in enumerate(((vcam0,model0), (vcam1,model1))):
+    testutils.confirm_equal( rectification_maps[icam],
+                             mrcal.project(v, *model.intrinsics()),
+                             worstcase = True,
+                             eps = 1e-3,
+                             msg=f'rectification map {icam} matches the reference computation')
+
+rectification_maps_fixed,_ = \
+    mrcal.stereo_rectify_prepare( (model0, model1),
+                                  az_fov_deg = az_fov_deg,
+                                  el_fov_deg = el_fov_deg,
+                                  pixels_per_deg_az = -1./8.,
+                                  pixels_per_deg_el = -1./4.,
+                                  fixed_point_maps  = True)
+for icam in range(2):
+    xy,interpolation = rectification_maps_fixed[icam]
+    q = xy + \
+        nps.mv(nps.cat(interpolation % 32, interpolation // 32), 0, -1) / 32.
+    # Far-off-imager points don't fit into the fixed-point map, so I only
+    # compare the points that do
+    i = np.all(np.abs(rectification_maps[icam]) < 30000, axis=-1)
+    testutils.confirm_equal( q[i], rectification_maps[icam][i],
+                             worstcase = True,
+                             eps = 0.5/32. + 1e-3,
+                             msg=f'fixed-point rectification map {icam} matches the float map')
+
 
 # I examine points somewhere in space. I make sure the rectification maps
 # transform it properly. And I compute what its az,el and disparity would have